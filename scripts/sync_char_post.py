@@ -403,6 +403,27 @@ def calculate_new_data_independence (worksets_entry, histogram) :
     #worksets_entry['window_start'] += DI_WINDOW_INCREMENT
 
         
+# Counts over a lock's logged worksets estimate counts over all its
+# critical sections when scaled by opened / sampled.  The windowed
+# metrics can't be: they compare neighbouring logged worksets, which
+# under sampling were not neighbouring critical sections, so they are
+# dropped and the lock is marked as sampled.
+def scale_sampled_lock(entry, rate) :
+    for key in entry['histogram'].keys() :
+        entry['histogram'][key] = int(round(entry['histogram'][key] * rate))
+    for key in ['q_count_dependent', 'q_count_independent',
+                'q_count_dependent_total_bytes',
+                'q_count_dependent_conflicting_bytes'] :
+        entry[key] = int(round(entry[key] * rate))
+
+    entry['di_sampled'] = rate
+    entry['hotos_data_dependence'] = 0.0
+    entry['hotos_dependent_bytes'] = 0.0
+    entry['hotos_dependent_bytes_pct'] = 0.0
+    for key in ['average_conflicts', 'average_completions',
+                'average_threads', 'conflict_density'] :
+        entry[key] = [0.0]*len(NUM_CPUS)
+
 def strip_underscore(key) :
     addr_re = re.compile(r'^(?P<addr>0x[a-fA-F0-9]+)')
     m = addr_re.match(key)
@@ -500,41 +521,23 @@ def print_map_av(mmap, keys, sort_key, ksym, num_print, title, print_desc, cycle
 
 
         # % of this kind of sync, then % of total cyc
-        # then avg(sd) for total/short/long instances
+        # then avg/p99/max cycles per instance
         # then percent conflicting datasets, average
         # conflict size for conflicting sets, average
         # conflict percent for conflicting sets
         cnt_total = float(mmap[key][sort_key][0])
-        cnt_short = float(mmap[key][sort_key][3])
-        cnt_long = float(mmap[key][sort_key][6])
 
         # Weighted total of data dependent things we are calculating
         #total_dependent += (mmap[key][sort_key][1] * mmap[key]['hotos_data_dependence'])
 
-        print '%4.2f%%(%4.2f%%) %s(%s)/%s(%s)/%s(%s) %.2f%% %.2f %.2f%%: %s' %(
+        print '%4.2f%%(%4.2f%%) %s/%s/%s %.2f%% %.2f %.2f%%: %s' %(
             ( 100.0 * mmap[key][sort_key][1] ) / key_sum,
             ( 100.0 * mmap[key][sort_key][1] ) / cycles,
 
             commify(str(
                 int(compute_average(mmap[key][sort_key][1], cnt_total)) )),
-            commify(str(
-               int(math.sqrt(math.fabs(
-               compute_average(mmap[key][sort_key][2], cnt_total) - 
-               compute_average(mmap[key][sort_key][1]**2, cnt_total) ))) )),
-
-            commify(str(
-               int(compute_average(mmap[key][sort_key][4], cnt_short)) )),
-            commify(str(
-               int(math.sqrt(math.fabs(
-               compute_average(mmap[key][sort_key][5], cnt_short) - 
-               compute_average(mmap[key][sort_key][4]**2, cnt_short) ))) )),
-
-            commify(str(
-               int(compute_average(mmap[key][sort_key][7], cnt_long)) )),
-            commify(str(
-               int(math.sqrt(math.fabs(
-               compute_average(mmap[key][sort_key][8], cnt_long) - 
-               compute_average(mmap[key][sort_key][7]**2, cnt_long) ))) )),
+            commify(str(mmap[key][sort_key][4])),
+            commify(str(mmap[key][sort_key][6])),
 
             100*mmap[key]['hotos_data_dependence'],
             mmap[key]['hotos_dependent_bytes'],
@@ -542,7 +545,9 @@ def print_map_av(mmap, keys, sort_key, ksym, num_print, title, print_desc, cycle
 
             key_str)
 
-        if len(mmap[key]['average_conflicts']) :
+        if mmap[key].get('di_sampled', 0) :
+            print '  Projected optimism: none, worksets sampled 1 in %.2f' % mmap[key]['di_sampled']
+        elif len(mmap[key]['average_conflicts']) :
             po_str = '  Projected optimism of %d max (ok/conf): ' % mmap[key]['max_threads']
             for i in xrange(len(mmap[key]['average_conflicts'])) :
                 po_str += '(%d: %.2f/%.2f, %.2f, %.2f), ' % (NUM_CPUS_ARRAY[i], \
@@ -572,8 +577,12 @@ def print_map_scalar(mmap, keys, sort_key, ksym, num_print, title, print_desc) :
     total_density16 = 0.0
     total_density32 = 0.0
     weight = 0.0
-    for key in keys :
-        weight = float(mmap[key][sort_key]) / float(key_sum)
+    # Locks whose worksets were sampled have no data independence
+    di_keys = [key for key in keys if not mmap[key].get('di_sampled', 0)]
+    di_key_sum = sum([mmap[key][sort_key] for key in di_keys])
+    if di_key_sum == 0 : di_keys = []
+    for key in di_keys :
+        weight = float(mmap[key][sort_key]) / float(di_key_sum)
         total_independent16 +=  mmap[key]['average_completions'][NUM_CPUS[16]] * weight
         total_independent32 += mmap[key]['average_completions'][NUM_CPUS[32]] * weight
         total_density16 += mmap[key]['conflict_density'][NUM_CPUS[16]] * weight
@@ -618,7 +627,9 @@ def print_map_scalar(mmap, keys, sort_key, ksym, num_print, title, print_desc) :
 
             key_str)
 
-        if len(mmap[key]['average_conflicts']) :
+        if mmap[key].get('di_sampled', 0) :
+            print '  Projected optimism: none, worksets sampled 1 in %.2f' % mmap[key]['di_sampled']
+        elif len(mmap[key]['average_conflicts']) :
             po_str = '  Projected optimism of %d max (ok/conf): ' % mmap[key]['max_threads']
             for i in xrange(len(mmap[key]['average_conflicts'])) :
                 po_str += '(%d: %.2f/%.2f, %.2f, %.2f), ' % (NUM_CPUS_ARRAY[i], \
@@ -780,6 +791,8 @@ def print_important_locks(mmap, cycles, idle_cycles, cpu_count, freq_mhz) :
                 speedup, projected_seconds, mmap[key]['asymmetry_rate'])
 
             print 'Average workset size (words): %.2f' % mmap[key]['avg_workset_size_words']
+            if mmap[key].get('di_sampled', 0) :
+                print 'No data independence: worksets sampled 1 in %.2f' % mmap[key]['di_sampled']
 
             print_conflict_histogram(mmap[key]['histogram'])
 
@@ -873,16 +886,15 @@ def process_exp(lockmap, callmap, ksym, cycles, idle_cycles, nm_sym, cpu_count,
         print_all('Futex', lockmap, callmap, futex_set, ksym,
                   opt_sync_categories, cycles, nm_sym, cpu_count, freq_mhz)
 
-def add_av(i, m, lockmap, lock_addr, field) :
+# A histogram is count sum p50 p90 p99 p99.9 max.  Counts and sums
+# add; the percentiles of merged histograms can't be recovered, so
+# each keeps the largest, which bounds the merged one from above.
+def add_hist(i, m, lockmap, lock_addr, field) :
     lockmap[lock_addr][field][0] += long(m.group(i + 0))
     lockmap[lock_addr][field][1] += long(m.group(i + 1))
-    lockmap[lock_addr][field][2] += long(m.group(i + 2))
-    lockmap[lock_addr][field][3] += long(m.group(i + 3))
-    lockmap[lock_addr][field][4] += long(m.group(i + 4))
-    lockmap[lock_addr][field][5] += long(m.group(i + 5))
-    lockmap[lock_addr][field][6] += long(m.group(i + 6))
-    lockmap[lock_addr][field][7] += long(m.group(i + 7))
-    lockmap[lock_addr][field][8] += long(m.group(i + 8))
+    for j in xrange(2, 7) :
+        lockmap[lock_addr][field][j] = max(lockmap[lock_addr][field][j],
+                                           long(m.group(i + j)))
 
 def usage() :
     print sys.argv[0] + \
@@ -1018,8 +1030,7 @@ inst_line_re = re.compile(r'''
    (?P<rsize>\d+)\s+                 # Aggregate size of workets, split by r/w/total
    (?P<wsize>\d+)\s+
    (?P<size>\d+)\s+
-   (?P<nest_depth>([\d\.]+\s+){9})   # Average variable for lock nesting depth
-                                     # splits at 1
+   (?P<nest_depth>(\d+\s+){7})        # Histogram of lock nesting depth
 ''', re.VERBOSE)
 
 caller_re = re.compile(r'''
@@ -1027,16 +1038,45 @@ caller_re = re.compile(r'''
    ^\s*                               # Begin with an arbitrary amount of space
    (?P<caller_ra>0?x?[a-fA-F0-9]+)\s+ # Followed by the return addr in hex
 
-   (\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+   # And 22 ints with various and sundry
-   (\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+   # meanings
-   (\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+
-   (\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+
-   (\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+
-   (\d+)\s+(\d+)                      
+   (\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+   # flags count q_count useless_release
+
+   (\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+   # Acquire cycles histogram
+   (\d+)\s+(\d+)\s+(\d+)\s+
+
+   (\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+   # Hold cycles histogram
+   (\d+)\s+(\d+)\s+(\d+)
 
 ''', re.VERBOSE)
 
 
+# Data independence computed by syncchar itself (online_independence)
+di_lock_re = re.compile(r'''
+   ^DI_LOCK\s+                       # Follows the lock's stats line
+   (?P<lock_addr>0x[a-fA-F0-9_]+)    # Lock addr, as on the stats line
+   \((?P<lock_name>.*)\)\s+          # Name of the lock in parens
+   (?P<closes>\d+)\s+                # Worksets closed
+   (?P<pids>\d+)\s+                  # Distinct pids that closed one
+''', re.VERBOSE)
+
+# One cpu count's sums on a DI_LOCK line
+di_cpus_re = re.compile(r'''
+   \[\s*(?P<cpus>\d+)\s+
+   (?P<samples>\d+)\s+
+   (?P<conflicting>\d+)\s+
+   (?P<completions>\d+)\s+
+   (?P<threads>\d+)\s+
+   (?P<density>[\d\.]+)
+''', re.VERBOSE)
+
+# Sampled worksets (ws_sample_rate and friends)
+ws_sample_re = re.compile(r'''
+   ^WS_SAMPLE\s+                     # Follows the lock's stats line
+   (?P<lock_addr>0x[a-fA-F0-9_]+)    # Lock addr, as on the stats line
+   \((?P<lock_name>.*)\)\s+          # Name of the lock in parens
+   (?P<opened>\d+)\s+                # Critical sections
+   (?P<sampled>\d+)                  # Those whose worksets were collected
+''', re.VERBOSE)
+
 # Regex to get the lock addr from the lockaddr_version combo
 lock_addr_re = re.compile(r'''
    ^(?P<lock_addr>0?x?[a-fA-F0-9]+)  # Ignore subsequent _...  
@@ -1200,8 +1240,8 @@ while 1 :
             'q_count_dependent_total_bytes' : 0,
             'q_count_dependent_conflicting_bytes' : 0,
             'useless_release' : 0,
-            'acq_total'  : [0, 0, 0, 0, 0, 0, 0, 0, 0],
-            'hold_total' : [0, 0, 0, 0, 0, 0, 0, 0, 0],
+            'acq_total'  : [0, 0, 0, 0, 0, 0, 0],
+            'hold_total' : [0, 0, 0, 0, 0, 0, 0],
             'hotos_data_dependence' : hotos_data_dependence_values[0],
             'hotos_dependent_bytes' : hotos_data_dependence_values[1],
             'hotos_dependent_bytes_pct' : hotos_data_dependence_values[2],
@@ -1221,6 +1261,8 @@ while 1 :
             'avg_workset_size_words' : avg_workset_size_words,
             # Nesting depth
             'nest_depth' : nest_depth,
+            # 1 in how many worksets were logged, if they were sampled
+            'di_sampled' : 0,
             }
 
         if q_count.has_key(lock_addr) and q_count[lock_addr].has_key(lock_generation) :
@@ -1239,8 +1281,8 @@ while 1 :
                 lockmap[lock_addr]['count'] += int(ma.group(3))
                 lockmap[lock_addr]['q_count'] += int(ma.group(4))
                 lockmap[lock_addr]['useless_release'] += int(ma.group(5))
-                add_av( 6, ma, lockmap, lock_addr, 'acq_total')
-                add_av(15, ma, lockmap, lock_addr, 'hold_total')
+                add_hist( 6, ma, lockmap, lock_addr, 'acq_total')
+                add_hist(13, ma, lockmap, lock_addr, 'hold_total')
                 
                 if not callmap.has_key(caller_ra) :
                     callmap[caller_ra] = {
@@ -1254,8 +1296,8 @@ while 1 :
                         'q_count_dependent_conflicting_bytes' : 0,
                         'useless_release' : 0,
                         'lock_id' : set(),
-                        'acq_total'  : [0, 0, 0, 0, 0, 0, 0, 0, 0],
-                        'hold_total' : [0, 0, 0, 0, 0, 0, 0, 0, 0],
+                        'acq_total'  : [0, 0, 0, 0, 0, 0, 0],
+                        'hold_total' : [0, 0, 0, 0, 0, 0, 0],
                         # We shouldn't use these values for anything
                         'hotos_data_dependence' : 0,
                         'hotos_dependent_bytes' : 0,
@@ -1271,12 +1313,41 @@ while 1 :
                 callmap[caller_ra]['q_count'] += int(ma.group(4))
                 callmap[caller_ra]['useless_release'] += int(ma.group(5))
                 callmap[caller_ra]['lock_id'].add(lock_id)
-                add_av( 6, ma, callmap, caller_ra, 'acq_total')
-                add_av(15, ma, callmap, caller_ra, 'hold_total')
+                add_hist( 6, ma, callmap, caller_ra, 'acq_total')
+                add_hist(13, ma, callmap, caller_ra, 'hold_total')
             else :
                 assert False, caller
         continue
 
+    # Online data independence, used for locks whose worksets
+    # weren't logged
+    m = di_lock_re.match(line)
+    if m :
+        lock_addr = m.group('lock_addr')
+        if lockmap.has_key(lock_addr) and lockmap[lock_addr]['max_threads'] == 0 :
+            lockmap[lock_addr]['max_threads'] = int(m.group('pids'))
+            for mc in di_cpus_re.finditer(line) :
+                cpus = int(mc.group('cpus'))
+                samples = int(mc.group('samples'))
+                if not NUM_CPUS.has_key(cpus) or samples == 0 :
+                    continue
+                i = NUM_CPUS[cpus]
+                lockmap[lock_addr]['average_conflicts'][i] = float(mc.group('conflicting')) / samples
+                lockmap[lock_addr]['average_completions'][i] = float(mc.group('completions')) / samples
+                lockmap[lock_addr]['average_threads'][i] = float(mc.group('threads')) / samples
+                lockmap[lock_addr]['conflict_density'][i] = float(mc.group('density')) / samples
+        continue
+
+    # Only some of this lock's worksets were logged
+    m = ws_sample_re.match(line)
+    if m :
+        lock_addr = m.group('lock_addr')
+        opened = long(m.group('opened'))
+        sampled = long(m.group('sampled'))
+        if lockmap.has_key(lock_addr) and 0 < sampled < opened :
+            scale_sampled_lock(lockmap[lock_addr], float(opened) / sampled)
+        continue
+
     # Do we match the workset for a given lock acq/release
     m = workset_re.match(line)
     if m :
@@ -0,0 +1,139 @@
+// MetaTM Project
+// File Name: CacheTrace.cc
+//
+// Description: binary cache event trace writer (format in
+// CacheTrace.h)
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include "simulator.h"
+#include <string.h>
+#include "CacheTrace.h"
+
+using namespace std;
+
+// One cache's block being filled
+typedef struct _ctrace_buf_t {
+   ctrace_block_header_t hdr;
+   uint64_t prev_seq;
+   cycles_t prev_cycle;
+   uint64_t prev_addr;
+   uint64_t prev_tag;
+   unsigned char data[CTRACE_BLOCK_BYTES];
+} ctrace_buf_t;
+
+struct _cache_trace_t {
+   FILE *fp;
+   uint64_t seq;
+   vector<ctrace_buf_t *> bufs;
+};
+
+cache_trace_t *cache_trace_open(const char *filename) {
+   FILE *fp = fopen(filename, "wb");
+   if(!fp)
+      return NULL;
+   ctrace_file_header_t fh;
+   memset(&fh, 0, sizeof(fh));
+   memcpy(fh.magic, CTRACE_MAGIC, sizeof(CTRACE_MAGIC));
+   fh.version = CTRACE_VERSION;
+   fh.block_bytes = CTRACE_BLOCK_BYTES;
+   if(fwrite(&fh, sizeof(fh), 1, fp) != 1) {
+      fclose(fp);
+      return NULL;
+   }
+   cache_trace_t *t = new cache_trace_t;
+   t->fp = fp;
+   t->seq = 0;
+   return t;
+}
+
+static void write_block(cache_trace_t *t, ctrace_buf_t *b) {
+   if(!b->hdr.nevents)
+      return;
+   fwrite(&b->hdr, sizeof(b->hdr), 1, t->fp);
+   fwrite(b->data, b->hdr.bytes, 1, t->fp);
+   b->hdr.nevents = 0;
+   b->hdr.bytes = 0;
+}
+
+void cache_trace_event(cache_trace_t *t, int cpu, cycles_t cycle,
+                       pcache_event evt) {
+   if(!t || !evt || cpu < 0)
+      return;
+   if((unsigned int)cpu >= t->bufs.size())
+      t->bufs.resize(cpu + 1, NULL);
+   ctrace_buf_t *b = t->bufs[cpu];
+   if(!b) {
+      b = t->bufs[cpu] = new ctrace_buf_t;
+      memset(&b->hdr, 0, sizeof(b->hdr));
+      b->hdr.magic = CTRACE_BLOCK_MAGIC;
+      b->hdr.cpu = cpu;
+   }
+   if(b->hdr.bytes + CTRACE_MAX_EVENT > CTRACE_BLOCK_BYTES)
+      write_block(t, b);
+   if(!b->hdr.nevents) {
+      // deltas restart with each block
+      b->hdr.first_seq = b->prev_seq = t->seq;
+      b->hdr.first_cycle = b->prev_cycle = cycle;
+      b->prev_addr = 0;
+      b->prev_tag = 0;
+   }
+
+   unsigned char *p = b->data + b->hdr.bytes;
+   unsigned int n = 0;
+   p[n++] = (evt->otyp & 0xf) | ((evt->status & 0x3) << 4) |
+      (evt->evaddr ? 0x40 : 0) | (evt->xID ? 0x80 : 0);
+   p[n++] = (evt->mc & 0x7) | ((evt->ctyp & 0x1) << 3) |
+      (evt->comm_next ? 0x10 : 0) | (evt->write_next ? 0x20 : 0) |
+      (evt->copy_next ? 0x40 : 0);
+   p[n++] = (unsigned char)((int)evt->state + 1);
+   n += ctrace_put_varint(p + n, t->seq - b->prev_seq);
+   n += ctrace_put_varint(p + n, ctrace_zigzag(cycle - b->prev_cycle));
+   n += ctrace_put_varint(p + n, ctrace_zigzag(evt->addr - b->prev_addr));
+   n += ctrace_put_varint(p + n, ctrace_zigzag(evt->tag - b->prev_tag));
+   n += ctrace_put_varint(p + n, (uint64_t)evt->latency);
+   if(evt->evaddr)
+      n += ctrace_put_varint(p + n, ctrace_zigzag(evt->evaddr - evt->addr));
+   if(evt->xID)
+      n += ctrace_put_varint(p + n, ctrace_zigzag(evt->xID));
+
+   b->hdr.bytes += n;
+   b->hdr.nevents++;
+   b->prev_seq = t->seq++;
+   b->prev_cycle = cycle;
+   b->prev_addr = evt->addr;
+   b->prev_tag = evt->tag;
+}
+
+void cache_trace_flush(cache_trace_t *t) {
+   if(!t)
+      return;
+   for(unsigned int i = 0; i < t->bufs.size(); i++)
+      if(t->bufs[i])
+         write_block(t, t->bufs[i]);
+   fflush(t->fp);
+}
+
+void cache_trace_close(cache_trace_t *t) {
+   if(!t)
+      return;
+   cache_trace_flush(t);
+   fclose(t->fp);
+   for(unsigned int i = 0; i < t->bufs.size(); i++)
+      delete t->bufs[i];
+   delete t;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
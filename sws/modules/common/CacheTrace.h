@@ -0,0 +1,118 @@
+// MetaTM Project
+// File Name: CacheTrace.h
+//
+// Description: Binary cache event trace.  The text trace
+// (dump_event) formats every event with several sprintfs and an
+// fprintf; this writes the same cache_event records packed, a few
+// bytes each, for CacheTraceReader and cachetrace-check to decode
+// offline.  C callable, so g-cache and txcache can use it like the
+// rest of osacachetrace.h; include it after the Simics headers (for
+// cycles_t and the txcache types).
+//
+// Each cache (cpu) fills its own buffer, which goes to the file as a
+// block when full.  A block decodes on its own: its header holds the
+// cache, the event count and the sequence number and cycle the deltas
+// start from.  Events carry a sequence number that is global across
+// caches so the reader can rebuild the original interleaving.
+//
+// File layout:
+//    ctrace_file_header_t
+//    blocks: ctrace_block_header_t, followed by bytes of events
+//
+// A trace that was not closed is missing the events still buffered;
+// a block cut short by a crash is dropped by the reader.
+//
+// Event encoding:
+//    byte 0: otyp (bits 0-3), status (4-5), has evaddr (6), has xID (7)
+//    byte 1: mc (bits 0-2), ctyp (3), comm_next (4), write_next (5),
+//            copy_next (6)
+//    byte 2: state + 1
+//    varints: seq - previous seq, then zigzag deltas of cycle, addr
+//             and tag from the previous event's, then latency
+//    if has evaddr: zigzag varint of evaddr - addr
+//    if has xID: zigzag varint of xID
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef CACHETRACE_H
+#define CACHETRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "osacachetrace.h"
+
+#define CTRACE_MAGIC         "OSACTRC"
+#define CTRACE_BLOCK_MAGIC   0x4b4c4243    // "CBLK"
+#define CTRACE_VERSION       1
+
+// Bytes of events per block; a block is written out when the next
+// event might not fit
+#define CTRACE_BLOCK_BYTES   (64 * 1024)
+// 3 bytes of fields and at most 7 varints of 10 bytes
+#define CTRACE_MAX_EVENT     73
+
+typedef struct _ctrace_file_header_t {
+   char magic[8];
+   uint32_t version;
+   uint32_t block_bytes;
+} ctrace_file_header_t;
+
+typedef struct _ctrace_block_header_t {
+   uint32_t magic;
+   uint32_t cpu;
+   uint32_t nevents;
+   uint32_t bytes;
+   uint64_t first_seq;
+   uint64_t first_cycle;
+} ctrace_block_header_t;
+
+typedef struct _cache_trace_t cache_trace_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+// NULL if filename can't be created
+cache_trace_t *cache_trace_open(const char *filename);
+// Record evt, seen by cache cpu at cycle
+void cache_trace_event(cache_trace_t *t, int cpu, cycles_t cycle,
+                       pcache_event evt);
+// Write out every partly filled buffer
+void cache_trace_flush(cache_trace_t *t);
+void cache_trace_close(cache_trace_t *t);
+#ifdef __cplusplus
+};
+#endif
+
+static inline unsigned int ctrace_put_varint(unsigned char *p, uint64_t v) {
+   unsigned int n = 0;
+   while(v >= 0x80) {
+      p[n++] = (unsigned char)(v | 0x80);
+      v >>= 7;
+   }
+   p[n++] = (unsigned char)v;
+   return n;
+}
+
+static inline uint64_t ctrace_zigzag(int64_t v) {
+   return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t ctrace_unzigzag(uint64_t v) {
+   return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
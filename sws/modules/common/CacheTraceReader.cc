@@ -0,0 +1,389 @@
+// MetaTM Project
+// File Name: CacheTraceReader.cc
+//
+// Description: binary cache event trace reader and TMESI checker
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <string.h>
+#include "CacheTraceReader.h"
+
+using namespace std;
+
+CacheTraceReader::CacheTraceReader(const char *filename) :
+   fp(NULL), blocks(0), events(0), short_block(false) {
+   FILE *f = fopen(filename, "rb");
+   if(!f) {
+      err = string(filename) + ": " + strerror(errno);
+      return;
+   }
+   ctrace_file_header_t fh;
+   if(fread(&fh, sizeof(fh), 1, f) != 1 ||
+      memcmp(fh.magic, CTRACE_MAGIC, sizeof(CTRACE_MAGIC))) {
+      err = string(filename) + ": not a cache trace";
+      fclose(f);
+      return;
+   }
+   if(fh.version != CTRACE_VERSION || fh.block_bytes > CTRACE_BLOCK_BYTES) {
+      err = string(filename) + ": unsupported cache trace version";
+      fclose(f);
+      return;
+   }
+   fp = f;
+   scan_blocks();
+}
+
+CacheTraceReader::~CacheTraceReader() {
+   if(fp)
+      fclose(fp);
+}
+
+// Index each cache's blocks, in file order (which is their order)
+void CacheTraceReader::scan_blocks() {
+   fseeko(fp, 0, SEEK_END);
+   long long len = ftello(fp);
+   long long off = sizeof(ctrace_file_header_t);
+   ctrace_block_header_t h;
+   while(off < len) {
+      fseeko(fp, off, SEEK_SET);
+      if(fread(&h, sizeof(h), 1, fp) != 1 ||
+         h.magic != CTRACE_BLOCK_MAGIC || h.bytes > CTRACE_BLOCK_BYTES ||
+         off + (long long)sizeof(h) + h.bytes > len) {
+         short_block = true;
+         break;
+      }
+      if(h.cpu >= streams.size()) {
+         unsigned int n = streams.size();
+         streams.resize(h.cpu + 1);
+         for(unsigned int i = n; i < streams.size(); i++) {
+            streams[i].next_block = 0;
+            streams[i].pos = 0;
+            streams[i].left = 0;
+            streams[i].have = false;
+         }
+      }
+      streams[h.cpu].blocks.push_back(make_pair(off + (long long)sizeof(h), h));
+      blocks++;
+      events += h.nevents;
+      off += sizeof(h) + h.bytes;
+   }
+   for(unsigned int i = 0; i < streams.size(); i++)
+      advance(streams[i]);
+}
+
+unsigned int CacheTraceReader::ncpus() const {
+   unsigned int n = 0;
+   for(unsigned int i = 0; i < streams.size(); i++)
+      if(!streams[i].blocks.empty())
+         n++;
+   return n;
+}
+
+bool CacheTraceReader::get_varint(ctrace_stream_t &s, uint64_t &v) {
+   v = 0;
+   for(int shift = 0; shift < 64 && s.pos < s.data.size(); shift += 7) {
+      unsigned char c = s.data[s.pos++];
+      v |= (uint64_t)(c & 0x7f) << shift;
+      if(!(c & 0x80))
+         return true;
+   }
+   return false;
+}
+
+// Decode the stream's next event into s.rec
+bool CacheTraceReader::advance(ctrace_stream_t &s) {
+   s.have = false;
+   if(!s.left) {
+      if(s.next_block >= s.blocks.size())
+         return false;
+      const ctrace_block_header_t &h = s.blocks[s.next_block].second;
+      s.data.resize(h.bytes);
+      fseeko(fp, s.blocks[s.next_block].first, SEEK_SET);
+      if(h.bytes && fread(&s.data[0], h.bytes, 1, fp) != 1) {
+         err = "short read";
+         return false;
+      }
+      s.next_block++;
+      s.pos = 0;
+      s.left = h.nevents;
+      s.rec.cpu = h.cpu;
+      s.rec.seq = h.first_seq;
+      s.rec.cycle = h.first_cycle;
+      s.prev_addr = 0;
+      s.prev_tag = 0;
+      if(!s.left)
+         return advance(s);
+   }
+
+   ctrace_record_t &r = s.rec;
+   cache_event &e = r.evt;
+   uint64_t seq, cycle, addr, tag, latency, v;
+   if(s.pos + 3 > s.data.size())
+      goto corrupt;
+   {
+      unsigned char b0 = s.data[s.pos], b1 = s.data[s.pos + 1];
+      int state = (int)s.data[s.pos + 2] - 1;
+      s.pos += 3;
+      e.otyp = (optype)(b0 & 0xf);
+      e.status = (hmstatus)((b0 >> 4) & 0x3);
+      e.mc = (missclass)(b1 & 0x7);
+      e.ctyp = (cache_type)((b1 >> 3) & 0x1);
+      e.comm_next = (b1 >> 4) & 1;
+      e.write_next = (b1 >> 5) & 1;
+      e.copy_next = (b1 >> 6) & 1;
+      e.state = (enum state_t)state;
+      if(!get_varint(s, seq) || !get_varint(s, cycle) ||
+         !get_varint(s, addr) || !get_varint(s, tag) ||
+         !get_varint(s, latency))
+         goto corrupt;
+      r.seq += seq;
+      r.cycle += ctrace_unzigzag(cycle);
+      e.addr = s.prev_addr += ctrace_unzigzag(addr);
+      e.tag = s.prev_tag += ctrace_unzigzag(tag);
+      e.latency = latency;
+      e.evaddr = 0;
+      e.xID = 0;
+      if(b0 & 0x40) {
+         if(!get_varint(s, v))
+            goto corrupt;
+         e.evaddr = e.addr + ctrace_unzigzag(v);
+      }
+      if(b0 & 0x80) {
+         if(!get_varint(s, v))
+            goto corrupt;
+         e.xID = (int)ctrace_unzigzag(v);
+      }
+   }
+   s.left--;
+   s.have = true;
+   return true;
+
+ corrupt:
+   err = "corrupt block";
+   s.left = 0;
+   s.next_block = s.blocks.size();
+   return false;
+}
+
+bool CacheTraceReader::next(ctrace_record_t &r) {
+   if(!err.empty())
+      return false;
+   ctrace_stream_t *min = NULL;
+   for(unsigned int i = 0; i < streams.size(); i++)
+      if(streams[i].have && (!min || streams[i].rec.seq < min->rec.seq))
+         min = &streams[i];
+   if(!min)
+      return false;
+   r = min->rec;
+   advance(*min);
+   return true;
+}
+
+// Index of a txcache state in the tables
+#define SI(s)  ((int)(s) + 1)
+
+static const int txc_I = SI(STATE_I), txc_S = SI(STATE_S),
+   txc_E = SI(STATE_E), txc_M = SI(STATE_M), txc_TI = SI(STATE_TI),
+   txc_TS = SI(STATE_TS), txc_TE = SI(STATE_TE), txc_TMI = SI(STATE_TMI),
+   txc_TM = SI(STATE_TM);
+
+// from, then the states it may go to
+static const int default_transitions[][CTRACE_NSTATES + 1] = {
+   { txc_I, txc_I, txc_S, txc_E, txc_M, txc_TS, txc_TE, txc_TM, -1 },
+   // no S -> E without a fill
+   { txc_S, txc_S, txc_M, txc_I, txc_TS, txc_TM, -1 },
+   { txc_E, txc_E, txc_M, txc_S, txc_I, txc_TS, txc_TE, txc_TM, -1 },
+   // M only gets clean by being written back and dropped
+   { txc_M, txc_M, txc_S, txc_I, txc_TS, txc_TE, txc_TM, txc_TMI, -1 },
+   // Transactional states end by commit (TS -> S, TE -> E, TM and
+   // TMI -> M, TI -> I) or abort (-> I)
+   { txc_TI, txc_TI, txc_I, txc_TS, txc_TE, txc_TM, txc_TMI, -1 },
+   { txc_TS, txc_TS, txc_TM, txc_TI, txc_S, txc_I, -1 },
+   { txc_TE, txc_TE, txc_TM, txc_TS, txc_TI, txc_E, txc_I, -1 },
+   { txc_TMI, txc_TMI, txc_TI, txc_M, txc_I, -1 },
+   { txc_TM, txc_TM, txc_TI, txc_M, txc_I, -1 },
+};
+
+static inline bool transactional(int si) {
+   return si >= txc_TI;
+}
+
+static inline bool invalid(int si) {
+   return si == txc_I || si == txc_TI;
+}
+
+CacheStateChecker::CacheStateChecker(int line_bits, unsigned int window) :
+   line_bits(line_bits), window(window) {
+   memset(legal, 0, sizeof(legal));
+   for(unsigned int i = 0; i < sizeof(default_transitions) /
+          sizeof(default_transitions[0]); i++) {
+      const int *t = default_transitions[i];
+      for(int j = 1; t[j] >= 0; j++)
+         legal[t[0]][t[j]] = true;
+   }
+}
+
+void CacheStateChecker::allow(enum state_t from, enum state_t to, bool ok) {
+   legal[SI(from)][SI(to)] = ok;
+}
+
+void CacheStateChecker::error(const ctrace_record_t &r, uint64_t line,
+                              const string &what) {
+   ctrace_error_t e;
+   e.seq = r.seq;
+   e.cpu = r.cpu;
+   e.line = line << line_bits;
+   e.what = what;
+   errs.push_back(e);
+}
+
+static string state_name(int si) {
+   return txcstate_string((enum state_t)(si - 1));
+}
+
+void CacheStateChecker::set_state(int cpu, uint64_t line, int state) {
+   int &s = lines[cpu][line];
+   if(transactional(s))
+      ntx[cpu]--;
+   if(transactional(state))
+      ntx[cpu]++;
+   s = state;
+}
+
+bool CacheStateChecker::conflicted(uint64_t line) const {
+   int exclusive = 0, tx_written = 0;
+   for(unsigned int c = 0; c < lines.size(); c++) {
+      line_map_t::const_iterator i = lines[c].find(line);
+      if(i == lines[c].end())
+         continue;
+      int si = i->second;
+      if(si == txc_E || si == txc_M)
+         exclusive++;
+      if(si == txc_TM || si == txc_TMI)
+         tx_written++;
+   }
+   return exclusive > 1 || (tx_written && exclusive);
+}
+
+void CacheStateChecker::check_conflict(const ctrace_record_t &r,
+                                       uint64_t line) {
+   if(conflicted(line)) {
+      if(!pending.count(line))
+         pending[line] = r;
+   } else {
+      pending.erase(line);
+   }
+}
+
+void CacheStateChecker::check(const ctrace_record_t &r) {
+   const cache_event &e = r.evt;
+   if(r.cpu < 0)
+      return;
+   if((unsigned int)r.cpu >= lines.size()) {
+      lines.resize(r.cpu + 1);
+      tx_ending.resize(r.cpu + 1, false);
+      ntx.resize(r.cpu + 1, 0);
+   }
+   line_map_t &mine = lines[r.cpu];
+   uint64_t line = e.addr >> line_bits;
+
+   if(e.otyp == ot_ctrl || e.otyp == ot_uncacheable)
+      return;
+   if(e.otyp == ot_commit_tx || e.otyp == ot_abort_tx) {
+      tx_ending[r.cpu] = true;
+      return;
+   }
+
+   // g-cache's I, S, E, M are 0-3
+   int si = (int)e.state;
+   if(e.ctyp == ct_gcache)
+      si = (si >= 0 && si <= 3) ? si : -1;
+   else
+      si = (si >= -1 && si <= 7) ? si + 1 : -1;
+   if(si < 0) {
+      ostringstream os;
+      os << "bad " << (e.ctyp == ct_gcache ? "g-cache" : "txcache")
+         << " state " << (int)e.state;
+      error(r, line, os.str());
+      return;
+   }
+
+   if(tx_ending[r.cpu] && e.otyp != ot_commit_line &&
+      e.otyp != ot_abort_line) {
+      tx_ending[r.cpu] = false;
+      // report them once, then forget them
+      line_map_t::iterator i = mine.begin();
+      while(ntx[r.cpu] && i != mine.end()) {
+         if(transactional(i->second)) {
+            error(r, i->first, state_name(i->second) +
+                  " line outlived its transaction");
+            ntx[r.cpu]--;
+            mine.erase(i++);
+         } else {
+            i++;
+         }
+      }
+   }
+
+   if(e.otyp == ot_repl || e.evaddr) {
+      uint64_t victim = (e.evaddr ? e.evaddr : e.addr) >> line_bits;
+      set_state(r.cpu, victim, txc_I);
+      check_conflict(r, victim);
+      if(e.otyp == ot_repl)
+         return;
+   }
+
+   line_map_t::iterator i = mine.find(line);
+   int prev = i == mine.end() ? -1 : i->second;
+   const char *op = event_str((pcache_event)&e);
+
+   if((e.otyp == ot_read || e.otyp == ot_write) && e.status == hms_hit &&
+      prev >= 0 && invalid(prev))
+      error(r, line, string(op) + " hit on " + state_name(prev) + " line");
+   if(e.otyp == ot_write && e.status == hms_hit &&
+      si != txc_M && si != txc_TM && si != txc_TMI)
+      error(r, line, "write hit left line " + state_name(si));
+   if((e.otyp == ot_inv || e.otyp == ot_remote_invl) && !invalid(si))
+      error(r, line, string(op) + " left line " + state_name(si));
+   if((e.otyp == ot_commit_line || e.otyp == ot_abort_line) &&
+      transactional(si))
+      error(r, line, string(op) + " left line " + state_name(si));
+   if(prev >= 0 && !legal[prev][si])
+      error(r, line, string(op) + " " + state_name(prev) + " -> " +
+            state_name(si));
+
+   set_state(r.cpu, line, si);
+   check_conflict(r, line);
+
+   // Conflicts nobody resolved in time
+   for(map<uint64_t, ctrace_record_t>::iterator p = pending.begin();
+       p != pending.end(); ) {
+      if(r.seq - p->second.seq > window) {
+         error(p->second, p->first, "line exclusive in two caches");
+         pending.erase(p++);
+      } else {
+         p++;
+      }
+   }
+}
+
+void CacheStateChecker::finish() {
+   for(map<uint64_t, ctrace_record_t>::iterator p = pending.begin();
+       p != pending.end(); p++)
+      error(p->second, p->first, "line exclusive in two caches");
+   pending.clear();
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
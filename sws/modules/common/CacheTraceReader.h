@@ -0,0 +1,157 @@
+// MetaTM Project
+// File Name: CacheTraceReader.h
+//
+// Description: Reads a binary cache event trace (format in
+// CacheTrace.h) back in global sequence order, and CacheStateChecker,
+// which replays it to find illegal TMESI (or g-cache MESI) line
+// states.
+//
+// The checker takes each event's state as the line's state once the
+// cache has handled the event, and checks it against the state the
+// same cache last left the line in:
+//    - the transition must be in the transition table in CacheTraceReader.cc
+//      (cachetrace-check's -a and -x add and remove entries)
+//    - a read or write hit on a line last seen invalid is an error
+//    - a write hit must leave the line M, TM or TMI
+//    - an invalidation must leave the line I or TI
+//    - commit_line and abort_line must leave the line non-transactional,
+//      and once a cache's commit_tx or abort_tx has had its lines, no
+//      line of that cache may still be transactional
+// A replacement (or a fill with an evicted address) drops the evicted
+// line.  Across caches, a line may not be E or M in two caches, or TM
+// or TMI in one and E or M in another.  (A snoop that only downgrades
+// a line to S is not always logged, so a stale E or M next to an S is
+// not an error.)  The other cache's invalidation may be logged a little
+// after the event that made the line exclusive, so such a conflict is
+// only reported if it outlives window events.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef CACHETRACEREADER_H
+#define CACHETRACEREADER_H
+
+#include "simulator.h"
+#include "CacheTrace.h"
+
+using namespace std;
+
+typedef struct _ctrace_record_t {
+   uint64_t seq;
+   int cpu;
+   cycles_t cycle;
+   cache_event evt;
+} ctrace_record_t;
+
+class CacheTraceReader {
+ public:
+   CacheTraceReader(const char *filename);
+   ~CacheTraceReader();
+
+   // False if the file could not be opened or is not a cache trace;
+   // error() says why
+   bool good() const { return fp != NULL; }
+   const string &error() const { return err; }
+
+   unsigned int nblocks() const { return blocks; }
+   // Caches that logged anything
+   unsigned int ncpus() const;
+   uint64_t nevents() const { return events; }
+   // The last block was cut short (and is ignored)
+   bool truncated() const { return short_block; }
+
+   // The next event in sequence order.  False at the end of the
+   // trace, or if a block is corrupt (error() is then set).
+   bool next(ctrace_record_t &r);
+
+ private:
+   typedef struct _ctrace_stream_t {
+      vector<pair<long long, ctrace_block_header_t> > blocks;
+      unsigned int next_block;
+      vector<unsigned char> data;
+      unsigned int pos;
+      uint32_t left;
+      // the decoded event next() will return from this cache
+      bool have;
+      ctrace_record_t rec;
+      uint64_t prev_addr;
+      uint64_t prev_tag;
+   } ctrace_stream_t;
+
+   void scan_blocks();
+   bool advance(ctrace_stream_t &s);
+   bool get_varint(ctrace_stream_t &s, uint64_t &v);
+
+   string err;
+   FILE *fp;
+   unsigned int blocks;
+   uint64_t events;
+   bool short_block;
+   vector<ctrace_stream_t> streams;
+
+   // Not copyable
+   CacheTraceReader(const CacheTraceReader &);
+   CacheTraceReader &operator=(const CacheTraceReader &);
+};
+
+// One illegal event
+typedef struct _ctrace_error_t {
+   uint64_t seq;
+   int cpu;
+   uint64_t line;
+   string what;
+} ctrace_error_t;
+
+// Line states, txcache's plus one, so I is 0
+#define CTRACE_NSTATES 9
+
+class CacheStateChecker {
+ public:
+   CacheStateChecker(int line_bits = 6, unsigned int window = 64);
+
+   // Allow or forbid from -> to, txcache states
+   void allow(enum state_t from, enum state_t to, bool ok);
+
+   // Replay r, appending anything illegal to errors()
+   void check(const ctrace_record_t &r);
+   // Report the cross-cache conflicts still outstanding
+   void finish();
+
+   const vector<ctrace_error_t> &errors() const { return errs; }
+
+ private:
+   typedef tr1::unordered_map<uint64_t, int> line_map_t;
+
+   void error(const ctrace_record_t &r, uint64_t line, const string &what);
+   void set_state(int cpu, uint64_t line, int state);
+   bool conflicted(uint64_t line) const;
+   void check_conflict(const ctrace_record_t &r, uint64_t line);
+
+   int line_bits;
+   unsigned int window;
+   bool legal[CTRACE_NSTATES][CTRACE_NSTATES];
+   // Per cache, its lines' last states; lines not present are unknown
+   vector<line_map_t> lines;
+   // Per cache, a commit_tx or abort_tx waiting for its lines
+   vector<bool> tx_ending;
+   // Per cache, how many of its lines are transactional
+   vector<unsigned int> ntx;
+   // Conflicted lines -> the event that conflicted them
+   map<uint64_t, ctrace_record_t> pending;
+   vector<ctrace_error_t> errs;
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -0,0 +1,251 @@
+// MetaTM Project
+// File Name: LogSink.cc
+//
+// Description: Buffered text log for a module's pStatStream
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <set>
+#include "LogSink.h"
+
+// Simics (and syncchar-replay) leave by calling exit(), and module
+// logs are never deleted, so write out what the open ones still
+// buffer from there.  Sinks may be created and destroyed on different
+// threads, one per machine.
+static set<LogSink *> open_sinks;
+static bool flush_registered = false;
+static pthread_mutex_t open_sinks_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void flush_open_sinks(void) {
+   pthread_mutex_lock(&open_sinks_mutex);
+   for(set<LogSink *>::iterator it = open_sinks.begin();
+       it != open_sinks.end(); it++)
+      (*it)->flush_all();
+   pthread_mutex_unlock(&open_sinks_mutex);
+}
+
+LogSink::LogSink(const char *filename, size_t bufsize, bool async)
+   : bufsize(bufsize), threaded(false), write_failed(false), cur(NULL),
+     cur_type(NULL), line_bytes(0), line_start(true), in_type(false),
+     busy(false), stopping(false) {
+
+   fp = fopen(filename, "w");
+   if(fp == NULL)
+      return;
+   // Whole buffers go to fwrite; don't copy them again
+   setvbuf(fp, NULL, _IONBF, 0);
+
+   if(this->bufsize < 1)
+      this->bufsize = 1;
+   cur = new vector<char>(this->bufsize);
+   setp(&(*cur)[0], &(*cur)[0] + this->bufsize);
+
+   pthread_mutex_init(&mutex, NULL);
+   pthread_cond_init(&work, NULL);
+   pthread_cond_init(&idle, NULL);
+   if(async)
+      start_thread();
+
+   pthread_mutex_lock(&open_sinks_mutex);
+   if(!flush_registered) {
+      atexit(flush_open_sinks);
+      flush_registered = true;
+   }
+   open_sinks.insert(this);
+   pthread_mutex_unlock(&open_sinks_mutex);
+}
+
+LogSink::~LogSink() {
+   if(fp == NULL)
+      return;
+   flush_all();
+   stop_thread();
+   pthread_mutex_lock(&open_sinks_mutex);
+   open_sinks.erase(this);
+   pthread_mutex_unlock(&open_sinks_mutex);
+   pthread_mutex_destroy(&mutex);
+   pthread_cond_destroy(&work);
+   pthread_cond_destroy(&idle);
+   fclose(fp);
+   delete cur;
+   for(unsigned int i = 0; i < spare.size(); i++)
+      delete spare[i];
+}
+
+void LogSink::configure(size_t new_bufsize, bool async) {
+   if(fp == NULL)
+      return;
+   flush_all();
+   if(async != threaded) {
+      if(async)
+         start_thread();
+      else
+         stop_thread();
+   }
+   if(new_bufsize < 1)
+      new_bufsize = 1;
+   if(new_bufsize != bufsize) {
+      bufsize = new_bufsize;
+      for(unsigned int i = 0; i < spare.size(); i++)
+         delete spare[i];
+      spare.clear();
+      cur->assign(bufsize, 0);
+      setp(&(*cur)[0], &(*cur)[0] + bufsize);
+   }
+}
+
+int LogSink::overflow(int c) {
+   if(fp == NULL)
+      return traits_type::eof();
+   drain();
+   if(!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+   }
+   return traits_type::not_eof(c);
+}
+
+// Write the current buffer, or queue it for the writer thread and
+// start on a spare one
+void LogSink::drain() {
+   size_t n = pptr() - pbase();
+   if(n == 0)
+      return;
+   cur->resize(n);
+
+   if(!threaded) {
+      write_out(cur);
+   } else {
+      pthread_mutex_lock(&mutex);
+      while(queue.size() >= LOG_SINK_MAX_QUEUE)
+         pthread_cond_wait(&idle, &mutex);
+      queue.push_back(cur);
+      if(spare.empty()) {
+         cur = new vector<char>();
+      } else {
+         cur = spare.back();
+         spare.pop_back();
+      }
+      pthread_cond_signal(&work);
+      pthread_mutex_unlock(&mutex);
+   }
+
+   cur->resize(bufsize);
+   setp(&(*cur)[0], &(*cur)[0] + bufsize);
+}
+
+void LogSink::write_out(const vector<char> *b) {
+   count(&(*b)[0], b->size());
+   if(fwrite(&(*b)[0], b->size(), 1, fp) != 1)
+      write_failed = true;
+}
+
+// Walk the text for line starts; a record's type is the run of
+// letters and underscores it starts with.  Bytes are added to the
+// type at the end of each line.
+void LogSink::count(const char *p, size_t n) {
+   for(size_t i = 0; i < n; i++) {
+      char c = p[i];
+      if(line_start && c != '\n' && c != ' ' && c != '\t') {
+         type_word.clear();
+         in_type = true;
+      }
+      line_start = false;
+      if(in_type) {
+         if(isalpha((unsigned char)c) || c == '_') {
+            if(type_word.size() < LOG_SINK_TYPE_LEN)
+               type_word += c;
+         } else {
+            end_type();
+         }
+      }
+      line_bytes++;
+      if(c == '\n') {
+         if(cur_type == NULL)
+            cur_type = &types["(other)"];
+         cur_type->bytes += line_bytes;
+         line_bytes = 0;
+         line_start = true;
+      }
+   }
+}
+
+void LogSink::end_type() {
+   in_type = false;
+   cur_type = &types[type_word.empty() ? string("(other)") : type_word];
+   cur_type->records++;
+}
+
+void LogSink::flush_all() {
+   if(fp == NULL)
+      return;
+   drain();
+   if(threaded) {
+      pthread_mutex_lock(&mutex);
+      while(!queue.empty() || busy)
+         pthread_cond_wait(&idle, &mutex);
+      pthread_mutex_unlock(&mutex);
+   }
+   if(fflush(fp) != 0)
+      write_failed = true;
+}
+
+void LogSink::start_thread() {
+   stopping = false;
+   if(pthread_create(&thread, NULL, thread_main, this) == 0)
+      threaded = true;
+}
+
+// The queue must be empty (flush_all())
+void LogSink::stop_thread() {
+   if(!threaded)
+      return;
+   pthread_mutex_lock(&mutex);
+   stopping = true;
+   pthread_cond_signal(&work);
+   pthread_mutex_unlock(&mutex);
+   pthread_join(thread, NULL);
+   threaded = false;
+}
+
+void *LogSink::thread_main(void *arg) {
+   LogSink *sink = (LogSink *)arg;
+
+   pthread_mutex_lock(&sink->mutex);
+   for(;;) {
+      while(sink->queue.empty() && !sink->stopping)
+         pthread_cond_wait(&sink->work, &sink->mutex);
+      if(sink->queue.empty())
+         break;
+
+      vector<char> *b = sink->queue.front();
+      sink->queue.pop_front();
+      sink->busy = true;
+      pthread_mutex_unlock(&sink->mutex);
+
+      sink->write_out(b);
+
+      pthread_mutex_lock(&sink->mutex);
+      sink->spare.push_back(b);
+      sink->busy = false;
+      pthread_cond_broadcast(&sink->idle);
+   }
+   pthread_mutex_unlock(&sink->mutex);
+   return NULL;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -0,0 +1,154 @@
+// MetaTM Project
+// File Name: LogSink.h
+//
+// Description: Buffered text log for a module's pStatStream.
+// LogStream is an ostream, so every `*osamod->pStatStream << ...`
+// works unchanged, but endl and flush no longer reach the disk: text
+// collects in a large buffer that is written when it fills, or
+// handed to a background writer thread if async is set.  It only
+// goes out at the explicit flush points (log_flush(): output_stat,
+// clear_stat, killsim) and when the log is closed or the simulator
+// exits.
+//
+// The sink also counts the records (lines not starting with
+// whitespace; indented lines continue the record above) and bytes
+// written for each record type, the leading word of the record
+// (WS_CLOSE, KSTAT, XXX, ...).
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef OSA_LOGSINK_H
+#define OSA_LOGSINK_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define LOG_SINK_BUFSIZE    (1 << 20)
+// Full buffers the writer thread may be behind by before the
+// simulation waits for it
+#define LOG_SINK_MAX_QUEUE  4
+// Longest record type kept; longer ones are truncated
+#define LOG_SINK_TYPE_LEN   24
+
+typedef struct _log_type_stats_t {
+   unsigned long long records;
+   unsigned long long bytes;
+} log_type_stats_t;
+
+typedef map<string, log_type_stats_t> log_type_map_t;
+
+class LogSink : public streambuf {
+ public:
+   // Opens (truncates) filename.  Check good().
+   LogSink(const char *filename, size_t bufsize, bool async);
+   // Writes what is buffered and closes the file
+   ~LogSink();
+
+   bool good() const { return fp != NULL; }
+   // True once a write has failed; the log is incomplete
+   bool failed() const { return write_failed; }
+
+   // Change the buffer size or the writer; what is buffered so far is
+   // written first
+   void configure(size_t bufsize, bool async);
+   size_t buffer_size() const { return bufsize; }
+   bool async() const { return threaded; }
+
+   // Write everything buffered and wait until it is in the file
+   void flush_all();
+
+   // Records and bytes by record type, as of the last flush_all()
+   const log_type_map_t &type_stats() const { return types; }
+
+ protected:
+   virtual int overflow(int c);
+   // endl and flush end up here; they are not flush points
+   virtual int sync() { return 0; }
+
+ private:
+   void drain();
+   void write_out(const vector<char> *b);
+   void count(const char *p, size_t n);
+   void end_type();
+   void start_thread();
+   void stop_thread();
+   static void *thread_main(void *arg);
+
+   FILE *fp;
+   size_t bufsize;
+   bool threaded;
+   bool write_failed;
+   vector<char> *cur;
+
+   // Record type counting, done by whoever writes the buffers
+   log_type_map_t types;
+   log_type_stats_t *cur_type;
+   string type_word;
+   size_t line_bytes;
+   bool line_start;
+   bool in_type;
+
+   // Shared with the writer thread
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t work;       // queue became non-empty or stopping
+   pthread_cond_t idle;       // a buffer was written
+   deque<vector<char> *> queue;
+   vector<vector<char> *> spare;
+   bool busy;
+   bool stopping;
+};
+
+class LogStream : public ostream {
+ public:
+   LogStream(const char *filename, size_t bufsize = LOG_SINK_BUFSIZE,
+             bool async = false)
+      : ostream(NULL), buf(filename, bufsize, async) {
+      rdbuf(&buf);
+      if(!buf.good())
+         setstate(ios::badbit);
+   }
+
+   LogSink *sink() { return &buf; }
+
+ private:
+   LogSink buf;
+};
+
+// The LogSink behind s, or NULL if s is some other stream
+static inline LogSink *log_sink(ostream *s) {
+   return s == NULL ? NULL : dynamic_cast<LogSink *>(s->rdbuf());
+}
+
+// An explicit flush point: write out everything logged to s
+static inline void log_flush(ostream *s) {
+   LogSink *sink = log_sink(s);
+   if(sink != NULL)
+      sink->flush_all();
+   else if(s != NULL)
+      s->flush();
+}
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
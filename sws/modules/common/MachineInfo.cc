@@ -11,6 +11,27 @@
 #include "MachineInfo.h"
 
 map<osa_cpu_object_t *, struct _osamod_t *> OsaMachineInfo::owners;
+OsaMachineInfo::cpu_slot_t OsaMachineInfo::cpu_slots[cpu_slot_count];
+
+int OsaMachineInfo::findCpuNum(osa_cpu_object_t *cpu) {
+   int i;
+   for (i=0; i<numCpus; i++)
+      if (cpus[i] == cpu)
+         return i;
+
+   // pr("XXX Request for invalid processor number\n");
+   return -1;
+}
+
+void OsaMachineInfo::cacheCpu(int index) {
+   osa_cpu_object_t *cpu = cpus[index];
+   cpu_slot_t &s = cpu_slots[cpuSlot(cpu)];
+   map<osa_cpu_object_t *, struct _osamod_t *>::iterator it = owners.find(cpu);
+   s.cpu = cpu;
+   s.system = system;
+   s.index = index;
+   s.owner = it == owners.end() ? NULL : it->second;
+}
 
 #ifdef _USE_SIMICS
 SimicsMachineInfo::SimicsMachineInfo(system_object_t *system, struct _osamod_t *osamod) {
@@ -39,6 +60,8 @@ SimicsMachineInfo::SimicsMachineInfo(system_object_t *system, struct _osamod_t *
 
 		numCpus++;
 	}
+   for (int i = 0; i < numCpus; i++)
+      cacheCpu(i);
    SIM_free_attribute(cpulist);
 
    prefix = SIM_get_attribute(this->system, "object_prefix").u.string;
@@ -28,14 +28,12 @@ class OsaMachineInfo { //all initialization will be done by the derived class
       return cpus[cpuNo];
    }
 
+   // -1 if cpu isn't ours
    int getCpuNum(osa_cpu_object_t *cpu) {
-      int i;
-      for (i=0; i<numCpus; i++)
-         if (cpus[i] == cpu)
-            return i;
-
-      // pr("XXX Request for invalid processor number\n");
-      return -1;
+      const cpu_slot_t &s = cpu_slots[cpuSlot(cpu)];
+      if (s.cpu == cpu && s.system == system)
+         return s.index;
+      return findCpuNum(cpu);
    }
 
    virtual system_component_object_t *getComponent(const char* name) = 0;
@@ -46,10 +44,40 @@ class OsaMachineInfo { //all initialization will be done by the derived class
 
    // In osatxm, the instruction decoder is shared between
    // all machines, so we need to map cpus to osamods
- static struct _osamod_t *getOwner(osa_cpu_object_t *cpu) { return owners[cpu]; }
+ static struct _osamod_t *getOwner(osa_cpu_object_t *cpu) {
+    const cpu_slot_t &s = cpu_slots[cpuSlot(cpu)];
+    if (s.cpu == cpu)
+       return s.owner;
+    map<osa_cpu_object_t *, struct _osamod_t *>::const_iterator it =
+       owners.find(cpu);
+    return it == owners.end() ? NULL : it->second;
+ }
 
  virtual ~OsaMachineInfo() { }
  protected:
+   // Both lookups run on every event, so each cpu is cached in a
+   // direct-mapped table shared by all machines, keyed by the cpu
+   // object.  A cpu belongs to a single system, so machines don't
+   // evict each other's entries; a collision falls back to the scan
+   // and the owners map.  The table and the map are only written
+   // while machines are configured, so machines simulated on
+   // different threads can share them.
+   typedef struct _cpu_slot_t {
+      osa_cpu_object_t *cpu;
+      system_object_t *system;
+      int index;
+      struct _osamod_t *owner;
+   } cpu_slot_t;
+   static const unsigned int cpu_slot_count = 256;
+   static cpu_slot_t cpu_slots[cpu_slot_count];
+
+   static unsigned int cpuSlot(osa_cpu_object_t *cpu) {
+      unsigned long p = (unsigned long)cpu;
+      return ((p >> 4) ^ (p >> 12)) & (cpu_slot_count - 1);
+   }
+   int findCpuNum(osa_cpu_object_t *cpu);
+   void cacheCpu(int index);
+
    static map<osa_cpu_object_t *, struct _osamod_t *> owners;
    system_object_t *system;
    int numCpus;
@@ -0,0 +1,234 @@
+// MetaTM Project
+// File Name: ProfileTrie.cc
+//
+// Description: profiler call-graph trie and its dump (format in
+// ProfileTrie.h)
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include "ProfileTrie.h"
+
+using namespace std;
+
+bool ProfileSymbols::load(const char *filename) {
+   ifstream in(filename);
+   if(!in) {
+      err = string(filename) + ": " + strerror(errno);
+      return false;
+   }
+   // System.map is sorted, but don't count on it
+   vector<pair<uint32_t, string> > syms;
+   string line;
+   while(getline(in, line)) {
+      char type;
+      char name[256];
+      unsigned long addr;
+      if(sscanf(line.c_str(), "%lx %c %255s", &addr, &type, name) != 3)
+         continue;
+      if(type != 'T' && type != 't' && type != 'W' && type != 'w')
+         continue;
+      syms.push_back(make_pair((uint32_t)addr, string(name)));
+   }
+   stable_sort(syms.begin(), syms.end());
+   addrs.clear();
+   names.clear();
+   for(unsigned int i = 0; i < syms.size(); i++) {
+      addrs.push_back(syms[i].first);
+      names.push_back(syms[i].second);
+   }
+   return true;
+}
+
+int ProfileSymbols::lookup(uint32_t addr) const {
+   vector<uint32_t>::const_iterator i =
+      upper_bound(addrs.begin(), addrs.end(), addr);
+   // Nothing gives the last symbol's size; it is usually an end
+   // marker like _etext, so it only covers its own address
+   if(i == addrs.begin() || (i == addrs.end() && addr != addrs.back()))
+      return -1;
+   return (i - addrs.begin()) - 1;
+}
+
+void ProfileTrie::clear() {
+   nodes.clear();
+   children.clear();
+   prof_node_t root;
+   memset(&root, 0, sizeof(root));
+   root.sym = PROF_NO_SYM;
+   nodes.push_back(root);
+}
+
+void ProfileTrie::add(const uint32_t *frames, int n) {
+   uint32_t cur = 0;
+   nodes[0].total++;
+   for(int i = n - 1; i >= 0; i--) {
+      uint64_t key = ((uint64_t)cur << 32) | frames[i];
+      tr1::unordered_map<uint64_t, uint32_t>::iterator c = children.find(key);
+      if(c != children.end()) {
+         cur = c->second;
+      } else {
+         prof_node_t child;
+         memset(&child, 0, sizeof(child));
+         child.ip = frames[i];
+         child.parent = cur;
+         child.sym = PROF_NO_SYM;
+         nodes.push_back(child);
+         cur = nodes.size() - 1;
+         children[key] = cur;
+      }
+      nodes[cur].total++;
+   }
+   nodes[cur].self++;
+}
+
+void ProfileTrie::flat(map<uint32_t, uint64_t> &out) const {
+   for(unsigned int i = 1; i < nodes.size(); i++)
+      if(nodes[i].self)
+         out[nodes[i].ip] += nodes[i].self;
+}
+
+void ProfileTrie::calls(map<uint32_t, uint64_t> &out) const {
+   for(unsigned int i = 1; i < nodes.size(); i++)
+      out[nodes[i].ip] += nodes[i].total;
+}
+
+bool ProfileTrie::write(const char *filename, const ProfileSymbols *syms,
+                        uint64_t interval) const {
+   vector<prof_node_t> out(nodes);
+   vector<prof_sym_t> symtab;
+   string strtab;
+
+   if(syms != NULL && !syms->empty()) {
+      // Only the symbols some node is in, renumbered by address
+      vector<int> found(out.size(), -1);
+      set<int> used;
+      for(unsigned int i = 1; i < out.size(); i++) {
+         found[i] = syms->lookup(out[i].ip);
+         if(found[i] >= 0)
+            used.insert(found[i]);
+      }
+      map<int, uint32_t> renumber;
+      for(set<int>::iterator s = used.begin(); s != used.end(); s++) {
+         prof_sym_t ps;
+         ps.addr = syms->addr(*s);
+         ps.name = strtab.size();
+         strtab += syms->name(*s);
+         strtab += '\0';
+         renumber[*s] = symtab.size();
+         symtab.push_back(ps);
+      }
+      for(unsigned int i = 1; i < out.size(); i++)
+         if(found[i] >= 0)
+            out[i].sym = renumber[found[i]];
+   }
+
+   prof_file_header_t hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, PROF_MAGIC, sizeof(PROF_MAGIC));
+   hdr.version = PROF_VERSION;
+   hdr.nnodes = out.size();
+   hdr.nsyms = symtab.size();
+   hdr.strtab_bytes = strtab.size();
+   hdr.interval = interval;
+
+   FILE *fp = fopen(filename, "wb");
+   if(!fp)
+      return false;
+   bool ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+      fwrite(&out[0], sizeof(prof_node_t), out.size(), fp) == out.size() &&
+      (symtab.empty() ||
+       fwrite(&symtab[0], sizeof(prof_sym_t), symtab.size(), fp) ==
+       symtab.size()) &&
+      (strtab.empty() || fwrite(strtab.data(), strtab.size(), 1, fp) == 1);
+   if(fclose(fp))
+      ok = false;
+   return ok;
+}
+
+bool ProfileDump::read(const char *filename) {
+   FILE *fp = fopen(filename, "rb");
+   if(!fp) {
+      err = string(filename) + ": " + strerror(errno);
+      return false;
+   }
+   bool ok = fread(&hdr, sizeof(hdr), 1, fp) == 1 &&
+      !memcmp(hdr.magic, PROF_MAGIC, sizeof(PROF_MAGIC));
+   if(!ok) {
+      err = string(filename) + ": not a profile dump";
+   } else if(hdr.version != PROF_VERSION || hdr.nnodes == 0) {
+      err = string(filename) + ": unsupported profile dump version";
+      ok = false;
+   } else {
+      nodes.resize(hdr.nnodes);
+      syms.resize(hdr.nsyms);
+      strtab.resize(hdr.strtab_bytes + 1);
+      ok = fread(&nodes[0], sizeof(prof_node_t), nodes.size(), fp) ==
+         nodes.size() &&
+         (syms.empty() ||
+          fread(&syms[0], sizeof(prof_sym_t), syms.size(), fp) ==
+          syms.size()) &&
+         (!hdr.strtab_bytes ||
+          fread(&strtab[0], hdr.strtab_bytes, 1, fp) == 1);
+      strtab[hdr.strtab_bytes] = 0;
+      for(unsigned int i = 0; ok && i < nodes.size(); i++)
+         ok = (i == 0 || nodes[i].parent < i) &&
+            (nodes[i].sym == PROF_NO_SYM || nodes[i].sym < syms.size());
+      for(unsigned int i = 0; ok && i < syms.size(); i++)
+         ok = syms[i].name < hdr.strtab_bytes;
+      if(!ok)
+         err = string(filename) + ": truncated or corrupt profile dump";
+   }
+   fclose(fp);
+   return ok;
+}
+
+string ProfileDump::function(unsigned int i) const {
+   if(nodes[i].sym != PROF_NO_SYM)
+      return &strtab[syms[nodes[i].sym].name];
+   char buf[16];
+   sprintf(buf, "0x%x", nodes[i].ip);
+   return buf;
+}
+
+void ProfileDump::folded(ostream &out) const {
+   map<string, uint64_t> stacks;
+   vector<unsigned int> path;
+   for(unsigned int i = 1; i < nodes.size(); i++) {
+      if(!nodes[i].self)
+         continue;
+      path.clear();
+      for(unsigned int n = i; n != 0; n = nodes[n].parent)
+         path.push_back(n);
+      string s;
+      for(int p = path.size() - 1; p >= 0; p--) {
+         s += function(path[p]);
+         if(p)
+            s += ';';
+      }
+      stacks[s] += nodes[i].self;
+   }
+   for(map<string, uint64_t>::iterator s = stacks.begin(); s != stacks.end();
+       s++)
+      out << s->first << " " << s->second << endl;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
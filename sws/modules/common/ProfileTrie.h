@@ -0,0 +1,152 @@
+// MetaTM Project
+// File Name: ProfileTrie.h
+//
+// Description: Call-graph trie for the sampling profiler, and its
+// binary dump.  Each node is one IP reached by one path of callers,
+// with the samples taken in it (self) and in it or anything it called
+// (total).  Node 0 is the root, whose total is the number of samples.
+// Kernel symbols from System.map are resolved once, when the trie is
+// written, so the dump can be read back without the kernel.  This
+// file and ProfileTrie.cc do not depend on the simulator, so osaprof
+// links them alone.
+//
+// File layout:
+//    prof_file_header_t
+//    nnodes x prof_node_t, each after its parent
+//    nsyms x prof_sym_t, by address
+//    strtab_bytes of NUL terminated symbol names
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef PROFILETRIE_H
+#define PROFILETRIE_H
+
+#include <stdint.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <tr1/unordered_map>
+
+using namespace std;
+
+#define PROF_MAGIC      "OSAPROF"
+#define PROF_VERSION    1
+// prof_node_t.sym of an IP no symbol covers
+#define PROF_NO_SYM     0xffffffffU
+
+typedef struct _prof_file_header_t {
+   char magic[8];
+   uint32_t version;
+   uint32_t nnodes;
+   uint32_t nsyms;
+   uint32_t strtab_bytes;
+   // profile_interval the samples were taken at
+   uint64_t interval;
+} prof_file_header_t;
+
+typedef struct _prof_node_t {
+   uint32_t ip;
+   uint32_t parent;
+   uint32_t sym;
+   uint32_t pad;
+   uint64_t self;
+   uint64_t total;
+} prof_node_t;
+
+typedef struct _prof_sym_t {
+   uint32_t addr;
+   // offset of the name in the string table
+   uint32_t name;
+} prof_sym_t;
+
+// A System.map: text symbols by address
+class ProfileSymbols {
+ public:
+   // False (see error()) if filename can't be read
+   bool load(const char *filename);
+   const string &error() const { return err; }
+   bool empty() const { return addrs.empty(); }
+
+   // Index of the symbol covering addr, or -1
+   int lookup(uint32_t addr) const;
+   uint32_t addr(int i) const { return addrs[i]; }
+   const string &name(int i) const { return names[i]; }
+
+ private:
+   string err;
+   vector<uint32_t> addrs;
+   vector<string> names;
+};
+
+class ProfileTrie {
+ public:
+   ProfileTrie() { clear(); }
+
+   // Count one sample.  frames[0] is the sampled IP and frames[n-1]
+   // the outermost caller found.
+   void add(const uint32_t *frames, int n);
+   void clear();
+
+   uint64_t samples() const { return nodes[0].total; }
+   unsigned int size() const { return nodes.size(); }
+   const prof_node_t &node(unsigned int i) const { return nodes[i]; }
+
+   // Samples with the IP sampled at ip, and with ip anywhere on the
+   // stack (once per frame), by ip
+   void flat(map<uint32_t, uint64_t> &out) const;
+   void calls(map<uint32_t, uint64_t> &out) const;
+
+   // Write the trie, with the symbols covering its IPs if syms isn't
+   // NULL.  False (errno set) on an I/O error.
+   bool write(const char *filename, const ProfileSymbols *syms,
+              uint64_t interval) const;
+
+ private:
+   vector<prof_node_t> nodes;
+   // (parent << 32) | ip -> child node
+   tr1::unordered_map<uint64_t, uint32_t> children;
+};
+
+// A dump read back
+class ProfileDump {
+ public:
+   // False (see error()) if filename is not a profile dump
+   bool read(const char *filename);
+   const string &error() const { return err; }
+
+   const prof_file_header_t &header() const { return hdr; }
+   unsigned int size() const { return nodes.size(); }
+   const prof_node_t &node(unsigned int i) const { return nodes[i]; }
+
+   // Node i's function, or its IP in hex if no symbol covers it
+   string function(unsigned int i) const;
+
+   // One line per distinct stack with self samples, outermost caller
+   // first, for flamegraph.pl and friends:
+   //    func;func;func count
+   void folded(ostream &out) const;
+
+ private:
+   string err;
+   prof_file_header_t hdr;
+   vector<prof_node_t> nodes;
+   vector<prof_sym_t> syms;
+   vector<char> strtab;
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
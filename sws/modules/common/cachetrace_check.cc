@@ -0,0 +1,158 @@
+// MetaTM Project
+// File Name: cachetrace_check.cc
+//
+// Description: cachetrace-check, replays a binary cache event trace
+// (CacheTrace.h) through CacheStateChecker and prints the illegal
+// events, or dumps the trace as text.
+//
+//    cachetrace-check [-d] [-s seq] [-e seq] [-l line_bits] [-w window]
+//                     [-m max] [-a FROM:TO] [-x FROM:TO] trace
+//
+// Each error is printed as
+//    seq cpu line: what
+// and the exit status is 1 if there were any.  -d instead prints
+// every event as
+//    seq cpu cycle dump_event's text
+// -s and -e limit what is printed to events with sequence numbers in
+// [s, e]; the checker still replays the trace from the start, so a
+// failing run can be bisected by dumping the events before an error.
+// -l is log2 of the line size (6), -w how many events a cross-cache
+// conflict may last (64), -m how many errors to print (100, 0 for
+// all).  -a allows and -x forbids a transition, e.g. -a M:E, in
+// txcache state names (I S E M TI TS TE TMI TM).
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "CacheTraceReader.h"
+
+using namespace std;
+
+static void usage(const char *prog) {
+   cerr << "usage: " << prog << " [-d] [-s seq] [-e seq] [-l line_bits]"
+        << " [-w window] [-m max] [-a FROM:TO] [-x FROM:TO] trace" << endl;
+   exit(1);
+}
+
+static bool parse_state(const string &name, enum state_t &s) {
+   for(int i = STATE_I; i <= STATE_TM; i++) {
+      if(name == txcstate_string((enum state_t)i)) {
+         s = (enum state_t)i;
+         return true;
+      }
+   }
+   return false;
+}
+
+static bool parse_transition(const char *arg, enum state_t &from,
+                             enum state_t &to) {
+   string a(arg);
+   string::size_type colon = a.find(':');
+   return colon != string::npos &&
+      parse_state(a.substr(0, colon), from) &&
+      parse_state(a.substr(colon + 1), to);
+}
+
+int main(int argc, char **argv) {
+   bool dump = false;
+   uint64_t first = 0, last = ~0ULL;
+   int line_bits = 6;
+   unsigned int window = 64;
+   unsigned int max_errors = 100;
+   vector<pair<pair<enum state_t, enum state_t>, bool> > overrides;
+   enum state_t from, to;
+   int c;
+
+   while((c = getopt(argc, argv, "ds:e:l:w:m:a:x:")) != -1) {
+      switch(c) {
+      case 'd': dump = true; break;
+      case 's': first = strtoull(optarg, NULL, 0); break;
+      case 'e': last = strtoull(optarg, NULL, 0); break;
+      case 'l': line_bits = atoi(optarg); break;
+      case 'w': window = strtoul(optarg, NULL, 0); break;
+      case 'm': max_errors = strtoul(optarg, NULL, 0); break;
+      case 'a':
+      case 'x':
+         if(!parse_transition(optarg, from, to)) {
+            cerr << "bad transition " << optarg << endl;
+            usage(argv[0]);
+         }
+         overrides.push_back(make_pair(make_pair(from, to), c == 'a'));
+         break;
+      default: usage(argv[0]);
+      }
+   }
+   if(optind != argc - 1 || line_bits < 0 || line_bits > 32)
+      usage(argv[0]);
+
+   CacheTraceReader trace(argv[optind]);
+   if(!trace.good()) {
+      cerr << trace.error() << endl;
+      return 1;
+   }
+
+   CacheStateChecker checker(line_bits, window);
+   for(unsigned int i = 0; i < overrides.size(); i++)
+      checker.allow(overrides[i].first.first, overrides[i].first.second,
+                    overrides[i].second);
+
+   ctrace_record_t r;
+   uint64_t n = 0;
+   while(trace.next(r)) {
+      n++;
+      if(dump) {
+         if(r.seq >= first && r.seq <= last) {
+            cout << r.seq << " " << r.cpu << " " << r.cycle << " " << flush;
+            dump_event(stdout, &r.evt);
+            fprintf(stdout, "\n");
+            fflush(stdout);
+         }
+         if(r.seq >= last)
+            break;
+      } else {
+         checker.check(r);
+      }
+   }
+   if(!trace.error().empty()) {
+      cerr << argv[optind] << ": " << trace.error() << " after " << n
+           << " events" << endl;
+      return 1;
+   }
+   if(dump)
+      return 0;
+   checker.finish();
+
+   unsigned int printed = 0, nerrors = 0;
+   const vector<ctrace_error_t> &errs = checker.errors();
+   for(unsigned int i = 0; i < errs.size(); i++) {
+      const ctrace_error_t &e = errs[i];
+      if(e.seq < first || e.seq > last)
+         continue;
+      nerrors++;
+      if(max_errors && printed >= max_errors)
+         continue;
+      printed++;
+      cout << e.seq << " " << e.cpu << " 0x" << hex << e.line << dec
+           << ": " << e.what << endl;
+   }
+   cout << n << " events from " << trace.ncpus() << " caches in "
+        << trace.nblocks() << " blocks"
+        << (trace.truncated() ? " (last block cut short)" : "")
+        << ", " << nerrors << " errors" << endl;
+   return nerrors ? 1 : 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -27,12 +27,10 @@
 #include "osacommon.h"
 #include "common.h"
 #include "profile.h"
+#include "replaytrace.h"
+#include "LogSink.h"
 
 #define OSA_PRINT_TO_CONSOLE	true  /*true*/
-bool gbOsaPrintCout	= OSA_PRINT_TO_CONSOLE;
-
-char log_file[256];
-FILE *fp;
 
 
 #include "stdio.h"
@@ -44,17 +42,6 @@ FILE *fp;
 using namespace std;
 using namespace std::tr1;
 
-/* Active memory watchpoints for catching STM isolation violations */
-typedef struct watchpoint{
-   osa_integer_t addr;
-   osa_integer_t len;
-   unsigned int pid;
-   breakpoint_id_t bp;
-} watchpoint_t;
-
-map<osa_integer_t, watchpoint_t> bps;
-int suspend_protect[OSA_MAX_CPUS];
-
 inline int cache_count(osamod_t *osamod) {
    return osamod->minfo->getNumCpus();
 }
@@ -207,6 +194,8 @@ static void clear_stats(osamod_t *osamod){
 
 static void output_stats(osamod_t *osamod){
    dump_profile(osamod, NULL);
+   if(osamod->common->log_fp != NULL)
+      fflush(osamod->common->log_fp);
 }
 
 
@@ -247,6 +236,10 @@ static integer_attribute_t get_fast_caches( SIMULATOR_GET_ATTRIBUTE_SIGNATURE )
 static osa_attr_set_t set_fast_caches( SIMULATOR_SET_INTEGER_ATTRIBUTE_SIGNATURE ) {
    osamod_t *osamod = (osamod_t*)obj;
    osamod->common->fast_caches = INTEGER_ARGUMENT;
+   // While the configuration is loading the hierarchy may not be
+   // connected yet; the stallers ask on their first transaction
+   if(SIM_initial_configuration_ok())
+      push_fast_caches(obj, osamod->common->fast_caches);
    return ATTR_OK;
 }
 /**** End: Code for cache latency squashing ***/
@@ -276,128 +269,280 @@ static void osa_random_kill(conf_object_t *cpu, void *_osamod) {
 }
 /**** End: Code for random simulator kills ***/
 
-/**** Begin: Macros for magic_callback dispatching ***/
-
-void _dispatch_all(osamod_t *osamod, unsigned long f_offset, bool all_flag) {
-   for(osamod_t *cur_mod = OSA_mod_list();
-       cur_mod != NULL; cur_mod = cur_mod->next_mod){
-      if(all_flag                                     
-         || sameMachine(osamod, cur_mod)){ 
+/**** Begin: Magic instruction dispatch table ***/
+
+// A module callback for one magic code; func2 also takes the code
+typedef struct _magic_handler_t {
+   osamod_t *mod;
+   magic_callback_func func;
+   magic_callback_func2 func2;
+} magic_handler_t;
+
+typedef struct _magic_entry_t {
+   // Set for codes that dispatch to modules, even if no module on
+   // this machine takes them
+   bool known;
+   // In the order the modules are called
+   vector<magic_handler_t> handlers;
+   unsigned long long calls;
+   unsigned long long host_ns;
+} magic_entry_t;
+
+// Per common instance, so per machine.  Built the first time a magic
+// instruction comes in after the module list changes, which in
+// practice is once, after configuration.  Every code seen gets an
+// entry for its counters, dispatching or not.
+typedef struct _magic_table {
+   unsigned int generation;
+   unordered_map<osa_uinteger_t, magic_entry_t> codes;
+} magic_table_t;
+
+// A module's interfaces, looked up once per build
+typedef struct _magic_mod_t {
+   osamod_t *mod;
+   common_osamod_interface_t *common;
+   common_syncchar_interface_t *syncchar;
+   common_osatxm_interface_t *osatxm;
+} magic_mod_t;
+
+static void *magic_iface(osamod_t *mod, const char *name) {
+   osa_sim_clear_error();
+   void *iface = osa_sim_get_interface((conf_object_t *)mod, name);
+   if(osa_sim_clear_error() || iface == NULL) {
+      *mod->pStatStream << "XXX: Can't find " << name << endl;
+      return NULL;
+   }
+   return iface;
+}
 
-         osa_sim_clear_error();
+static magic_entry_t &magic_add(magic_table_t *t, osa_uinteger_t code) {
+   magic_entry_t &e = t->codes[code];
+   e.known = true;
+   return e;
+}
 
-         common_osamod_interface_t *iface =           
-            (common_osamod_interface_t *) osa_sim_get_interface((system_component_object_t *)cur_mod,
-                                                            "common_osamod_interface");
-         if( SIM_get_pending_exception() ) {
-            *cur_mod->pStatStream << "XXX: Can't find common interface \"" << SIM_last_error() << "\"" << endl;
-            SIM_clear_exception();
-         } else {
-            magic_callback_func *f =
-               (magic_callback_func*)((char*)iface + f_offset);
-            (*f)(cur_mod);
-         }
-      }
-   }
+static void magic_add_handler(magic_table_t *t, osa_uinteger_t code,
+                              osamod_t *mod, magic_callback_func func,
+                              magic_callback_func2 func2) {
+   if(func == NULL && func2 == NULL)
+      return;
+   magic_handler_t h;
+   h.mod = mod;
+   h.func = func;
+   h.func2 = func2;
+   magic_add(t, code).handlers.push_back(h);
 }
 
-#define DISPATCH_ALL(osamod, func, all_flag)  \
-         _dispatch_all(osamod, \
-               (unsigned long)&((common_osamod_interface_t*)0x0)->func, \
-               all_flag);
-#if 0
-         for(osamod_t *cur_mod = OSA_mod_list();            \
-             cur_mod != NULL; cur_mod = cur_mod->next_mod){ \
-                                                            \
-            if(all_flag                                     \
-               || sameMachine(osamod, cur_mod)){            \
-                                                            \
-               common_osamod_interface_t *iface =           \
-                  (common_osamod_interface_t *) osa_sim_get_interface((system_component_object_t *)cur_mod, \
-                                                                  "common_osamod_interface"); \
-               if( osa_sim_clear_error() ) {                \
-                  *cur_mod->pStatStream << "XXX: Can't find common interface" << endl; \
-               } else {                                     \
-                  iface->func(cur_mod);                     \
-               }                                            \
-            }                                               \
-         }
-#endif
+static void sched_break(osamod_t *cur_mod) {
+   if(cur_mod->common->break_on_sched)
+      osa_break_simulation("OSA Magic Breakpoint Requested on schedule.");
+}
 
+// Every module's clear_stat or output_stat; only our machine's
+// unless all_flag
+#define MAGIC_ALL(code, func, all_flag)                                \
+   do {                                                                \
+      magic_add(t, code);                                              \
+      for(unsigned int i = 0; i < mods.size(); i++)                    \
+         if(mods[i].common                                             \
+            && (all_flag || sameMachine(osamod, mods[i].mod)))         \
+            magic_add_handler(t, code, mods[i].mod,                    \
+                              mods[i].common->func, NULL);             \
+   } while(0)
 
 // don't muck with other machines
-#define DISPATCH_OS_VISIBILITY(osamod, func)  \
-         for(osamod_t *cur_mod = OSA_mod_list();                      \
-             cur_mod != NULL; cur_mod = cur_mod->next_mod){           \
-                                                                      \
-            if(!sameMachine(osamod, cur_mod))                         \
-               continue;                                              \
-                                                                      \
-            func(cur_mod);                                            \
-         }          
+#define MAGIC_OS_VISIBILITY(code, func)                                \
+   do {                                                                \
+      magic_add(t, code);                                              \
+      for(unsigned int i = 0; i < mods.size(); i++)                    \
+         if(sameMachine(osamod, mods[i].mod))                          \
+            magic_add_handler(t, code, mods[i].mod, func, NULL);       \
+   } while(0)
 
 // Only syncchar cares about this magic instruction
-#define DISPATCH_SYNCCHAR(osamod, func) \
-         for(osamod_t *cur_mod = OSA_mod_list();                      \
-             cur_mod != NULL; cur_mod = cur_mod->next_mod){           \
-                                                                      \
-            if((!sameMachine(osamod, cur_mod))                        \
-               || cur_mod->type != SYNCCHAR){                         \
-               continue;                                              \
-            }                                                         \
-                                                                      \
-            common_syncchar_interface_t *iface =                      \
-               (common_syncchar_interface_t *) osa_sim_get_interface((system_component_object_t *)cur_mod, \
-                                                                 "common_syncchar_interface");\
-            if( osa_sim_clear_error() ) {                             \
-               *cur_mod->pStatStream << "XXX: Can't find common syncchar interface" << endl; \
-            } else {                                                  \
-               iface->func(cur_mod);                                  \
-            }                                                         \
-         }
-
+#define MAGIC_SYNCCHAR(code, func)                                     \
+   do {                                                                \
+      magic_add(t, code);                                              \
+      for(unsigned int i = 0; i < mods.size(); i++)                    \
+         if(mods[i].syncchar)                                          \
+            magic_add_handler(t, code, mods[i].mod,                    \
+                              mods[i].syncchar->func, NULL);           \
+   } while(0)
 
 // Only osatxm cares about this magic instruction
-#define DISPATCH_OSATXM(osamod, func) \
-         for(osamod_t *cur_mod = OSA_mod_list();                      \
-             cur_mod != NULL; cur_mod = cur_mod->next_mod){           \
-                                                                      \
-            if((!sameMachine(osamod, cur_mod))                        \
-               || cur_mod->type != OSATXM){                           \
-               continue;                                              \
-            }                                                         \
-                                                                      \
-            common_osatxm_interface_t *iface =                        \
-               (common_osatxm_interface_t *) osa_sim_get_interface((conf_object_t *)cur_mod, \
-                                                               "common_osatxm_interface");\
-            if( osa_sim_clear_error() ) {                             \
-               *cur_mod->pStatStream << "XXX: Can't find common osatxm interface" << endl; \
-            } else {                                                  \
-               iface->func(cur_mod);                                  \
-            }                                                         \
-         }
+#define MAGIC_OSATXM(code, func)                                       \
+   do {                                                                \
+      magic_add(t, code);                                              \
+      for(unsigned int i = 0; i < mods.size(); i++)                    \
+         if(mods[i].osatxm)                                            \
+            magic_add_handler(t, code, mods[i].mod,                    \
+                              mods[i].osatxm->func, NULL);             \
+   } while(0)
+
+#define MAGIC_OSATXM2(code, func)                                      \
+   do {                                                                \
+      magic_add(t, code);                                              \
+      for(unsigned int i = 0; i < mods.size(); i++)                    \
+         if(mods[i].osatxm)                                            \
+            magic_add_handler(t, code, mods[i].mod,                    \
+                              NULL, mods[i].osatxm->func);             \
+   } while(0)
+
+// Resolve, for each code, the module callbacks the magic instruction
+// runs, in the order magic_callback used to walk the module list for
+// them.  Counters survive a rebuild.
+static void build_magic_table(osamod_t *osamod) {
+   magic_table_t *t = osamod->common->magic;
+   for(unordered_map<osa_uinteger_t, magic_entry_t>::iterator it =
+          t->codes.begin(); it != t->codes.end(); it++) {
+      it->second.known = false;
+      it->second.handlers.clear();
+   }
+   t->generation = OSA_mod_generation();
 
-// Only osatxm cares about this magic instruction
-#define DISPATCH_OSATXM2(osamod, func, codeVal) \
-         for(osamod_t *cur_mod = OSA_mod_list();                      \
-             cur_mod != NULL; cur_mod = cur_mod->next_mod){           \
-                                                                      \
-            if((!sameMachine(osamod, cur_mod))                        \
-               || cur_mod->type != OSATXM){                           \
-               continue;                                              \
-            }                                                         \
-                                                                      \
-            common_osatxm_interface_t *iface =                        \
-               (common_osatxm_interface_t *) osa_sim_get_interface((conf_object_t *)cur_mod, \
-                                                               "common_osatxm_interface");\
-            if( osa_sim_clear_error() ) {                             \
-               *cur_mod->pStatStream << "XXX: Can't find common osatxm interface" << endl; \
-            } else {                                                  \
-               iface->func(codeVal, cur_mod);                         \
-            }                                                         \
-         }
+   vector<magic_mod_t> mods;
+   for(osamod_t *cur_mod = OSA_mod_list();
+       cur_mod != NULL; cur_mod = cur_mod->next_mod){
+      magic_mod_t m;
+      m.mod = cur_mod;
+      m.common = (common_osamod_interface_t *)
+         magic_iface(cur_mod, "common_osamod_interface");
+      m.syncchar = NULL;
+      m.osatxm = NULL;
+      if(sameMachine(osamod, cur_mod)) {
+         if(cur_mod->type == SYNCCHAR)
+            m.syncchar = (common_syncchar_interface_t *)
+               magic_iface(cur_mod, "common_syncchar_interface");
+         else if(cur_mod->type == OSATXM)
+            m.osatxm = (common_osatxm_interface_t *)
+               magic_iface(cur_mod, "common_osatxm_interface");
+      }
+      mods.push_back(m);
+   }
+
+   MAGIC_ALL(OSA_CLEAR_STAT, clear_stat, false);
+   MAGIC_ALL(OSA_CLEAR_STAT_ALL, clear_stat, true);
+   MAGIC_ALL(OSA_OUTPUT_STAT, output_stat, false);
+   MAGIC_ALL(OSA_OUTPUT_STAT_ALL, output_stat, true);
+
+   // Make sure syncchar knows we are past boot so that it can start
+   // logging worksets if needed
+   MAGIC_SYNCCHAR(OSA_BENCHMARK, osa_after_boot);
+
+   // os visibility is needed by each module.  Syncchar needs to
+   // manage runqueue handoff when sched is executed.
+   magic_add(t, OSA_SCHED);
+   for(unsigned int i = 0; i < mods.size(); i++) {
+      osamod_t *cur_mod = mods[i].mod;
+      if(!sameMachine(osamod, cur_mod))
+         continue;
+      if(cur_mod->type == COMMON)
+         magic_add_handler(t, OSA_SCHED, cur_mod, sched_break, NULL);
+      if(mods[i].syncchar)
+         magic_add_handler(t, OSA_SCHED, cur_mod,
+                           mods[i].syncchar->osa_sched, NULL);
+      // Everyone does os_sched
+      magic_add_handler(t, OSA_SCHED, cur_mod, os_sched, NULL);
+   }
+
+   MAGIC_OSATXM(OSA_FORK, osa_fork);
+   MAGIC_SYNCCHAR(OSA_FORK, osa_fork);
+   MAGIC_OS_VISIBILITY(OSA_FORK, os_fork);
+   MAGIC_OS_VISIBILITY(OSA_TIMER, os_timer);
+   MAGIC_OS_VISIBILITY(OSA_KSTAT, os_kstat);
+   MAGIC_OS_VISIBILITY(OSA_KSTAT_2_4, os_kstat_2_4);
+   MAGIC_OS_VISIBILITY(OSA_TASK_STATE_VAL, os_task_state);
+   MAGIC_OS_VISIBILITY(OSA_CUR_SYSCALL_VAL, os_cur_syscall);
+   MAGIC_OS_VISIBILITY(OSA_ENTER_SCHED, os_enter_sched);
+   MAGIC_OS_VISIBILITY(OSA_EXIT_SWITCH_TO, os_exit_switch_to);
+
+   MAGIC_OSATXM(OSA_KERNEL_BOOT, osa_kernel_boot);
+
+   // Syncchar only
+   MAGIC_SYNCCHAR(OSA_REGISTER_SPINLOCK, osa_register_spinlock);
+
+   MAGIC_OS_VISIBILITY(OSA_EXIT_CODE, os_exit);
+   MAGIC_OSATXM(OSA_EXIT_CODE, osa_exit_code);
+   MAGIC_SYNCCHAR(OSA_EXIT_CODE, osa_exit);
+
+   // osatxm-specific stuff
+   MAGIC_OSATXM(OSA_XSETPID, osa_xsetpid);
+   MAGIC_OSATXM(OSA_NEW_PROC_VAL, osa_new_proc_val);
+   MAGIC_OSATXM(OSA_PROC_PRIO, osa_proc_prio);
+   MAGIC_OSATXM(OSA_ACTIVETX_DATA, osa_activetx_data);
+   MAGIC_OSATXM(OSA_KILL_TX, osa_kill_transaction);
+   MAGIC_OSATXM(OSA_SET_VCONF_ADDR_BUF, osa_set_vconf_addr_buf);
+   MAGIC_OSATXM(OSA_TX_STATE, osa_tx_state);
+   MAGIC_OSATXM(OSA_GET_CM_POLICY, osa_get_cm_policy);
+   MAGIC_OSATXM(OSA_SET_CM_POLICY, osa_set_cm_policy);
+   MAGIC_OSATXM(OSA_GET_BACKOFF_POLICY, osa_get_backoff_policy);
+   MAGIC_OSATXM(OSA_SET_BACKOFF_POLICY, osa_set_backoff_policy);
+   MAGIC_OSATXM(OSA_GET_BK_POLCHG_THRESH, osa_get_bk_polchg_thresh);
+   MAGIC_OSATXM(OSA_GET_CM_POLCHG_THRESH, osa_get_cm_polchg_thresh);
+   MAGIC_OSATXM(OSA_TRACK_EVENT_VAL, osa_track_named_event);
+   MAGIC_OSATXM(OSA_BACK_TRACE_VAL, osa_back_trace);
+   MAGIC_OSATXM(OSA_TX_TRACE_MODE_VAL, osa_tx_trace_mode);
+   MAGIC_OSATXM(OSA_THREAD_PROF_DATA, osa_thread_prof_data);
+   MAGIC_OSATXM(OSA_SINK_AREA_VAL, osa_sink_area_val);
+   MAGIC_OSATXM(OSA_TXMIGRATION_MODE, osa_txmigration_mode);
+   MAGIC_OSATXM(OSA_TX_SET_LOG_BASE, osa_tx_set_log_base);
+   MAGIC_OSATXM(OSA_ACTIVETX_PARAM, osa_activetx_param);
+   MAGIC_OSATXM(OSA_PAGE_FAULT, osa_page_fault);
+   MAGIC_OSATXM(OSA_GET_MAX_CONFLICTER, osa_get_max_conflicter);
+   MAGIC_OSATXM(OSA_CLEAR_MAX_CONFLICTER, osa_clear_max_conflicter);
+   MAGIC_OSATXM(OSA_LOG_SCHEDULE, osa_log_schedule);
+   MAGIC_OSATXM2(OSA_CXSPIN_INFO_TX, osa_cxspin_info);
+   MAGIC_OSATXM2(OSA_CXSPIN_INFO_NOTX, osa_cxspin_info);
+   MAGIC_OSATXM2(OSA_CXSPIN_INFO_IOTX, osa_cxspin_info);
+   MAGIC_OSATXM2(OSA_CXSPIN_INFO_IONOTX, osa_cxspin_info);
+   MAGIC_OSATXM(OSA_CX_LOCK_ATTEMPT, osa_cx_lock_attempt);
+   MAGIC_OSATXM2(OSA_OP_XGETTXID, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XBEGIN, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XBEGIN_IO, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XEND, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XPUSH, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XPOP, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XRESTART, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XRESTART_EX, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XCAS, osa_opcode);
+   MAGIC_OSATXM2(OSA_OP_XSTATUS, osa_opcode);
+   MAGIC_OSATXM(OSA_OP_XEND_USER, osa_xend_user);
+   MAGIC_OSATXM(OSA_OP_XABORT_USER, osa_xabort_user);
+   MAGIC_OSATXM(OSA_OP_XGETTXID_USER, osa_xgettxid_user);
+   MAGIC_OSATXM(OSA_OP_SET_USER_SYSCALL_BIT, osa_set_user_syscall_bit);
+   MAGIC_OSATXM(OSA_OP_GET_USER_SYSCALL_BIT, osa_get_user_syscall_bit);
+   MAGIC_OSATXM(OSA_USER_OVERFLOW_BEGIN, osa_user_overflow_begin);
+   MAGIC_OSATXM(OSA_USER_OVERFLOW_END, osa_user_overflow_end);
+   MAGIC_OSATXM(OSA_TXCACHE_TRACE, osa_txcache_trace_mode);
+
+   MAGIC_SYNCCHAR(SYNCCHAR_CLEAR_MAP, syncchar_clear_map);
+   MAGIC_SYNCCHAR(SYNCCHAR_LOAD_MAP, syncchar_load_map);
+}
+
+static magic_entry_t &magic_entry(osamod_t *osamod, osa_uinteger_t code) {
+   magic_table_t *t = osamod->common->magic;
+   if(t->generation != OSA_mod_generation())
+      build_magic_table(osamod);
+   return t->codes[code];
+}
+
+static inline void magic_dispatch(magic_entry_t &e, osa_uinteger_t code) {
+   for(vector<magic_handler_t>::iterator h = e.handlers.begin();
+       h != e.handlers.end(); h++) {
+      if(h->func2)
+         h->func2(code, h->mod);
+      else
+         h->func(h->mod);
+   }
+}
+
+static inline unsigned long long host_ns() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
-/**** End: Macros for magic_callback dispatching ***/
+/**** End: Magic instruction dispatch table ***/
 
 static void magic_callback(lang_void *callback_data, 
                            conf_object_t *trigger_obj) {
@@ -406,12 +551,15 @@ static void magic_callback(lang_void *callback_data,
    osamod_t *osamod = (osamod_t*)callback_data;
    common_data_t *common = osamod->common;
 
-   fp = fopen(log_file,"a");   
-
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
    int cpunum = osamod->minfo->getCpuNum(cpu);
    codeVal = _osa_read_register(cpu, regESI);
 
+   OSA_REPLAY_SCOPE(osamod, REPLAY_EV_MAGIC, cpu, NULL, NULL);
+
+   magic_entry_t &entry = magic_entry(osamod, codeVal);
+   unsigned long long start = host_ns();
+
    // do we want the results of this instruction to happen on
    // all machines?
    int all_flag = 0;
@@ -422,10 +570,11 @@ static void magic_callback(lang_void *callback_data,
    case OSA_PRINT_STR_VAL: 
       {
          string printStr =  osa_get_name_val(OSA_get_sim_cpu());
-         if( gbOsaPrintCout ){
+         if( common->print_cout ){
             cout << printStr << endl;
-	    fprintf(fp,"%s\n",printStr.c_str());
-		}
+            if(common->log_fp != NULL)
+               fprintf(common->log_fp, "%s\n", printStr.c_str());
+         }
          // Iterate over all of the modules for our machine (or all if
          // the all_flag is set), and put this string in their logs
          for(osamod_t *cur_mod = OSA_mod_list();
@@ -444,18 +593,14 @@ static void magic_callback(lang_void *callback_data,
 
          break;
       }
-   case OSA_CLEAR_STAT_ALL:
-      all_flag = 1;
-   case OSA_CLEAR_STAT:
-      DISPATCH_ALL(osamod, clear_stat, all_flag);
-      break;
-   case OSA_OUTPUT_STAT_ALL:
-      all_flag = 1;
-   case OSA_OUTPUT_STAT: 
-      DISPATCH_ALL(osamod, output_stat, all_flag);
-      break;
-
    case OSA_KILLSIM:
+      // Get the logs of this machine's modules out before the idle
+      // period ends the simulation
+      for(osamod_t *cur_mod = OSA_mod_list();
+          cur_mod != NULL; cur_mod = cur_mod->next_mod){
+         if(sameMachine(osamod, cur_mod))
+            log_flush(cur_mod->pStatStream);
+      }
       set_idle_callback(osamod);
       break;
    case OSA_BREAKSIM:
@@ -488,13 +633,14 @@ static void magic_callback(lang_void *callback_data,
             }
          }
 
-         // Make sure syncchar knows we are past boot so that it can
-         // start logging worksets if needed.  This is idempotent, so
-         // it is ok to run around every benchmark
-         DISPATCH_SYNCCHAR(osamod, osa_after_boot);
+         // Syncchar's osa_after_boot.  This is idempotent, so it is
+         // ok to run around every benchmark
+         magic_dispatch(entry, codeVal);
 
-         if(osamod->common->fast_caches != 2)
+         if(osamod->common->fast_caches != 2) {
             osamod->common->fast_caches = 0;
+            push_fast_caches((system_component_object_t *) osamod, 0);
+         }
 
          break;
       }
@@ -519,7 +665,7 @@ static void magic_callback(lang_void *callback_data,
          // Don't put newlines here - osa_get_num_char() already does.
          // Extra newlines play hell with sync_char_post
          
-         if( gbOsaPrintCout ) {
+         if( common->print_cout ) {
             cout << printStr;
             cout.flush();
          }
@@ -555,7 +701,7 @@ static void magic_callback(lang_void *callback_data,
             }
 
             if(sameMachine(osamod, cur_mod)){
-               *cur_mod->pStatStream << "Thread " << cur_mod->os->current_process[cpunum] 
+               *cur_mod->pStatStream << "Thread " << os_current_spid(cur_mod->os, cpunum) 
                                      << " starting up at cycle " << osa_get_sim_cycle_count(cpu) << endl;
             }
          }
@@ -578,7 +724,7 @@ static void magic_callback(lang_void *callback_data,
             }
 
             if(sameMachine(osamod, cur_mod)){
-               *cur_mod->pStatStream << "Thread " << cur_mod->os->current_process[cpunum] 
+               *cur_mod->pStatStream << "Thread " << os_current_spid(cur_mod->os, cpunum) 
                                      << " stopping at cycle " << osa_get_sim_cycle_count(cpu) << endl;
             }
          }
@@ -614,66 +760,6 @@ static void magic_callback(lang_void *callback_data,
       
       break;
    }
-      // os visibility is needed by each module.
-      // Maybe we can still put it in common later...
-   case OSA_SCHED: 
-      {
-         // Iterate over all of the modules for our machine (or all if
-         // the all_flag is set), and put this string in their logs
-         for(osamod_t *cur_mod = OSA_mod_list();
-             cur_mod != NULL; cur_mod = cur_mod->next_mod){
-            
-            // don't muck with other machines
-            if(!sameMachine(osamod, cur_mod))
-               continue;
-
-            if(cur_mod->type == COMMON && cur_mod->common->break_on_sched)
-               osa_break_simulation("OSA Magic Breakpoint Requested on schedule.");
-
-            // Syncchar needs to manage runqueue handoff when sched is executed
-            if(cur_mod->type == SYNCCHAR){
-               common_syncchar_interface_t *iface = 
-                  (common_syncchar_interface_t *) osa_sim_get_interface((conf_object_t *)cur_mod,
-                                                                    "common_syncchar_interface");
-               if( osa_sim_clear_error() ) {
-                  *cur_mod->pStatStream << "XXX: Can't find common syncchar interface" << endl;
-               } else {
-                  iface->osa_sched(cur_mod);
-               }
-            }
-
-            // Everyone does os_sched
-            os_sched(cur_mod);
-         }
-         break;
-      }
-   case OSA_FORK:
-      DISPATCH_OSATXM(osamod, osa_fork);
-      DISPATCH_SYNCCHAR(osamod, osa_fork);
-      DISPATCH_OS_VISIBILITY(osamod, os_fork);
-      break;
-   case OSA_TIMER:
-      DISPATCH_OS_VISIBILITY(osamod, os_timer);
-      break;
-   case OSA_KSTAT:
-      DISPATCH_OS_VISIBILITY(osamod, os_kstat);
-      break;
-   case OSA_KSTAT_2_4:
-      DISPATCH_OS_VISIBILITY(osamod, os_kstat_2_4);
-      break;
-   case OSA_TASK_STATE_VAL:
-      DISPATCH_OS_VISIBILITY(osamod, os_task_state);
-      break;
-   case OSA_CUR_SYSCALL_VAL:
-      DISPATCH_OS_VISIBILITY(osamod, os_cur_syscall);
-      break;
-   case OSA_ENTER_SCHED:
-      DISPATCH_OS_VISIBILITY(osamod, os_enter_sched);
-      break;
-   case OSA_EXIT_SWITCH_TO:
-      DISPATCH_OS_VISIBILITY(osamod, os_exit_switch_to);
-      break;
-
       // Dispatch this to trans-staller as well, to turn on cache
       // perturbation once we are out of the bios
    case OSA_KERNEL_BOOT:
@@ -681,145 +767,14 @@ static void magic_callback(lang_void *callback_data,
       // modules should be on the timing chain
       enable_cache_perturb((system_component_object_t *) osamod,
             osamod->minfo->getCpuNum(cpu));
-      DISPATCH_OSATXM(osamod, osa_kernel_boot);
+      magic_dispatch(entry, codeVal);
       break;
 
-      // Syncchar only
-   case OSA_REGISTER_SPINLOCK: 
-      DISPATCH_SYNCCHAR(osamod, osa_register_spinlock);
-      break;
-
-   case OSA_EXIT_CODE:
-      DISPATCH_OS_VISIBILITY(osamod, os_exit);
-      DISPATCH_OSATXM(osamod, osa_exit_code);
-      DISPATCH_SYNCCHAR(osamod, osa_exit);
-      break;
-      // osatxm-specific stuff
-   case OSA_XSETPID:
-      DISPATCH_OSATXM(osamod, osa_xsetpid);
-      break;
-   case OSA_NEW_PROC_VAL:
-      DISPATCH_OSATXM(osamod, osa_new_proc_val);
-      break;
-   case OSA_PROC_PRIO:
-      DISPATCH_OSATXM(osamod, osa_proc_prio);
-      break;
-   case OSA_ACTIVETX_DATA:
-      DISPATCH_OSATXM(osamod, osa_activetx_data);
-      break;
-   case OSA_KILL_TX:
-      DISPATCH_OSATXM(osamod, osa_kill_transaction);
-      break;
-   case OSA_SET_VCONF_ADDR_BUF:
-      DISPATCH_OSATXM(osamod, osa_set_vconf_addr_buf);
-      break;
-   case OSA_TX_STATE:
-      DISPATCH_OSATXM(osamod, osa_tx_state);
-      break;
-   case OSA_GET_CM_POLICY:
-      DISPATCH_OSATXM(osamod, osa_get_cm_policy);
-      break;
-   case OSA_SET_CM_POLICY:
-      DISPATCH_OSATXM(osamod, osa_set_cm_policy);
-      break;
-   case OSA_GET_BACKOFF_POLICY:
-      DISPATCH_OSATXM(osamod, osa_get_backoff_policy);
-      break;
-   case OSA_SET_BACKOFF_POLICY:
-      DISPATCH_OSATXM(osamod, osa_set_backoff_policy);
-      break;
-   case OSA_GET_BK_POLCHG_THRESH:
-      DISPATCH_OSATXM(osamod, osa_get_bk_polchg_thresh);
-      break;
-   case OSA_GET_CM_POLCHG_THRESH:
-      DISPATCH_OSATXM(osamod, osa_get_cm_polchg_thresh);
-      break;
    case OSA_GET_RANDOM: {
       osa_uinteger_t res = (osa_uinteger_t) rand();
       osa_write_register(cpu, regEBX, res);            
       break;
    }
-   case OSA_TRACK_EVENT_VAL:
-      DISPATCH_OSATXM(osamod, osa_track_named_event);
-      break;
-   case OSA_BACK_TRACE_VAL:
-      DISPATCH_OSATXM(osamod, osa_back_trace);
-      break;
-   case OSA_TX_TRACE_MODE_VAL:
-      DISPATCH_OSATXM(osamod, osa_tx_trace_mode);
-      break;
-   case OSA_THREAD_PROF_DATA:
-      DISPATCH_OSATXM(osamod, osa_thread_prof_data);
-      break;
-   case OSA_SINK_AREA_VAL:
-      DISPATCH_OSATXM(osamod, osa_sink_area_val);
-      break;
-   case OSA_TXMIGRATION_MODE:
-      DISPATCH_OSATXM(osamod, osa_txmigration_mode);
-      break;
-   case OSA_TX_SET_LOG_BASE:
-      DISPATCH_OSATXM(osamod, osa_tx_set_log_base);
-      break;
-   case OSA_ACTIVETX_PARAM:
-      DISPATCH_OSATXM(osamod, osa_activetx_param);
-      break;
-   case OSA_PAGE_FAULT:
-      DISPATCH_OSATXM(osamod, osa_page_fault);
-      break;
-   case OSA_GET_MAX_CONFLICTER:
-      DISPATCH_OSATXM(osamod, osa_get_max_conflicter);
-      break;
-   case OSA_CLEAR_MAX_CONFLICTER:
-      DISPATCH_OSATXM(osamod, osa_clear_max_conflicter);
-      break;
-   case OSA_LOG_SCHEDULE:
-      DISPATCH_OSATXM(osamod, osa_log_schedule);
-      break;
-   case OSA_CXSPIN_INFO_TX:
-   case OSA_CXSPIN_INFO_NOTX:
-   case OSA_CXSPIN_INFO_IOTX:
-   case OSA_CXSPIN_INFO_IONOTX:
-      DISPATCH_OSATXM2(osamod, osa_cxspin_info, codeVal);
-      break;
-   case OSA_CX_LOCK_ATTEMPT:
-      DISPATCH_OSATXM(osamod, osa_cx_lock_attempt);
-      break;
-   case OSA_OP_XGETTXID:
-   case OSA_OP_XBEGIN:
-   case OSA_OP_XBEGIN_IO:
-   case OSA_OP_XEND:
-   case OSA_OP_XPUSH:
-   case OSA_OP_XPOP:
-   case OSA_OP_XRESTART:
-   case OSA_OP_XRESTART_EX:
-   case OSA_OP_XCAS:
-   case OSA_OP_XSTATUS:
-      DISPATCH_OSATXM2(osamod, osa_opcode, codeVal);
-      break;
-
-   case OSA_OP_XEND_USER:
-      DISPATCH_OSATXM(osamod, osa_xend_user);
-      break;
-   case OSA_OP_XABORT_USER:
-      DISPATCH_OSATXM(osamod, osa_xabort_user);
-      break;
-   case OSA_OP_XGETTXID_USER:
-      DISPATCH_OSATXM(osamod, osa_xgettxid_user);
-      break;
-   case OSA_OP_SET_USER_SYSCALL_BIT:
-      DISPATCH_OSATXM(osamod, osa_set_user_syscall_bit);
-      break;
-   case OSA_OP_GET_USER_SYSCALL_BIT:
-      DISPATCH_OSATXM(osamod, osa_get_user_syscall_bit);
-      break;
-
-   case OSA_USER_OVERFLOW_BEGIN:
-      DISPATCH_OSATXM(osamod, osa_user_overflow_begin);
-      break;
-
-   case OSA_USER_OVERFLOW_END:
-      DISPATCH_OSATXM(osamod, osa_user_overflow_end);
-      break;
 
    case OSA_DEBUG_PRINT: {
          string printStr =  osa_get_name_val(OSA_get_sim_cpu());
@@ -847,18 +802,18 @@ static void magic_callback(lang_void *callback_data,
       struct watchpoint wp;
       wp.addr = addr;
       wp.len = length;
-      wp.pid = osamod->os->current_process[cpunum];
+      wp.pid = os_current_spid(osamod->os, cpunum);
       wp.bp = bp;
-      bps.insert(make_pair(addr, wp));
+      osamod->common->bps.insert(make_pair(addr, wp));
       break;
    }
    case OSA_UNPROTECT_ADDR: {
       osa_uinteger_t addr = osa_read_register(cpu, regEBX);
       map<osa_integer_t, watchpoint_t>::iterator iter =
-         bps.find(addr);
-      if(iter != bps.end()){
+         osamod->common->bps.find(addr);
+      if(iter != osamod->common->bps.end()){
          SIM_delete_breakpoint(iter->second.bp);
-         bps.erase(iter);
+         osamod->common->bps.erase(iter);
       } else {
          cout << "Can't find " << std::hex << addr << std::dec << endl;
          //osa_break_simulation("Boo");
@@ -867,12 +822,12 @@ static void magic_callback(lang_void *callback_data,
    }
    case OSA_PROTECT_SUSPEND: {
       int cpunum = osamod->minfo->getCpuNum(cpu);
-      suspend_protect[cpunum] = 1;
+      osamod->common->suspend_protect[cpunum] = 1;
       break;
    }
    case OSA_PROTECT_RESUME: {
       int cpunum = osamod->minfo->getCpuNum(cpu);
-      suspend_protect[cpunum] = 0;
+      osamod->common->suspend_protect[cpunum] = 0;
       break;
    }
 
@@ -884,7 +839,7 @@ static void magic_callback(lang_void *callback_data,
            << std::hex << addr  << std::dec
            << ", eip is at " 
            << std::hex << eip << std::dec 
-           << ", pid is " << osamod->os->current_process[cpunum]
+           << ", pid is " << os_current_spid(osamod->os, cpunum)
            << endl;
 
       SIM_break_simulation("SIGSEGV");
@@ -892,19 +847,6 @@ static void magic_callback(lang_void *callback_data,
       break;
    }
 
-   case SYNCCHAR_CLEAR_MAP: 
-      DISPATCH_SYNCCHAR(osamod, syncchar_clear_map);
-      break;
-
-   case SYNCCHAR_LOAD_MAP: 
-      DISPATCH_SYNCCHAR(osamod, syncchar_load_map);
-      break;
-
-   case OSA_TXCACHE_TRACE: {
-      DISPATCH_OSATXM(osamod, osa_txcache_trace_mode);
-      break;
-   }
-
    case OSA_RANDOM_SHUTDOWN_BEGIN:
    {
       /* Randomly shutdown between now and limit cycles from
@@ -1013,12 +955,16 @@ static void magic_callback(lang_void *callback_data,
    
       break;
 
+      // Codes that only dispatch to modules are in the table
    default:
-      pr("[common] odd magic breakpoint 0x%x\n", (int) codeVal);
-   
+      if(entry.known)
+         magic_dispatch(entry, codeVal);
+      else
+         pr("[common] odd magic breakpoint 0x%x\n", (int) codeVal);
    }
 
-   fclose (fp);
+   entry.calls++;
+   entry.host_ns += host_ns() - start;
 }
 
 /*
@@ -1030,6 +976,7 @@ static void breakpoint_callback(lang_void* callback_data,
                                 osa_integer_t break_number,
                                 osa_sim_inner_memop_t *memop) {
    osamod_t *osamod = (osamod_t *) callback_data;
+   common_data_t *common = osamod->common;
 
    osa_sim_outer_memop_t* xmt = (osa_sim_outer_memop_t*) memop;
    unsigned int addr = (unsigned int)xmt->linear_address;
@@ -1039,23 +986,23 @@ static void breakpoint_callback(lang_void* callback_data,
 
    /*
    cout << "Checking out a bp on addr " << std::hex << addr << std::dec 
-        << ", prot = " << suspend_protect[cpunum] << ", cpunum = " << cpunum << endl;
+        << ", prot = " << common->suspend_protect[cpunum] << ", cpunum = " << cpunum << endl;
    */
 
    /* Don't break on memops in a page fault handler */
-   if(suspend_protect[cpunum])
+   if(common->suspend_protect[cpunum])
       return;
 
-   if(bps.empty())
+   if(common->bps.empty())
       osa_break_simulation("Where did this come from?");
 
    /* Find the watchpoint object*/
-   for(map<osa_integer_t, watchpoint_t>::const_iterator it = bps.begin();
-       it != bps.end(); it++){
+   for(map<osa_integer_t, watchpoint_t>::const_iterator it = common->bps.begin();
+       it != common->bps.end(); it++){
 
       if(it->second.addr <= addr && addr <= it->second.addr + it->second.len){
          /* Make sure the current pc is right */
-         if(osamod->os->current_process[cpunum] == it->second.pid){
+         if(os_current_spid(osamod->os, cpunum) == it->second.pid){
             osa_break_simulation("Isolation violation");
             return;
          } else {
@@ -1183,7 +1130,7 @@ static set_error_t set_context_attribute(void*, conf_object_t *osamod_obj,
       SIM_set_attribute(cpu, "current_context",
                         &context_attr);
 
-      suspend_protect[i] = 0;
+      osamod->common->suspend_protect[i] = 0;
 
       hapHandle = SIM_hap_add_callback_obj(
                                            "Core_Magic_Instruction",
@@ -1230,16 +1177,191 @@ static set_error_t set_profile_interval(void*, conf_object_t *osamod_obj,
    return Sim_Set_Ok;
 }
 
+static attr_value_t get_profile_system_map(void*, conf_object_t *osamod,
+      attr_value_t *idx) {
+   const char *map = ((osamod_t*)osamod)->common->prof.system_map;
+   if(map == NULL)
+      return SIM_make_attr_nil();
+   return SIM_make_attr_string(map);
+}
+
+static set_error_t set_profile_system_map(void*, conf_object_t *osamod_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   osamod_t *osamod = (osamod_t*)osamod_obj;
+   if(osamod->common->prof.system_map != NULL)
+      MM_FREE((void*)osamod->common->prof.system_map);
+   osamod->common->prof.system_map = NULL;
+   if(val->kind != Sim_Val_Nil)
+      osamod->common->prof.system_map = MM_STRDUP(val->u.string);
+   return Sim_Set_Ok;
+}
+
+static attr_value_t get_profile_cpus(void*, conf_object_t *osamod,
+      attr_value_t *idx) {
+   set<int> &cpus = ((osamod_t*)osamod)->common->prof.cpus;
+   attr_value_t list = SIM_alloc_attr_list(cpus.size());
+   int i = 0;
+   for(set<int>::iterator it = cpus.begin(); it != cpus.end(); it++, i++) {
+      list.u.list.vector[i] = SIM_make_attr_integer(*it);
+   }
+   return list;
+}
+
+static set_error_t set_profile_cpus(void*, conf_object_t *osamod_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   osamod_t *osamod = (osamod_t*)osamod_obj;
+   osamod->common->prof.cpus.clear();
+   for(int i = 0; i < (int)val->u.list.size; i++) {
+      osamod->common->prof.cpus.insert(val->u.list.vector[i].u.integer);
+   }
+   return Sim_Set_Ok;
+}
+
+static attr_value_t get_profile_spids(void*, conf_object_t *osamod,
+      attr_value_t *idx) {
+   set<unsigned int> &spids = ((osamod_t*)osamod)->common->prof.spids;
+   attr_value_t list = SIM_alloc_attr_list(spids.size());
+   int i = 0;
+   for(set<unsigned int>::iterator it = spids.begin(); it != spids.end();
+         it++, i++) {
+      list.u.list.vector[i] = SIM_make_attr_integer(*it);
+   }
+   return list;
+}
+
+static set_error_t set_profile_spids(void*, conf_object_t *osamod_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   osamod_t *osamod = (osamod_t*)osamod_obj;
+   osamod->common->prof.spids.clear();
+   for(int i = 0; i < (int)val->u.list.size; i++) {
+      osamod->common->prof.spids.insert(val->u.list.vector[i].u.integer);
+   }
+   return Sim_Set_Ok;
+}
+
 static set_error_t set_common_log(void*, conf_object_t *osamod_obj, 
       attr_value_t *val, attr_value_t *idx) {
+   common_data_t *common = ((osamod_t*)osamod_obj)->common;
    time_t tim = time(NULL);  
-   strcpy(log_file, val->u.string);
-   fp = fopen (log_file,"a");
-   fprintf(fp, "###########################\nStarted simulation at %s\n\n", ctime(&tim));
-   fclose(fp);
+   // Kept open (and buffered) for the printing magic instructions
+   if(common->log_fp != NULL)
+      fclose(common->log_fp);
+   if(strlen(val->u.string) >= sizeof(common->log_file))
+      return Sim_Set_Illegal_Value;
+   strcpy(common->log_file, val->u.string);
+   common->log_fp = fopen (common->log_file,"a");
+   if(common->log_fp == NULL)
+      return Sim_Set_Illegal_Value;
+   fprintf(common->log_fp, "###########################\nStarted simulation at %s\n\n", ctime(&tim));
+   fflush(common->log_fp);
    return Sim_Set_Ok;
 }
 
+// Sorted by code
+static attr_value_t get_magic_stats(void*, conf_object_t *osamod_obj,
+      attr_value_t *idx) {
+   magic_table_t *t = ((osamod_t*)osamod_obj)->common->magic;
+   map<osa_uinteger_t, magic_entry_t*> sorted;
+   for(unordered_map<osa_uinteger_t, magic_entry_t>::iterator it =
+          t->codes.begin(); it != t->codes.end(); it++) {
+      if(it->second.calls)
+         sorted[it->first] = &it->second;
+   }
+   attr_value_t list = SIM_alloc_attr_list(sorted.size());
+   int i = 0;
+   for(map<osa_uinteger_t, magic_entry_t*>::iterator it = sorted.begin();
+       it != sorted.end(); it++, i++) {
+      attr_value_t stat = SIM_alloc_attr_list(4);
+      stat.u.list.vector[0] = SIM_make_attr_integer(it->first);
+      stat.u.list.vector[1] = SIM_make_attr_integer(it->second->calls);
+      stat.u.list.vector[2] = SIM_make_attr_integer(it->second->host_ns);
+      stat.u.list.vector[3] =
+         SIM_make_attr_integer(it->second->handlers.size());
+      list.u.list.vector[i] = stat;
+   }
+   return list;
+}
+
+/**** Begin: Offline replay capture ***/
+
+static attr_value_t get_replay_record(void*, conf_object_t *osamod_obj,
+      attr_value_t *idx) {
+   osamod_t *osamod = (osamod_t*)osamod_obj;
+   if(osamod->recorder == NULL)
+      return SIM_make_attr_nil();
+   return SIM_make_attr_string(osamod->recorder->name());
+}
+
+// Setting a file name starts a capture for this machine, setting nil
+// (or an empty string) closes it.  The capture starts with enough of
+// the module configuration for syncchar-replay to rebuild it.
+static set_error_t set_replay_record(void*, conf_object_t *osamod_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   osamod_t *osamod = (osamod_t*)osamod_obj;
+   replay_recorder *rec = osamod->recorder;
+
+   for(osamod_t *cur_mod = OSA_mod_list();
+       cur_mod != NULL; cur_mod = cur_mod->next_mod){
+      if(sameMachine(osamod, cur_mod))
+         cur_mod->recorder = NULL;
+   }
+   osamod->recorder = NULL;
+   delete rec;
+
+   if(val->kind != Sim_Val_String || val->u.string[0] == 0)
+      return Sim_Set_Ok;
+
+   if(osamod->minfo == NULL)
+      return Sim_Set_Illegal_Value;
+
+   rec = new replay_recorder(val->u.string, osamod);
+   if(!rec->good()) {
+      delete rec;
+      return Sim_Set_Illegal_Value;
+   }
+
+   static const char *common_attrs[] = {
+      "system", "context", "os_visibility", "fast_caches", NULL
+   };
+   static const char *syncchar_attrs[] = {
+      "system", "context", "os_visibility", "mapfile", "use_txcache",
+      "archived_worksets", "log_worksets", "online_independence",
+      "ws_sample_rate", "ws_sample_lock_rates", "ws_sample_caller_rates",
+      "ws_sample_window", "after_boot", NULL
+   };
+
+   // What the modules ask of the system component and its cpus
+   rec->record_attr(osamod->system, "cpu_list");
+   rec->record_attr(osamod->system, "object_prefix");
+   for(int i = 0; i < osamod->minfo->getNumCpus(); i++) {
+      rec->record_attr(osamod->minfo->getCpu(i), "architecture");
+      rec->record_attr(osamod->minfo->getCpu(i), "freq_mhz");
+   }
+
+   for(int i = 0; common_attrs[i]; i++)
+      rec->record_attr((conf_object_t *)osamod, common_attrs[i]);
+   osamod->recorder = rec;
+
+   for(osamod_t *cur_mod = OSA_mod_list();
+       cur_mod != NULL; cur_mod = cur_mod->next_mod){
+      if(!sameMachine(osamod, cur_mod) || cur_mod == osamod)
+         continue;
+      if(cur_mod->type == SYNCCHAR) {
+         for(int i = 0; syncchar_attrs[i]; i++)
+            rec->record_attr((conf_object_t *)cur_mod, syncchar_attrs[i]);
+      }
+      // get_next_module can't be read back, so record the
+      // registration explicitly
+      rec->record_attr((conf_object_t *)osamod, "modules",
+                       SIM_make_attr_object((conf_object_t *)cur_mod));
+      cur_mod->recorder = rec;
+   }
+
+   return Sim_Set_Ok;
+}
+
+/**** End: Offline replay capture ***/
+
 extern "C" {
    static system_component_object_t* new_common_instance(parse_object_t *parse_obj) {
 
@@ -1265,6 +1387,13 @@ extern "C" {
       osamod->common->preload        = 0;
       osamod->common->fast_caches    = 0;
       osamod->common->break_on_sched = false;
+      osamod->common->magic          = new magic_table_t;
+      osamod->common->magic->generation = 0;
+      osamod->common->print_cout     = OSA_PRINT_TO_CONSOLE;
+      osamod->common->log_file[0]    = 0;
+      osamod->common->log_fp         = NULL;
+      memset(osamod->common->suspend_protect, 0,
+             sizeof(osamod->common->suspend_protect));
       init_profiler(osamod);
 
       // Common errors go to stderr
@@ -1276,6 +1405,7 @@ extern "C" {
 
       osamod->common->kill_imminent = false;
       osamod->common->kill_safe_level = 0;
+      osamod->recorder = NULL;
       
       return &osamod->log.obj; //wouldn't "return osamod" do the same?
    }
@@ -1484,6 +1614,46 @@ extern "C" {
                                    "i", NULL,
                                    "Interval in cycles to log IP");
 
+      SIM_register_typed_attribute(
+                                   pConfClass, "profile_system_map",
+                                   get_profile_system_map, NULL,
+                                   set_profile_system_map, NULL,
+                                   Sim_Attr_Optional,
+                                   "s|n", NULL,
+                                   "Kernel System.map; symbols for the profile's call graph dump (prefix-a.prof) are resolved from it when it is written");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "profile_cpus",
+                                   get_profile_cpus, NULL,
+                                   set_profile_cpus, NULL,
+                                   Sim_Attr_Optional,
+                                   "[i*]", NULL,
+                                   "Cpu numbers to profile; empty for all");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "profile_spids",
+                                   get_profile_spids, NULL,
+                                   set_profile_spids, NULL,
+                                   Sim_Attr_Optional,
+                                   "[i*]", NULL,
+                                   "Spids to profile, e.g. the benchmark's threads; empty for all");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "magic_stats",
+                                   get_magic_stats, NULL,
+                                   0, NULL,
+                                   Sim_Attr_Pseudo,
+                                   "[[iiii]*]", NULL,
+                                   "[[code, calls, host ns, module callbacks]*] for the magic instructions seen on this machine.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "replay_record",
+                                   get_replay_record, NULL,
+                                   set_replay_record, NULL,
+                                   Sim_Attr_Session,
+                                   "s|n", NULL,
+                                   "Capture an offline replay trace for this machine to the given file (nil stops).");
+
    }
 
 #endif
@@ -1,8 +1,21 @@
 #ifndef __COMMON_H
 #define __COMMON_H
 
+#include <map>
+#include <stdio.h>
 #include "profile.h"
 
+// Magic instruction dispatch table, private to common.cc
+struct _magic_table;
+
+/* Active memory watchpoints for catching STM isolation violations */
+typedef struct watchpoint{
+   osa_integer_t addr;
+   osa_integer_t len;
+   unsigned int pid;
+   breakpoint_id_t bp;
+} watchpoint_t;
+
 typedef struct _common_data_t {
    system_component_object_t **ide;
    int ide_count;
@@ -32,6 +45,19 @@ typedef struct _common_data_t {
    bool kill_imminent;
    int kill_safe_level;
    osa_cycles_t kill_begin_time;
+
+   // Module callbacks and counters per magic code
+   struct _magic_table *magic;
+
+   // Print magic strings to the console, and to the log_init file
+   bool print_cout;
+   char log_file[256];
+   FILE *log_fp;
+
+   // Protected addresses by start, and cpus with protection
+   // suspended (in a page fault handler)
+   std::map<osa_integer_t, watchpoint_t> bps;
+   int suspend_protect[OSA_MAX_CPUS];
 } common_data_t;
 
 #ifdef _USE_SIMICS
@@ -14,17 +14,25 @@ using namespace std;
 #include "osacommon.h"
 #include "os.h"
 
-void init_procs(osamod_t *osamod){
-   // we have to use new here because os_data_t contains
-   // embedded c++ classes whose contstructors need
-   // calling
-   os_data_t *os = new os_data_t;
+static void free_slot(os_data_t *os, unsigned int slot) {
+   os->slots[slot] = NULL;
+   if(++os->slot_gen[slot] < OS_SPID_GEN_RETIRED)
+      os->free_slots.push_back(slot);
+}
+
+static void clear_procs(os_data_t *os) {
+   for(unsigned int i = 0; i < os->slots.size(); i++)
+      delete os->slots[i];
+   os->slots.clear();
+   os->slot_gen.clear();
+   os->free_slots.clear();
+   os->pids.clear();
+   os->nprocs = 0;
+}
+
+void os_init_procs(os_data_t *os) {
+   clear_procs(os);
 
-   osamod->os = os;
-   os->last_pid = 0;
-   os->timer_count = 0;
-   os->spid_max = 1;
-    
    struct pid_info *p0 = new struct pid_info();
    p0->pid = 0;
    p0->spid = 0;
@@ -33,12 +41,65 @@ void init_procs(osamod_t *osamod){
    p0->state = 0;
    p0->syscall = 0;
 
-   os->procs[0] = p0;
-   os->sprocs[0] = p0;
-   for(int i = 0; i < osamod->minfo->getNumCpus(); i++){
+   os->slots.push_back(p0);
+   os->slot_gen.push_back(0);
+   os->pids.push_back(p0);
+   os->nprocs = 1;
+   for(int i = 0; i < OSA_MAX_CPUS; i++){
       os->current_process[i] = 0;
    }
+}
+
+struct pid_info *os_add_proc(os_data_t *os, int pid, bool kernel) {
+   if(pid < 0)
+      return NULL;
+   os_remove_proc(os, pid);
+
+   unsigned int slot;
+   if(!os->free_slots.empty()) {
+      slot = os->free_slots.front();
+      os->free_slots.pop_front();
+   } else if(os->slots.size() < OS_SPID_SLOT_MASK) {
+      slot = os->slots.size();
+      os->slots.push_back(NULL);
+      os->slot_gen.push_back(0);
+   } else {
+      return NULL;
+   }
+
+   struct pid_info *pp = new struct pid_info();
+   pp->pid = pid;
+   pp->spid = OS_SPID(slot, os->slot_gen[slot]);
+   pp->kernel = kernel;
+   os->slots[slot] = pp;
+   if((unsigned int)pid >= os->pids.size())
+      os->pids.resize(pid + 1, NULL);
+   os->pids[pid] = pp;
+   os->nprocs++;
+   return pp;
+}
+
+bool os_remove_proc(os_data_t *os, int pid) {
+   struct pid_info *pp = os_pid_info(os, pid);
+   if(pp == NULL)
+      return false;
+   os->pids[pid] = NULL;
+   free_slot(os, OS_SPID_SLOT(pp->spid));
+   os->nprocs--;
+   delete pp;
+   return true;
+}
+
+void init_procs(osamod_t *osamod){
+   // we have to use new here because os_data_t contains
+   // embedded c++ classes whose contstructors need
+   // calling
+   os_data_t *os = new os_data_t;
+
+   osamod->os = os;
    os->last_pid = 0;
+   os->timer_count = 0;
+   os_init_procs(os);
    os->stat_interval = 10000000;
    os->kstat_plugin = NULL;
 }
@@ -51,7 +112,7 @@ void os_sched(osamod_t *osamod){
    unsigned int len =  (int)osa_read_register(cpu, regEDX);
    osa_logical_address_t ptr = osa_read_register(cpu, regEBX);
 
-   struct pid_info *pp = os->procs[pid];
+   struct pid_info *pp = os_pid_info(os, pid);
    if(pp == NULL){
       pr("Trying to access pid %d, which hasn't been forked yet.  Qua!?!\n", pid);
       osa_break_simulation("Invalid Access");
@@ -74,7 +135,7 @@ void os_sched(osamod_t *osamod){
    }
 	    
    pp->cpu = osamod->minfo->getCpuNum(cpu);
-   os->current_process[pp->cpu] = pp->spid;
+   os_set_current_spid(os, pp->cpu, pp->spid);
    //cout << "Running process " << pp->pid << ", cmd = [" << pp->cmd << "]" << endl;
 }
 
@@ -132,9 +193,6 @@ void os_fork(osamod_t *osamod){
    
    //cout << "Forked pid " << pid << " in kernel = " << kernel << endl;
 
-   struct pid_info *pp = new struct pid_info();
-   OSA_assert(pp != NULL, osamod);
-   pp->pid = pid;
    if(pid != os->last_pid + 1){
       pr("XXX Out-of-order pid allocation: last = %d, new pid = %d", os->last_pid,  pid);
       pr(" on CPU %d", osamod->minfo->getCpuNum(cpu));
@@ -145,17 +203,16 @@ void os_fork(osamod_t *osamod){
       pr("\n");
    }
    os->last_pid = pid;
-   pp->spid = os->spid_max;
-   os->spid_max++;
-   pp->kernel = kernel;
-   if(os->procs[pid]){
-      // garbage collect old proc_info
+   if(os_pid_info(os, pid)){
+      // os_add_proc garbage collects the old proc_info
       pr("XXX: Garbage collecting info for pid %d\n", pid);
-      struct pid_info *old_pp = os->procs[pid];
-      delete old_pp;
    }
-   os->procs[pid] = pp;
-   os->sprocs[pp->spid] = pp;
+   struct pid_info *pp = os_add_proc(os, pid, kernel);
+   if(pp == NULL){
+      pr("XXX: No spid left for pid %d\n", pid);
+      osa_break_simulation("Process table full");
+      return;
+   }
 
    // Initialize to unknown
    pp->state = 256;
@@ -169,10 +226,8 @@ void os_exit(osamod_t *osamod){
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
    osa_uinteger_t pid =  osa_read_register(cpu, regECX);
 
-   struct pid_info *pp = os->procs[pid];
-   os->sprocs.erase(pp->spid);
-   os->procs.erase(pid);
-   delete pp;
+   if(!os_remove_proc(os, pid))
+      pr("XXX: Exit of pid %d, which hasn't been forked\n", (int)pid);
 }
 
 void os_task_state(osamod_t *osamod){
@@ -182,7 +237,7 @@ void os_task_state(osamod_t *osamod){
    int pid =  (int)osa_read_register(cpu, regEBX);
    int state =  (int)osa_read_register(cpu, regECX);
 
-   struct pid_info *pp = os->procs[pid];
+   struct pid_info *pp = os_pid_info(os, pid);
    if(pp == NULL){
       pr("Trying to set state on pid %d, which hasn't been forked yet.  Qua!?!\n", pid);
       osa_break_simulation("Invalid Access");
@@ -201,7 +256,7 @@ void os_cur_syscall(osamod_t *osamod){
    int pid =  (int)osa_read_register(cpu, regEBX);
    int syscall =  (int)osa_read_register(cpu, regECX);
 
-   struct pid_info *pp = os->procs[pid];
+   struct pid_info *pp = os_pid_info(os, pid);
    if(pp == NULL){
       pr("Trying to set syscall on pid %d, which hasn't been forked yet.  Qua!?!\n", pid);
       osa_break_simulation("Invalid Access");
@@ -467,20 +522,56 @@ osa_attr_set_t set_os_visibility(void *arg, conf_object_t *obj,
    map<string, attr_value_t> os_map;
    dict_to_map(*pAttrValue, os_map);
 
-   os->spid_max = os_map["spid_max"].u.integer;
+   clear_procs(os);
+   unsigned int nslots = os_map["spid_max"].u.integer;
+   if(nslots > OS_SPID_SLOT_MASK)
+      nslots = OS_SPID_SLOT_MASK;
+   os->slots.resize(nslots, NULL);
+   // Checkpoints from before spids had generations have no slot_gen.
+   // Their spids are their slots; start the free ones at generation
+   // 1 so that an exited process's spid is not handed out again.
+   if(os_map.count("slot_gen")) {
+      attr_value_t &gens = os_map["slot_gen"];
+      for(unsigned int i = 0; i < nslots; i++)
+         os->slot_gen.push_back(i < (unsigned int)gens.u.list.size ?
+                                gens.u.list.vector[i].u.integer : 1);
+   } else {
+      os->slot_gen.resize(nslots, 1);
+   }
+
    for(int i = 0; i < os_map["sprocs"].u.dict.size; i++){
-      os->sprocs[os_map["sprocs"].u.dict.vector[i].key.u.integer] = 
+      struct pid_info *pp =
          deserialize_pid_info(os_map["sprocs"].u.dict.vector[i].value);
+      unsigned int slot = OS_SPID_SLOT(pp->spid);
+      if(slot >= nslots || os->slots[slot] != NULL){
+         pr("XXX: Can't restore spid %u\n", pp->spid);
+         delete pp;
+         continue;
+      }
+      os->slots[slot] = pp;
+      os->slot_gen[slot] = pp->spid >> OS_SPID_SLOT_BITS;
+      os->nprocs++;
+   }
+   for(unsigned int i = 0; i < nslots; i++){
+      if(os->slots[i] == NULL && os->slot_gen[i] < OS_SPID_GEN_RETIRED)
+         os->free_slots.push_back(i);
    }
 
    for(int i = 0; i < os_map["procs"].u.dict.size; i++){
-      os->procs[os_map["procs"].u.dict.vector[i].key.u.integer] = 
-         os->sprocs[os_map["procs"].u.dict.vector[i].value.u.integer];
+      int pid = os_map["procs"].u.dict.vector[i].key.u.integer;
+      struct pid_info *pp = os_spid_info(os,
+            os_map["procs"].u.dict.vector[i].value.u.integer);
+      if(pid < 0 || pp == NULL)
+         continue;
+      if((unsigned int)pid >= os->pids.size())
+         os->pids.resize(pid + 1, NULL);
+      os->pids[pid] = pp;
    }
 
    for(int i = 0; i < os_map["current_process"].u.dict.size; i++){
-      os->current_process[os_map["current_process"].u.dict.vector[i].key.u.integer] = 
-         os_map["current_process"].u.dict.vector[i].value.u.integer;
+      os_set_current_spid(os,
+            os_map["current_process"].u.dict.vector[i].key.u.integer,
+            os_map["current_process"].u.dict.vector[i].value.u.integer);
    }
 
    os->last_pid = os_map["last_pid"].u.integer;
@@ -498,33 +589,41 @@ attr_value_t get_os_visibility( void *arg, conf_object_t *obj,
    osamod_t *osamod = (osamod_t*)obj;
    os_data_t *os = osamod->os;
 
-   attr_value_t avReturn = SIM_alloc_attr_dict(7);
+   attr_value_t avReturn = SIM_alloc_attr_dict(8);
    avReturn.u.dict.vector[0].key = SIM_make_attr_string("spid_max");
-   avReturn.u.dict.vector[0].value = SIM_make_attr_integer(os->spid_max);
+   avReturn.u.dict.vector[0].value = SIM_make_attr_integer(os->slots.size());
    // serialize sprocs
    // then organize procs and current_process by spid
    avReturn.u.dict.vector[1].key = SIM_make_attr_string("sprocs");
-   avReturn.u.dict.vector[1].value = SIM_alloc_attr_dict(os->sprocs.size());
+   avReturn.u.dict.vector[1].value = SIM_alloc_attr_dict(os->nprocs);
    int i = 0;
-   for(map<spid_t, struct pid_info*>::iterator iter = os->sprocs.begin(); iter != os->sprocs.end(); iter++, i++){
-      avReturn.u.dict.vector[1].value.u.dict.vector[i].key = SIM_make_attr_integer(iter->first);
-      avReturn.u.dict.vector[1].value.u.dict.vector[i].value = serialize_pid_info(iter->second);
+   for(unsigned int slot = 0; slot < os->slots.size(); slot++){
+      struct pid_info *pp = os->slots[slot];
+      if(pp == NULL)
+         continue;
+      avReturn.u.dict.vector[1].value.u.dict.vector[i].key = SIM_make_attr_integer(pp->spid);
+      avReturn.u.dict.vector[1].value.u.dict.vector[i].value = serialize_pid_info(pp);
+      i++;
    }
 
    avReturn.u.dict.vector[2].key = SIM_make_attr_string("procs");
-   avReturn.u.dict.vector[2].value = SIM_alloc_attr_dict(os->procs.size());
+   avReturn.u.dict.vector[2].value = SIM_alloc_attr_dict(os->nprocs);
    i = 0;
-   for(map<int, struct pid_info*>::iterator iter = os->procs.begin(); iter != os->procs.end(); iter++, i++){
-      avReturn.u.dict.vector[2].value.u.dict.vector[i].key = SIM_make_attr_integer(iter->first);
-      avReturn.u.dict.vector[2].value.u.dict.vector[i].value = SIM_make_attr_integer(iter->second->spid);
+   for(unsigned int pid = 0; pid < os->pids.size(); pid++){
+      struct pid_info *pp = os->pids[pid];
+      if(pp == NULL)
+         continue;
+      avReturn.u.dict.vector[2].value.u.dict.vector[i].key = SIM_make_attr_integer(pid);
+      avReturn.u.dict.vector[2].value.u.dict.vector[i].value = SIM_make_attr_integer(pp->spid);
+      i++;
    }
 
+   int ncpus = osamod->minfo->getNumCpus();
    avReturn.u.dict.vector[3].key = SIM_make_attr_string("current_process");
-   avReturn.u.dict.vector[3].value = SIM_alloc_attr_dict(os->current_process.size());
-   i = 0;
-   for(map<int, spid_t>::iterator iter = os->current_process.begin(); iter != os->current_process.end(); iter++, i++){
-      avReturn.u.dict.vector[3].value.u.dict.vector[i].key = SIM_make_attr_integer(iter->first);
-      avReturn.u.dict.vector[3].value.u.dict.vector[i].value = SIM_make_attr_integer(iter->second);
+   avReturn.u.dict.vector[3].value = SIM_alloc_attr_dict(ncpus);
+   for(i = 0; i < ncpus; i++){
+      avReturn.u.dict.vector[3].value.u.dict.vector[i].key = SIM_make_attr_integer(i);
+      avReturn.u.dict.vector[3].value.u.dict.vector[i].value = SIM_make_attr_integer(os_current_spid(os, i));
    }
 
    avReturn.u.dict.vector[4].key = SIM_make_attr_string("last_pid");
@@ -536,6 +635,13 @@ attr_value_t get_os_visibility( void *arg, conf_object_t *obj,
    avReturn.u.dict.vector[6].key = SIM_make_attr_string("kstat_addrs");
    avReturn.u.dict.vector[6].value = get_kstat_addrs(os);
 
+   avReturn.u.dict.vector[7].key = SIM_make_attr_string("slot_gen");
+   avReturn.u.dict.vector[7].value = SIM_alloc_attr_list(os->slot_gen.size());
+   for(unsigned int slot = 0; slot < os->slot_gen.size(); slot++){
+      avReturn.u.dict.vector[7].value.u.list.vector[slot] =
+         SIM_make_attr_integer(os->slot_gen[slot]);
+   }
+
    return avReturn;
 }
 #else
@@ -17,6 +17,19 @@ using namespace std;
 
 typedef unsigned int spid_t;
 
+// A spid is a slot in the process table plus the slot's generation,
+// which is bumped each time the slot is reused, so a spid never
+// names two live processes and a stale one is told from the slot's
+// current owner.  Slot OS_SPID_SLOT_MASK is never handed out, so no
+// spid is (spid_t)-1.  Generations don't wrap: a slot whose generation
+// reaches OS_SPID_GEN_RETIRED is never used again, rather than let a
+// new process alias a spid still held in worksets and lock maps.
+#define OS_SPID_SLOT_BITS  16
+#define OS_SPID_SLOT_MASK  ((1U << OS_SPID_SLOT_BITS) - 1)
+#define OS_SPID_GEN_RETIRED ((1U << (32 - OS_SPID_SLOT_BITS)) - 1)
+#define OS_SPID(slot, gen) (((spid_t)(gen) << OS_SPID_SLOT_BITS) | (slot))
+#define OS_SPID_SLOT(spid) ((spid) & OS_SPID_SLOT_MASK)
+
 struct pid_info{
    int pid;
    spid_t spid;
@@ -56,7 +69,6 @@ PeriodicData()
 typedef struct _os_data_t {
    int last_pid;
    int timer_count;
-   unsigned int spid_max;
 
    /* Data for user/kernel/idle stats */
    vector<unsigned int> kstats;
@@ -64,9 +76,18 @@ typedef struct _os_data_t {
 
    int stat_interval;
 
-   map<int, struct pid_info*> procs;
-   map<spid_t, struct pid_info*> sprocs;
-   map<int, spid_t> current_process;
+   // Process table, use the os_* accessors below.  slots is indexed
+   // by spid slot and pids by Linux pid; both grow on demand.  Freed
+   // slots are reused oldest first, which spreads the generations,
+   // until they are retired.
+   vector<struct pid_info*> slots;
+   vector<unsigned short> slot_gen;
+   deque<unsigned int> free_slots;
+   vector<struct pid_info*> pids;
+   unsigned int nprocs;
+
+   // spid running on each cpu
+   spid_t current_process[OSA_MAX_CPUS];
 
    /* kstat plugin */
    void (*kstat_plugin)(lang_void *callback_data, 
@@ -79,6 +100,47 @@ typedef struct _os_data_t {
     int kernel_version;
 } os_data_t;
 
+// The spid running on cpu; 0 for a cpu we don't own
+static inline spid_t os_current_spid(const os_data_t *os, int cpu) {
+   if((unsigned int)cpu >= OSA_MAX_CPUS)
+      return 0;
+   return os->current_process[cpu];
+}
+
+static inline void os_set_current_spid(os_data_t *os, int cpu, spid_t spid) {
+   if((unsigned int)cpu < OSA_MAX_CPUS)
+      os->current_process[cpu] = spid;
+}
+
+// NULL if pid hasn't been forked, or has exited
+static inline struct pid_info *os_pid_info(const os_data_t *os, int pid) {
+   if((unsigned int)pid >= os->pids.size())
+      return NULL;
+   return os->pids[pid];
+}
+
+// NULL if spid has exited, even if its slot is in use again
+static inline struct pid_info *os_spid_info(const os_data_t *os, spid_t spid) {
+   unsigned int slot = OS_SPID_SLOT(spid);
+   if(slot >= os->slots.size())
+      return NULL;
+   struct pid_info *pp = os->slots[slot];
+   return pp != NULL && pp->spid == spid ? pp : NULL;
+}
+
+static inline unsigned int os_nprocs(const os_data_t *os) {
+   return os->nprocs;
+}
+
+// Set up an empty table holding only pid 0 (spid 0)
+void os_init_procs(os_data_t *os);
+// A new process with the next spid.  An existing pid's info is
+// dropped first.  NULL if the table is full (every slot in use or
+// retired).
+struct pid_info *os_add_proc(os_data_t *os, int pid, bool kernel);
+// Drop pid's info and free its slot; false if there is none
+bool os_remove_proc(os_data_t *os, int pid);
+
 void init_procs(osamod_t *osamod);
 void os_sched(osamod_t *osamod);
 void os_enter_sched(osamod_t *osamod);
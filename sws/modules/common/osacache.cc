@@ -623,6 +623,7 @@ set_timing_model( SIMULATOR_SET_GENERIC_ATTRIBUTE_SIGNATURE )
       }
       pOsaTxm->timing_model = GENERIC_ARGUMENT;
    }
+   invalidate_cache_hier(obj);
    return ATTR_OK;
 }
     
@@ -656,9 +657,11 @@ set_caches( SIMULATOR_SET_LIST_ATTRIBUTE_SIGNATURE )
 	
    MM_FREE( pOsaTxm->ppCaches );
    MM_FREE( pOsaTxm->ppCachesIfc );
+   MM_FREE( pOsaTxm->pCacheHier );
    pOsaTxm->nCaches = nCaches;
    pOsaTxm->ppCaches = MM_MALLOC( nCaches, system_component_object_t *);
    pOsaTxm->ppCachesIfc = MM_MALLOC( nCaches, timing_model_interface_t * ); 
+   pOsaTxm->pCacheHier = MM_ZALLOC( nCaches, cache_hier_t );
 	
    for( i=0; i<nCaches; i++ ) {
       pCache = &LIST_ARGUMENT(i);
@@ -678,12 +681,16 @@ set_caches( SIMULATOR_SET_LIST_ATTRIBUTE_SIGNATURE )
          pOsaTxm->nCaches = 0;
          MM_FREE(pOsaTxm->ppCaches);
          MM_FREE(pOsaTxm->ppCachesIfc);
+         MM_FREE(pOsaTxm->pCacheHier);
          pOsaTxm->ppCaches = NULL;
          pOsaTxm->ppCachesIfc = NULL;
+         pOsaTxm->pCacheHier = NULL;
          return INTERFACE_NOT_FOUND_ERR;
       }
       pOsaTxm->ppCaches[i] = pCache->u.object;
    }
+   // Walk the new hierarchies the next time they are asked for
+   invalidate_cache_hier(obj);
 	
    return ATTR_OK;
 }
@@ -723,70 +730,112 @@ get_caches( SIMULATOR_GET_ATTRIBUTE_SIGNATURE )
 }
 
 /*
- * find_staller
- * chase through the cache hierarchy until we find a staller
- * object, or conclude that one is not present. Don't assume
- * a particular structure to the hierarchy, other than that
- * there must be a splitter at the cpu (for i/d).
+ * resolve_cache_hier
+ * chase through procNum's cache hierarchy, recording the store
+ * buffer, L1D, any L2/L3 and the staller. Don't assume a
+ * particular structure to the hierarchy, other than that there
+ * must be a splitter at the cpu (for i/d). The hierarchy may not
+ * be wired up yet when the caches attribute is set, so this is
+ * done when a cpu's hierarchy is asked for. A walk that gets
+ * past the L1D is kept, whether or not the end of its
+ * timing_model chain is a staller, until invalidate_cache_hier();
+ * one that stops short of the L1D is redone on the next lookup.
  */
-system_component_object_t * 
-find_staller(system_component_object_t *pConfObject, int procNum) {
-   osamod_t * osamod = (osamod_t *) pConfObject;
-   system_component_object_t *pstorebuffer = NULL;   
-   system_component_object_t *pcache = NULL;
-   system_component_object_t *pstaller = NULL;
-   system_component_object_t *psplitter = NULL;
+static void 
+resolve_cache_hier(osamod_t *osamod, cache_hier_t *hier, int procNum) {
    system_component_object_t *pbranch = NULL;
-   if(NULL == osamod->ppCaches) return NULL;
-   if(NULL == (psplitter = osamod->ppCaches[procNum]))
+   system_component_object_t *pcache = NULL;
+   system_component_object_t *pnext = NULL;
+   memset(hier, 0, sizeof(*hier));
+   if(NULL == (hier->splitter = osamod->ppCaches[procNum]))
       goto clear_exception;
-   if(NULL == (pbranch = osa_sim_get_generic_attribute(psplitter, "dbranch")))
+   if(NULL == (pbranch = osa_sim_get_generic_attribute(hier->splitter, "dbranch")))
       goto clear_exception;
-   if(NULL == (pstorebuffer = osa_sim_get_generic_attribute(pbranch, "cache")))
+   if(NULL == (hier->storebuffer = osa_sim_get_generic_attribute(pbranch, "cache")))
       goto clear_exception;
-   if(NULL == (pcache = osa_sim_get_generic_attribute(pstorebuffer, "timing_model")))
+   hier->storebuffer_ac = (abort_commit_interface_t *) 
+      osa_sim_get_interface(hier->storebuffer, "abort-commit-interface");
+   if(osa_sim_get_error ()!= NO_ERROR)
+      osa_sim_clear_error();   
+   if(NULL == (hier->l1d = osa_sim_get_generic_attribute(hier->storebuffer, "timing_model")))
       goto clear_exception;
-   do {
-      /* follow timing_model connections until we find a staller */
-      if(NULL == (pstaller = osa_sim_get_generic_attribute(pcache, "timing_model")))
+   hier->l1d_ac = (abort_commit_interface_t *) 
+      osa_sim_get_interface(hier->l1d, "abort-commit-interface");
+   if(osa_sim_get_error ()!= NO_ERROR)
+      osa_sim_clear_error();   
+   pcache = hier->l1d;
+   hier->resolved = true;
+   for(;;) {
+      /* follow timing_model connections until we find a staller
+       * or the chain ends */
+      if(NULL == (pnext = osa_sim_get_generic_attribute(pcache, "timing_model")))
          goto clear_exception;
-      pcache = pstaller;
-   } while(strncmp(pstaller->name, "staller", strlen("staller")));
-   return pstaller;
+      if(!strncmp(pnext->name, "staller", strlen("staller"))) {
+         hier->staller = pnext;
+         break;
+      }
+      if(pcache == hier->l1d)
+         hier->l2 = pnext;
+      else if(pcache == hier->l2)
+         hier->l3 = pnext;
+      pcache = pnext;
+   }
+   return;
 clear_exception:
    if (osa_sim_get_error ()!= NO_ERROR)
       osa_sim_clear_error();   
-   return NULL;
+}
+
+/*
+ * cache_hier
+ * procNum's cache hierarchy, as far as it is wired up, or NULL
+ * if there is no caches list.
+ */
+static inline cache_hier_t *
+cache_hier(system_component_object_t *pConfObject, int procNum) {
+   osamod_t * osamod = (osamod_t *) pConfObject;
+   cache_hier_t *hier;
+   if(NULL == osamod->ppCaches || NULL == osamod->pCacheHier) 
+      return NULL;
+   hier = &osamod->pCacheHier[procNum];
+   if(!hier->resolved)
+      resolve_cache_hier(osamod, hier, procNum);
+   return hier;
+}
+
+/*
+ * invalidate_cache_hier
+ * forget the resolved hierarchies, e.g. because the caches list
+ * or the objects in it have been rewired. 
+ */
+void
+invalidate_cache_hier(system_component_object_t *pConfObject) {
+   osamod_t * osamod = (osamod_t *) pConfObject;
+   if(NULL == osamod->pCacheHier) return;
+   for(int i=0; i<osamod->nCaches; i++)
+      osamod->pCacheHier[i].resolved = false;
+}
+
+/*
+ * find_staller
+ * the staller object below procNum's L1D, or NULL if one
+ * is not present.
+ */
+system_component_object_t * 
+find_staller(system_component_object_t *pConfObject, int procNum) {
+   cache_hier_t *hier = cache_hier(pConfObject, procNum);
+   return hier ? hier->staller : NULL;
 }
 
 /*
  * find_l1_dcache
- * chase through the cache hierarchy until we find a staller
- * object, or conclude that one is not present. Don't assume
- * a particular structure to the hierarchy, other than that
- * there must be a splitter at the cpu (for i/d).
+ * the L1 data cache behind procNum's store buffer, or NULL if 
+ * one is not present.
  */
 system_component_object_t * 
 find_l1_dcache(system_component_object_t *pConfObject, int procNum) {
-   osamod_t * osamod = (osamod_t *) pConfObject;
-   system_component_object_t *pstorebuffer = NULL;   
-   system_component_object_t *pcache = NULL;
-   system_component_object_t *psplitter = NULL;
-   system_component_object_t *pbranch = NULL;
-   if(NULL == osamod->ppCaches) return NULL;
-   if(NULL == (psplitter = osamod->ppCaches[procNum]))
-      goto clear_exception;
-   if(NULL == (pbranch = osa_sim_get_generic_attribute(psplitter, "dbranch")))
-      goto clear_exception;
-   if(NULL == (pstorebuffer = osa_sim_get_generic_attribute(pbranch, "cache")))
-      goto clear_exception;
-   if(NULL == (pcache = osa_sim_get_generic_attribute(pstorebuffer, "timing_model")))
-      goto clear_exception;
-   return pcache;
-clear_exception:
-   if (osa_sim_get_error ()!= NO_ERROR)
-      osa_sim_clear_error();   
-   return NULL;
+   cache_hier_t *hier = cache_hier(pConfObject, procNum);
+   return hier ? hier->l1d : NULL;
 }
 
 /*
@@ -797,15 +846,8 @@ clear_exception:
 system_component_object_t * 
 hierarchy_entry(system_component_object_t *pConfObject, int procNum) {
    osamod_t * osamod = (osamod_t *) pConfObject;
-   system_component_object_t *psplitter = NULL;
    if(NULL == osamod->ppCaches) return NULL;
-   if(NULL == (psplitter = osamod->ppCaches[procNum]))
-      goto clear_exception;
-   return psplitter;
-clear_exception:
-   if (osa_sim_get_error ()!= NO_ERROR)
-      osa_sim_clear_error();   
-   return NULL;
+   return osamod->ppCaches[procNum];
 }
 
 /*
@@ -839,8 +881,8 @@ memhier_exercise(system_component_object_t * obj,
       mt.exception = Sim_PE_No_Exception;
       SIM_set_mem_op_type(&mt, isread ? Sim_Trans_Load : Sim_Trans_Store);
       
-      ifc = (timing_model_interface_t *) SIM_get_interface(top,
-                                                           TIMING_MODEL_INTERFACE);
+      // set_caches() already looked up top's interface
+      ifc = ((osamod_t *) obj)->ppCachesIfc[procNum];
       
       if(ifc) {
          latency += ifc->operate(top, NULL, NULL, &mt);
@@ -935,26 +977,13 @@ memhier_store_block(system_component_object_t * obj,
 
 /*
  * find_storebuffer
- * chase through the cache hierarchy until we find a storebuffer
+ * the store buffer on procNum's data branch, or NULL if one 
+ * is not present.
  */
 system_component_object_t * 
 find_storebuffer(system_component_object_t *pConfObject, int procNum) {
-   osamod_t * osamod = (osamod_t *) pConfObject;
-   system_component_object_t *pstorebuffer = NULL;   
-   system_component_object_t *psplitter = NULL;
-   system_component_object_t *pbranch = NULL;
-   if(NULL == osamod->ppCaches) return NULL;
-   if(NULL == (psplitter = osamod->ppCaches[procNum]))
-      goto clear_exception;
-   if(NULL == (pbranch = osa_sim_get_generic_attribute(psplitter, "dbranch")))
-      goto clear_exception;
-   if(NULL == (pstorebuffer = osa_sim_get_generic_attribute(pbranch, "cache")))
-      goto clear_exception;
-   return pstorebuffer;
-clear_exception:
-   if (osa_sim_get_error ()!= NO_ERROR)
-      osa_sim_clear_error();   
-   return NULL;
+   cache_hier_t *hier = cache_hier(pConfObject, procNum);
+   return hier ? hier->storebuffer : NULL;
 }
 
 
@@ -1043,53 +1072,62 @@ clear_exception:
       osa_sim_clear_error();   
 }
                          
+/*
+ * push_fast_caches
+ * tell the staller below each cpu whether cache latencies are
+ * being squashed, so that it need not ask the common module on
+ * every transaction. Stallers without a fast_caches attribute
+ * are left alone.
+ */
+void push_fast_caches(system_component_object_t *pConfObject, 
+                      int fast_caches) {
+   osamod_t * osamod = (osamod_t *) pConfObject;
+   system_component_object_t *pstaller = NULL;
+   integer_attribute_t av = INT_ATTRIFY(fast_caches);
+   for(int i=0; i<osamod->nCaches; i++) {
+      if(NULL == (pstaller = find_staller(pConfObject, i)))
+         continue;
+      if(ATTR_OK != osa_sim_set_integer_attribute(pstaller, "fast_caches", &av)
+         && osa_sim_get_error ()!= NO_ERROR)
+         osa_sim_clear_error();   
+   }
+}
+
 osa_cycles_t commitTxCache(system_component_object_t *obj, 
                            int currentTxID) {
    osa_cycles_t latency = 0;
-   abort_commit_interface_t * ifc = NULL;
-   system_component_object_t * pdcache = NULL;
-   system_component_object_t * pstorebuffer = NULL;
+   cache_hier_t * hier = NULL;
    osamod_t * osamod = (osamod_t *) obj;
    int procNum =  osamod->minfo->getCpuNum(OSA_get_sim_cpu());
    if(!osamod->use_txcache ||
       !osamod->ppCaches ||
       !osamod->ppCaches[procNum])
-      goto clear_exception;
-   if(NULL == (pdcache = find_l1_dcache(obj, procNum)))
-      goto clear_exception;
-   osamod->abort_commit_ifc = (abort_commit_interface_t *) osa_sim_get_interface(pdcache, "abort-commit-interface");
-   latency += osamod->abort_commit_ifc->commitTx(pdcache, currentTxID);
-   if(NULL == (pstorebuffer = find_storebuffer(obj, procNum)))
-      goto clear_exception;
-   ifc = (abort_commit_interface_t *) osa_sim_get_interface(pstorebuffer, "abort-commit-interface");
-   latency += ifc->commitTx(pstorebuffer, currentTxID);
-   return latency;
-clear_exception:
-   if (osa_sim_get_error ()!= NO_ERROR)
-      osa_sim_clear_error();   
+      return latency;
+   hier = cache_hier(obj, procNum);
+   if(NULL == hier->l1d || NULL == hier->l1d_ac)
+      return latency;
+   osamod->abort_commit_ifc = hier->l1d_ac;
+   latency += hier->l1d_ac->commitTx(hier->l1d, currentTxID);
+   if(NULL == hier->storebuffer || NULL == hier->storebuffer_ac)
+      return latency;
+   latency += hier->storebuffer_ac->commitTx(hier->storebuffer, currentTxID);
    return latency;
 }
 
 osa_cycles_t abortTxCache(conf_object_t * obj, int currentTxID, int procNum) {   
    osa_cycles_t latency = 0;
    osamod_t * osamod = (osamod_t *) obj;
-   conf_object_t *pdcache = NULL;
-   conf_object_t *pstorebuffer = NULL;
-   abort_commit_interface_t * ifc = NULL;
+   cache_hier_t * hier = NULL;
    if(!osamod->use_txcache || !osamod->ppCaches) 
-      goto clear_exception;
-   if(NULL == (pdcache = find_l1_dcache(obj, procNum)))
-      goto clear_exception;
-   osamod->abort_commit_ifc = (abort_commit_interface_t *) osa_sim_get_interface(pdcache, "abort-commit-interface");
-   latency += osamod->abort_commit_ifc->abortTx(pdcache, currentTxID);
-   if(NULL == (pstorebuffer = find_storebuffer(obj, procNum)))
-      goto clear_exception;
-   ifc = (abort_commit_interface_t *) osa_sim_get_interface(pstorebuffer, "abort-commit-interface");
-   latency += ifc->abortTx(pstorebuffer, currentTxID);
-   return latency;
-clear_exception:
-   if (SIM_get_pending_exception ()!= NO_ERROR)
-      SIM_clear_exception();   
+      return latency;
+   hier = cache_hier(obj, procNum);
+   if(NULL == hier->l1d || NULL == hier->l1d_ac)
+      return latency;
+   osamod->abort_commit_ifc = hier->l1d_ac;
+   latency += hier->l1d_ac->abortTx(hier->l1d, currentTxID);
+   if(NULL == hier->storebuffer || NULL == hier->storebuffer_ac)
+      return latency;
+   latency += hier->storebuffer_ac->abortTx(hier->storebuffer, currentTxID);
    return latency;
 }
 
@@ -1097,27 +1135,21 @@ void earlyRelease(system_component_object_t *obj,
                   osa_physical_address_t paddr,
                   osa_logical_address_t laddr,
                   int currentTxID) {
-   abort_commit_interface_t * ifc = NULL;
-   system_component_object_t *pdcache = NULL;
-   system_component_object_t *pstorebuffer = NULL;
+   cache_hier_t * hier = NULL;
    osamod_t * osamod = (osamod_t *) obj;
    int procNum =  osamod->minfo->getCpuNum(OSA_get_sim_cpu());
    if(!osamod->use_txcache ||
       !osamod->ppCaches ||
       !osamod->ppCaches[procNum])
-      goto clear_exception;
-   if(NULL == (pdcache = find_l1_dcache(obj, procNum)))
-      goto clear_exception;
-   osamod->abort_commit_ifc = (abort_commit_interface_t *) osa_sim_get_interface(pdcache, "abort-commit-interface");
-   osamod->abort_commit_ifc->earlyRelease(pdcache, paddr, laddr, currentTxID);
-   if(NULL == (pstorebuffer = find_storebuffer(obj, procNum)))
-      goto clear_exception;
-   ifc = (abort_commit_interface_t *) osa_sim_get_interface(pstorebuffer, "abort-commit-interface");
-   ifc->earlyRelease(pstorebuffer, paddr, laddr, currentTxID);
-   return;
-clear_exception:
-   if (osa_sim_get_error ()!= NO_ERROR)
-      osa_sim_clear_error();   
+      return;
+   hier = cache_hier(obj, procNum);
+   if(NULL == hier->l1d || NULL == hier->l1d_ac)
+      return;
+   osamod->abort_commit_ifc = hier->l1d_ac;
+   hier->l1d_ac->earlyRelease(hier->l1d, paddr, laddr, currentTxID);
+   if(NULL == hier->storebuffer || NULL == hier->storebuffer_ac)
+      return;
+   hier->storebuffer_ac->earlyRelease(hier->storebuffer, paddr, laddr, currentTxID);
 }
 
 
@@ -80,6 +80,9 @@ osa_cycles_t memhier_store_block(system_component_object_t * obj,
 system_component_object_t * 
 find_l1_dcache(system_component_object_t *pConfObject, int procNum);
 
+void
+invalidate_cache_hier(system_component_object_t *pConfObject);
+
 osa_attr_set_t
 set_timing_model( SIMULATOR_SET_GENERIC_ATTRIBUTE_SIGNATURE );
 
@@ -129,6 +132,8 @@ void earlyRelease(system_component_object_t *obj,
                   int currentTxID);
 void enable_cache_perturb(system_component_object_t *pConfObject, 
                           int procNum);
+void push_fast_caches(system_component_object_t *pConfObject, 
+                      int fast_caches);
 
 #endif
 
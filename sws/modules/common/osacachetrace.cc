@@ -8,9 +8,7 @@
 // Copyright 2006, 2007. All Rights Reserved.
 // See LICENSE file for license terms.
 
-#include <simics/api.h>
-#include <simics/alloc.h>
-#include <simics/utils.h>
+#include "simulator.h"
 #include "osacachetrace.h"
 #include "../txcache/types.h"
 
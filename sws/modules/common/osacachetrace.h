@@ -76,6 +76,7 @@ const char * event_str(pcache_event e);
 const char * event_status(pcache_event e);
 const char * event_line_state(pcache_event e);
 const char * event_miss_classification(pcache_event e);
+// One event as text; CacheTrace.h writes them in binary
 void dump_event(FILE * fp, pcache_event evt);
 void check_state(pcache_event evt);
 #ifdef __cplusplus
@@ -11,14 +11,20 @@
 #include "osacommon.h"
 #include "osacache.h"
 #include "memaccess.h"
+#include "LogSink.h"
 
 static osamod_t *head_mod = NULL;
+static unsigned int mod_generation = 0;
 osamod_t *OSA_mod_list() {
    return head_mod;
 }
 void OSA_add_mod(osamod_t *osamod) {
    osamod->next_mod = head_mod;
    head_mod = osamod;
+   mod_generation++;
+}
+unsigned int OSA_mod_generation() {
+   return mod_generation;
 }
 
 
@@ -160,8 +166,16 @@ set_log( SIMULATOR_SET_STRING_ATTRIBUTE_SIGNATURE ) {
    osamod_t *osamod = (osamod_t*)obj;
 
    time_t tim = time(NULL);
+   // The new log keeps the old one's buffering
+   size_t bufsize = LOG_SINK_BUFSIZE;
+   bool async = false;
+   LogSink *old = log_sink(osamod->pStatStream);
+   if(old != NULL) {
+      bufsize = old->buffer_size();
+      async = old->async();
+   }
    delete osamod->pStatStream;
-   osamod->pStatStream = new ofstream(STRING_ARGUMENT);
+   osamod->pStatStream = new LogStream(STRING_ARGUMENT, bufsize, async);
    if(osamod->pStatStream->good() == false){
       return ATTR_VALUE_ERR;
    }
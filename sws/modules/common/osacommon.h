@@ -59,6 +59,23 @@ typedef struct _ctxtsw_hist_t {
    osa_cycles_t       tot_ctxtsw;
    osa_cycles_t       tot_ctxtsw_cyc;
 } ctxtsw_hist;
+/*
+ * one cpu's data-side cache hierarchy, looked up once from its
+ * entry in the caches list: splitter -> dbranch -> store buffer ->
+ * L1D -> (L2 -> L3 ->) staller. Any piece may be missing. The
+ * abort-commit interfaces are those of the L1D and store buffer.
+ */
+typedef struct _cache_hier_t {
+   bool resolved;
+   system_component_object_t *splitter;
+   system_component_object_t *storebuffer;
+   system_component_object_t *l1d;
+   system_component_object_t *l2;
+   system_component_object_t *l3;
+   system_component_object_t *staller;
+   abort_commit_interface_t *l1d_ac;
+   abort_commit_interface_t *storebuffer_ac;
+} cache_hier_t;
 
 typedef struct _osamod_t {
 #ifdef _USE_SIMICS
@@ -100,6 +117,8 @@ typedef struct _osamod_t {
    system_component_object_t ** ppCaches;
    timing_model_interface_t **ppCachesIfc;
    int nCaches;
+   /* ppCaches[i]'s hierarchy, filled in on first use */
+   cache_hier_t *pCacheHier;
    int overflowBit;
    int tOperateCount;
    vector <conflict_store_t> pConflictStore;
@@ -133,6 +152,11 @@ typedef struct _osamod_t {
     */
    struct _osamod_t *next_mod;
 
+   /* Offline replay capture, shared by all modules of a machine.
+    * NULL unless common's replay_record attribute is set.
+    */
+   class replay_recorder *recorder;
+
 } osamod_t;
 
 int sameMachine(osamod_t *a, osamod_t *b);
@@ -223,6 +247,8 @@ typedef struct common_osatxm_interface {
 /* register a list of all osamod objects */
 osamod_t *OSA_mod_list();
 void OSA_add_mod(osamod_t *);
+// Bumped whenever the module list changes
+unsigned int OSA_mod_generation();
 
 osa_attr_set_t
 set_tx_trace( SIMULATOR_SET_INTEGER_ATTRIBUTE_SIGNATURE );
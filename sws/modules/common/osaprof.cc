@@ -0,0 +1,105 @@
+// MetaTM Project
+// File Name: osaprof.cc
+//
+// Description: osaprof, prints a profiler call graph dump
+// (prefix-a.prof, format in ProfileTrie.h).
+//
+//    osaprof [-f] [-n count] dump
+//
+// With no options, prints the samples taken and the count functions
+// (20) with the most samples, self and total.  -f prints the folded
+// stacks instead, one line per stack, for flamegraph.pl:
+//    func;func;func samples
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include "ProfileTrie.h"
+
+using namespace std;
+
+static void usage(const char *prog) {
+   cerr << "usage: " << prog << " [-f] [-n count] dump" << endl;
+   exit(1);
+}
+
+static bool by_self(const pair<string, pair<uint64_t, uint64_t> > &a,
+                    const pair<string, pair<uint64_t, uint64_t> > &b) {
+   return a.second.first > b.second.first;
+}
+
+static void top(const ProfileDump &dump, unsigned int count) {
+   // self, and total counted once per stack, by function
+   map<string, pair<uint64_t, uint64_t> > funcs;
+   vector<string> names(dump.size());
+   for(unsigned int i = 1; i < dump.size(); i++) {
+      names[i] = dump.function(i);
+      funcs[names[i]].first += dump.node(i).self;
+      // recursion: only the outermost frame of a function adds
+      bool outer = true;
+      for(unsigned int p = dump.node(i).parent; p != 0 && outer;
+          p = dump.node(p).parent)
+         outer = names[p] != names[i];
+      if(outer)
+         funcs[names[i]].second += dump.node(i).total;
+   }
+
+   vector<pair<string, pair<uint64_t, uint64_t> > > sorted(funcs.begin(),
+                                                          funcs.end());
+   stable_sort(sorted.begin(), sorted.end(), by_self);
+   uint64_t samples = dump.node(0).total;
+   cout << samples << " samples every " << dump.header().interval
+        << " cycles, " << dump.size() - 1 << " call graph nodes, "
+        << dump.header().nsyms << " symbols" << endl;
+   cout << "     self    total  function" << endl;
+   for(unsigned int i = 0; i < sorted.size() && i < count; i++) {
+      char line[64];
+      sprintf(line, "%8.2f%% %7.2f%%  ",
+              100.0 * sorted[i].second.first / samples,
+              100.0 * sorted[i].second.second / samples);
+      cout << line << sorted[i].first << endl;
+   }
+}
+
+int main(int argc, char **argv) {
+   bool fold = false;
+   unsigned int count = 20;
+   int c;
+
+   while((c = getopt(argc, argv, "fn:")) != -1) {
+      switch(c) {
+      case 'f': fold = true; break;
+      case 'n': count = strtoul(optarg, NULL, 0); break;
+      default: usage(argv[0]);
+      }
+   }
+   if(optind != argc - 1)
+      usage(argv[0]);
+
+   ProfileDump dump;
+   if(!dump.read(argv[optind])) {
+      cerr << dump.error() << endl;
+      return 1;
+   }
+   if(fold)
+      dump.folded(cout);
+   else if(dump.node(0).total)
+      top(dump, count);
+   return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -1,6 +1,7 @@
 #include "profile.h"
 #include "common.h"
 #include "memaccess.h"
+#include "os.h"
 
 static unsigned int std_read_4bytes(osamod_t *osamod,
       osa_cpu_object_t *cpu, osa_segment_t segment,
@@ -16,6 +17,7 @@ void init_profiler(osamod_t *osamod) {
    osamod->common->prof.scheduled = false;
    osamod->common->prof.memread = std_read_4bytes;
    osamod->common->prof.mem_reader = osamod;
+   osamod->common->prof.system_map = NULL;
 
    // look up the limits of kernel text in the symtable
    conf_object_t *st0 = osa_get_object_by_name("st0");
@@ -34,28 +36,105 @@ void init_profiler(osamod_t *osamod) {
    osamod->common->prof.text_max = text_max;
 }
 
-static void profiler_tick(conf_object_t *cpu, void* osamod_arg) {
-   osamod_t *osamod = (osamod_t*)osamod_arg;
-   common_data_t *common = osamod->common;
+// Stack pages translated during one tick.  A kernel stack is two
+// pages, so a walk never needs more.
+#define PROF_XLATE_PAGES 4
+#define PROF_PAGE_MASK   (~(uinteger_t)4095)
 
-   logical_address_t eip = SIM_get_program_counter(cpu);
-   if(eip >= common->prof.text_min && eip < common->prof.text_max) {
-      profile_iterator_t fpit = common->prof.flat_profile.find(eip);
-      if(fpit != common->prof.flat_profile.end()) {
-         fpit->second++;
-      }
-      else {
-         common->prof.flat_profile[eip] = 1;
+typedef struct _prof_xlate_t {
+   int n;
+   uinteger_t page[PROF_XLATE_PAGES];
+   osa_physical_address_t paddr[PROF_XLATE_PAGES];
+} prof_xlate_t;
+
+// Physical address of the stack word at addr, 0 if it isn't mapped
+static osa_physical_address_t stack_paddr(osa_cpu_object_t *cpu,
+      prof_xlate_t *xl, uinteger_t addr) {
+   uinteger_t page = addr & PROF_PAGE_MASK;
+   for(int i = 0; i < xl->n; i++) {
+      if(xl->page[i] == page) {
+         return xl->paddr[i] ? xl->paddr[i] + (addr - page) : 0;
       }
+   }
+   osa_physical_address_t paddr =
+      OSA_logical_to_physical(cpu, STACK_SEGMENT, page);
+   if(xl->n < PROF_XLATE_PAGES) {
+      xl->page[xl->n] = page;
+      xl->paddr[xl->n] = paddr;
+      xl->n++;
+   }
+   return paddr ? paddr + (addr - page) : 0;
+}
 
-      profile_iterator_t spit = common->prof.stack_profile.find(eip);
-      if(spit != common->prof.stack_profile.end()) {
-         spit->second++;
+// Read the saved ebp and the return address of the frame at ebp.
+// Reads go through osatxm when it is loaded, so that they see
+// transactional data; otherwise each stack page is translated once
+// per tick and both words come in one physical read.
+static bool read_frame(common_data_t *common, osa_cpu_object_t *cpu,
+      prof_xlate_t *xl, uinteger_t ebp, uinteger_t *prev_ebp,
+      uinteger_t *ra) {
+   if(common->prof.memread != std_read_4bytes) {
+      *ra = common->prof.memread(common->prof.mem_reader, cpu,
+            STACK_SEGMENT, ebp+4);
+      *prev_ebp = common->prof.memread(common->prof.mem_reader, cpu,
+            STACK_SEGMENT, ebp);
+      return true;
+   }
+
+   osa_physical_address_t paddr = stack_paddr(cpu, xl, ebp);
+   if(paddr == 0) {
+      return false;
+   }
+   if(((ebp + 7) & PROF_PAGE_MASK) == (ebp & PROF_PAGE_MASK)) {
+      unsigned long long v = osa_read_sim_8bytes_phys(cpu, paddr);
+      *prev_ebp = (unsigned int)v;
+      *ra = (unsigned int)(v >> 32);
+      return true;
+   }
+   osa_physical_address_t ra_paddr = stack_paddr(cpu, xl, ebp+4);
+   if(ra_paddr == 0) {
+      return false;
+   }
+   *prev_ebp = osa_read_sim_4bytes_phys(cpu, paddr);
+   *ra = osa_read_sim_4bytes_phys(cpu, ra_paddr);
+   return true;
+}
+
+// Whether cpu's current sample passes the cpu and spid filters
+static bool profile_wanted(osamod_t *osamod, osa_cpu_object_t *cpu) {
+   ip_profiler_t *prof = &osamod->common->prof;
+   if(prof->cpus.empty() && prof->spids.empty()) {
+      return true;
+   }
+   int cpunum = osamod->minfo->getCpuNum(cpu);
+   if(!prof->cpus.empty() && prof->cpus.find(cpunum) == prof->cpus.end()) {
+      return false;
+   }
+   if(!prof->spids.empty()) {
+      if(osamod->os == NULL) {
+         return false;
       }
-      else {
-         common->prof.stack_profile[eip] = 1;
+      spid_t spid = os_current_spid(osamod->os, cpunum);
+      if(prof->spids.find(spid) == prof->spids.end()) {
+         return false;
       }
+   }
+   return true;
+}
 
+static void profiler_tick(conf_object_t *cpu, void* osamod_arg) {
+   osamod_t *osamod = (osamod_t*)osamod_arg;
+   common_data_t *common = osamod->common;
+
+   logical_address_t eip = SIM_get_program_counter(cpu);
+   if(eip >= common->prof.text_min && eip < common->prof.text_max &&
+         profile_wanted(osamod, cpu)) {
+      uint32_t frames[MAX_FRAMES + 1];
+      int n = 0;
+      frames[n++] = eip;
+
+      prof_xlate_t xl;
+      xl.n = 0;
       uinteger_t ebp = _osa_read_register(cpu, regEBP);
       uinteger_t esp = _osa_read_register(cpu, regESP);
       for(int n_frames = 0; n_frames < MAX_FRAMES; n_frames++) {
@@ -66,30 +145,25 @@ static void profiler_tick(conf_object_t *cpu, void* osamod_arg) {
             break;
          }
 
-         // read the return address and check if its in kernel text
-         uinteger_t ra = common->prof.memread(common->prof.mem_reader, cpu,
-               STACK_SEGMENT, ebp+4);
-         if(ra < common->prof.text_min || ra >= common->prof.text_max) {
+         uinteger_t ra, prev_ebp;
+         if(!read_frame(common, cpu, &xl, ebp, &prev_ebp, &ra)) {
             break;
          }
 
-         spit = common->prof.stack_profile.find(ra);
-         if(spit != common->prof.stack_profile.end()) {
-            spit->second++;
-         }
-         else {
-            common->prof.stack_profile[ra] = 1;
+         // check if the return address is in kernel text
+         if(ra < common->prof.text_min || ra >= common->prof.text_max) {
+            break;
          }
+         frames[n++] = ra;
 
-         // read previous ebp and check that it actually goes up the stack
-         uinteger_t prev_ebp = common->prof.memread(common->prof.mem_reader,
-               cpu, STACK_SEGMENT, ebp);
+         // check that the previous ebp actually goes up the stack
          if(prev_ebp <= ebp) {
             break;
          }
          ebp = prev_ebp;
-         n_frames++;
       }
+
+      common->prof.trie.add(frames, n);
    }
 
    profiler_schedule_tick(osamod, cpu);
@@ -121,30 +195,44 @@ void profiler_schedule_tick(osamod_t *osamod, osa_cpu_object_t *cpu) {
 }
 
 void dump_profile(osamod_t *osamod, ostream *out) {
-   if(osamod->common->prof.flat_profile.empty()) {
+   ip_profiler_t *prof = &osamod->common->prof;
+   if(prof->trie.samples() == 0) {
       return;
    }
 
    bool cleanup_out = false;
    if(out == NULL) {
-      if(osamod->common->prof.log_prefix == NULL) {
+      if(prof->log_prefix == NULL) {
          return;
       }
 
-      int len = strlen(osamod->common->prof.log_prefix);
+      int len = strlen(prof->log_prefix);
       char *logname = (char*)alloca(len + 7);
-      strcpy(logname, osamod->common->prof.log_prefix);
+      strcpy(logname, prof->log_prefix);
       logname[len] = '-';
-      logname[len+1] = 'a' + (unsigned char)osamod->common->prof.log_number;
+      logname[len+1] = 'a' + (unsigned char)prof->log_number;
       strcpy(logname + len + 2, ".log");
       out = new ofstream(logname);
       cleanup_out = true;
+
+      // and the call graph next to it, as prefix-a.prof
+      ProfileSymbols syms;
+      if(prof->system_map != NULL && !syms.load(prof->system_map)) {
+         cerr << "profiler: " << syms.error() << endl;
+      }
+      strcpy(logname + len + 2, ".prof");
+      if(!prof->trie.write(logname, &syms, prof->interval)) {
+         cerr << "profiler: can't write " << logname << ": "
+              << strerror(errno) << endl;
+      }
    }
 
+   map<uint32_t, uint64_t> counts;
+   prof->trie.flat(counts);
    *out << "BEGIN FLAT PROFILE" << endl;
-   profile_iterator_t pit = osamod->common->prof.flat_profile.begin();
+   map<uint32_t, uint64_t>::iterator pit = counts.begin();
    uinteger_t total = 0;
-   for(; pit != osamod->common->prof.flat_profile.end(); pit++) {
+   for(; pit != counts.end(); pit++) {
       unsigned int addr = pit->first;
       unsigned int count = pit->second;
       *out << hex << addr << " " << dec << count << endl;
@@ -152,10 +240,12 @@ void dump_profile(osamod_t *osamod, ostream *out) {
    }
    *out << "TOTAL: " << total << endl << endl;
 
+   counts.clear();
+   prof->trie.calls(counts);
    *out << "BEGIN CALL PROFILE" << endl;
-   pit = osamod->common->prof.stack_profile.begin();
+   pit = counts.begin();
    total = 0;
-   for(; pit != osamod->common->prof.stack_profile.end(); pit++) {
+   for(; pit != counts.end(); pit++) {
       unsigned int addr = pit->first;
       unsigned int count = pit->second;
       *out << hex << addr << " " << dec << count << endl;
@@ -169,7 +259,6 @@ void dump_profile(osamod_t *osamod, ostream *out) {
 }
 
 void clear_profile(osamod_t *osamod) {
-   osamod->common->prof.flat_profile.clear();
-   osamod->common->prof.stack_profile.clear();
+   osamod->common->prof.trie.clear();
    osamod->common->prof.log_number++;
 }
@@ -4,6 +4,7 @@
 #include <simulator.h>
 #include <osacommon.h>
 #include <fstream>
+#include "ProfileTrie.h"
 
 using namespace std::tr1;
 
@@ -22,14 +23,17 @@ typedef struct _ip_profiler {
          osa_segment_t segment, osa_logical_address_t addr);
    osamod_t *mem_reader;
 
-   unordered_map<unsigned int, unsigned long long> flat_profile;
-   unordered_map<unsigned int, unsigned long long> stack_profile;
+   // a sample's IP and return addresses, from the IP outwards
+   ProfileTrie trie;
    logical_address_t text_min;
    logical_address_t text_max;
-} ip_profiler_t;
 
-typedef unordered_map<unsigned int, unsigned long long>::iterator
-   profile_iterator_t;
+   // only sample these cpus and spids; empty for all
+   set<int> cpus;
+   set<unsigned int> spids;
+   // symbols for the binary dump, read when it is written
+   const char *system_map;
+} ip_profiler_t;
 
 
 void init_profiler(struct _osamod_t *common);
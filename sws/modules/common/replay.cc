@@ -0,0 +1,1122 @@
+// MetaTM Project
+// File Name: replay.cc
+//
+// Description: Simics API emulation for the offline trace-replay
+// backend (see replay.h).  Classes, objects, attributes, interfaces,
+// haps, breakpoints and posted events are kept in simple tables.
+// Register values, cycle counts and guest memory are taken from the
+// recorded stream before each event is dispatched.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <stdarg.h>
+#include <tr1/unordered_map>
+#include <map>
+#include <vector>
+#include <deque>
+#include <string>
+#include <iostream>
+
+#include "simulator.h"
+#include "replaytrace.h"
+
+using namespace std;
+
+typedef struct _replay_attr_t {
+   get_attr_t get;
+   lang_void *get_data;
+   set_attr_t set;
+   lang_void *set_data;
+} replay_attr_t;
+
+typedef struct _replay_class_t {
+   conf_class_t pub;          // must be first
+   class_data_t data;
+   // Classes nobody registered (cpus, the system component, ...)
+   // are created on demand and keep attributes in a plain store
+   bool generic;
+   map<string, replay_attr_t> attrs;
+   map<string, void *> ifaces;
+} replay_class_t;
+
+typedef struct _replay_object_t {
+   conf_object_t obj;         // must be first
+   map<string, attr_value_t> attrs;
+   int cpu_num;               // -1 unless the object is a recorded cpu
+   cycles_t cycle;
+   uinteger_t regs[REPLAY_NREGS];
+} replay_object_t;
+
+typedef struct _replay_hap_t {
+   string hap;
+   conf_object_t *obj;        // NULL for global callbacks
+   obj_hap_func_t func;
+   lang_void *data;
+   integer_t index;           // -1 unless periodic
+   cycles_t next;
+   bool live;
+} replay_hap_t;
+
+typedef struct _replay_bp_t {
+   conf_object_t *obj;
+   uint64 addr;
+   uint64 len;
+   bool live;
+} replay_bp_t;
+
+typedef struct _replay_post_t {
+   conf_object_t *obj;
+   event_handler_t func;
+   lang_void *data;
+   cycles_t when;
+} replay_post_t;
+
+typedef struct _replay_override_t {
+   string obj;
+   string attr;
+   string value;
+   bool used;
+} replay_override_t;
+
+typedef void (*hap_func_0_t)(lang_void *, conf_object_t *);
+typedef void (*hap_func_int_t)(lang_void *, conf_object_t *, integer_t);
+typedef void (*hap_func_memop_t)(lang_void *, conf_object_t *,
+                                 generic_transaction_t *);
+typedef void (*hap_func_bp_t)(lang_void *, conf_object_t *, integer_t,
+                              generic_transaction_t *);
+
+static map<string, replay_class_t *> classes;
+static map<string, conf_object_t *> objects;
+static vector<replay_hap_t> haps;            // handle is index + 1
+static vector<replay_bp_t> bps;              // id is index + 1
+static deque<replay_post_t> stacked_posts;
+static vector<pair<conf_object_t *, replay_post_t> > time_posts;
+static vector<replay_override_t> overrides;
+
+static sim_exception_t pending_exception = SimExc_No_Exception;
+static string last_error;
+static conf_object_t *current_cpu = NULL;
+static vector<string> cpu_names;
+static bool quit_requested = false;
+// Set once the configuration records at the start of the stream
+// have been applied
+static bool configured = false;
+static replay_stats_t *cur_stats = NULL;
+
+// Guest state, filled from the stream
+typedef pair<int, logical_address_t> xlate_key_t;
+typedef struct _xlate_val_t {
+   physical_address_t paddr;
+   bool fault;
+} xlate_val_t;
+static map<xlate_key_t, xlate_val_t> xlate;
+static map<xlate_key_t, physical_address_t> xlate_pages;
+static tr1::unordered_map<physical_address_t, uint8> phys_mem;
+
+#define REPLAY_PAGE_SHIFT 12
+#define REPLAY_PAGE_MASK  ((1ULL << REPLAY_PAGE_SHIFT) - 1)
+
+static void set_error(sim_exception_t exc, const string &msg) {
+   pending_exception = exc;
+   last_error = msg;
+}
+
+static replay_object_t *generic_object(const conf_object_t *obj) {
+   if(obj == NULL)
+      return NULL;
+   return (replay_object_t *)obj->replay_data;
+}
+
+static replay_class_t *replay_class(const conf_object_t *obj) {
+   return (replay_class_t *)obj->class_data;
+}
+
+/**** Attribute values ****/
+
+attr_value_t SIM_make_attr_string(const char *str) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   if(str == NULL) {
+      v.kind = Sim_Val_Nil;
+   } else {
+      v.kind = Sim_Val_String;
+      v.u.string = str;
+   }
+   return v;
+}
+
+attr_value_t SIM_make_attr_integer(integer_t i) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   v.kind = Sim_Val_Integer;
+   v.u.integer = i;
+   return v;
+}
+
+attr_value_t SIM_make_attr_boolean(integer_t b) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   v.kind = Sim_Val_Boolean;
+   v.u.boolean = b ? 1 : 0;
+   return v;
+}
+
+attr_value_t SIM_make_attr_floating(double d) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   v.kind = Sim_Val_Floating;
+   v.u.floating = d;
+   return v;
+}
+
+attr_value_t SIM_make_attr_object(conf_object_t *obj) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   if(obj == NULL) {
+      v.kind = Sim_Val_Nil;
+   } else {
+      v.kind = Sim_Val_Object;
+      v.u.object = obj;
+   }
+   return v;
+}
+
+attr_value_t SIM_make_attr_nil(void) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   v.kind = Sim_Val_Nil;
+   return v;
+}
+
+attr_value_t SIM_make_attr_invalid(void) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   v.kind = Sim_Val_Invalid;
+   return v;
+}
+
+attr_value_t SIM_alloc_attr_list(integer_t length) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   v.kind = Sim_Val_List;
+   v.u.list.size = length;
+   v.u.list.vector = length ? MM_ZALLOC(length, attr_value_t) : NULL;
+   return v;
+}
+
+attr_value_t SIM_alloc_attr_dict(integer_t length) {
+   attr_value_t v;
+   memset(&v, 0, sizeof(v));
+   v.kind = Sim_Val_Dict;
+   v.u.dict.size = length;
+   v.u.dict.vector = length ? MM_ZALLOC(length, attr_dict_pair_t) : NULL;
+   return v;
+}
+
+// Like Simics 3, strings are not owned by the value and are not
+// freed here
+void SIM_free_attribute(attr_value_t value) {
+   switch(value.kind) {
+   case Sim_Val_List:
+      for(int i = 0; i < value.u.list.size; i++)
+         SIM_free_attribute(value.u.list.vector[i]);
+      MM_FREE(value.u.list.vector);
+      break;
+   case Sim_Val_Dict:
+      for(int i = 0; i < value.u.dict.size; i++) {
+         SIM_free_attribute(value.u.dict.vector[i].key);
+         SIM_free_attribute(value.u.dict.vector[i].value);
+      }
+      MM_FREE(value.u.dict.vector);
+      break;
+   case Sim_Val_Data:
+      MM_FREE(value.u.data.data);
+      break;
+   default:
+      break;
+   }
+}
+
+// Deep copy.  With own_strings the copy gets private string storage
+// (used for values kept in the generic attribute store).
+static attr_value_t copy_attr(attr_value_t v, bool own_strings) {
+   attr_value_t c = v;
+   switch(v.kind) {
+   case Sim_Val_String:
+      if(own_strings)
+         c.u.string = MM_STRDUP(v.u.string);
+      break;
+   case Sim_Val_List:
+      c = SIM_alloc_attr_list(v.u.list.size);
+      for(int i = 0; i < v.u.list.size; i++)
+         c.u.list.vector[i] = copy_attr(v.u.list.vector[i], own_strings);
+      break;
+   case Sim_Val_Dict:
+      c = SIM_alloc_attr_dict(v.u.dict.size);
+      for(int i = 0; i < v.u.dict.size; i++) {
+         c.u.dict.vector[i].key = copy_attr(v.u.dict.vector[i].key,
+                                            own_strings);
+         c.u.dict.vector[i].value = copy_attr(v.u.dict.vector[i].value,
+                                              own_strings);
+      }
+      break;
+   case Sim_Val_Data:
+      c.u.data.data = MM_MALLOC(v.u.data.size, uint8);
+      memcpy(c.u.data.data, v.u.data.data, v.u.data.size);
+      break;
+   default:
+      break;
+   }
+   return c;
+}
+
+static void free_owned_attr(attr_value_t v) {
+   switch(v.kind) {
+   case Sim_Val_String:
+      MM_FREE((char *)v.u.string);
+      break;
+   case Sim_Val_List:
+      for(int i = 0; i < v.u.list.size; i++)
+         free_owned_attr(v.u.list.vector[i]);
+      MM_FREE(v.u.list.vector);
+      break;
+   case Sim_Val_Dict:
+      for(int i = 0; i < v.u.dict.size; i++) {
+         free_owned_attr(v.u.dict.vector[i].key);
+         free_owned_attr(v.u.dict.vector[i].value);
+      }
+      MM_FREE(v.u.dict.vector);
+      break;
+   default:
+      SIM_free_attribute(v);
+      break;
+   }
+}
+
+/**** Classes and objects ****/
+
+static replay_class_t *new_class(const char *name, bool generic) {
+   replay_class_t *cls = new replay_class_t;
+   cls->pub.name = MM_STRDUP(name);
+   memset(&cls->data, 0, sizeof(cls->data));
+   cls->generic = generic;
+   classes[name] = cls;
+   return cls;
+}
+
+conf_class_t *SIM_register_class(const char *name, class_data_t *class_data) {
+   replay_class_t *cls = new_class(name, false);
+   cls->data = *class_data;
+   return &cls->pub;
+}
+
+conf_class_t *SIM_get_class(const char *name) {
+   map<string, replay_class_t *>::iterator it = classes.find(name);
+   if(it == classes.end()) {
+      set_error(SimExc_General, string("No class ") + name);
+      return NULL;
+   }
+   return &it->second->pub;
+}
+
+int SIM_register_interface(conf_class_t *cls, const char *name, void *iface) {
+   ((replay_class_t *)cls)->ifaces[name] = iface;
+   return 0;
+}
+
+void *SIM_get_interface(const conf_object_t *obj, const char *name) {
+   if(obj != NULL) {
+      replay_class_t *cls = replay_class(obj);
+      map<string, void *>::iterator it = cls->ifaces.find(name);
+      if(it != cls->ifaces.end())
+         return it->second;
+   }
+   set_error(SimExc_Lookup, string("No interface ") + name);
+   return NULL;
+}
+
+int SIM_register_typed_attribute(conf_class_t *cls, const char *name,
+                                 get_attr_t get_attr, lang_void *user_data_get,
+                                 set_attr_t set_attr, lang_void *user_data_set,
+                                 attr_attr_t attr, const char *type,
+                                 const char *idx_type, const char *desc) {
+   replay_attr_t a;
+   a.get = get_attr;
+   a.get_data = user_data_get;
+   a.set = set_attr;
+   a.set_data = user_data_set;
+   ((replay_class_t *)cls)->attrs[name] = a;
+   return 0;
+}
+
+attr_value_t SIM_get_attribute_idx(conf_object_t *obj, const char *name,
+                                   attr_value_t *idx) {
+   if(obj == NULL) {
+      set_error(SimExc_General, string("get of ") + name + " on NULL");
+      return SIM_make_attr_invalid();
+   }
+   replay_class_t *cls = replay_class(obj);
+   map<string, replay_attr_t>::iterator it = cls->attrs.find(name);
+   if(it != cls->attrs.end() && it->second.get != NULL)
+      return it->second.get(it->second.get_data, obj, idx);
+
+   replay_object_t *gen = generic_object(obj);
+   if(gen != NULL && idx == NULL) {
+      map<string, attr_value_t>::iterator vit = gen->attrs.find(name);
+      if(vit != gen->attrs.end())
+         return copy_attr(vit->second, false);
+   }
+   set_error(SimExc_Attribute, string("No attribute ") + obj->name + "."
+             + name);
+   return SIM_make_attr_invalid();
+}
+
+attr_value_t SIM_get_attribute(conf_object_t *obj, const char *name) {
+   return SIM_get_attribute_idx(obj, name, NULL);
+}
+
+set_error_t SIM_set_attribute(conf_object_t *obj, const char *name,
+                              attr_value_t *value) {
+   if(obj == NULL)
+      return Sim_Set_Object_Not_Found;
+   replay_class_t *cls = replay_class(obj);
+   map<string, replay_attr_t>::iterator it = cls->attrs.find(name);
+   if(it != cls->attrs.end()) {
+      if(it->second.set == NULL)
+         return Sim_Set_Not_Writable;
+      return it->second.set(it->second.set_data, obj, value, NULL);
+   }
+
+   replay_object_t *gen = generic_object(obj);
+   if(gen == NULL)
+      return Sim_Set_Attribute_Not_Found;
+   map<string, attr_value_t>::iterator vit = gen->attrs.find(name);
+   if(vit != gen->attrs.end())
+      free_owned_attr(vit->second);
+   gen->attrs[name] = copy_attr(*value, true);
+   return Sim_Set_Ok;
+}
+
+conf_object_t *SIM_get_object(const char *name) {
+   map<string, conf_object_t *>::iterator it = objects.find(name);
+   if(it == objects.end()) {
+      set_error(SimExc_General, string("No object named ") + name);
+      return NULL;
+   }
+   return it->second;
+}
+
+static conf_object_t *new_generic_object(const char *class_name,
+                                         const char *name) {
+   map<string, replay_class_t *>::iterator cit = classes.find(class_name);
+   replay_class_t *cls = cit != classes.end() ? cit->second
+      : new_class(class_name, true);
+
+   replay_object_t *gen = new replay_object_t;
+   gen->obj.class_data = &cls->pub;
+   gen->obj.name = MM_STRDUP(name);
+   gen->obj.replay_data = gen;
+   gen->cpu_num = -1;
+   gen->cycle = 0;
+   memset(gen->regs, 0, sizeof(gen->regs));
+
+   for(unsigned i = 0; i < cpu_names.size(); i++) {
+      if(cpu_names[i] == name) {
+         gen->cpu_num = i;
+         if(current_cpu == NULL)
+            current_cpu = &gen->obj;
+      }
+   }
+
+   objects[name] = &gen->obj;
+   return &gen->obj;
+}
+
+static conf_object_t *new_object(const char *class_name, const char *name) {
+   map<string, conf_object_t *>::iterator oit = objects.find(name);
+   if(oit != objects.end())
+      return oit->second;
+
+   map<string, replay_class_t *>::iterator cit = classes.find(class_name);
+   if(cit == classes.end() || cit->second->generic
+      || cit->second->data.new_instance == NULL)
+      return new_generic_object(class_name, name);
+
+   replay_class_t *cls = cit->second;
+   parse_object_t parse_obj;
+   parse_obj.name = MM_STRDUP(name);
+   parse_obj.class_data = &cls->pub;
+   conf_object_t *obj = cls->data.new_instance(&parse_obj);
+   if(obj == NULL)
+      return NULL;
+   obj->class_data = &cls->pub;
+   obj->name = parse_obj.name;
+   obj->replay_data = NULL;
+   objects[name] = obj;
+   return obj;
+}
+
+void SIM_log_constructor(log_object_t *log, parse_object_t *parse_obj) {
+   log->obj.name = parse_obj->name;
+   log->obj.class_data = parse_obj->class_data;
+   log->obj.replay_data = NULL;
+   log->log_level = 1;
+}
+
+void SIM_log_error(log_object_t *log, int group, const char *fmt, ...) {
+   va_list ap;
+   va_start(ap, fmt);
+   fprintf(stderr, "[%s error] ", log->obj.name);
+   vfprintf(stderr, fmt, ap);
+   fprintf(stderr, "\n");
+   va_end(ap);
+}
+
+/**** Simulation control ****/
+
+void SIM_break_simulation(const char *msg) {
+   if(cur_stats)
+      cur_stats->breaks++;
+   cerr << "[replay] break: " << (msg ? msg : "") << endl;
+}
+
+void SIM_quit(int exit_code) {
+   quit_requested = true;
+}
+
+int SIM_initial_configuration_ok(void) {
+   return configured;
+}
+
+sim_exception_t SIM_get_pending_exception(void) {
+   return pending_exception;
+}
+
+sim_exception_t SIM_clear_exception(void) {
+   sim_exception_t exc = pending_exception;
+   pending_exception = SimExc_No_Exception;
+   return exc;
+}
+
+const char *SIM_last_error(void) {
+   return last_error.c_str();
+}
+
+/**** Processors ****/
+
+conf_object_t *SIM_current_processor(void) {
+   return current_cpu;
+}
+
+int SIM_get_processor_number(const conf_object_t *cpu) {
+   replay_object_t *gen = generic_object(cpu);
+   return gen ? gen->cpu_num : -1;
+}
+
+cycles_t SIM_cycle_count(conf_object_t *cpu) {
+   replay_object_t *gen = generic_object(cpu);
+   return gen ? gen->cycle : 0;
+}
+
+static int reg_slot(int reg) {
+   if(reg == regEAX) return REPLAY_REG_EAX;
+   if(reg == regECX) return REPLAY_REG_ECX;
+   if(reg == regEDX) return REPLAY_REG_EDX;
+   if(reg == regEBX) return REPLAY_REG_EBX;
+   if(reg == regESP) return REPLAY_REG_ESP;
+   if(reg == regEBP) return REPLAY_REG_EBP;
+   if(reg == regESI) return REPLAY_REG_ESI;
+   if(reg == regEDI) return REPLAY_REG_EDI;
+   if(reg == regEIP) return REPLAY_REG_EIP;
+   return -1;
+}
+
+uinteger_t SIM_read_register(conf_object_t *cpu, int reg) {
+   replay_object_t *gen = generic_object(cpu);
+   int slot = reg_slot(reg);
+   if(gen == NULL || slot < 0)
+      return 0;
+   return gen->regs[slot];
+}
+
+void SIM_write_register(conf_object_t *cpu, int reg, uinteger_t value) {
+   replay_object_t *gen = generic_object(cpu);
+   int slot = reg_slot(reg);
+   if(gen != NULL && slot >= 0)
+      gen->regs[slot] = value;
+}
+
+int SIM_get_register_number(conf_object_t *cpu, const char *name) {
+   static const struct { const char *name; int *num; } names[] = {
+      { "eax", &regEAX }, { "ecx", &regECX }, { "edx", &regEDX },
+      { "ebx", &regEBX }, { "esp", &regESP }, { "ebp", &regEBP },
+      { "esi", &regESI }, { "edi", &regEDI }, { "eip", &regEIP },
+   };
+   for(unsigned i = 0; i < sizeof(names)/sizeof(names[0]); i++) {
+      if(0 == strcmp(names[i].name, name))
+         return *names[i].num;
+   }
+   set_error(SimExc_Lookup, string("No register ") + name);
+   return -1;
+}
+
+attr_value_t SIM_get_all_registers(conf_object_t *cpu) {
+   int regs[REPLAY_NREGS] = { regEAX, regECX, regEDX, regEBX, regESP,
+                              regEBP, regESI, regEDI, regEIP };
+   attr_value_t list = SIM_alloc_attr_list(REPLAY_NREGS);
+   for(int i = 0; i < REPLAY_NREGS; i++)
+      list.u.list.vector[i] = SIM_make_attr_integer(regs[i]);
+   return list;
+}
+
+logical_address_t SIM_get_program_counter(conf_object_t *cpu) {
+   return SIM_read_register(cpu, regEIP);
+}
+
+// The stream does not carry the cpl; the modules only ever use it to
+// tell kernel from user, and the kernel lives above 0xc0000000
+processor_mode_t SIM_processor_privilege_level(conf_object_t *cpu) {
+   return SIM_read_register(cpu, regEIP) >= 0xc0000000 ?
+      Sim_CPU_Mode_Supervisor : Sim_CPU_Mode_User;
+}
+
+/**** Guest memory ****/
+
+uinteger_t SIM_read_phys_memory(conf_object_t *cpu, physical_address_t paddr,
+                                int length) {
+   uinteger_t value = 0;
+   for(int i = length - 1; i >= 0; i--) {
+      tr1::unordered_map<physical_address_t, uint8>::iterator it =
+         phys_mem.find(paddr + i);
+      value = (value << 8) | (it != phys_mem.end() ? it->second : 0);
+   }
+   return value;
+}
+
+void SIM_write_phys_memory(conf_object_t *cpu, physical_address_t paddr,
+                           uinteger_t value, int length) {
+   for(int i = 0; i < length; i++) {
+      phys_mem[paddr + i] = value & 0xff;
+      value >>= 8;
+   }
+}
+
+physical_address_t SIM_logical_to_physical(conf_object_t *cpu,
+                                           data_or_instr_t data_or_instr,
+                                           logical_address_t vaddr) {
+   map<xlate_key_t, xlate_val_t>::iterator it =
+      xlate.find(xlate_key_t(data_or_instr, vaddr));
+   if(it != xlate.end()) {
+      if(it->second.fault) {
+         set_error(SimExc_Memory, "recorded translation fault");
+         return 0;
+      }
+      return it->second.paddr;
+   }
+
+   // Not translated at capture time; fall back to the last mapping
+   // seen for the page
+   map<xlate_key_t, physical_address_t>::iterator pit =
+      xlate_pages.find(xlate_key_t(data_or_instr,
+                                   vaddr >> REPLAY_PAGE_SHIFT));
+   if(pit != xlate_pages.end())
+      return pit->second | (vaddr & REPLAY_PAGE_MASK);
+
+   set_error(SimExc_Memory, "address not in replay trace");
+   return 0;
+}
+
+static void apply_fills(vector<replay_fill_t> &fills) {
+   for(unsigned i = 0; i < fills.size(); i++) {
+      replay_fill_t &f = fills[i];
+      if(f.type == REPLAY_FILL_XLATE) {
+         xlate_val_t v;
+         v.paddr = f.value;
+         v.fault = f.fault;
+         xlate[xlate_key_t(f.segment, f.key)] = v;
+         if(!f.fault)
+            xlate_pages[xlate_key_t(f.segment, f.key >> REPLAY_PAGE_SHIFT)] =
+               f.value & ~REPLAY_PAGE_MASK;
+      } else if(f.type == REPLAY_FILL_PHYS) {
+         SIM_write_phys_memory(NULL, f.key, f.value, f.length);
+      }
+   }
+}
+
+/**** Memory transactions ****/
+
+int SIM_mem_op_is_read(const generic_transaction_t *mop) {
+   return mop->type != Sim_Trans_Store;
+}
+
+int SIM_mem_op_is_data(const generic_transaction_t *mop) {
+   return mop->type != Sim_Trans_Instr_Fetch;
+}
+
+int SIM_mem_op_is_from_cpu(const generic_transaction_t *mop) {
+   return mop->ini_type == Sim_Initiator_CPU;
+}
+
+void SIM_set_mem_op_type(generic_transaction_t *mop, mem_op_type_t type) {
+   mop->type = type;
+}
+
+x86_memory_transaction_t *SIM_x86_mem_trans_from_generic(generic_transaction_t *mop) {
+   return (x86_memory_transaction_t *)mop;
+}
+
+/**** Haps, breakpoints and events ****/
+
+static hap_handle_t add_hap(const char *hap, conf_object_t *obj,
+                            obj_hap_func_t func, lang_void *data,
+                            integer_t index) {
+   replay_hap_t h;
+   h.hap = hap;
+   h.obj = obj;
+   h.func = func;
+   h.data = data;
+   h.index = index;
+   h.next = index;
+   h.live = true;
+   haps.push_back(h);
+   return haps.size();
+}
+
+hap_handle_t SIM_hap_add_callback(const char *hap, obj_hap_func_t func,
+                                  lang_void *data) {
+   return add_hap(hap, NULL, func, data, -1);
+}
+
+hap_handle_t SIM_hap_add_callback_obj(const char *hap, conf_object_t *obj,
+                                      hap_flags_t flags, obj_hap_func_t func,
+                                      lang_void *data) {
+   return add_hap(hap, obj, func, data, -1);
+}
+
+hap_handle_t SIM_hap_add_callback_index(const char *hap, obj_hap_func_t func,
+                                        lang_void *data, integer_t index) {
+   return add_hap(hap, NULL, func, data, index);
+}
+
+void SIM_hap_delete_callback(const char *hap, obj_hap_func_t func,
+                             lang_void *data) {
+   for(unsigned i = 0; i < haps.size(); i++) {
+      if(haps[i].live && haps[i].obj == NULL && haps[i].hap == hap
+         && haps[i].func == func && haps[i].data == data)
+         haps[i].live = false;
+   }
+}
+
+void SIM_hap_delete_callback_obj(const char *hap, conf_object_t *obj,
+                                 obj_hap_func_t func, lang_void *data) {
+   for(unsigned i = 0; i < haps.size(); i++) {
+      if(haps[i].live && haps[i].obj == obj && haps[i].hap == hap
+         && haps[i].func == func && haps[i].data == data)
+         haps[i].live = false;
+   }
+}
+
+int SIM_hap_callback_exists(const char *hap, obj_hap_func_t func,
+                            lang_void *data) {
+   for(unsigned i = 0; i < haps.size(); i++) {
+      if(haps[i].live && haps[i].hap == hap
+         && haps[i].func == func && haps[i].data == data)
+         return 1;
+   }
+   return 0;
+}
+
+// Handles of the non-periodic callbacks for hap on obj.  Callbacks
+// may add or remove haps, so collect first and recheck liveness
+// before each call.
+static void find_haps(const char *hap, conf_object_t *obj,
+                      vector<int> &found) {
+   found.clear();
+   for(unsigned i = 0; i < haps.size(); i++) {
+      if(haps[i].live && haps[i].index < 0 && haps[i].hap == hap
+         && (haps[i].obj == NULL || haps[i].obj == obj))
+         found.push_back(i);
+   }
+}
+
+breakpoint_id_t SIM_breakpoint(conf_object_t *obj, breakpoint_kind_t kind,
+                               access_t access, uint64 address, uint64 length,
+                               unsigned flags) {
+   replay_bp_t bp;
+   bp.obj = obj;
+   bp.addr = address;
+   bp.len = length;
+   bp.live = true;
+   bps.push_back(bp);
+   return bps.size();
+}
+
+void SIM_delete_breakpoint(breakpoint_id_t id) {
+   if(id > 0 && id <= (int)bps.size())
+      bps[id - 1].live = false;
+}
+
+static breakpoint_id_t find_breakpoint(conf_object_t *obj, uint64 addr) {
+   for(unsigned i = 0; i < bps.size(); i++) {
+      if(bps[i].live && bps[i].obj == obj && bps[i].addr <= addr
+         && addr < bps[i].addr + bps[i].len)
+         return i + 1;
+   }
+   return -1;
+}
+
+void SIM_stacked_post(conf_object_t *obj, event_handler_t func,
+                      lang_void *user_data) {
+   replay_post_t post;
+   post.obj = obj;
+   post.func = func;
+   post.data = user_data;
+   post.when = 0;
+   stacked_posts.push_back(post);
+}
+
+void SIM_time_post_cycle(conf_object_t *obj, cycles_t delta, sync_t sync,
+                         event_handler_t func, lang_void *user_data) {
+   replay_post_t post;
+   post.obj = obj;
+   post.func = func;
+   post.data = user_data;
+   post.when = SIM_cycle_count(obj) + delta;
+   time_posts.push_back(make_pair(obj, post));
+}
+
+void SIM_time_clean(conf_object_t *obj, sync_t sync, event_handler_t func,
+                    lang_void *user_data) {
+   for(unsigned i = 0; i < time_posts.size(); ) {
+      if(time_posts[i].first == obj && time_posts[i].second.func == func
+         && time_posts[i].second.data == user_data)
+         time_posts.erase(time_posts.begin() + i);
+      else
+         i++;
+   }
+}
+
+// Run whatever the simulator would have run on cpu before reaching
+// the current event: posted timers and periodic haps
+static void run_timers(conf_object_t *cpu) {
+   cycles_t now = SIM_cycle_count(cpu);
+   for(unsigned i = 0; i < time_posts.size(); ) {
+      if(time_posts[i].first == cpu && time_posts[i].second.when <= now) {
+         replay_post_t post = time_posts[i].second;
+         time_posts.erase(time_posts.begin() + i);
+         post.func(post.obj, post.data);
+         i = 0;
+      } else {
+         i++;
+      }
+   }
+
+   for(unsigned i = 0; i < haps.size(); i++) {
+      if(!haps[i].live || haps[i].index <= 0 || haps[i].next > now)
+         continue;
+      while(haps[i].next <= now)
+         haps[i].next += haps[i].index;
+      ((hap_func_int_t)haps[i].func)(haps[i].data, cpu, haps[i].index);
+   }
+}
+
+/**** Driver ****/
+
+void replay_add_override(const char *obj, const char *attr,
+                         const char *value) {
+   replay_override_t o;
+   o.obj = obj;
+   o.attr = attr;
+   o.value = value;
+   o.used = false;
+   overrides.push_back(o);
+}
+
+static attr_value_t parse_override(const string &s);
+
+// "[a, b, ...]": a list of overrides, which may be lists themselves
+static bool parse_override_list(const string &s, attr_value_t *out) {
+   if(s.size() < 2 || s[0] != '[' || s[s.size() - 1] != ']')
+      return false;
+   vector<string> items;
+   string item;
+   int depth = 0;
+   for(size_t i = 1; i + 1 < s.size(); i++) {
+      char c = s[i];
+      if(c == '[')
+         depth++;
+      else if(c == ']' && --depth < 0)
+         return false;
+      if(c == ',' && depth == 0) {
+         items.push_back(item);
+         item.clear();
+      } else if(c != ' ' || !item.empty()) {
+         item += c;
+      }
+   }
+   if(depth != 0)
+      return false;
+   if(!item.empty() || !items.empty())
+      items.push_back(item);
+
+   *out = SIM_alloc_attr_list(items.size());
+   for(unsigned i = 0; i < items.size(); i++) {
+      while(!items[i].empty() && items[i][items[i].size() - 1] == ' ')
+         items[i].erase(items[i].size() - 1);
+      out->u.list.vector[i] = parse_override(items[i]);
+   }
+   return true;
+}
+
+static attr_value_t parse_override(const string &s) {
+   if(s == "nil")
+      return SIM_make_attr_nil();
+   attr_value_t list;
+   if(parse_override_list(s, &list))
+      return list;
+   char *end;
+   long long i = strtoll(s.c_str(), &end, 0);
+   if(!s.empty() && *end == 0)
+      return SIM_make_attr_integer(i);
+   double d = strtod(s.c_str(), &end);
+   if(!s.empty() && *end == 0)
+      return SIM_make_attr_floating(d);
+   return SIM_make_attr_string(s.c_str());
+}
+
+static void set_recorded_attr(conf_object_t *obj, const char *attr,
+                              attr_value_t *val) {
+   set_error_t err = SIM_set_attribute(obj, attr, val);
+   if(err != Sim_Set_Ok)
+      cerr << "XXX: replay could not set " << obj->name << "." << attr
+           << " (error " << err << ")" << endl;
+   SIM_clear_exception();
+}
+
+static void apply_attr(conf_object_t *obj, const string &payload,
+                       vector<conf_object_t *> &lookup) {
+   const char *p = payload.c_str();
+   const char *end = p + payload.size();
+   string attr(p);
+   p += attr.size() + 1;
+   attr_value_t val = replay_reader::get_attr_value(p, end, lookup);
+
+   for(unsigned i = 0; i < overrides.size(); i++) {
+      if(overrides[i].obj == obj->name && overrides[i].attr == attr) {
+         SIM_free_attribute(val);
+         val = parse_override(overrides[i].value);
+         overrides[i].used = true;
+      }
+   }
+   set_recorded_attr(obj, attr.c_str(), &val);
+   SIM_free_attribute(val);
+}
+
+static void apply_remaining_overrides() {
+   for(unsigned i = 0; i < overrides.size(); i++) {
+      if(overrides[i].used)
+         continue;
+      overrides[i].used = true;
+      conf_object_t *obj = SIM_get_object(overrides[i].obj.c_str());
+      if(obj == NULL) {
+         cerr << "XXX: no object " << overrides[i].obj << " in trace" << endl;
+         SIM_clear_exception();
+         continue;
+      }
+      attr_value_t val = parse_override(overrides[i].value);
+      set_recorded_attr(obj, overrides[i].attr.c_str(), &val);
+   }
+}
+
+static attr_value_t empty_stack_trace(conf_object_t *cpu, int maxframes) {
+   return SIM_alloc_attr_list(0);
+}
+
+static void make_builtin_objects() {
+   // Objects the modules look up by name
+   if(objects.find("sim") == objects.end())
+      new_generic_object("sim", "sim");
+   if(objects.find("st0") == objects.end()) {
+      static symtable_interface_t symtable = { empty_stack_trace };
+      conf_object_t *st0 = new_generic_object("symtable", "st0");
+      SIM_register_interface(st0->class_data, "symtable", &symtable);
+   }
+}
+
+static void dispatch(replay_event_t &ev, conf_object_t *cpu,
+                     conf_object_t *obj, replay_stats_t *stats) {
+   x86_memory_transaction_t xmt;
+   memset(&xmt, 0, sizeof(xmt));
+   xmt.s.logical_address = ev.laddr;
+   xmt.s.physical_address = ev.paddr;
+   xmt.s.size = ev.size;
+   xmt.s.type = (mem_op_type_t)ev.memop_type;
+   xmt.s.ini_type = (ev.flags & REPLAY_MF_FROM_CPU) ?
+      Sim_Initiator_CPU : Sim_Initiator_Other;
+   xmt.s.ini_ptr = cpu;
+   xmt.s.exception = Sim_PE_No_Exception;
+   xmt.s.may_stall = (ev.flags & REPLAY_MF_MAY_STALL) ? 1 : 0;
+   xmt.s.user_ptr = (ev.flags & REPLAY_MF_TX) ? (void *)1 : NULL;
+   xmt.linear_address = ev.laddr;
+   xmt.mode = (processor_mode_t)ev.mode;
+   xmt.access_type = (x86_access_type_t)ev.access_type;
+
+   vector<int> found;
+
+   switch(ev.type) {
+   case REPLAY_EV_BREAKPOINT:
+      {
+         breakpoint_id_t id = find_breakpoint(obj, ev.laddr);
+         find_haps("Core_Breakpoint_Memop", obj, found);
+         for(unsigned i = 0; i < found.size(); i++) {
+            replay_hap_t &h = haps[found[i]];
+            if(h.live)
+               ((hap_func_bp_t)h.func)(h.data, obj, id, &xmt.s);
+         }
+         break;
+      }
+   case REPLAY_EV_POST:
+      {
+         if(stacked_posts.empty()) {
+            stats->unmatched_posts++;
+            break;
+         }
+         replay_post_t post = stacked_posts.front();
+         stacked_posts.pop_front();
+         post.func(post.obj, post.data);
+         break;
+      }
+   case REPLAY_EV_MEMOP:
+      {
+         timing_model_interface_t *ifc = (timing_model_interface_t *)
+            SIM_get_interface(obj, TIMING_MODEL_INTERFACE);
+         if(ifc == NULL) {
+            SIM_clear_exception();
+            stats->unknown_objects++;
+            break;
+         }
+         stats->memop_stall += ifc->operate(obj, NULL, NULL, &xmt.s);
+         break;
+      }
+   case REPLAY_EV_MAGIC:
+      find_haps("Core_Magic_Instruction", cpu, found);
+      for(unsigned i = 0; i < found.size(); i++) {
+         replay_hap_t &h = haps[found[i]];
+         if(h.live)
+            ((hap_func_int_t)h.func)(h.data, cpu, 0);
+      }
+      break;
+   case REPLAY_EV_EXCEPTION:
+      find_haps("Core_Exception", cpu, found);
+      for(unsigned i = 0; i < found.size(); i++) {
+         replay_hap_t &h = haps[found[i]];
+         if(h.live)
+            ((hap_func_int_t)h.func)(h.data, cpu, 0);
+      }
+      break;
+   case REPLAY_EV_DEVICE:
+      find_haps("Core_Device_Access_Memop", NULL, found);
+      for(unsigned i = 0; i < found.size(); i++) {
+         replay_hap_t &h = haps[found[i]];
+         if(h.live)
+            ((hap_func_memop_t)h.func)(h.data, cpu, &xmt.s);
+      }
+      break;
+   default:
+      break;
+   }
+}
+
+int replay_run(const char *filename, replay_stats_t *stats) {
+   replay_reader reader(filename);
+   if(!reader.good())
+      return -1;
+
+   memset(stats, 0, sizeof(*stats));
+   cur_stats = stats;
+   quit_requested = false;
+
+   for(int i = 0; i < reader.ncpus(); i++)
+      cpu_names.push_back(reader.cpu_name(i));
+   make_builtin_objects();
+
+   vector<conf_object_t *> lookup;
+   vector<conf_object_t *> cpus(reader.ncpus(), (conf_object_t *)NULL);
+   configured = false;
+
+   replay_event_t ev;
+   vector<replay_fill_t> fills;
+   string payload;
+   while(!quit_requested && reader.next(ev, fills, payload)) {
+      if(ev.type < REPLAY_MAX_EVENT_TYPE)
+         stats->events[ev.type]++;
+      stats->fills += fills.size();
+
+      if(ev.type == REPLAY_EV_OBJECT) {
+         size_t sep = payload.find('\0');
+         string cls = payload.substr(0, sep);
+         string name = sep == string::npos ? "" : payload.substr(sep + 1);
+         if(lookup.size() <= ev.obj)
+            lookup.resize(ev.obj + 1, NULL);
+         lookup[ev.obj] = new_object(cls.c_str(), name.c_str());
+         continue;
+      }
+
+      conf_object_t *obj = ev.obj < lookup.size() ? lookup[ev.obj] : NULL;
+      if(ev.type == REPLAY_EV_ATTR) {
+         if(obj == NULL)
+            stats->unknown_objects++;
+         else
+            apply_attr(obj, payload, lookup);
+         continue;
+      }
+
+      if(!configured) {
+         apply_remaining_overrides();
+         configured = true;
+      }
+
+      if(ev.cpu >= cpus.size()) {
+         stats->unknown_objects++;
+         continue;
+      }
+      if(cpus[ev.cpu] == NULL) {
+         cpus[ev.cpu] = SIM_get_object(reader.cpu_name(ev.cpu));
+         if(cpus[ev.cpu] == NULL) {
+            SIM_clear_exception();
+            cpus[ev.cpu] = new_generic_object("processor",
+                                              reader.cpu_name(ev.cpu));
+         }
+      }
+      conf_object_t *cpu = cpus[ev.cpu];
+      replay_object_t *state = generic_object(cpu);
+      state->cycle = ev.cycle;
+      for(int i = 0; i < REPLAY_NREGS; i++)
+         state->regs[i] = ev.regs[i];
+      current_cpu = cpu;
+
+      run_timers(cpu);
+      apply_fills(fills);
+      dispatch(ev, cpu, obj, stats);
+   }
+
+   if(!configured)
+      apply_remaining_overrides();
+   stats->bytes = reader.offset();
+   cur_stats = NULL;
+   return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -0,0 +1,792 @@
+// MetaTM Project
+// File Name: replay.h
+//
+// Description: Simics API surface for the offline trace-replay
+// backend.  Modules built with -D_USE_REPLAY (and -D_USE_SIMICS, so
+// the existing Simics code paths are taken) link against replay.cc
+// instead of the Simics runtime.  Only the subset of the Simics 3 API
+// used by the osa modules is provided.  Objects, attributes,
+// interfaces, haps and breakpoints behave like their Simics
+// counterparts; registers, cycle counts and guest memory come from a
+// recorded event stream (see replaytrace.h).
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+
+#ifndef OSA_REPLAY_H
+#define OSA_REPLAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/* Basic Simics types */
+typedef unsigned long long uinteger_t;
+typedef long long integer_t;
+typedef uint64_t uint64;
+typedef uint32_t uint32;
+typedef uint16_t uint16;
+typedef uint8_t uint8;
+typedef int64_t int64;
+typedef int32_t int32;
+typedef uinteger_t logical_address_t;
+typedef uinteger_t physical_address_t;
+typedef uinteger_t linear_address_t;
+typedef uinteger_t generic_address_t;
+typedef integer_t cycles_t;
+typedef void lang_void;
+typedef void interface_t;
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define DLL_EXPORT
+
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+
+#define MM_MALLOC(n, t)     ((t *)malloc((n) * sizeof(t)))
+#define MM_ZALLOC(n, t)     ((t *)calloc((n), sizeof(t)))
+#define MM_REALLOC(p, n, t) ((t *)realloc((p), (n) * sizeof(t)))
+#define MM_FREE(p)          free(p)
+#define MM_STRDUP(s)        strdup(s)
+
+#define pr(...)     printf(__VA_ARGS__)
+#define pr_err(...) fprintf(stderr, __VA_ARGS__)
+
+// Only the name is public; replay.cc keeps the rest of the class
+typedef struct conf_class {
+   const char *name;
+} conf_class_t;
+
+typedef struct conf_object {
+   conf_class_t *class_data;
+   const char *name;
+   void *replay_data;   // per-object state owned by replay.cc
+} conf_object_t;
+
+typedef struct log_object {
+   conf_object_t obj;
+   int log_level;
+} log_object_t;
+
+typedef struct parse_object {
+   const char *name;
+   conf_class_t *class_data;
+} parse_object_t;
+
+typedef enum {
+   Sim_Val_Invalid  = 0,
+   Sim_Val_String   = 1,
+   Sim_Val_Integer  = 2,
+   Sim_Val_Floating = 3,
+   Sim_Val_List     = 4,
+   Sim_Val_Data     = 5,
+   Sim_Val_Nil      = 6,
+   Sim_Val_Object   = 7,
+   Sim_Val_Dict     = 8,
+   Sim_Val_Boolean  = 9
+} attr_kind_t;
+
+typedef struct attr_value attr_value_t;
+
+typedef struct attr_list {
+   integer_t size;
+   attr_value_t *vector;
+} attr_list_t;
+
+typedef struct attr_dict_pair attr_dict_pair_t;
+
+typedef struct attr_dict {
+   integer_t size;
+   attr_dict_pair_t *vector;
+} attr_dict_t;
+
+typedef struct attr_data {
+   integer_t size;
+   uint8 *data;
+} attr_data_t;
+
+struct attr_value {
+   attr_kind_t kind;
+   union {
+      const char *string;
+      integer_t integer;
+      integer_t boolean;
+      double floating;
+      attr_list_t list;
+      attr_dict_t dict;
+      attr_data_t data;
+      conf_object_t *object;
+   } u;
+};
+
+struct attr_dict_pair {
+   attr_value_t key;
+   attr_value_t value;
+};
+
+typedef enum {
+   Sim_Set_Ok,
+   Sim_Set_Need_Integer,
+   Sim_Set_Need_Floating,
+   Sim_Set_Need_String,
+   Sim_Set_Need_List,
+   Sim_Set_Need_Dict,
+   Sim_Set_Need_Boolean,
+   Sim_Set_Need_Data,
+   Sim_Set_Need_Object,
+   Sim_Set_Object_Not_Found,
+   Sim_Set_Interface_Not_Found,
+   Sim_Set_Illegal_Value,
+   Sim_Set_Illegal_Type,
+   Sim_Set_Illegal_Index,
+   Sim_Set_Attribute_Not_Found,
+   Sim_Set_Not_Writable
+} set_error_t;
+
+typedef enum {
+   Sim_Attr_Required = 0,
+   Sim_Attr_Optional = 1,
+   Sim_Attr_Session  = 3,
+   Sim_Attr_Pseudo   = 4
+} attr_attr_t;
+
+typedef attr_value_t (*get_attr_t)(lang_void *arg, conf_object_t *obj,
+                                   attr_value_t *idx);
+typedef set_error_t (*set_attr_t)(lang_void *arg, conf_object_t *obj,
+                                  attr_value_t *val, attr_value_t *idx);
+
+typedef struct class_data {
+   conf_object_t *(*new_instance)(parse_object_t *parse_obj);
+   int (*delete_instance)(conf_object_t *obj);
+   conf_class_t *parent;
+   const char *description;
+} class_data_t;
+
+typedef enum {
+   SimExc_No_Exception = 0,
+   SimExc_General,
+   SimExc_Memory,
+   SimExc_Index,
+   SimExc_Type,
+   SimExc_Lookup,
+   SimExc_Attribute
+} sim_exception_t;
+
+typedef enum {
+   Sim_PE_No_Exception = 1025,
+   Sim_PE_Code_Break,
+   Sim_PE_Silent_Break,
+   Sim_PE_Stall_Cpu,
+   Sim_PE_Default_Semantics
+} exception_type_t;
+
+typedef enum {
+   Sim_DI_Instruction = 0,
+   Sim_DI_Data        = 1
+} data_or_instr_t;
+
+typedef enum {
+   Sim_CPU_Mode_User       = 0,
+   Sim_CPU_Mode_Supervisor = 1,
+   Sim_CPU_Mode_Hypervisor = 2
+} processor_mode_t;
+
+typedef enum {
+   Sim_Trans_Load        = 0,
+   Sim_Trans_Store       = 1,
+   Sim_Trans_Instr_Fetch = 2,
+   Sim_Trans_Prefetch    = 4,
+   Sim_Trans_Cache       = 8
+} mem_op_type_t;
+
+typedef enum {
+   Sim_Initiator_Illegal = 0x0,
+   Sim_Initiator_CPU     = 0x1000,
+   Sim_Initiator_Device  = 0x2000,
+   Sim_Initiator_Other   = 0x3000
+} ini_type_t;
+
+typedef enum {
+   X86_Other,
+   X86_Vanilla,
+   X86_Instruction,
+   X86_Clflush,
+   X86_Fpu_Env,
+   X86_Fpu_State,
+   X86_Idt,
+   X86_Gdt,
+   X86_Ldt,
+   X86_Task_Segment,
+   X86_Task_Switch,
+   X86_Far_Call_Parameter,
+   X86_Stack,
+   X86_Pml4,
+   X86_Pdp,
+   X86_Pd,
+   X86_Pt,
+   X86_Sse,
+   X86_Fpu,
+   X86_Access_Simple,
+   X86_Microcode_Update,
+   X86_Non_Temporal,
+   X86_Prefetch_3DNow,
+   X86_Prefetchw_3DNow,
+   X86_Prefetch_T0,
+   X86_Prefetch_T1,
+   X86_Prefetch_T2,
+   X86_Prefetch_NTA,
+   X86_Loadall,
+   X86_Atomic_Info,
+   X86_Cmpxchg16b,
+   X86_Smm_State,
+   X86_Vmcs,
+   X86_Vmx_IO_Bitmap,
+   X86_Vmx_Vapic,
+   X86_Vmx_Msr
+} x86_access_type_t;
+
+typedef struct generic_transaction {
+   logical_address_t logical_address;
+   physical_address_t physical_address;
+   unsigned int size;
+   mem_op_type_t type;
+   ini_type_t ini_type;
+   conf_object_t *ini_ptr;
+   int id;
+   exception_type_t exception;
+   void *user_ptr;
+   char *real_address;
+   unsigned int may_stall:1;
+   unsigned int reissue:1;
+   unsigned int block_STC:1;
+   unsigned int inquiry:1;
+   unsigned int speculative:1;
+   unsigned int ignore:1;
+} generic_transaction_t;
+
+typedef struct x86_memory_transaction {
+   generic_transaction_t s;
+   linear_address_t linear_address;
+   processor_mode_t mode;
+   x86_access_type_t access_type;
+} x86_memory_transaction_t;
+
+typedef struct map_list map_list_t;
+
+typedef cycles_t (*operate_func_t)(conf_object_t *mem_hier,
+                                   conf_object_t *space,
+                                   map_list_t *map_list,
+                                   generic_transaction_t *mem_op);
+
+typedef struct timing_model_interface {
+   operate_func_t operate;
+} timing_model_interface_t;
+
+#define TIMING_MODEL_INTERFACE "timing_model"
+
+typedef struct symtable_interface {
+   attr_value_t (*stack_trace)(conf_object_t *cpu, int maxframes);
+} symtable_interface_t;
+
+/* Haps */
+typedef int hap_handle_t;
+typedef enum { Sim_Hap_Simulation = 0 } hap_flags_t;
+typedef void (*obj_hap_func_t)();
+
+/* Breakpoints */
+typedef int breakpoint_id_t;
+typedef enum {
+   Sim_Break_Physical = 0,
+   Sim_Break_Virtual  = 1,
+   Sim_Break_Linear   = 2
+} breakpoint_kind_t;
+typedef enum {
+   Sim_Access_Read    = 1,
+   Sim_Access_Write   = 2,
+   Sim_Access_Execute = 4
+} access_t;
+typedef enum {
+   Sim_Breakpoint_Temporary  = 1,
+   Sim_Breakpoint_Simulation = 2,
+   Sim_Breakpoint_Private    = 4
+} breakpoint_flag;
+
+/* Events */
+typedef enum {
+   Sim_Sync_Processor = 0,
+   Sim_Sync_Machine   = 1
+} sync_t;
+typedef void (*event_handler_t)(conf_object_t *obj, lang_void *user_data);
+
+/* Functions provided by replay.cc */
+attr_value_t SIM_make_attr_string(const char *str);
+attr_value_t SIM_make_attr_integer(integer_t i);
+attr_value_t SIM_make_attr_boolean(integer_t b);
+attr_value_t SIM_make_attr_floating(double d);
+attr_value_t SIM_make_attr_object(conf_object_t *obj);
+attr_value_t SIM_make_attr_nil(void);
+attr_value_t SIM_make_attr_invalid(void);
+attr_value_t SIM_alloc_attr_list(integer_t length);
+attr_value_t SIM_alloc_attr_dict(integer_t length);
+void SIM_free_attribute(attr_value_t value);
+
+conf_class_t *SIM_register_class(const char *name, class_data_t *class_data);
+conf_class_t *SIM_get_class(const char *name);
+int SIM_register_interface(conf_class_t *cls, const char *name, void *iface);
+void *SIM_get_interface(const conf_object_t *obj, const char *name);
+int SIM_register_typed_attribute(conf_class_t *cls, const char *name,
+                                 get_attr_t get_attr, lang_void *user_data_get,
+                                 set_attr_t set_attr, lang_void *user_data_set,
+                                 attr_attr_t attr, const char *type,
+                                 const char *idx_type, const char *desc);
+attr_value_t SIM_get_attribute(conf_object_t *obj, const char *name);
+attr_value_t SIM_get_attribute_idx(conf_object_t *obj, const char *name,
+                                   attr_value_t *idx);
+set_error_t SIM_set_attribute(conf_object_t *obj, const char *name,
+                              attr_value_t *value);
+conf_object_t *SIM_get_object(const char *name);
+void SIM_log_constructor(log_object_t *log, parse_object_t *parse_obj);
+void SIM_log_error(log_object_t *log, int group, const char *fmt, ...);
+
+void SIM_break_simulation(const char *msg);
+void SIM_quit(int exit_code);
+int SIM_initial_configuration_ok(void);
+sim_exception_t SIM_get_pending_exception(void);
+sim_exception_t SIM_clear_exception(void);
+const char *SIM_last_error(void);
+
+conf_object_t *SIM_current_processor(void);
+int SIM_get_processor_number(const conf_object_t *cpu);
+cycles_t SIM_cycle_count(conf_object_t *cpu);
+uinteger_t SIM_read_register(conf_object_t *cpu, int reg);
+void SIM_write_register(conf_object_t *cpu, int reg, uinteger_t value);
+int SIM_get_register_number(conf_object_t *cpu, const char *name);
+attr_value_t SIM_get_all_registers(conf_object_t *cpu);
+logical_address_t SIM_get_program_counter(conf_object_t *cpu);
+processor_mode_t SIM_processor_privilege_level(conf_object_t *cpu);
+uinteger_t SIM_read_phys_memory(conf_object_t *cpu, physical_address_t paddr,
+                                int length);
+void SIM_write_phys_memory(conf_object_t *cpu, physical_address_t paddr,
+                           uinteger_t value, int length);
+physical_address_t SIM_logical_to_physical(conf_object_t *cpu,
+                                           data_or_instr_t data_or_instr,
+                                           logical_address_t vaddr);
+
+int SIM_mem_op_is_read(const generic_transaction_t *mop);
+int SIM_mem_op_is_data(const generic_transaction_t *mop);
+int SIM_mem_op_is_from_cpu(const generic_transaction_t *mop);
+void SIM_set_mem_op_type(generic_transaction_t *mop, mem_op_type_t type);
+x86_memory_transaction_t *SIM_x86_mem_trans_from_generic(generic_transaction_t *mop);
+
+hap_handle_t SIM_hap_add_callback(const char *hap, obj_hap_func_t func,
+                                  lang_void *data);
+hap_handle_t SIM_hap_add_callback_obj(const char *hap, conf_object_t *obj,
+                                      hap_flags_t flags, obj_hap_func_t func,
+                                      lang_void *data);
+hap_handle_t SIM_hap_add_callback_index(const char *hap, obj_hap_func_t func,
+                                        lang_void *data, integer_t index);
+void SIM_hap_delete_callback(const char *hap, obj_hap_func_t func,
+                             lang_void *data);
+void SIM_hap_delete_callback_obj(const char *hap, conf_object_t *obj,
+                                 obj_hap_func_t func, lang_void *data);
+int SIM_hap_callback_exists(const char *hap, obj_hap_func_t func,
+                            lang_void *data);
+
+// Simics' C headers declare obj_hap_func_t without a prototype, so
+// callbacks of any signature are accepted; do the same for C++
+template<class F> hap_handle_t
+SIM_hap_add_callback(const char *hap, F func, lang_void *data) {
+   return SIM_hap_add_callback(hap, (obj_hap_func_t)func, data);
+}
+template<class F> hap_handle_t
+SIM_hap_add_callback_obj(const char *hap, conf_object_t *obj,
+                         hap_flags_t flags, F func, lang_void *data) {
+   return SIM_hap_add_callback_obj(hap, obj, flags, (obj_hap_func_t)func,
+                                   data);
+}
+template<class F> hap_handle_t
+SIM_hap_add_callback_index(const char *hap, F func, lang_void *data,
+                           integer_t index) {
+   return SIM_hap_add_callback_index(hap, (obj_hap_func_t)func, data, index);
+}
+template<class F> void
+SIM_hap_delete_callback(const char *hap, F func, lang_void *data) {
+   SIM_hap_delete_callback(hap, (obj_hap_func_t)func, data);
+}
+template<class F> void
+SIM_hap_delete_callback_obj(const char *hap, conf_object_t *obj, F func,
+                            lang_void *data) {
+   SIM_hap_delete_callback_obj(hap, obj, (obj_hap_func_t)func, data);
+}
+template<class F> int
+SIM_hap_callback_exists(const char *hap, F func, lang_void *data) {
+   return SIM_hap_callback_exists(hap, (obj_hap_func_t)func, data);
+}
+
+breakpoint_id_t SIM_breakpoint(conf_object_t *obj, breakpoint_kind_t kind,
+                               access_t access, uint64 address, uint64 length,
+                               unsigned flags);
+void SIM_delete_breakpoint(breakpoint_id_t id);
+
+void SIM_stacked_post(conf_object_t *obj, event_handler_t func,
+                      lang_void *user_data);
+void SIM_time_post_cycle(conf_object_t *obj, cycles_t delta, sync_t sync,
+                         event_handler_t func, lang_void *user_data);
+void SIM_time_clean(conf_object_t *obj, sync_t sync, event_handler_t func,
+                    lang_void *user_data);
+
+/* Driver interface, used by syncchar-replay */
+#define REPLAY_MAX_EVENT_TYPE 16
+
+typedef struct _replay_stats_t {
+   unsigned long long events[REPLAY_MAX_EVENT_TYPE];
+   unsigned long long fills;
+   unsigned long long bytes;
+   unsigned long long breaks;           // SIM_break_simulation calls
+   unsigned long long unmatched_posts;  // POST with nothing queued
+   unsigned long long unknown_objects;  // events naming no object
+   cycles_t memop_stall;                // sum of timing_model results
+} replay_stats_t;
+
+// Replace the recorded value of obj.attr (or set it once the
+// recorded configuration has been applied).  value is parsed as
+// nil, an integer, a float, a list ("[a, b, ...]") or else a string.
+void replay_add_override(const char *obj, const char *attr,
+                         const char *value);
+// Feed a trace through the registered classes.  Returns 0 on success.
+int replay_run(const char *filename, replay_stats_t *stats);
+
+/* The rest mirrors simics.h so that the osa code sees one interface */
+
+typedef uinteger_t                                        osa_uinteger_t;
+typedef integer_t                                         osa_integer_t;
+typedef logical_address_t                                 osa_logical_address_t;
+typedef physical_address_t                                osa_physical_address_t;
+typedef linear_address_t                                  osa_linear_address_t;
+typedef cycles_t                                          osa_cycles_t;
+typedef conf_object_t                                     osa_cpu_object_t;
+typedef data_or_instr_t                                   osa_segment_t;
+typedef generic_transaction_t                             osa_sim_inner_memop_t;
+typedef x86_memory_transaction_t                          osa_sim_outer_memop_t;
+typedef processor_mode_t                                  osa_privilege_level_t;
+typedef x86_access_type_t                                 osa_memop_specific_type_t;
+typedef mem_op_type_t                                     osa_memop_basic_type_t;
+typedef attr_value_t                                      osa_segment_register_t;
+typedef sim_exception_t                                   osa_simulator_error_t;
+typedef exception_type_t                                  osa_exception_type_t;
+typedef conf_object_t                                     system_object_t;
+typedef conf_object_t                                     system_component_object_t;
+
+#define CODE_SEGMENT Sim_DI_Instruction
+#define DATA_SEGMENT Sim_DI_Data
+#define STACK_SEGMENT Sim_DI_Data
+#define OSA_get_sim_cpu() SIM_current_processor()
+#define _osa_read_register SIM_read_register
+#define _osa_write_register SIM_write_register
+#define osa_read_phys_memory SIM_read_phys_memory
+#define osa_write_phys_memory SIM_write_phys_memory
+#define GET_OUTER_MEMOP_PTR_FROM_INNER_PTR(x) (SIM_x86_mem_trans_from_generic(x))
+#define GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(x) (&((x)->s))
+#define osa_user_mode Sim_CPU_Mode_User
+#define osa_supervisor_mode Sim_CPU_Mode_Supervisor
+#define osa_get_sim_cycle_count SIM_cycle_count
+#define osa_get_proc_privilege SIM_processor_privilege_level
+#define osa_logical_to_physical SIM_logical_to_physical
+#define osa_release_segment_register SIM_free_attribute
+#define osa_stacked_post SIM_stacked_post
+#define NO_ERROR SimExc_No_Exception
+#define MEM_ERROR SimExc_Memory
+#define GENERIC_ERROR SimExc_General
+#define NO_EXCEPTION Sim_PE_No_Exception
+#define STALL Sim_PE_Stall_Cpu
+#define osa_get_object_by_name SIM_get_object
+#define osa_break_simulation SIM_break_simulation
+#define osa_quit SIM_quit
+#define osa_sim_get_interface SIM_get_interface
+#define osa_sim_clear_error SIM_clear_exception
+#define osa_sim_free_attribute SIM_free_attribute
+#define osa_sim_allocate_list SIM_alloc_attr_list
+
+#define SIMULATOR_SET_ATTRIBUTE_SIGNATURE      void *arg, \
+                                               conf_object_t *obj, \
+                                               attr_value_t *pAttrValue, \
+                                               attr_value_t *pAttrIdx
+
+#define SIMULATOR_GET_ATTRIBUTE_SIGNATURE      void *arg, \
+                                               conf_object_t *obj, \
+                                               attr_value_t *pAttrIdx
+
+#define TIMING_SIGNATURE                       conf_object_t* pConfObject, \
+                                               conf_object_t* pSpaceConfObject, \
+                                               map_list_t* pMapList, \
+                                               osa_sim_inner_memop_t* pMemTx
+
+#define TIMING_ARGUMENTS                       pConfObject, \
+                                               pSpaceConfObject, \
+                                               pMapList, \
+                                               pMemTx
+
+#define TIMING_ARGUMENTS_1                     pCache, \
+                                               pSpaceConfObject, \
+                                               pMapList, \
+                                               pMemTx
+
+#define TIMING_ARGUMENTS_2                     pOsaTxm->timing_model, \
+                                               pSpaceConfObject, \
+                                               pMapList, \
+                                               pMemTx
+
+#define BOOLEAN_ARGUMENT                       pAttrValue->u.boolean
+#define INTEGER_ARGUMENT                       pAttrValue->u.integer
+#define GENERIC_ARGUMENT                       pAttrValue->u.object
+#define FLOAT_ARGUMENT                         pAttrValue->u.floating
+#define STRING_ARGUMENT                        pAttrValue->u.string
+#define LIST_ARGUMENT_SIZE                     pAttrValue->u.list.size
+#define LIST_ARGUMENT(i)                       pAttrValue->u.list.vector[(i)]
+
+#define SIMULATOR_SET_BOOLEAN_ATTRIBUTE_SIGNATURE SIMULATOR_SET_ATTRIBUTE_SIGNATURE
+#define SIMULATOR_SET_INTEGER_ATTRIBUTE_SIGNATURE SIMULATOR_SET_ATTRIBUTE_SIGNATURE
+#define SIMULATOR_SET_STRING_ATTRIBUTE_SIGNATURE SIMULATOR_SET_ATTRIBUTE_SIGNATURE
+#define SIMULATOR_SET_GENERIC_ATTRIBUTE_SIGNATURE SIMULATOR_SET_ATTRIBUTE_SIGNATURE
+#define SIMULATOR_SET_LIST_ATTRIBUTE_SIGNATURE SIMULATOR_SET_ATTRIBUTE_SIGNATURE
+#define SIMULATOR_SET_FLOAT_ATTRIBUTE_SIGNATURE SIMULATOR_SET_ATTRIBUTE_SIGNATURE
+
+#define BOOL_ATTRIFY SIM_make_attr_boolean
+#define INT_ATTRIFY SIM_make_attr_integer
+#define STRING_ATTRIFY SIM_make_attr_string
+#define GENERIC_ATTRIFY SIM_make_attr_object
+#define FLOAT_ATTRIFY SIM_make_attr_floating
+#define ATTR_OK Sim_Set_Ok
+#define ATTR_VALUE_ERR Sim_Set_Illegal_Value
+#define INTERFACE_NOT_FOUND_ERR Sim_Set_Interface_Not_Found
+
+#define BOOL_ATTR(x) (x).u.boolean
+#define INT_ATTR(x) (x).u.integer
+#define STRING_ATTR(x) (x).u.string
+#define GENERIC_ATTR(x) (x).u.object
+#define FLOAT_ATTR(x) (x).u.floating
+#define LIST_ATTR(x,i)(x).u.list.vector[(i)]
+#define LIST_SIZE(x) (x).u.list.size
+#define LIST_ATTR_P(x, i) (x)->u.list.vector[(i)]
+#define LIST_SIZE_P(x) (x)->u.list.size
+
+typedef attr_value_t integer_attribute_t;
+typedef attr_value_t boolean_attribute_t;
+typedef attr_value_t string_attribute_t;
+typedef attr_value_t generic_attribute_t;
+typedef attr_value_t float_attribute_t;
+typedef attr_value_t list_attribute_t;
+typedef set_error_t osa_attr_set_t;
+
+#define osa_sim_set_integer_attribute SIM_set_attribute
+#define osa_sim_set_boolean_attribute SIM_set_attribute
+#define osa_sim_set_string_attribute SIM_set_attribute
+#define osa_sim_set_generic_attribute SIM_set_attribute
+#define osa_sim_set_float_attribute SIM_set_attribute
+
+#define osa_sim_get_integer_attribute(x, y) SIM_get_attribute(x, y).u.integer
+#define osa_sim_get_boolean_attribute(x, y) SIM_get_attribute(x, y).u.boolean
+#define osa_sim_get_string_attribute(x, y) SIM_get_attribute(x, y).u.string
+#define osa_sim_get_generic_attribute(x, y) SIM_get_attribute(x, y).u.object
+#define osa_sim_get_float_attribute(x, y) SIM_get_attribute(x, y).u.floating
+
+inline unsigned int&
+size_memop(osa_sim_inner_memop_t* op) {
+   return op->size;
+}
+
+inline unsigned int&
+size_memop(osa_sim_outer_memop_t* op) {
+   return(size_memop(GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(op)));
+}
+
+inline int&
+id_memop(osa_sim_inner_memop_t* op) {
+   return op->id;
+}
+
+inline int&
+id_memop(osa_sim_outer_memop_t* op) {
+   return(id_memop(GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(op)));
+}
+
+inline osa_privilege_level_t&
+priv_level_memop(osa_sim_outer_memop_t* op) {
+   return op->mode;
+}
+
+inline osa_privilege_level_t&
+priv_level_memop(osa_sim_inner_memop_t* op) {
+   return(priv_level_memop(GET_OUTER_MEMOP_PTR_FROM_INNER_PTR(op)));
+}
+
+inline osa_logical_address_t&
+laddr_memop(osa_sim_inner_memop_t* op) {
+   return op->logical_address;
+}
+
+inline osa_logical_address_t&
+laddr_memop(osa_sim_outer_memop_t* op) {
+   return(laddr_memop(GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(op)));
+}
+
+inline osa_physical_address_t&
+paddr_memop(osa_sim_inner_memop_t* op) {
+   return op->physical_address;
+}
+
+inline osa_physical_address_t&
+paddr_memop(osa_sim_outer_memop_t* op) {
+   return(paddr_memop(GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(op)));
+}
+
+inline osa_linear_address_t&
+linear_addr_memop(osa_sim_outer_memop_t* op) {
+   return op->linear_address;
+}
+
+inline osa_linear_address_t&
+linear_addr_memop(osa_sim_inner_memop_t* op) {
+   return(linear_addr_memop(GET_OUTER_MEMOP_PTR_FROM_INNER_PTR(op)));
+}
+
+inline bool
+is_read_memop(osa_sim_inner_memop_t* op) {
+   return SIM_mem_op_is_read(op);
+}
+
+inline bool
+is_read_memop(osa_sim_outer_memop_t* op) {
+   return(is_read_memop(GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(op)));
+}
+
+inline bool
+is_data_memop(osa_sim_inner_memop_t* op) {
+   return SIM_mem_op_is_data(op);
+}
+
+inline bool
+is_data_memop(osa_sim_outer_memop_t* op) {
+   return(is_data_memop(GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(op)));
+}
+
+inline bool
+is_from_cpu_memop(osa_sim_inner_memop_t* op) {
+   return SIM_mem_op_is_from_cpu(op);
+}
+
+inline bool
+is_from_cpu_memop(osa_sim_outer_memop_t* op) {
+   return(is_from_cpu_memop(GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(op)));
+}
+
+inline osa_memop_specific_type_t&
+memop_specific_access_type(osa_sim_outer_memop_t *op) {
+   return op->access_type;
+}
+
+inline osa_memop_specific_type_t&
+memop_specific_access_type(osa_sim_inner_memop_t *op) {
+   return(memop_specific_access_type(GET_OUTER_MEMOP_PTR_FROM_INNER_PTR(op)));
+}
+
+inline char*&
+data_ptr_memop(osa_sim_inner_memop_t *op) {
+   return op->real_address;
+}
+
+inline char*&
+data_ptr_memop(osa_sim_outer_memop_t *op) {
+   return(data_ptr_memop(GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(op)));
+}
+
+inline osa_segment_register_t
+osa_get_segment_register(osa_cpu_object_t *cpu, const char *segname) {
+   return SIM_get_attribute(cpu, segname);
+}
+
+inline osa_uinteger_t
+seg_base(osa_segment_register_t segment) {
+   return segment.u.list.vector[7].u.integer;
+}
+
+inline osa_uinteger_t
+seg_limit(osa_segment_register_t segment) {
+   return segment.u.list.vector[8].u.integer;
+}
+
+inline osa_uinteger_t
+seg_valid(osa_segment_register_t segment) {
+   return segment.u.list.vector[9].u.integer;
+}
+
+static inline osa_simulator_error_t
+osa_sim_get_error(void) {
+   return SIM_get_pending_exception();
+}
+
+extern int regEAX;
+extern int regAX;
+extern int regAL;
+extern int regAH;
+extern int regECX;
+extern int regCX;
+extern int regCL;
+extern int regCH;
+extern int regEDX;
+extern int regDX;
+extern int regDL;
+extern int regDH;
+extern int regEBX;
+extern int regBX;
+extern int regBL;
+extern int regBH;
+extern int regESP;
+extern int regSP;
+extern int regEBP;
+extern int regBP;
+extern int regESI;
+extern int regSI;
+extern int regEDI;
+extern int regDI;
+extern int regIP;
+extern int regEIP;
+extern int regES;
+extern int regCS;
+extern int regSS;
+extern int regDS;
+extern int regFS;
+extern int regGS;
+
+
+static inline void dict_to_map(attr_value_t dict,
+      std::map<std::string, attr_value_t> &m) {
+   for(int i = 0; i < dict.u.dict.size; i++) {
+      m[dict.u.dict.vector[i].key.u.string] = dict.u.dict.vector[i].value;
+   }
+}
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -0,0 +1,445 @@
+// MetaTM Project
+// File Name: replaytrace.cc
+//
+// Description: recorder and reader for the offline replay stream
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include "replaytrace.h"
+#include "memaccess.h"
+#include "osacommon.h"
+
+using namespace std;
+
+replay_recorder *osa_replay_current = NULL;
+
+replay_recorder::replay_recorder(const char *filename, osamod_t *osamod) {
+   this->filename = filename;
+   this->osamod = osamod;
+   depth = 0;
+   nevents = 0;
+
+   fp = fopen(filename, "w");
+   if(fp == NULL) {
+      *osamod->pStatStream << "XXX: Can't open replay trace " << filename
+                           << ": " << strerror(errno) << endl;
+      return;
+   }
+   // Captures can run for hours; keep the syscall count down
+   setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+   replay_file_header_t hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   strncpy(hdr.magic, REPLAY_MAGIC, sizeof(hdr.magic));
+   hdr.version = REPLAY_VERSION;
+   hdr.ncpus = osamod->minfo->getNumCpus();
+   fwrite(&hdr, sizeof(hdr), 1, fp);
+
+   for(int i = 0; i < osamod->minfo->getNumCpus(); i++) {
+      const char *name = osamod->minfo->getCpu(i)->name;
+      uint32_t len = strlen(name);
+      fwrite(&len, sizeof(len), 1, fp);
+      fwrite(name, 1, len, fp);
+   }
+}
+
+replay_recorder::~replay_recorder() {
+   if(fp == NULL)
+      return;
+   replay_event_t ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.type = REPLAY_EV_END;
+   ev.obj = REPLAY_NO_OBJECT;
+   fwrite(&ev, sizeof(ev), 1, fp);
+   fclose(fp);
+}
+
+int replay_recorder::cpu_index(osa_cpu_object_t *cpu) {
+   // Recording is only ever attached to one machine, so the common
+   // module's cpu numbering is the stream's numbering
+   return osamod->minfo->getCpuNum(cpu);
+}
+
+void replay_recorder::begin(int type, osa_cpu_object_t *cpu,
+                            conf_object_t *obj,
+                            osa_sim_inner_memop_t *memop) {
+   if(fp == NULL)
+      return;
+   if(depth++ > 0)
+      return;
+
+   int cpunum = cpu_index(cpu);
+   if(cpunum < 0) {
+      // Another machine's cpu; don't capture it
+      depth = -1000000;
+      return;
+   }
+
+   memset(&cur, 0, sizeof(cur));
+   cur.type = type;
+   cur.cpu = cpunum;
+   cur.obj = obj ? object_id(obj) : REPLAY_NO_OBJECT;
+   cur.cycle = osa_get_sim_cycle_count(cpu);
+
+   // Same order as REPLAY_REG_*
+   int regs[REPLAY_NREGS] = { regEAX, regECX, regEDX, regEBX, regESP,
+                              regEBP, regESI, regEDI, regEIP };
+   for(int i = 0; i < REPLAY_NREGS; i++)
+      cur.regs[i] = (uint32_t)_osa_read_register(cpu, regs[i]);
+
+   if(memop) {
+      osa_sim_outer_memop_t *xmt = GET_OUTER_MEMOP_PTR_FROM_INNER_PTR(memop);
+      cur.laddr = type == REPLAY_EV_BREAKPOINT ?
+         linear_addr_memop(xmt) : laddr_memop(memop);
+      cur.paddr = paddr_memop(memop);
+      cur.size = size_memop(memop);
+      cur.memop_type = memop->type;
+      cur.access_type = memop_specific_access_type(xmt);
+      cur.mode = priv_level_memop(xmt);
+      if(memop->may_stall)
+         cur.flags |= REPLAY_MF_MAY_STALL;
+      if(is_from_cpu_memop(memop))
+         cur.flags |= REPLAY_MF_FROM_CPU;
+      if((long)(memop->user_ptr) & 0x7fffffff)
+         cur.flags |= REPLAY_MF_TX;
+   }
+
+   fills.clear();
+   osa_replay_current = this;
+}
+
+void replay_recorder::end() {
+   if(fp == NULL)
+      return;
+   if(--depth > 0)
+      return;
+   if(depth < 0) {
+      depth = 0;
+      return;
+   }
+
+   osa_replay_current = NULL;
+   cur.nfill = fills.size();
+   fwrite(&cur, sizeof(cur), 1, fp);
+   if(!fills.empty())
+      fwrite(&fills[0], sizeof(replay_fill_t), fills.size(), fp);
+   nevents++;
+}
+
+void replay_recorder::fill_xlate(osa_segment_t segment,
+                                 osa_logical_address_t laddr,
+                                 osa_physical_address_t paddr, bool fault) {
+   // The event header only has room for 64k fills; a callback that
+   // reads that much guest memory is a bug anyway
+   if(fills.size() >= 0xffff)
+      return;
+   replay_fill_t f;
+   memset(&f, 0, sizeof(f));
+   f.type = REPLAY_FILL_XLATE;
+   f.segment = segment;
+   f.fault = fault;
+   f.key = laddr;
+   f.value = paddr;
+   fills.push_back(f);
+}
+
+void replay_recorder::fill_phys(osa_physical_address_t paddr, int length,
+                                osa_uinteger_t value) {
+   if(fills.size() >= 0xffff)
+      return;
+   replay_fill_t f;
+   memset(&f, 0, sizeof(f));
+   f.type = REPLAY_FILL_PHYS;
+   f.length = length;
+   f.key = paddr;
+   f.value = value;
+   fills.push_back(f);
+}
+
+uint32_t replay_recorder::object_id(conf_object_t *obj) {
+   map<conf_object_t *, uint32_t>::iterator it = objects.find(obj);
+   if(it != objects.end())
+      return it->second;
+
+   uint32_t id = objects.size();
+   objects[obj] = id;
+
+   // payload: class name, NUL, object name
+   string payload(obj->class_data->name);
+   payload.push_back('\0');
+   payload.append(obj->name);
+
+   replay_event_t ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.type = REPLAY_EV_OBJECT;
+   ev.obj = id;
+   ev.size = payload.size();
+   fwrite(&ev, sizeof(ev), 1, fp);
+   fwrite(payload.data(), 1, payload.size(), fp);
+   return id;
+}
+
+template<class T> static void put_raw(string &buf, T v) {
+   buf.append((const char *)&v, sizeof(v));
+}
+
+void replay_recorder::put_attr_value(string &buf, attr_value_t val) {
+   buf.push_back((char)val.kind);
+   switch(val.kind) {
+   case Sim_Val_Integer:
+   case Sim_Val_Boolean:
+      put_raw<int64_t>(buf, val.u.integer);
+      break;
+   case Sim_Val_Floating:
+      put_raw<double>(buf, val.u.floating);
+      break;
+   case Sim_Val_String:
+      put_raw<uint32_t>(buf, strlen(val.u.string));
+      buf.append(val.u.string);
+      break;
+   case Sim_Val_Object:
+      put_raw<uint32_t>(buf, val.u.object ? object_id(val.u.object)
+                        : REPLAY_NO_OBJECT);
+      break;
+   case Sim_Val_Data:
+      put_raw<uint32_t>(buf, val.u.data.size);
+      buf.append((const char *)val.u.data.data, val.u.data.size);
+      break;
+   case Sim_Val_List:
+      put_raw<uint32_t>(buf, val.u.list.size);
+      for(int i = 0; i < val.u.list.size; i++)
+         put_attr_value(buf, val.u.list.vector[i]);
+      break;
+   case Sim_Val_Dict:
+      put_raw<uint32_t>(buf, val.u.dict.size);
+      for(int i = 0; i < val.u.dict.size; i++) {
+         put_attr_value(buf, val.u.dict.vector[i].key);
+         put_attr_value(buf, val.u.dict.vector[i].value);
+      }
+      break;
+   default:
+      break;
+   }
+}
+
+void replay_recorder::record_attr(conf_object_t *obj, const char *attr) {
+   attr_value_t val = SIM_get_attribute(obj, attr);
+   if(osa_sim_get_error() != NO_ERROR) {
+      osa_sim_clear_error();
+      return;
+   }
+   if(val.kind == Sim_Val_Invalid)
+      return;
+   record_attr(obj, attr, val);
+   SIM_free_attribute(val);
+}
+
+void replay_recorder::record_attr(conf_object_t *obj, const char *attr,
+                                  attr_value_t val) {
+   if(fp == NULL)
+      return;
+   uint32_t id = object_id(obj);
+
+   // payload: attribute name, NUL, encoded value
+   string payload(attr);
+   payload.push_back('\0');
+   put_attr_value(payload, val);
+
+   replay_event_t ev;
+   memset(&ev, 0, sizeof(ev));
+   ev.type = REPLAY_EV_ATTR;
+   ev.obj = id;
+   ev.size = payload.size();
+   fwrite(&ev, sizeof(ev), 1, fp);
+   fwrite(payload.data(), 1, payload.size(), fp);
+}
+
+// Stacked posts are run by the simulator after the current
+// instruction, outside the breakpoint callback that posted them.
+// Wrap them so that they become their own event in the stream.
+typedef struct _replay_post_t {
+   replay_recorder *rec;
+   event_handler_t func;
+   lang_void *data;
+   osa_cpu_object_t *cpu;
+} replay_post_t;
+
+static void replay_post_trampoline(conf_object_t *obj, lang_void *data) {
+   replay_post_t *post = (replay_post_t *)data;
+   {
+      replay_scope scope(post->rec, REPLAY_EV_POST, post->cpu, obj);
+      post->func(obj, post->data);
+   }
+   MM_FREE(post);
+}
+
+void osa_replay_stacked_post(conf_object_t *obj, event_handler_t func,
+                             lang_void *data) {
+   replay_post_t *post = MM_ZALLOC(1, replay_post_t);
+   post->rec = osa_replay_current;
+   post->func = func;
+   post->data = data;
+   post->cpu = OSA_get_sim_cpu();
+   SIM_stacked_post(obj, replay_post_trampoline, post);
+}
+
+void osa_replay_fill_xlate(osa_segment_t segment, osa_logical_address_t laddr,
+                           osa_physical_address_t paddr) {
+   osa_replay_current->fill_xlate(segment, laddr, paddr,
+                                  SIM_get_pending_exception() != NO_ERROR);
+}
+
+void osa_replay_fill_phys(osa_physical_address_t paddr, int length,
+                          osa_uinteger_t value) {
+   osa_replay_current->fill_phys(paddr, length, value);
+}
+
+/**** Reader ****/
+
+replay_reader::replay_reader(const char *filename) {
+   pos = 0;
+   fp = fopen(filename, "r");
+   if(fp == NULL)
+      return;
+   setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+   replay_file_header_t hdr;
+   if(fread(&hdr, sizeof(hdr), 1, fp) != 1
+      || strncmp(hdr.magic, REPLAY_MAGIC, sizeof(hdr.magic))
+      || hdr.version != REPLAY_VERSION) {
+      cerr << "XXX: " << filename << " is not a replay trace (version "
+           << REPLAY_VERSION << ")" << endl;
+      fclose(fp);
+      fp = NULL;
+      return;
+   }
+   pos += sizeof(hdr);
+
+   for(uint32_t i = 0; i < hdr.ncpus; i++) {
+      uint32_t len;
+      char name[256];
+      if(fread(&len, sizeof(len), 1, fp) != 1 || len >= sizeof(name)
+         || fread(name, 1, len, fp) != len) {
+         cerr << "XXX: truncated cpu table in " << filename << endl;
+         fclose(fp);
+         fp = NULL;
+         return;
+      }
+      name[len] = 0;
+      cpu_names.push_back(name);
+      pos += sizeof(len) + len;
+   }
+}
+
+replay_reader::~replay_reader() {
+   if(fp)
+      fclose(fp);
+}
+
+bool replay_reader::next(replay_event_t &ev, vector<replay_fill_t> &fills,
+                         string &payload) {
+   if(fp == NULL || fread(&ev, sizeof(ev), 1, fp) != 1)
+      return false;
+   pos += sizeof(ev);
+   if(ev.type == REPLAY_EV_END)
+      return false;
+
+   fills.resize(ev.nfill);
+   if(ev.nfill
+      && fread(&fills[0], sizeof(replay_fill_t), ev.nfill, fp) != ev.nfill)
+      return false;
+   pos += ev.nfill * sizeof(replay_fill_t);
+
+   payload.clear();
+   if(ev.type == REPLAY_EV_OBJECT || ev.type == REPLAY_EV_ATTR) {
+      payload.resize(ev.size);
+      if(ev.size && fread(&payload[0], 1, ev.size, fp) != ev.size)
+         return false;
+      pos += ev.size;
+   }
+   return true;
+}
+
+template<class T> static T get_raw(const char *&p, const char *end) {
+   T v = 0;
+   if(p + sizeof(T) <= end)
+      memcpy(&v, p, sizeof(T));
+   p += sizeof(T);
+   return v;
+}
+
+attr_value_t replay_reader::get_attr_value(const char *&p, const char *end,
+                                           vector<conf_object_t *> &lookup) {
+   attr_value_t val;
+   memset(&val, 0, sizeof(val));
+   if(p >= end) {
+      val.kind = Sim_Val_Invalid;
+      return val;
+   }
+   val.kind = (attr_kind_t)*p++;
+   switch(val.kind) {
+   case Sim_Val_Integer:
+   case Sim_Val_Boolean:
+      val.u.integer = get_raw<int64_t>(p, end);
+      break;
+   case Sim_Val_Floating:
+      val.u.floating = get_raw<double>(p, end);
+      break;
+   case Sim_Val_String: {
+      uint32_t len = get_raw<uint32_t>(p, end);
+      char *s = MM_ZALLOC(len + 1, char);
+      memcpy(s, p, MIN(len, (uint32_t)(end - p)));
+      p += len;
+      val.u.string = s;
+      break;
+   }
+   case Sim_Val_Object: {
+      uint32_t id = get_raw<uint32_t>(p, end);
+      val.u.object = id < lookup.size() ? lookup[id] : NULL;
+      if(val.u.object == NULL)
+         val.kind = Sim_Val_Nil;
+      break;
+   }
+   case Sim_Val_Data: {
+      uint32_t len = get_raw<uint32_t>(p, end);
+      val.u.data.size = len;
+      val.u.data.data = MM_MALLOC(len, uint8);
+      memcpy(val.u.data.data, p, MIN(len, (uint32_t)(end - p)));
+      p += len;
+      break;
+   }
+   case Sim_Val_List: {
+      uint32_t n = get_raw<uint32_t>(p, end);
+      val = SIM_alloc_attr_list(n);
+      for(uint32_t i = 0; i < n; i++)
+         val.u.list.vector[i] = get_attr_value(p, end, lookup);
+      break;
+   }
+   case Sim_Val_Dict: {
+      uint32_t n = get_raw<uint32_t>(p, end);
+      val = SIM_alloc_attr_dict(n);
+      for(uint32_t i = 0; i < n; i++) {
+         val.u.dict.vector[i].key = get_attr_value(p, end, lookup);
+         val.u.dict.vector[i].value = get_attr_value(p, end, lookup);
+      }
+      break;
+   }
+   default:
+      break;
+   }
+   return val;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -0,0 +1,210 @@
+// MetaTM Project
+// File Name: replaytrace.h
+//
+// Description: Binary event stream used to re-run the osa modules
+// offline.  A recorder attached to the common module (attribute
+// replay_record) captures every breakpoint hit, stacked post,
+// instrumented memop, magic instruction, cpu exception and device
+// access seen by the modules, together with a register snapshot and
+// the guest memory the modules read while handling it.  The replay
+// backend (replay.h/replay.cc, -D_USE_REPLAY) feeds the stream back
+// into the same callbacks without Simics.
+//
+// Stream layout:
+//    replay_file_header_t
+//    ncpus x (uint32 length, cpu name)
+//    records: replay_event_t, followed by
+//             nfill x replay_fill_t, followed by
+//             payload bytes (object and attribute records only)
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef OSA_REPLAYTRACE_H
+#define OSA_REPLAYTRACE_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "simulator.h"
+
+using namespace std;
+
+#define REPLAY_MAGIC     "OSARPLY"
+#define REPLAY_VERSION   1
+
+// Registers snapshotted with every event.  Order matters: this is
+// the on-disk order.
+#define REPLAY_NREGS     9
+#define REPLAY_REG_EAX   0
+#define REPLAY_REG_ECX   1
+#define REPLAY_REG_EDX   2
+#define REPLAY_REG_EBX   3
+#define REPLAY_REG_ESP   4
+#define REPLAY_REG_EBP   5
+#define REPLAY_REG_ESI   6
+#define REPLAY_REG_EDI   7
+#define REPLAY_REG_EIP   8
+
+// Event types
+#define REPLAY_EV_OBJECT      1  // declare object id -> (class, name)
+#define REPLAY_EV_ATTR        2  // attribute value at start of capture
+#define REPLAY_EV_BREAKPOINT  3  // Core_Breakpoint_Memop on obj
+#define REPLAY_EV_POST        4  // a stacked post from the previous bp
+#define REPLAY_EV_MEMOP       5  // timing_model operate on obj
+#define REPLAY_EV_MAGIC       6  // Core_Magic_Instruction on cpu
+#define REPLAY_EV_EXCEPTION   7  // Core_Exception on cpu
+#define REPLAY_EV_DEVICE      8  // Core_Device_Access_Memop
+#define REPLAY_EV_END         9  // capture closed cleanly
+
+// Fill types: answers the simulator gave while an event was handled
+#define REPLAY_FILL_XLATE     1  // logical -> physical translation
+#define REPLAY_FILL_PHYS      2  // physical memory read
+
+#define REPLAY_NO_OBJECT      0xffffffff
+
+typedef struct _replay_file_header_t {
+   char     magic[8];
+   uint32_t version;
+   uint32_t ncpus;
+} replay_file_header_t;
+
+typedef struct _replay_event_t {
+   uint8_t  type;
+   uint8_t  access_type;   // memop: x86 access type
+   uint8_t  memop_type;    // memop: load/store/fetch
+   uint8_t  mode;          // memop: user/supervisor
+   uint16_t nfill;
+   uint16_t flags;         // memop: REPLAY_MF_*
+   uint32_t cpu;           // index into the cpu table
+   uint32_t obj;           // object id, REPLAY_NO_OBJECT if none
+   uint64_t cycle;         // cycle count of cpu
+   uint64_t laddr;         // memop/bp: logical (linear) address
+   uint64_t paddr;         // memop: physical address
+   uint32_t size;          // memop: size, object/attr: payload bytes
+   uint32_t regs[REPLAY_NREGS];
+} replay_event_t;
+
+#define REPLAY_MF_MAY_STALL   0x1
+#define REPLAY_MF_FROM_CPU    0x2
+#define REPLAY_MF_TX          0x4
+
+typedef struct _replay_fill_t {
+   uint8_t  type;
+   uint8_t  segment;
+   uint8_t  fault;
+   uint8_t  length;
+   uint32_t pad;
+   uint64_t key;           // logical or physical address
+   uint64_t value;         // physical address or data read
+} replay_fill_t;
+
+class replay_recorder {
+ public:
+   replay_recorder(const char *filename, struct _osamod_t *osamod);
+   ~replay_recorder();
+
+   bool good() { return fp != NULL; }
+   const char *name() { return filename.c_str(); }
+
+   // Brackets around one simulator callback.  Fills recorded between
+   // begin() and end() are attached to the event.  Nested begins are
+   // folded into the outermost event.
+   void begin(int type, osa_cpu_object_t *cpu, conf_object_t *obj,
+              osa_sim_inner_memop_t *memop = NULL);
+   void end();
+
+   void fill_xlate(osa_segment_t segment, osa_logical_address_t laddr,
+                   osa_physical_address_t paddr, bool fault);
+   void fill_phys(osa_physical_address_t paddr, int length,
+                  osa_uinteger_t value);
+
+   // Capture-time configuration: declare an object and dump one of
+   // its attributes so the replay can rebuild the same setup.
+   uint32_t object_id(conf_object_t *obj);
+   void record_attr(conf_object_t *obj, const char *attr);
+   void record_attr(conf_object_t *obj, const char *attr, attr_value_t val);
+
+   unsigned long long events() { return nevents; }
+
+ private:
+   void put_attr_value(string &buf, attr_value_t val);
+   int cpu_index(osa_cpu_object_t *cpu);
+
+   string filename;
+   FILE *fp;
+   struct _osamod_t *osamod;
+   int depth;
+   replay_event_t cur;
+   vector<replay_fill_t> fills;
+   map<conf_object_t *, uint32_t> objects;
+   unsigned long long nevents;
+};
+
+// Scope guard, so that every return path of a callback closes its
+// event.
+class replay_scope {
+ public:
+   replay_scope(replay_recorder *r, int type, osa_cpu_object_t *cpu,
+                conf_object_t *obj, osa_sim_inner_memop_t *memop = NULL)
+      : rec(r) {
+      if(rec)
+         rec->begin(type, cpu, obj, memop);
+   }
+   ~replay_scope() {
+      if(rec)
+         rec->end();
+   }
+ private:
+   replay_recorder *rec;
+};
+
+#define OSA_REPLAY_SCOPE(osamod, type, cpu, obj, memop) \
+   replay_scope __replay_scope((osamod)->recorder, type, cpu, obj, memop)
+
+// Non-NULL while a recorder is inside begin()/end() in this module.
+// The simics.h memory wrappers use it to capture fills.
+extern replay_recorder *osa_replay_current;
+
+class replay_reader {
+ public:
+   replay_reader(const char *filename);
+   ~replay_reader();
+
+   bool good() { return fp != NULL; }
+   int ncpus() { return (int)cpu_names.size(); }
+   const char *cpu_name(int i) { return cpu_names[i].c_str(); }
+
+   // Returns false at end of stream.  payload holds the object name
+   // or attribute encoding for REPLAY_EV_OBJECT/REPLAY_EV_ATTR.
+   bool next(replay_event_t &ev, vector<replay_fill_t> &fills,
+             string &payload);
+
+   // Attribute payload decoding.  Objects are resolved through
+   // lookup, indexed by recorded object id.
+   static attr_value_t get_attr_value(const char *&p, const char *end,
+                                      vector<conf_object_t *> &lookup);
+
+   unsigned long long offset() { return pos; }
+
+ private:
+   FILE *fp;
+   vector<string> cpu_names;
+   unsigned long long pos;
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
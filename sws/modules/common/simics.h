@@ -61,7 +61,6 @@ typedef conf_object_t                                     system_component_objec
 #define OSA_get_sim_cpu() SIM_current_processor()
 #define _osa_read_register SIM_read_register
 #define _osa_write_register SIM_write_register
-#define osa_read_phys_memory SIM_read_phys_memory
 #define osa_write_phys_memory SIM_write_phys_memory
 #define GET_OUTER_MEMOP_PTR_FROM_INNER_PTR(x) (SIM_x86_mem_trans_from_generic(x))
 #define GET_INNER_MEMOP_PTR_FROM_OUTER_PTR(x) (&((x)->s))
@@ -69,7 +68,6 @@ typedef conf_object_t                                     system_component_objec
 #define osa_supervisor_mode Sim_CPU_Mode_Supervisor
 #define osa_get_sim_cycle_count SIM_cycle_count
 #define osa_get_proc_privilege SIM_processor_privilege_level
-#define osa_logical_to_physical SIM_logical_to_physical //OSA_log... also exists. It checks for simulator exceptions, while this does not
 #define osa_release_segment_register SIM_free_attribute  //don't need this for QEMU! Just make it a null
 #define NO_ERROR SimExc_No_Exception
 #define MEM_ERROR SimExc_Memory 
@@ -169,6 +167,46 @@ typedef set_error_t osa_attr_set_t;
 #define osa_sim_get_float_attribute(x, y) SIM_get_attribute(x, y).u.floating
 
 /* Functions go here */
+
+/* Replay capture hooks, see replaytrace.h.  osa_replay_current is
+ * only set while a recorder is capturing an event, so the cost when
+ * not recording is one load and branch per guest memory access. */
+class replay_recorder;
+extern replay_recorder *osa_replay_current;
+void osa_replay_fill_xlate(osa_segment_t segment, osa_logical_address_t laddr,
+                           osa_physical_address_t paddr);
+void osa_replay_fill_phys(osa_physical_address_t paddr, int length,
+                          osa_uinteger_t value);
+void osa_replay_stacked_post(conf_object_t *obj, event_handler_t func,
+                             lang_void *data);
+
+//OSA_log... also exists. It checks for simulator exceptions, while this does not
+static inline osa_physical_address_t
+osa_logical_to_physical(osa_cpu_object_t *cpu, osa_segment_t segment,
+                        osa_logical_address_t laddr) {
+   osa_physical_address_t paddr = SIM_logical_to_physical(cpu, segment, laddr);
+   if(osa_replay_current)
+      osa_replay_fill_xlate(segment, laddr, paddr);
+   return paddr;
+}
+
+static inline osa_uinteger_t
+osa_read_phys_memory(osa_cpu_object_t *cpu, osa_physical_address_t paddr,
+                     int length) {
+   osa_uinteger_t value = SIM_read_phys_memory(cpu, paddr, length);
+   if(osa_replay_current)
+      osa_replay_fill_phys(paddr, length, value);
+   return value;
+}
+
+static inline void
+osa_stacked_post(conf_object_t *obj, event_handler_t func, lang_void *data) {
+   if(osa_replay_current)
+      osa_replay_stacked_post(obj, func, data);
+   else
+      SIM_stacked_post(obj, func, data);
+}
+
 inline unsigned int&
 size_memop(osa_sim_inner_memop_t* op) {
    return op->size;
@@ -33,7 +33,11 @@
 #include "allochist.h"
 
 
-#if defined(_USE_SIMICS)
+// The replay backend provides the Simics API itself, so it is built
+// with both _USE_REPLAY and _USE_SIMICS and must be checked first
+#if defined(_USE_REPLAY)
+#include "replay.h"
+#elif defined(_USE_SIMICS)
 #include "simics.h"
 #elif defined(_USE_QEMU)
 #include "qemu.h"
@@ -1,7 +1,13 @@
 // MetaTM Project
-// File Name: txsbline.h
+// File Name: pool.h
 //
-// Description: 
+// Description: Fixed-size object pool with a free list per cpu.
+// Slots are carved out of chunks of def_pool_size (or the given
+// increment) and are never returned to malloc until the pool goes
+// away, so allocate and pfree are a pointer pop and push.  An object
+// may be freed on another cpu than the one it came from; it then
+// goes to that cpu's list.  Objects still allocated when the pool is
+// destroyed are not destructed.
 //
 // Operating Systems & Architecture Group
 // University of Texas at Austin - Department of Computer Sciences
@@ -10,37 +16,69 @@
 
 #ifndef _POOL_H_
 #define _POOL_H_
-#include "../common/simulator.h"
+#include <new>
+#include <vector>
+#include <iostream>
+
+using namespace std;
 
 static const int def_pool_size = 32;
 
 #ifdef _DEBUG_POOL
 #define checkpool() sanity_check()
-#else 
+#else
 #define checkpool()
 #endif
 
 template <typename T> class pool {
  private:
-  list<T*> m_free;
-  list<T*> m_allocated;
-  int      m_increment;
-  int      m_allocations;
-  int      m_deallocations;
-  void grow(int n) {
-    for(int i=0;i<n;i++)
-      m_free.push_back(new T());
+  // A free slot holds the next free slot of its list
+  struct free_slot {
+    free_slot *next;
+  };
+  // Slots are rounded up to this, to keep T aligned within a chunk
+  static const size_t slot_align = 16;
+
+  vector<free_slot*> m_free;     // per cpu
+  vector<char*>      m_chunks;
+  size_t             m_slot_size;
+  int                m_increment;
+  unsigned long long m_allocations;
+  unsigned long long m_deallocations;
+  unsigned long long m_live;
+  unsigned long long m_high_water;
+  unsigned long long m_slots;
+
+  free_slot *&list(int cpu) {
+    if(cpu < 0 || cpu >= (int)m_free.size())
+      cpu = 0;
+    return m_free[cpu];
   }
-  void free_list(list<T*>& l) {
-    while(!l.empty()) {
-      T* p = l.front();
-      l.pop_front();
-      delete p;
+  void grow(int cpu) {
+    char *chunk = (char*)::operator new(m_slot_size * m_increment);
+    m_chunks.push_back(chunk);
+    free_slot *&head = list(cpu);
+    for(int i = m_increment - 1; i >= 0; i--) {
+      free_slot *s = (free_slot*)(chunk + i * m_slot_size);
+      s->next = head;
+      head = s;
     }
+    m_slots += m_increment;
+  }
+  void init(int ncpus, int nsize) {
+    m_free.assign(ncpus > 0 ? ncpus : 1, (free_slot*)NULL);
+    m_slot_size = sizeof(T) > sizeof(free_slot) ? sizeof(T) : sizeof(free_slot);
+    m_slot_size = (m_slot_size + slot_align - 1) & ~(slot_align - 1);
+    m_increment = nsize > 0 ? nsize : def_pool_size;
+    m_allocations = 0;
+    m_deallocations = 0;
+    m_live = 0;
+    m_high_water = 0;
+    m_slots = 0;
   }
   void sanity_check() {
     if((m_allocations % 100) == 1) {
-      cout << "pool check:" 
+      cout << "pool check:"
 	   << " a: " << allocated_count()
 	   << " f: " << free_count()
 	   << " ta: " << m_allocations
@@ -48,47 +86,69 @@ template <typename T> class pool {
 	   << endl;
     }
   }
+  // Not copyable
+  pool(const pool &);
+  pool &operator=(const pool &);
  public:
-  pool<T>(int nsize) {
-    m_allocations = 0;
-    m_deallocations = 0;
-    m_increment = nsize;
-    grow(nsize);
+  pool(int ncpus, int nsize) {
+    init(ncpus, nsize);
   }
-  pool<T>() {
-    m_allocations = 0;
-    m_deallocations = 0;
-    m_increment = def_pool_size;
-    grow(def_pool_size);
+  pool(int ncpus) {
+    init(ncpus, def_pool_size);
   }
-  ~pool<T>() {
-    free_list(m_free);
-    free_list(m_allocated);   
+  pool() {
+    init(1, def_pool_size);
   }
-  T* allocate() {
+  ~pool() {
+    for(size_t i = 0; i < m_chunks.size(); i++)
+      ::operator delete(m_chunks[i]);
+  }
+
+  // Raw storage for one T, from cpu's list
+  void *get(int cpu) {
+    free_slot *&head = list(cpu);
+    if(head == NULL)
+      grow(cpu);
+    free_slot *s = head;
+    head = s->next;
     m_allocations++;
-    if(m_free.empty())
-      grow(m_increment);
-    T * p = m_free.front();
-    m_free.pop_front();
-    m_allocated.push_front(p);
+    if(++m_live > m_high_water)
+      m_high_water = m_live;
     checkpool();
-    return p;
+    return s;
   }
-  void pfree(T * p) {
+  void put(void *p, int cpu) {
+    free_slot *s = (free_slot*)p;
+    free_slot *&head = list(cpu);
+    s->next = head;
+    head = s;
     m_deallocations++;
-    m_allocated.remove(p);
-    m_free.push_front(p);
+    m_live--;
     checkpool();
   }
-  int free_count() {
-    return m_free.size();
+
+  // A default constructed T.  Types without a default constructor
+  // use get and placement new, then destroy and put.
+  T* allocate(int cpu) {
+    return new(get(cpu)) T();
+  }
+  void pfree(T * p, int cpu) {
+    p->~T();
+    put(p, cpu);
+  }
+
+  unsigned long long allocations() { return m_allocations; }
+  unsigned long long deallocations() { return m_deallocations; }
+  // Most objects out at once
+  unsigned long long high_water() { return m_high_water; }
+  unsigned long long free_count() {
+    return m_slots - m_live;
   }
-  int allocated_count() {
-    return m_allocated.size();
+  unsigned long long allocated_count() {
+    return m_live;
   }
-  int size() {
-    return free_count() + allocated_count();
+  unsigned long long size() {
+    return m_slots;
   }
 };
 #endif
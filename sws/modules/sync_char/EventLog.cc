@@ -0,0 +1,192 @@
+// SyncChar Project
+// File Name: EventLog.cc
+//
+// Description: Event log schemas and block codecs, shared by the
+// writer and the reader
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <string.h>
+#include "EventLog.h"
+
+#ifdef EVLOG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef EVLOG_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef EVLOG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+const evlog_schema_t evlog_schemas[EVLOG_NSEGS] = {
+   { "ws_close", EVLOG_WS_NCOLS, EVLOG_WS_LOCK, {
+         { "seq", 8, -1 },
+         { "cycle", 8, -1 },
+         { "lock", 4, -1 },
+         { "generation", 4, -1 },
+         { "index", 4, -1 },
+         { "pid", 4, -1 },
+         { "old_pid", 4, -1 },
+         { "cpu", 4, -1 },
+         { "flags", 4, -1 },
+         { "size", 4, -1 },
+         { "nranges", 4, -1 },
+         { "range_addr", 4, EVLOG_WS_NRANGES },
+         { "range_bmap", EVLOG_RANGE_BMAP_BYTES, EVLOG_WS_NRANGES } } },
+   { "contention", EVLOG_CT_NCOLS, EVLOG_CT_LOCK, {
+         { "seq", 8, -1 },
+         { "cycle", 8, -1 },
+         { "lock", 4, -1 },
+         { "generation", 4, -1 },
+         { "index", 4, -1 },
+         { "holder_generation", 4, -1 },
+         { "holder_index", 4, -1 },
+         { "pid", 4, -1 },
+         { "cpu", 4, -1 } } },
+   { "lock_stats", EVLOG_LS_NCOLS, EVLOG_LS_LOCK, {
+         { "seq", 8, -1 },
+         { "snapshot", 4, -1 },
+         { "lock", 4, -1 },
+         { "generation", 4, -1 },
+         { "lock_id", 4, -1 },
+         { "workset_count", 4, -1 },
+         { "nacq", 4, -1 },
+         { "rsize", 4, -1 },
+         { "wsize", 4, -1 },
+         { "size", 4, -1 },
+         { "acquires", 8, -1 },
+         { "contended", 8, -1 },
+         { "useless_release", 8, -1 },
+         { "acq_cycles", 8, -1 },
+         { "hold_cycles", 8, -1 } } },
+   { "reset", EVLOG_RS_NCOLS, -1, {
+         { "seq", 8, -1 },
+         { "cycle", 8, -1 },
+         { "epoch", 4, -1 } } },
+   { "timeline", EVLOG_TL_NCOLS, EVLOG_TL_LOCK, {
+         { "seq", 8, -1 },
+         { "snapshot", 4, -1 },
+         { "lock", 4, -1 },
+         { "generation", 4, -1 },
+         { "start", 8, -1 },
+         { "length", 8, -1 },
+         { "acquires", 4, -1 },
+         { "contended", 4, -1 },
+         { "hold_cycles", 8, -1 },
+         { "max_wait", 8, -1 } } }
+};
+
+const char *evlog_codec_names[EVLOG_NCODECS] = {
+   "none", "zlib", "lz4", "zstd"
+};
+
+int evlog_codec_by_name(const char *name) {
+   for(int i = 0; i < EVLOG_NCODECS; i++)
+      if(strcmp(name, evlog_codec_names[i]) == 0)
+         return i;
+   return -1;
+}
+
+bool evlog_codec_available(int codec) {
+   switch(codec) {
+   case EVLOG_CODEC_NONE:
+      return true;
+#ifdef EVLOG_HAVE_ZLIB
+   case EVLOG_CODEC_ZLIB:
+      return true;
+#endif
+#ifdef EVLOG_HAVE_LZ4
+   case EVLOG_CODEC_LZ4:
+      return true;
+#endif
+#ifdef EVLOG_HAVE_ZSTD
+   case EVLOG_CODEC_ZSTD:
+      return true;
+#endif
+   default:
+      return false;
+   }
+}
+
+// Fast settings throughout: blocks are compressed on the writer
+// thread, which has to keep up with the simulation
+bool evlog_compress(int codec, const char *in, size_t len, vector<char> &out) {
+   switch(codec) {
+#ifdef EVLOG_HAVE_ZLIB
+   case EVLOG_CODEC_ZLIB: {
+      uLongf dlen = compressBound(len);
+      out.resize(dlen);
+      if(compress2((Bytef *)&out[0], &dlen, (const Bytef *)in, len,
+                   Z_BEST_SPEED) != Z_OK)
+         return false;
+      out.resize(dlen);
+      return true;
+   }
+#endif
+#ifdef EVLOG_HAVE_LZ4
+   case EVLOG_CODEC_LZ4: {
+      out.resize(LZ4_compressBound(len));
+      int dlen = LZ4_compress_default(in, &out[0], len, out.size());
+      if(dlen <= 0)
+         return false;
+      out.resize(dlen);
+      return true;
+   }
+#endif
+#ifdef EVLOG_HAVE_ZSTD
+   case EVLOG_CODEC_ZSTD: {
+      out.resize(ZSTD_compressBound(len));
+      size_t dlen = ZSTD_compress(&out[0], out.size(), in, len, 1);
+      if(ZSTD_isError(dlen))
+         return false;
+      out.resize(dlen);
+      return true;
+   }
+#endif
+   default:
+      return false;
+   }
+}
+
+bool evlog_decompress(int codec, const char *in, size_t len,
+                      char *out, size_t raw_len) {
+   switch(codec) {
+   case EVLOG_CODEC_NONE:
+      if(len != raw_len)
+         return false;
+      memcpy(out, in, len);
+      return true;
+#ifdef EVLOG_HAVE_ZLIB
+   case EVLOG_CODEC_ZLIB: {
+      uLongf dlen = raw_len;
+      return uncompress((Bytef *)out, &dlen, (const Bytef *)in, len) == Z_OK
+         && dlen == raw_len;
+   }
+#endif
+#ifdef EVLOG_HAVE_LZ4
+   case EVLOG_CODEC_LZ4:
+      return LZ4_decompress_safe(in, out, len, raw_len) == (int)raw_len;
+#endif
+#ifdef EVLOG_HAVE_ZSTD
+   case EVLOG_CODEC_ZSTD:
+      return ZSTD_decompress(out, raw_len, in, len) == raw_len;
+#endif
+   default:
+      return false;
+   }
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
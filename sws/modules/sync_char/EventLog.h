@@ -0,0 +1,203 @@
+// SyncChar Project
+// File Name: EventLog.h
+//
+// Description: On-disk format of the binary syncchar event log,
+// written alongside (instead of inside) sync_char.log by
+// EventLogWriter and read back by EventLogReader.  Each record type
+// is a segment with a fixed set of columns; records are batched per
+// segment into blocks, each block storing its columns one after the
+// other, optionally compressed.  This file and EventLog.cc do not
+// depend on the simulator, so analysis tools can link them alone.
+//
+// File layout:
+//    evlog_file_header_t
+//    blocks: evlog_block_header_t, followed by stored_len bytes
+//            padded to EVLOG_COLUMN_ALIGN
+//    block index: nblocks x evlog_index_entry_t
+//    lock index: nlocks x evlog_lock_entry_t, then the block numbers
+//                they point into (uint32 each)
+//    evlog_trailer_t
+//
+// A log that was not closed (crash, kill) has no index or trailer;
+// the reader falls back to walking the block headers.
+//
+// Every record carries a sequence number that is global across
+// segments, so the original interleaving can be rebuilt.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+using namespace std;
+
+#define EVLOG_MAGIC          "SCEVLOG"
+#define EVLOG_TRAILER_MAGIC  "SCEVIDX"
+#define EVLOG_BLOCK_MAGIC    0x4b4c4245    // "EBLK"
+#define EVLOG_VERSION        1
+
+// Segments (record types)
+#define EVLOG_SEG_WS_CLOSE      0  // a workset was closed
+#define EVLOG_SEG_CONTENTION    1  // a closed workset waited on another
+#define EVLOG_SEG_LOCK_STATS    2  // one lock's counters at a stats dump
+#define EVLOG_SEG_RESET         3  // RESET_STATS
+#define EVLOG_SEG_TIMELINE      4  // one lock's counters over an epoch
+#define EVLOG_NSEGS             5
+
+// Block codecs.  Only the ones built in (EVLOG_HAVE_*) can be
+// written or read.
+#define EVLOG_CODEC_NONE     0
+#define EVLOG_CODEC_ZLIB     1
+#define EVLOG_CODEC_LZ4      2
+#define EVLOG_CODEC_ZSTD     3
+#define EVLOG_NCODECS        4
+
+// Records per block, and the raw size at which a block is sealed
+// early (worksets vary a lot in size)
+#define EVLOG_BLOCK_RECORDS  4096
+#define EVLOG_BLOCK_BYTES    (1 << 20)
+
+// Columns and blocks are padded to this so that mmapped columns are
+// aligned
+#define EVLOG_COLUMN_ALIGN   8
+#define EVLOG_ALIGN(n) \
+   (((n) + EVLOG_COLUMN_ALIGN - 1) & ~(uint64_t)(EVLOG_COLUMN_ALIGN - 1))
+
+#define EVLOG_MAX_COLUMNS    16
+
+// WS_CLOSE flags column
+#define EVLOG_WS_IO          0x1
+#define EVLOG_WS_TWO_OWNERS  0x2
+
+// Bytes per range_bmap row: one ByteRange (WorkSet.h)
+#define EVLOG_RANGE_BMAP_BYTES  8
+
+typedef struct _evlog_column_t {
+   const char *name;
+   uint32_t width;      // bytes per row: 4 or 8
+   int count_col;       // -1: one row per record.  Otherwise the
+                        // rows are the sum of that column.
+} evlog_column_t;
+
+typedef struct _evlog_schema_t {
+   const char *name;
+   int ncols;
+   int lock_col;        // column holding the lock address
+   evlog_column_t cols[EVLOG_MAX_COLUMNS];
+} evlog_schema_t;
+
+// Column numbers, per segment.  These index evlog_schemas[seg].cols
+// and are part of the on-disk format.
+enum {
+   EVLOG_WS_SEQ, EVLOG_WS_CYCLE, EVLOG_WS_LOCK, EVLOG_WS_GENERATION,
+   EVLOG_WS_INDEX, EVLOG_WS_PID, EVLOG_WS_OLD_PID, EVLOG_WS_CPU,
+   EVLOG_WS_FLAGS, EVLOG_WS_SIZE, EVLOG_WS_NRANGES,
+   // one row per SET_GRANULARITY range, as in logWorkset
+   EVLOG_WS_RANGE_ADDR, EVLOG_WS_RANGE_BMAP,
+   EVLOG_WS_NCOLS
+};
+
+enum {
+   EVLOG_CT_SEQ, EVLOG_CT_CYCLE, EVLOG_CT_LOCK, EVLOG_CT_GENERATION,
+   EVLOG_CT_INDEX, EVLOG_CT_HOLDER_GENERATION, EVLOG_CT_HOLDER_INDEX,
+   EVLOG_CT_PID, EVLOG_CT_CPU,
+   EVLOG_CT_NCOLS
+};
+
+enum {
+   EVLOG_LS_SEQ, EVLOG_LS_SNAPSHOT, EVLOG_LS_LOCK, EVLOG_LS_GENERATION,
+   EVLOG_LS_LOCK_ID, EVLOG_LS_WORKSET_COUNT, EVLOG_LS_NACQ,
+   EVLOG_LS_RSIZE, EVLOG_LS_WSIZE, EVLOG_LS_SIZE, EVLOG_LS_ACQUIRES,
+   EVLOG_LS_CONTENDED, EVLOG_LS_USELESS_RELEASE, EVLOG_LS_ACQ_CYCLES,
+   EVLOG_LS_HOLD_CYCLES,
+   EVLOG_LS_NCOLS
+};
+
+enum {
+   EVLOG_RS_SEQ, EVLOG_RS_CYCLE, EVLOG_RS_EPOCH,
+   EVLOG_RS_NCOLS
+};
+
+// A bucket still filling at one stats dump is written again at the
+// next; the record with the highest snapshot is the final one
+enum {
+   EVLOG_TL_SEQ, EVLOG_TL_SNAPSHOT, EVLOG_TL_LOCK, EVLOG_TL_GENERATION,
+   EVLOG_TL_START, EVLOG_TL_LENGTH, EVLOG_TL_ACQUIRES, EVLOG_TL_CONTENDED,
+   EVLOG_TL_HOLD_CYCLES, EVLOG_TL_MAX_WAIT,
+   EVLOG_TL_NCOLS
+};
+
+extern const evlog_schema_t evlog_schemas[EVLOG_NSEGS];
+extern const char *evlog_codec_names[EVLOG_NCODECS];
+
+// Codec by name ("none", "zlib", "lz4", "zstd"), -1 if unknown
+int evlog_codec_by_name(const char *name);
+// Whether this build can write and read codec
+bool evlog_codec_available(int codec);
+// Block (de)compression.  Both return false on failure, or if codec
+// is not built in.
+bool evlog_compress(int codec, const char *in, size_t len, vector<char> &out);
+bool evlog_decompress(int codec, const char *in, size_t len,
+                      char *out, size_t raw_len);
+
+typedef struct _evlog_file_header_t {
+   char     magic[8];
+   uint32_t version;
+   uint32_t flags;
+} evlog_file_header_t;
+
+typedef struct _evlog_block_header_t {
+   uint32_t magic;
+   uint16_t segment;
+   uint16_t codec;
+   uint32_t nrecords;
+   uint32_t raw_len;       // column bytes before compression
+   uint32_t stored_len;    // bytes following this header
+   uint32_t lock_min;      // range of lock addresses in the block
+   uint32_t lock_max;
+   uint32_t pad;
+   uint64_t seq_first;
+   uint64_t seq_last;
+} evlog_block_header_t;
+
+typedef struct _evlog_index_entry_t {
+   uint64_t offset;        // of the block header
+   evlog_block_header_t hdr;
+} evlog_index_entry_t;
+
+// Blocks of any segment that hold records for lock
+typedef struct _evlog_lock_entry_t {
+   uint32_t lock;
+   uint32_t first;         // into the block number array
+   uint32_t count;
+   uint32_t pad;
+} evlog_lock_entry_t;
+
+typedef struct _evlog_trailer_t {
+   uint64_t index_offset;
+   uint32_t nblocks;
+   uint32_t nlocks;
+   uint64_t lock_offset;
+   uint64_t nrecords;
+   char     magic[8];
+} evlog_trailer_t;
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
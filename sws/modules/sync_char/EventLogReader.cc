@@ -0,0 +1,287 @@
+// SyncChar Project
+// File Name: EventLogReader.cc
+//
+// Description: mmap reader for the binary event log
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "EventLogReader.h"
+
+void EventLogBlock::clear() {
+   memset(&hdr, 0, sizeof(hdr));
+   for(int c = 0; c < EVLOG_MAX_COLUMNS; c++) {
+      cols[c] = NULL;
+      nrows[c] = 0;
+      width[c] = 0;
+      count_col[c] = -1;
+      starts[c].clear();
+   }
+}
+
+EventLogReader::EventLogReader(const char *filename)
+   : fd(-1), data(NULL), len(0), has_trailer(false), locks(NULL),
+     nlocks(0), lock_block_list(NULL) {
+
+   fd = open(filename, O_RDONLY);
+   if(fd < 0) {
+      err = string("can't open ") + filename + ": " + strerror(errno);
+      return;
+   }
+   struct stat st;
+   if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(evlog_file_header_t)) {
+      err = string(filename) + " is too short for an event log";
+      return;
+   }
+   len = st.st_size;
+   void *p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+   if(p == MAP_FAILED) {
+      err = string("can't mmap ") + filename + ": " + strerror(errno);
+      return;
+   }
+
+   const evlog_file_header_t *hdr = (const evlog_file_header_t *)p;
+   if(memcmp(hdr->magic, EVLOG_MAGIC, sizeof(hdr->magic)) != 0
+      || hdr->version != EVLOG_VERSION) {
+      err = string(filename)
+         + " is not an event log, or is from another version";
+      munmap(p, len);
+      return;
+   }
+   data = (const char *)p;
+
+   if(!read_trailer())
+      scan_blocks();
+}
+
+EventLogReader::~EventLogReader() {
+   if(data)
+      munmap((void *)data, len);
+   if(fd >= 0)
+      close(fd);
+}
+
+// Use the indices at the end of the file, if they are there and sane
+bool EventLogReader::read_trailer() {
+   if(len < sizeof(evlog_file_header_t) + sizeof(evlog_trailer_t))
+      return false;
+
+   evlog_trailer_t t;
+   memcpy(&t, data + len - sizeof(t), sizeof(t));
+   if(memcmp(t.magic, EVLOG_TRAILER_MAGIC, sizeof(t.magic)) != 0)
+      return false;
+
+   uint64_t end = len - sizeof(t);
+   if(t.index_offset > end
+      || (end - t.index_offset) / sizeof(evlog_index_entry_t) < t.nblocks
+      || t.lock_offset != t.index_offset
+                          + t.nblocks * sizeof(evlog_index_entry_t)
+      || (end - t.lock_offset) / sizeof(evlog_lock_entry_t) < t.nlocks)
+      return false;
+
+   const evlog_index_entry_t *e =
+      (const evlog_index_entry_t *)(data + t.index_offset);
+   index.assign(e, e + t.nblocks);
+   for(unsigned int i = 0; i < index.size(); i++) {
+      if(index[i].offset + sizeof(evlog_block_header_t)
+            + index[i].hdr.stored_len > t.index_offset) {
+         index.clear();
+         return false;
+      }
+   }
+
+   locks = (const evlog_lock_entry_t *)(data + t.lock_offset);
+   nlocks = t.nlocks;
+   lock_block_list = (const uint32_t *)(locks + nlocks);
+   uint64_t nlist = (end - t.lock_offset - nlocks * sizeof(evlog_lock_entry_t))
+      / sizeof(uint32_t);
+   for(uint32_t i = 0; i < nlocks; i++) {
+      if(locks[i].first + (uint64_t)locks[i].count > nlist) {
+         index.clear();
+         locks = NULL;
+         nlocks = 0;
+         lock_block_list = NULL;
+         return false;
+      }
+   }
+
+   has_trailer = true;
+   return true;
+}
+
+// No trailer: the log was not closed.  Walk the blocks up to the
+// first one that is cut short.
+void EventLogReader::scan_blocks() {
+   uint64_t pos = sizeof(evlog_file_header_t);
+   while(pos + sizeof(evlog_block_header_t) <= len) {
+      evlog_index_entry_t e;
+      e.offset = pos;
+      memcpy(&e.hdr, data + pos, sizeof(e.hdr));
+      if(e.hdr.magic != EVLOG_BLOCK_MAGIC
+         || e.hdr.segment >= EVLOG_NSEGS
+         || pos + sizeof(e.hdr) + e.hdr.stored_len > len)
+         break;
+      index.push_back(e);
+      pos += sizeof(e.hdr) + EVLOG_ALIGN(e.hdr.stored_len);
+   }
+}
+
+bool EventLogReader::load(unsigned int i, EventLogBlock &blk) {
+   blk.clear();
+   if(i >= index.size()) {
+      err = "no such block";
+      return false;
+   }
+
+   const evlog_block_header_t &hdr = index[i].hdr;
+   if(hdr.segment >= EVLOG_NSEGS) {
+      err = "bad segment in block header";
+      return false;
+   }
+   blk.hdr = hdr;
+
+   const char *stored = data + index[i].offset + sizeof(hdr);
+   const char *base = stored;
+   if(hdr.codec != EVLOG_CODEC_NONE) {
+      if(hdr.codec >= EVLOG_NCODECS || !evlog_codec_available(hdr.codec)) {
+         err = string("block uses codec ")
+            + (hdr.codec < EVLOG_NCODECS ? evlog_codec_names[hdr.codec] : "?")
+            + ", which this build lacks";
+         return false;
+      }
+      blk.buf.resize(hdr.raw_len);
+      if(!evlog_decompress(hdr.codec, stored, hdr.stored_len,
+                           hdr.raw_len ? &blk.buf[0] : NULL, hdr.raw_len)) {
+         err = "corrupt compressed block";
+         return false;
+      }
+      base = hdr.raw_len ? &blk.buf[0] : NULL;
+   } else if(hdr.stored_len != hdr.raw_len) {
+      err = "bad block length";
+      return false;
+   }
+
+   // Columns are laid out in schema order; counted columns get their
+   // row count from an earlier column
+   const evlog_schema_t *schema = &evlog_schemas[hdr.segment];
+   uint64_t off = 0;
+   for(int c = 0; c < schema->ncols; c++) {
+      const evlog_column_t *col = &schema->cols[c];
+      uint64_t rows = hdr.nrecords;
+      if(col->count_col >= 0) {
+         vector<uint32_t> &s = blk.starts[col->count_col];
+         if(s.empty()) {
+            const uint32_t *counts = blk.u32(col->count_col);
+            s.resize(hdr.nrecords + 1);
+            s[0] = 0;
+            for(uint32_t r = 0; r < hdr.nrecords; r++) {
+               if((uint64_t)s[r] + counts[r] > hdr.raw_len) {
+                  err = "bad row count";
+                  return false;
+               }
+               s[r + 1] = s[r] + counts[r];
+            }
+         }
+         rows = s[hdr.nrecords];
+      }
+      if(off + rows * col->width > hdr.raw_len) {
+         err = "block too short for its columns";
+         return false;
+      }
+      blk.cols[c] = base + off;
+      blk.nrows[c] = rows;
+      blk.width[c] = col->width;
+      blk.count_col[c] = col->count_col;
+      off += EVLOG_ALIGN(rows * col->width);
+   }
+   return true;
+}
+
+static bool lock_entry_before(const evlog_lock_entry_t &e, uint32_t lock) {
+   return e.lock < lock;
+}
+
+void EventLogReader::find_lock(uint32_t lock, int seg,
+                               vector<unsigned int> &out) const {
+   out.clear();
+   if(has_trailer) {
+      const evlog_lock_entry_t *e =
+         lower_bound(locks, locks + nlocks, lock, lock_entry_before);
+      if(e == locks + nlocks || e->lock != lock)
+         return;
+      for(uint32_t i = 0; i < e->count; i++) {
+         unsigned int b = lock_block_list[e->first + i];
+         if(b < index.size() && (seg < 0 || index[b].hdr.segment == seg))
+            out.push_back(b);
+      }
+      return;
+   }
+
+   for(unsigned int b = 0; b < index.size(); b++) {
+      const evlog_block_header_t &hdr = index[b].hdr;
+      if((seg < 0 || hdr.segment == seg)
+         && evlog_schemas[hdr.segment].lock_col >= 0
+         && hdr.lock_min <= lock && lock <= hdr.lock_max)
+         out.push_back(b);
+   }
+}
+
+bool EventLogReader::ws_closes(uint32_t lock, vector<evlog_ws_close_t> &out) {
+   out.clear();
+
+   vector<unsigned int> blocks;
+   find_lock(lock, EVLOG_SEG_WS_CLOSE, blocks);
+
+   EventLogBlock blk;
+   for(unsigned int i = 0; i < blocks.size(); i++) {
+      if(!load(blocks[i], blk))
+         return false;
+
+      const uint32_t *lk = blk.u32(EVLOG_WS_LOCK);
+      for(uint32_t r = 0; r < blk.records(); r++) {
+         if(lk[r] != lock)
+            continue;
+
+         out.push_back(evlog_ws_close_t());
+         evlog_ws_close_t &ws = out.back();
+         ws.seq = blk.u64(EVLOG_WS_SEQ)[r];
+         ws.cycle = blk.u64(EVLOG_WS_CYCLE)[r];
+         ws.lock = lk[r];
+         ws.generation = blk.u32(EVLOG_WS_GENERATION)[r];
+         ws.index = blk.u32(EVLOG_WS_INDEX)[r];
+         ws.pid = blk.u32(EVLOG_WS_PID)[r];
+         ws.old_pid = blk.u32(EVLOG_WS_OLD_PID)[r];
+         ws.cpu = blk.u32(EVLOG_WS_CPU)[r];
+         ws.flags = blk.u32(EVLOG_WS_FLAGS)[r];
+         ws.size = blk.u32(EVLOG_WS_SIZE)[r];
+
+         uint32_t first = blk.first_row(EVLOG_WS_RANGE_ADDR, r);
+         uint32_t last = blk.first_row(EVLOG_WS_RANGE_ADDR, r + 1);
+         ws.range_addr.assign(blk.u32(EVLOG_WS_RANGE_ADDR) + first,
+                              blk.u32(EVLOG_WS_RANGE_ADDR) + last);
+         ws.range_bmap.assign(blk.u64(EVLOG_WS_RANGE_BMAP) + first,
+                              blk.u64(EVLOG_WS_RANGE_BMAP) + last);
+      }
+   }
+   return true;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -0,0 +1,141 @@
+// SyncChar Project
+// File Name: EventLogReader.h
+//
+// Description: Reader for the binary event log (format in
+// EventLog.h).  The file is mmapped; uncompressed columns are used in
+// place.  The lock index lets an analysis load only the blocks that
+// hold one lock's records.  Links with EventLog.cc only, no
+// simulator code.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef EVENTLOGREADER_H
+#define EVENTLOGREADER_H
+
+#include <string>
+#include <vector>
+#include "EventLog.h"
+
+using namespace std;
+
+// One decoded block.  Column pointers stay valid until the block is
+// reloaded or the reader is closed.
+class EventLogBlock {
+ public:
+   EventLogBlock() { clear(); }
+
+   int segment() const { return hdr.segment; }
+   uint32_t records() const { return hdr.nrecords; }
+   const evlog_block_header_t &header() const { return hdr; }
+
+   uint32_t rows(int col) const { return nrows[col]; }
+   const char *column(int col) const { return cols[col]; }
+   const uint32_t *u32(int col) const { return (const uint32_t *)cols[col]; }
+   const uint64_t *u64(int col) const { return (const uint64_t *)cols[col]; }
+   // A 4 or 8 byte column value, widened
+   uint64_t value(int col, uint32_t row) const {
+      return width[col] == 8 ? u64(col)[row] : u32(col)[row];
+   }
+
+   // For a column with a count column: the first row of record r.
+   // The rows of record r are [first_row(col, r), first_row(col, r+1)).
+   uint32_t first_row(int col, uint32_t r) const {
+      return starts[count_col[col]][r];
+   }
+
+ private:
+   friend class EventLogReader;
+   void clear();
+
+   evlog_block_header_t hdr;
+   const char *cols[EVLOG_MAX_COLUMNS];
+   uint32_t nrows[EVLOG_MAX_COLUMNS];
+   uint32_t width[EVLOG_MAX_COLUMNS];
+   int count_col[EVLOG_MAX_COLUMNS];
+   // Prefix sums of each count column, nrecords + 1 entries
+   vector<uint32_t> starts[EVLOG_MAX_COLUMNS];
+   // Decompressed data, if the block was compressed
+   vector<char> buf;
+};
+
+// A WS_CLOSE record with its ranges
+typedef struct _evlog_ws_close_t {
+   uint64_t seq;
+   uint64_t cycle;
+   uint32_t lock;
+   uint32_t generation;
+   uint32_t index;
+   uint32_t pid;
+   uint32_t old_pid;
+   uint32_t cpu;
+   uint32_t flags;
+   uint32_t size;
+   // One entry per SET_GRANULARITY range: the range address and its
+   // ByteRange (the first set_chunk in the low word)
+   vector<uint32_t> range_addr;
+   vector<uint64_t> range_bmap;
+} evlog_ws_close_t;
+
+class EventLogReader {
+ public:
+   EventLogReader(const char *filename);
+   ~EventLogReader();
+
+   // False if the file could not be opened or is not an event log;
+   // error() says why
+   bool good() const { return data != NULL; }
+   const string &error() const { return err; }
+
+   // True if the log was closed and has its indices.  Otherwise the
+   // blocks were found by walking the file, and lock lookups fall
+   // back to each block's lock range.
+   bool indexed() const { return has_trailer; }
+
+   unsigned int nblocks() const { return index.size(); }
+   const evlog_index_entry_t &block(unsigned int i) const { return index[i]; }
+
+   // Decode block i.  False (see error()) if it is corrupt or uses a
+   // codec this build lacks.
+   bool load(unsigned int i, EventLogBlock &blk);
+
+   // Blocks of segment seg (-1 for any) that may hold records for lock
+   void find_lock(uint32_t lock, int seg, vector<unsigned int> &out) const;
+
+   // All WS_CLOSE records of lock, in order
+   bool ws_closes(uint32_t lock, vector<evlog_ws_close_t> &out);
+
+ private:
+   bool read_trailer();
+   void scan_blocks();
+
+   string err;
+   int fd;
+   const char *data;
+   uint64_t len;
+
+   vector<evlog_index_entry_t> index;
+   bool has_trailer;
+   const evlog_lock_entry_t *locks;
+   uint32_t nlocks;
+   const uint32_t *lock_block_list;
+
+   // Not copyable
+   EventLogReader(const EventLogReader &);
+   EventLogReader &operator=(const EventLogReader &);
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -0,0 +1,437 @@
+// SyncChar Project
+// File Name: EventLogWriter.cc
+//
+// Description: Streaming writer for the binary event log
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <set>
+#include "EventLogWriter.h"
+#include "WorkSet.h"
+
+// The range_bmap column is written straight from ByteRanges
+typedef char evlog_bmap_size_check[
+   sizeof(ByteRange) == EVLOG_RANGE_BMAP_BYTES ? 1 : -1];
+
+// Simics (and syncchar-replay) leave by calling exit(), so close any
+// logs that are still open from there; otherwise the last blocks and
+// the indices would be lost.  Each machine has its own writer, and
+// machines may be created and destroyed on different threads.
+static set<EventLogWriter *> open_logs;
+static bool close_registered = false;
+static pthread_mutex_t open_logs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void close_open_logs(void) {
+   for(;;) {
+      pthread_mutex_lock(&open_logs_mutex);
+      EventLogWriter *log = open_logs.empty() ? NULL : *open_logs.begin();
+      pthread_mutex_unlock(&open_logs_mutex);
+      if(log == NULL)
+         break;
+      // close() takes it out of open_logs
+      log->close();
+   }
+}
+
+EventLogWriter::EventLogWriter(const char *filename, int codec)
+   : filename(filename), codec(codec), seq(0), nrecords(0), epoch(0),
+     snapshot(0), nblocks(0), busy(false), stopping(false), max_queue(0),
+     offset(0), raw_total(0), stored_total(0), write_failed(false) {
+
+   for(int i = 0; i < EVLOG_NSEGS; i++) {
+      segs[i].nrecords = 0;
+      segs[i].bytes = 0;
+   }
+
+   fp = fopen(filename, "wb");
+   if(fp == NULL)
+      return;
+
+   evlog_file_header_t hdr;
+   memset(&hdr, 0, sizeof(hdr));
+   memcpy(hdr.magic, EVLOG_MAGIC, sizeof(hdr.magic));
+   hdr.version = EVLOG_VERSION;
+   if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+      fclose(fp);
+      fp = NULL;
+      return;
+   }
+   offset = sizeof(hdr);
+
+   pthread_mutex_init(&mutex, NULL);
+   pthread_cond_init(&work, NULL);
+   pthread_cond_init(&idle, NULL);
+   if(pthread_create(&thread, NULL, thread_main, this) != 0) {
+      fclose(fp);
+      fp = NULL;
+      return;
+   }
+
+   pthread_mutex_lock(&open_logs_mutex);
+   if(!close_registered) {
+      atexit(close_open_logs);
+      close_registered = true;
+   }
+   open_logs.insert(this);
+   pthread_mutex_unlock(&open_logs_mutex);
+}
+
+EventLogWriter::~EventLogWriter() {
+   close();
+}
+
+uint64_t EventLogWriter::begin_record(int seg, uint32_t lock) {
+   segment *s = &segs[seg];
+   if(s->nrecords == 0) {
+      s->seq_first = seq;
+      s->lock_min = lock;
+      s->lock_max = lock;
+   } else {
+      s->lock_min = min(s->lock_min, lock);
+      s->lock_max = max(s->lock_max, lock);
+   }
+   s->seq_last = seq;
+   nrecords++;
+   return seq++;
+}
+
+void EventLogWriter::end_record(int seg) {
+   segment *s = &segs[seg];
+   if(++s->nrecords >= EVLOG_BLOCK_RECORDS || s->bytes >= EVLOG_BLOCK_BYTES)
+      seal(seg);
+}
+
+void EventLogWriter::put(int seg, int col, const void *p, size_t len) {
+   vector<char> &c = segs[seg].cols[col];
+   c.insert(c.end(), (const char *)p, (const char *)p + len);
+   segs[seg].bytes += len;
+}
+
+void EventLogWriter::put32(int seg, int col, uint32_t v) {
+   put(seg, col, &v, sizeof(v));
+}
+
+void EventLogWriter::put64(int seg, int col, uint64_t v) {
+   put(seg, col, &v, sizeof(v));
+}
+
+void EventLogWriter::ws_close(WorkSet *ws, uint64_t cycle) {
+   if(fp == NULL)
+      return;
+
+   ws->get_ranges(range_addrs, range_bmaps);
+
+   uint32_t flags = 0;
+   if(ws->IO)
+      flags |= EVLOG_WS_IO;
+   if(ws->twoowners)
+      flags |= EVLOG_WS_TWO_OWNERS;
+
+   int s = EVLOG_SEG_WS_CLOSE;
+   put64(s, EVLOG_WS_SEQ, begin_record(s, ws->id.lock_addr));
+   put64(s, EVLOG_WS_CYCLE, cycle);
+   put32(s, EVLOG_WS_LOCK, ws->id.lock_addr);
+   put32(s, EVLOG_WS_GENERATION, ws->id.lock_generation);
+   put32(s, EVLOG_WS_INDEX, ws->id.workset_index);
+   put32(s, EVLOG_WS_PID, ws->pid);
+   put32(s, EVLOG_WS_OLD_PID, ws->twoowners ? ws->old_pid : ws->pid);
+   put32(s, EVLOG_WS_CPU, ws->cpu);
+   put32(s, EVLOG_WS_FLAGS, flags);
+   put32(s, EVLOG_WS_SIZE, ws->size());
+   put32(s, EVLOG_WS_NRANGES, range_addrs.size());
+   if(!range_addrs.empty()) {
+      put(s, EVLOG_WS_RANGE_ADDR, &range_addrs[0],
+          range_addrs.size() * sizeof(uint32_t));
+      put(s, EVLOG_WS_RANGE_BMAP, &range_bmaps[0],
+          range_bmaps.size() * sizeof(ByteRange));
+   }
+   end_record(s);
+
+   s = EVLOG_SEG_CONTENTION;
+   for(vector<WorksetID>::iterator iter = ws->contended_worksets.begin();
+       iter != ws->contended_worksets.end(); iter++) {
+      put64(s, EVLOG_CT_SEQ, begin_record(s, ws->id.lock_addr));
+      put64(s, EVLOG_CT_CYCLE, cycle);
+      put32(s, EVLOG_CT_LOCK, ws->id.lock_addr);
+      put32(s, EVLOG_CT_GENERATION, ws->id.lock_generation);
+      put32(s, EVLOG_CT_INDEX, ws->id.workset_index);
+      put32(s, EVLOG_CT_HOLDER_GENERATION, iter->lock_generation);
+      put32(s, EVLOG_CT_HOLDER_INDEX, iter->workset_index);
+      put32(s, EVLOG_CT_PID, ws->pid);
+      put32(s, EVLOG_CT_CPU, ws->cpu);
+      end_record(s);
+   }
+}
+
+void EventLogWriter::begin_stats() {
+   snapshot++;
+}
+
+void EventLogWriter::lock_stats(const evlog_lock_stats_t &st) {
+   if(fp == NULL)
+      return;
+
+   int s = EVLOG_SEG_LOCK_STATS;
+   put64(s, EVLOG_LS_SEQ, begin_record(s, st.lock));
+   put32(s, EVLOG_LS_SNAPSHOT, snapshot);
+   put32(s, EVLOG_LS_LOCK, st.lock);
+   put32(s, EVLOG_LS_GENERATION, st.generation);
+   put32(s, EVLOG_LS_LOCK_ID, st.lock_id);
+   put32(s, EVLOG_LS_WORKSET_COUNT, st.workset_count);
+   put32(s, EVLOG_LS_NACQ, st.nacq);
+   put32(s, EVLOG_LS_RSIZE, st.rsize);
+   put32(s, EVLOG_LS_WSIZE, st.wsize);
+   put32(s, EVLOG_LS_SIZE, st.size);
+   put64(s, EVLOG_LS_ACQUIRES, st.acquires);
+   put64(s, EVLOG_LS_CONTENDED, st.contended);
+   put64(s, EVLOG_LS_USELESS_RELEASE, st.useless_release);
+   put64(s, EVLOG_LS_ACQ_CYCLES, st.acq_cycles);
+   put64(s, EVLOG_LS_HOLD_CYCLES, st.hold_cycles);
+   end_record(s);
+}
+
+void EventLogWriter::timeline(const evlog_timeline_t &b) {
+   if(fp == NULL)
+      return;
+
+   int s = EVLOG_SEG_TIMELINE;
+   put64(s, EVLOG_TL_SEQ, begin_record(s, b.lock));
+   put32(s, EVLOG_TL_SNAPSHOT, snapshot);
+   put32(s, EVLOG_TL_LOCK, b.lock);
+   put32(s, EVLOG_TL_GENERATION, b.generation);
+   put64(s, EVLOG_TL_START, b.start);
+   put64(s, EVLOG_TL_LENGTH, b.length);
+   put32(s, EVLOG_TL_ACQUIRES, b.acquires);
+   put32(s, EVLOG_TL_CONTENDED, b.contended);
+   put64(s, EVLOG_TL_HOLD_CYCLES, b.hold_cycles);
+   put64(s, EVLOG_TL_MAX_WAIT, b.max_wait);
+   end_record(s);
+}
+
+void EventLogWriter::reset(uint64_t cycle) {
+   if(fp == NULL)
+      return;
+
+   int s = EVLOG_SEG_RESET;
+   put64(s, EVLOG_RS_SEQ, begin_record(s, 0));
+   put64(s, EVLOG_RS_CYCLE, cycle);
+   put32(s, EVLOG_RS_EPOCH, ++epoch);
+   end_record(s);
+}
+
+// Turn a segment's columns into a block and queue it for the writer
+// thread
+void EventLogWriter::seal(int seg) {
+   segment *s = &segs[seg];
+   if(s->nrecords == 0)
+      return;
+
+   const evlog_schema_t *schema = &evlog_schemas[seg];
+   pending *p = new pending;
+   memset(&p->hdr, 0, sizeof(p->hdr));
+   p->hdr.magic = EVLOG_BLOCK_MAGIC;
+   p->hdr.segment = seg;
+   p->hdr.codec = EVLOG_CODEC_NONE;
+   p->hdr.nrecords = s->nrecords;
+   p->hdr.lock_min = s->lock_min;
+   p->hdr.lock_max = s->lock_max;
+   p->hdr.seq_first = s->seq_first;
+   p->hdr.seq_last = s->seq_last;
+
+   size_t len = 0;
+   for(int c = 0; c < schema->ncols; c++)
+      len += EVLOG_ALIGN(s->cols[c].size());
+   p->data.resize(len);
+   p->hdr.raw_len = len;
+
+   char *d = len ? &p->data[0] : NULL;
+   for(int c = 0; c < schema->ncols; c++) {
+      vector<char> &col = s->cols[c];
+      if(!col.empty())
+         memcpy(d, &col[0], col.size());
+      d += EVLOG_ALIGN(col.size());
+   }
+
+   // Note which locks this block holds.  Unique them first so that
+   // the map sees each lock once per block.
+   unsigned int block = nblocks++;
+   if(schema->lock_col >= 0) {
+      const uint32_t *locks = (const uint32_t *)&s->cols[schema->lock_col][0];
+      vector<uint32_t> uniq(locks, locks + s->nrecords);
+      sort(uniq.begin(), uniq.end());
+      uniq.erase(unique(uniq.begin(), uniq.end()), uniq.end());
+      for(unsigned int i = 0; i < uniq.size(); i++)
+         lock_blocks[uniq[i]].push_back(block);
+   }
+
+   for(int c = 0; c < schema->ncols; c++)
+      s->cols[c].clear();
+   s->nrecords = 0;
+   s->bytes = 0;
+
+   pthread_mutex_lock(&mutex);
+   queue.push_back(p);
+   if(queue.size() > max_queue)
+      max_queue = queue.size();
+   pthread_cond_signal(&work);
+   pthread_mutex_unlock(&mutex);
+}
+
+void *EventLogWriter::thread_main(void *arg) {
+   EventLogWriter *log = (EventLogWriter *)arg;
+
+   pthread_mutex_lock(&log->mutex);
+   for(;;) {
+      while(log->queue.empty() && !log->stopping)
+         pthread_cond_wait(&log->work, &log->mutex);
+      if(log->queue.empty())
+         break;
+
+      pending *p = log->queue.front();
+      log->queue.pop_front();
+      log->busy = true;
+      pthread_mutex_unlock(&log->mutex);
+
+      log->write_block(p);
+      delete p;
+
+      pthread_mutex_lock(&log->mutex);
+      log->busy = false;
+      if(log->queue.empty())
+         pthread_cond_broadcast(&log->idle);
+   }
+   pthread_mutex_unlock(&log->mutex);
+   return NULL;
+}
+
+void EventLogWriter::write_block(pending *p) {
+   const char *data = p->data.empty() ? NULL : &p->data[0];
+   vector<char> packed;
+
+   // Keep the compressed form only if it is smaller
+   if(codec != EVLOG_CODEC_NONE
+      && evlog_compress(codec, data, p->data.size(), packed)
+      && packed.size() < p->data.size()) {
+      p->hdr.codec = codec;
+      data = &packed[0];
+   }
+   p->hdr.stored_len = p->hdr.codec == EVLOG_CODEC_NONE
+      ? p->data.size() : packed.size();
+
+   static const char zeros[EVLOG_COLUMN_ALIGN] = { 0 };
+   size_t pad = EVLOG_ALIGN(p->hdr.stored_len) - p->hdr.stored_len;
+   if(fwrite(&p->hdr, sizeof(p->hdr), 1, fp) != 1
+      || (p->hdr.stored_len
+          && fwrite(data, p->hdr.stored_len, 1, fp) != 1)
+      || (pad && fwrite(zeros, pad, 1, fp) != 1)) {
+      write_failed = true;
+      return;
+   }
+
+   evlog_index_entry_t e;
+   e.offset = offset;
+   e.hdr = p->hdr;
+   index.push_back(e);
+
+   offset += sizeof(p->hdr) + p->hdr.stored_len + pad;
+   raw_total += p->hdr.raw_len;
+   stored_total += p->hdr.stored_len;
+}
+
+void EventLogWriter::flush() {
+   if(fp == NULL)
+      return;
+
+   for(int i = 0; i < EVLOG_NSEGS; i++)
+      seal(i);
+
+   pthread_mutex_lock(&mutex);
+   while(!queue.empty() || busy)
+      pthread_cond_wait(&idle, &mutex);
+   pthread_mutex_unlock(&mutex);
+
+   // The writer thread is idle until the next seal()
+   if(fflush(fp) != 0)
+      write_failed = true;
+}
+
+void EventLogWriter::close() {
+   if(fp == NULL)
+      return;
+
+   flush();
+
+   pthread_mutex_lock(&mutex);
+   stopping = true;
+   pthread_cond_signal(&work);
+   pthread_mutex_unlock(&mutex);
+   pthread_join(thread, NULL);
+   pthread_mutex_destroy(&mutex);
+   pthread_cond_destroy(&work);
+   pthread_cond_destroy(&idle);
+
+   // Block index, then the lock index, then the trailer that points
+   // at them
+   evlog_trailer_t trailer;
+   memset(&trailer, 0, sizeof(trailer));
+   trailer.index_offset = offset;
+   trailer.nblocks = index.size();
+   trailer.nrecords = nrecords;
+   memcpy(trailer.magic, EVLOG_TRAILER_MAGIC, sizeof(trailer.magic));
+
+   vector<evlog_lock_entry_t> locks;
+   vector<uint32_t> lock_block_list;
+   for(map<uint32_t, vector<uint32_t> >::iterator iter = lock_blocks.begin();
+       iter != lock_blocks.end(); iter++) {
+      evlog_lock_entry_t e;
+      e.lock = iter->first;
+      e.first = lock_block_list.size();
+      e.count = iter->second.size();
+      e.pad = 0;
+      locks.push_back(e);
+      lock_block_list.insert(lock_block_list.end(),
+                             iter->second.begin(), iter->second.end());
+   }
+   trailer.lock_offset = offset + index.size() * sizeof(evlog_index_entry_t);
+   trailer.nlocks = locks.size();
+
+   // A failed block write leaves the block numbers out of step with
+   // the index, so don't write indices that would mislead the reader
+   if(!write_failed) {
+      if((!index.empty()
+          && fwrite(&index[0], sizeof(index[0]), index.size(), fp)
+             != index.size())
+         || (!locks.empty()
+             && fwrite(&locks[0], sizeof(locks[0]), locks.size(), fp)
+                != locks.size())
+         || (!lock_block_list.empty()
+             && fwrite(&lock_block_list[0], sizeof(uint32_t),
+                       lock_block_list.size(), fp)
+                != lock_block_list.size())
+         || fwrite(&trailer, sizeof(trailer), 1, fp) != 1)
+         write_failed = true;
+   }
+   if(fclose(fp) != 0)
+      write_failed = true;
+   fp = NULL;
+   pthread_mutex_lock(&open_logs_mutex);
+   open_logs.erase(this);
+   pthread_mutex_unlock(&open_logs_mutex);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
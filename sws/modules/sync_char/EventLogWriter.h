@@ -0,0 +1,169 @@
+// SyncChar Project
+// File Name: EventLogWriter.h
+//
+// Description: Streaming writer for the binary event log (format in
+// EventLog.h).  Records are appended to in-memory columns; full
+// blocks are handed to a background thread that compresses and
+// writes them, so the simulation never waits on the disk.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef EVENTLOGWRITER_H
+#define EVENTLOGWRITER_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "EventLog.h"
+#include "WorkSet.h"
+
+using namespace std;
+
+// Counters from one lock at a stats dump, filled in by sync_char
+typedef struct _evlog_lock_stats_t {
+   uint32_t lock;
+   uint32_t generation;
+   uint32_t lock_id;
+   uint32_t workset_count;
+   uint32_t nacq;
+   uint32_t rsize;
+   uint32_t wsize;
+   uint32_t size;
+   uint64_t acquires;
+   uint64_t contended;
+   uint64_t useless_release;
+   uint64_t acq_cycles;
+   uint64_t hold_cycles;
+} evlog_lock_stats_t;
+
+// One bucket of a lock's timeline: [start, start + length) cycles
+typedef struct _evlog_timeline_t {
+   uint32_t lock;
+   uint32_t generation;
+   uint64_t start;
+   uint64_t length;
+   uint32_t acquires;
+   uint32_t contended;
+   uint64_t hold_cycles;
+   uint64_t max_wait;
+} evlog_timeline_t;
+
+class EventLogWriter {
+ public:
+   // Opens filename and starts the writer thread.  Check good().
+   EventLogWriter(const char *filename, int codec);
+   // Same as close()
+   ~EventLogWriter();
+
+   bool good() { return fp != NULL; }
+   const char *name() { return filename.c_str(); }
+
+   // Record producers.  ws_close also writes one contention record
+   // per workset that ws waited on.  A stats dump calls begin_stats()
+   // and then lock_stats() once per lock, and timeline() once per
+   // bucket of a lock's timeline.
+   void ws_close(WorkSet *ws, uint64_t cycle);
+   void begin_stats();
+   void lock_stats(const evlog_lock_stats_t &stats);
+   void timeline(const evlog_timeline_t &bucket);
+   void reset(uint64_t cycle);
+
+   // Hand all partial blocks to the writer thread and wait until they
+   // are on disk
+   void flush();
+   // flush(), then write the indices and stop the thread
+   void close();
+
+   // True once a write has failed; the log is incomplete
+   bool failed() { return write_failed; }
+
+   uint64_t records() { return nrecords; }
+   uint64_t raw_bytes() { return raw_total; }
+   uint64_t stored_bytes() { return stored_total; }
+   unsigned int blocks() { return nblocks; }
+   unsigned int max_queued() { return max_queue; }
+
+ private:
+   struct segment {
+      vector<char> cols[EVLOG_MAX_COLUMNS];
+      uint32_t nrecords;
+      uint32_t lock_min;
+      uint32_t lock_max;
+      uint64_t seq_first;
+      uint64_t seq_last;
+      size_t bytes;
+   };
+   struct pending {
+      evlog_block_header_t hdr;
+      vector<char> data;
+   };
+
+   uint64_t begin_record(int seg, uint32_t lock);
+   void end_record(int seg);
+   void seal(int seg);
+   void put32(int seg, int col, uint32_t v);
+   void put64(int seg, int col, uint64_t v);
+   void put(int seg, int col, const void *p, size_t len);
+
+   static void *thread_main(void *arg);
+   void write_block(pending *p);
+
+   string filename;
+   FILE *fp;
+   int codec;
+
+   segment segs[EVLOG_NSEGS];
+   uint64_t seq;
+   uint64_t nrecords;
+   uint32_t epoch;
+   uint32_t snapshot;
+
+   // Lock -> block numbers, kept by the simulation thread; block
+   // numbers are handed out in queue order, which is write order
+   map<uint32_t, vector<uint32_t> > lock_blocks;
+   unsigned int nblocks;
+
+   // ws_close scratch, kept to reuse its storage
+   vector<uint32_t> range_addrs;
+   vector<ByteRange> range_bmaps;
+
+   // Shared with the writer thread
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t work;       // queue became non-empty or stopping
+   pthread_cond_t idle;       // queue drained
+   deque<pending *> queue;
+   bool busy;
+   bool stopping;
+   unsigned int max_queue;
+
+   // Writer thread only (until it is joined)
+   vector<evlog_index_entry_t> index;
+   uint64_t offset;
+   uint64_t raw_total;
+   uint64_t stored_total;
+   bool write_failed;
+
+   // Not copyable
+   EventLogWriter(const EventLogWriter &);
+   EventLogWriter &operator=(const EventLogWriter &);
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
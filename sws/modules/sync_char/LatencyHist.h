@@ -0,0 +1,146 @@
+// SyncChar Project
+// File Name: LatencyHist.h
+//
+// Description: Fixed-size log-linear histogram of cycle counts, for
+// lock acquire and hold times.  Values below 16 get a bucket each;
+// above that every power of 2 is split into 8 buckets, so a value is
+// known to within 1/8 of itself up to 2^32 cycles.  Larger values
+// share the top bucket (max is still exact).  Recording is one bucket
+// increment, and histograms of the same lock's callers can be merged.
+// There is one of these per caller and lock, most of which never
+// record anything, so the buckets (under 1KB) are only allocated by
+// the first record.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef LATENCYHIST_H
+#define LATENCYHIST_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define LH_SUB_BITS   3
+#define LH_SUB        (1 << LH_SUB_BITS)
+#define LH_MAX_BITS   32
+// 2 * LH_SUB exact buckets, then LH_SUB for each power of 2 above
+#define LH_BUCKETS    (2 * LH_SUB + (LH_MAX_BITS - LH_SUB_BITS - 1) * LH_SUB)
+
+class LatencyHist {
+ public:
+   LatencyHist() : counts(NULL) { clear(); }
+   LatencyHist(const LatencyHist &other) : counts(NULL) { *this = other; }
+   ~LatencyHist() { delete[] counts; }
+
+   LatencyHist &operator=(const LatencyHist &other) {
+      if(this == &other)
+         return *this;
+      clear();
+      merge(other);
+      return *this;
+   }
+
+   void clear() {
+      delete[] counts;
+      counts = NULL;
+      cnt = 0;
+      total = 0;
+      vmax = 0;
+   }
+
+   void record(uint64_t v) {
+      alloc();
+      counts[bucket(v)]++;
+      cnt++;
+      total += v;
+      if(v > vmax)
+         vmax = v;
+   }
+
+   void merge(const LatencyHist &other) {
+      if(other.counts == NULL)
+         return;
+      alloc();
+      for(int i = 0; i < LH_BUCKETS; i++)
+         counts[i] += other.counts[i];
+      cnt += other.cnt;
+      total += other.total;
+      if(other.vmax > vmax)
+         vmax = other.vmax;
+   }
+
+   uint64_t count() const { return cnt; }
+   uint64_t sum() const { return total; }
+   uint64_t max() const { return vmax; }
+
+   // The smallest value that at least fraction p (0 to 1) of the
+   // recorded values are at or below, to bucket precision
+   uint64_t percentile(double p) const {
+      if(cnt == 0)
+         return 0;
+      uint64_t rank = (uint64_t)(p * cnt + 0.5);
+      if(rank < 1)
+         rank = 1;
+      uint64_t seen = 0;
+      for(int i = 0; i < LH_BUCKETS; i++) {
+         seen += counts[i];
+         if(seen >= rank) {
+            if(i == LH_BUCKETS - 1)
+               return vmax;
+            uint64_t top = bucket_high(i);
+            return top < vmax ? top : vmax;
+         }
+      }
+      return vmax;
+   }
+
+ private:
+   void alloc() {
+      if(counts == NULL) {
+         counts = new uint32_t[LH_BUCKETS];
+         memset(counts, 0, LH_BUCKETS * sizeof(uint32_t));
+      }
+   }
+
+   static int bucket(uint64_t v) {
+      if(v < 2 * LH_SUB)
+         return (int)v;
+      int e = 63 - __builtin_clzll(v);
+      if(e >= LH_MAX_BITS)
+         return LH_BUCKETS - 1;
+      int shift = e - LH_SUB_BITS;
+      return 2 * LH_SUB + (e - LH_SUB_BITS - 1) * LH_SUB
+         + (int)(v >> shift) - LH_SUB;
+   }
+
+   // Largest value that lands in bucket i
+   static uint64_t bucket_high(int i) {
+      if(i < 2 * LH_SUB)
+         return i;
+      int e = (i - 2 * LH_SUB) / LH_SUB + LH_SUB_BITS + 1;
+      uint64_t sub = (i - 2 * LH_SUB) % LH_SUB + LH_SUB;
+      int shift = e - LH_SUB_BITS;
+      return ((sub + 1) << shift) - 1;
+   }
+
+   uint64_t cnt;
+   uint64_t total;
+   uint64_t vmax;
+   // NULL until something is recorded
+   uint32_t *counts;
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
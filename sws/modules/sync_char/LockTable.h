@@ -0,0 +1,244 @@
+// SyncChar Project
+// File Name: LockTable.h
+//
+// Description: Table of lock records keyed by 32-bit lock address.
+// Lookups go through a flat, open-addressed index of (address,
+// handle) pairs with linear probing, so a miss or a hit costs one or
+// two cache lines instead of a bucket walk.  The records themselves
+// live in fixed-size chunks that are never moved, so a lock_handle_t
+// (or a pointer to the record) stays valid until that lock is
+// erased, no matter how many other locks are inserted.
+//
+// A small Bloom filter in front of the index answers "is this a lock
+// word at all?" for the memop path, where the answer is almost
+// always no.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef LOCKTABLE_H
+#define LOCKTABLE_H
+
+#include <vector>
+
+using namespace std;
+
+typedef unsigned int lock_handle_t;
+#define LOCK_HANDLE_NONE   ((lock_handle_t)0xffffffff)
+
+// Records per chunk, and the initial index size (both powers of 2)
+#define LOCK_CHUNK_ORDER   8
+#define LOCK_CHUNK_SIZE    (1 << LOCK_CHUNK_ORDER)
+#define LOCK_INDEX_MIN     64
+
+template <class T>
+class LockTable {
+ public:
+   // first/second so that iteration reads like a map
+   struct entry {
+      unsigned int first;
+      T second;
+      bool live;
+   };
+
+   class iterator {
+    public:
+      iterator() : table(NULL), h(0) {}
+      iterator(LockTable *t, lock_handle_t handle) : table(t), h(handle) {
+         skip();
+      }
+      entry &operator*() { return *table->slot_entry(h); }
+      entry *operator->() { return table->slot_entry(h); }
+      iterator &operator++() { h++; skip(); return *this; }
+      iterator operator++(int) { iterator old = *this; ++*this; return old; }
+      bool operator==(const iterator &o) const { return h == o.h; }
+      bool operator!=(const iterator &o) const { return h != o.h; }
+      lock_handle_t handle() const { return h; }
+    private:
+      void skip() {
+         while(h < table->nrecords && !table->slot_entry(h)->live)
+            h++;
+      }
+      LockTable *table;
+      lock_handle_t h;
+   };
+
+   LockTable() : nrecords(0), count(0) {
+      index_alloc(LOCK_INDEX_MIN);
+   }
+   ~LockTable() {
+      for(unsigned int i = 0; i < chunks.size(); i++)
+         delete [] chunks[i];
+   }
+
+   // Handle of the lock at addr, or LOCK_HANDLE_NONE
+   lock_handle_t find(unsigned int addr) const {
+      for(unsigned int i = home(addr); ; i = (i + 1) & mask) {
+         if(index[i].handle == LOCK_HANDLE_NONE)
+            return LOCK_HANDLE_NONE;
+         if(index[i].addr == addr)
+            return index[i].handle;
+      }
+   }
+
+   // Whether addr is a lock.  Most misses never touch the index.
+   bool contains(unsigned int addr) const {
+      unsigned int h = addr * 2654435761U;
+      unsigned int b1 = h >> filter_shift;
+      unsigned int b2 = (h * 0x85ebca6bU) >> filter_shift;
+      if(!(filter[b1 >> 5] & (1U << (b1 & 31)))
+         || !(filter[b2 >> 5] & (1U << (b2 & 31))))
+         return false;
+      return find(addr) != LOCK_HANDLE_NONE;
+   }
+
+   // Record of the lock at addr, or NULL
+   T *lookup(unsigned int addr) {
+      lock_handle_t h = find(addr);
+      return h == LOCK_HANDLE_NONE ? NULL : &slot_entry(h)->second;
+   }
+
+   // Handle of the lock at addr, adding a default-constructed record
+   // if there isn't one yet
+   lock_handle_t insert(unsigned int addr) {
+      lock_handle_t h = find(addr);
+      if(h != LOCK_HANDLE_NONE)
+         return h;
+
+      if((count + 1) * 2 > index.size())
+         index_alloc(index.size() * 2);
+
+      if(!free_handles.empty()) {
+         h = free_handles.back();
+         free_handles.pop_back();
+      } else {
+         if((nrecords & (LOCK_CHUNK_SIZE - 1)) == 0)
+            chunks.push_back(new entry[LOCK_CHUNK_SIZE]);
+         h = nrecords++;
+      }
+      entry *e = slot_entry(h);
+      e->first = addr;
+      e->live = true;
+      index_put(addr, h);
+      count++;
+      return h;
+   }
+
+   // Drop the lock; its record is reset and the handle may be reused.
+   // Its filter bits stay set until the next resize.
+   void erase(lock_handle_t h) {
+      entry *e = slot_entry(h);
+      unsigned int i = home(e->first);
+      while(index[i].handle != h)
+         i = (i + 1) & mask;
+
+      // Backward-shift deletion: pull later members of the probe run
+      // into the hole so find() never needs tombstones
+      for(unsigned int j = i; ; ) {
+         j = (j + 1) & mask;
+         if(index[j].handle == LOCK_HANDLE_NONE)
+            break;
+         unsigned int k = home(index[j].addr);
+         if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+         index[i] = index[j];
+         i = j;
+      }
+      index[i].handle = LOCK_HANDLE_NONE;
+
+      e->second = T();
+      e->live = false;
+      free_handles.push_back(h);
+      count--;
+   }
+
+   T *get(lock_handle_t h) { return &slot_entry(h)->second; }
+   unsigned int addr(lock_handle_t h) { return slot_entry(h)->first; }
+
+   iterator begin() { return iterator(this, 0); }
+   iterator end() { return iterator(this, nrecords); }
+   unsigned int size() const { return count; }
+   bool empty() const { return count == 0; }
+
+ private:
+   struct index_slot {
+      unsigned int addr;
+      lock_handle_t handle;
+   };
+
+   // Lock addresses are word aligned; a multiplicative hash keeps the
+   // high bits, which is where the entropy ends up
+   unsigned int home(unsigned int addr) const {
+      return (addr * 2654435761U) >> shift;
+   }
+
+   entry *slot_entry(lock_handle_t h) {
+      return &chunks[h >> LOCK_CHUNK_ORDER][h & (LOCK_CHUNK_SIZE - 1)];
+   }
+
+   void index_put(unsigned int addr, lock_handle_t h) {
+      unsigned int i = home(addr);
+      while(index[i].handle != LOCK_HANDLE_NONE)
+         i = (i + 1) & mask;
+      index[i].addr = addr;
+      index[i].handle = h;
+      filter_put(addr);
+   }
+
+   void filter_put(unsigned int addr) {
+      unsigned int h = addr * 2654435761U;
+      unsigned int b1 = h >> filter_shift;
+      unsigned int b2 = (h * 0x85ebca6bU) >> filter_shift;
+      filter[b1 >> 5] |= 1U << (b1 & 31);
+      filter[b2 >> 5] |= 1U << (b2 & 31);
+   }
+
+   void index_alloc(unsigned int size) {
+      index_slot empty_slot = { 0, LOCK_HANDLE_NONE };
+      index.assign(size, empty_slot);
+      mask = size - 1;
+      shift = 32;
+      for(unsigned int s = size; s > 1; s >>= 1)
+         shift--;
+
+      // 8 filter bits per index slot, so at least 16 per lock
+      filter.assign(size / 4, 0);
+      filter_shift = shift - 3;
+      for(lock_handle_t h = 0; h < nrecords; h++) {
+         entry *e = slot_entry(h);
+         if(e->live)
+            index_put(e->first, h);
+      }
+   }
+
+   vector<index_slot> index;
+   unsigned int mask;
+   unsigned int shift;
+
+   vector<unsigned int> filter;
+   unsigned int filter_shift;
+
+   vector<entry *> chunks;
+   vector<lock_handle_t> free_handles;
+   unsigned int nrecords;
+   unsigned int count;
+
+   // Not copyable: handles point into this table
+   LockTable(const LockTable &);
+   LockTable &operator=(const LockTable &);
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
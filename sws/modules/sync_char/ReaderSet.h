@@ -0,0 +1,130 @@
+// SyncChar Project
+// File Name: ReaderSet.h
+//
+// Description: The pids holding a reader lock, each with the number
+// of times it has acquired it.  There are rarely more than a few at
+// once, so they are kept in a small array inside the lock record and
+// only spill to a hash table when there are more than
+// READER_SET_INLINE.  Lookups scan the array.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef READERSET_H
+#define READERSET_H
+
+#include <vector>
+#include <tr1/unordered_map>
+
+using namespace std;
+using namespace std::tr1;
+
+#define READER_SET_INLINE  4
+
+template <class K>
+class ReaderSet {
+ public:
+   ReaderSet() : n(0), spill(NULL) { }
+   ReaderSet(const ReaderSet &other) : n(0), spill(NULL) { *this = other; }
+   ~ReaderSet() { delete spill; }
+
+   ReaderSet &operator=(const ReaderSet &other) {
+      if(this == &other)
+         return *this;
+      clear();
+      n = other.n;
+      for(unsigned int i = 0; i < n; i++)
+         inline_[i] = other.inline_[i];
+      if(other.spill)
+         spill = new spill_map_t(*other.spill);
+      return *this;
+   }
+
+   bool empty() const { return size() == 0; }
+   unsigned int size() const { return spill ? spill->size() : n; }
+
+   void clear() {
+      delete spill;
+      spill = NULL;
+      n = 0;
+   }
+
+   // The reader's acquire count, or NULL if it is not a reader
+   int *find(K key) {
+      if(spill) {
+         typename spill_map_t::iterator it = spill->find(key);
+         return it == spill->end() ? NULL : &it->second;
+      }
+      for(unsigned int i = 0; i < n; i++)
+         if(inline_[i].first == key)
+            return &inline_[i].second;
+      return NULL;
+   }
+
+   // key must not be a reader already
+   void insert(K key, int count) {
+      if(spill) {
+         (*spill)[key] = count;
+         return;
+      }
+      if(n < READER_SET_INLINE) {
+         inline_[n++] = make_pair(key, count);
+         return;
+      }
+      spill = new spill_map_t(inline_, inline_ + n);
+      (*spill)[key] = count;
+      n = 0;
+   }
+
+   void erase(K key) {
+      if(spill) {
+         spill->erase(key);
+         if(spill->empty()) {
+            delete spill;
+            spill = NULL;
+         }
+         return;
+      }
+      for(unsigned int i = 0; i < n; i++) {
+         if(inline_[i].first == key) {
+            inline_[i] = inline_[--n];
+            return;
+         }
+      }
+   }
+
+   void keys(vector<K> &out) const {
+      out.clear();
+      if(spill) {
+         for(typename spill_map_t::const_iterator it = spill->begin();
+             it != spill->end(); it++)
+            out.push_back(it->first);
+         return;
+      }
+      for(unsigned int i = 0; i < n; i++)
+         out.push_back(inline_[i].first);
+   }
+
+ private:
+   typedef unordered_map<K, int> spill_map_t;
+
+   pair<K, int> inline_[READER_SET_INLINE];
+   unsigned int n;
+   // All the readers, once there have been too many for inline_
+   spill_map_t *spill;
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
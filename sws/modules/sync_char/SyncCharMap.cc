@@ -0,0 +1,312 @@
+// SyncChar Project
+// File Name: SyncCharMap.cc
+//
+// Description: sync_char.map compiler and mmap loader
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include "SyncCharMap.h"
+
+SyncCharMap::SyncCharMap()
+   : from_text(false), was_compiled(false), data(NULL), len(0),
+     mapped(false), hdr(NULL), ras(NULL), locks(NULL), labels(NULL) {
+}
+
+SyncCharMap::~SyncCharMap() {
+   if(mapped)
+      munmap((void *)data, len);
+}
+
+static bool ra_before(const scmap_ra_t &a, const scmap_ra_t &b) {
+   return a.ra < b.ra;
+}
+
+// Same records as the old line parser: anything that is not a full
+// ra record is tried as a lock definition
+bool SyncCharMap::compile(const char *text, vector<char> &out,
+                          vector<string> &bad, string &err) {
+   FILE *f = fopen(text, "r");
+   if(f == NULL) {
+      err = string("can't open ") + text + ": " + strerror(errno);
+      return false;
+   }
+
+   vector<scmap_ra_t> ras;
+   vector<scmap_lock_t> locks;
+   string pool;
+   map<string, uint32_t> interned;
+
+   char buf[256];
+   char label[256];
+   char lock_reg[4];
+   unsigned int lock_ra, lock_off, lock_id, flags, func_pc;
+   while(!feof(f)) {
+      int matched;
+      buf[0] = 0;
+      if(fgets(buf, 256, f) == NULL)
+         break;
+      // sscanf might not clear these values if it has a blank line
+      lock_ra = lock_off = lock_id = flags = func_pc = 0;
+      lock_reg[0] = 0;
+      label[0] = 0;
+      matched = sscanf(buf, "%x %x %3s %d %x %x %255s",
+                       &lock_ra, &lock_off, &lock_reg[0],
+                       &lock_id, &flags, &func_pc, &label[0]);
+      bool is_ra = true;
+      unsigned int lock_addr = 0;
+      int lock_val = 0;
+      if(matched != 7 && buf[0] != 0) {
+         is_ra = false;
+         matched = sscanf(buf, "%x %d %d %255s",
+                          &lock_addr, &lock_id, &lock_val, &label[0]);
+         if(matched != 4) {
+            bad.push_back(buf);
+            continue;
+         }
+      }
+
+      map<string, uint32_t>::iterator it = interned.find(label);
+      if(it == interned.end()) {
+         it = interned.insert(make_pair(string(label),
+                                        (uint32_t)pool.size())).first;
+         pool.append(label, strlen(label) + 1);
+      }
+
+      if(is_ra) {
+         scmap_ra_t r;
+         memset(&r, 0, sizeof(r));
+         r.ra = lock_ra;
+         r.lock_off = lock_off;
+         r.lock_id = lock_id;
+         r.flags = flags;
+         r.func_pc = func_pc;
+         r.label = it->second;
+         memcpy(r.lock_reg, lock_reg, sizeof(r.lock_reg));
+         ras.push_back(r);
+      } else {
+         scmap_lock_t l;
+         l.addr = lock_addr;
+         l.lock_id = lock_id;
+         l.value = lock_val;
+         l.label = it->second;
+         locks.push_back(l);
+      }
+   }
+   fclose(f);
+
+   // Stable, so that a repeated ra keeps its file order
+   stable_sort(ras.begin(), ras.end(), ra_before);
+
+   scmap_header_t h;
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, SCMAP_MAGIC, sizeof(h.magic));
+   h.version = SCMAP_VERSION;
+   h.nras = ras.size();
+   h.nlocks = locks.size();
+   h.labels_len = pool.size();
+   string bad_pool;
+   for(unsigned int i = 0; i < bad.size(); i++)
+      bad_pool.append(bad[i].c_str(), bad[i].size() + 1);
+   h.nbad = bad.size();
+   h.bad_len = bad_pool.size();
+
+   size_t ras_len = ras.size() * sizeof(scmap_ra_t);
+   size_t locks_len = locks.size() * sizeof(scmap_lock_t);
+   out.resize(sizeof(h) + ras_len + locks_len + pool.size()
+              + bad_pool.size());
+   char *p = &out[0];
+   memcpy(p, &h, sizeof(h));
+   p += sizeof(h);
+   if(ras_len)
+      memcpy(p, &ras[0], ras_len);
+   p += ras_len;
+   if(locks_len)
+      memcpy(p, &locks[0], locks_len);
+   p += locks_len;
+   if(pool.size())
+      memcpy(p, pool.data(), pool.size());
+   p += pool.size();
+   if(bad_pool.size())
+      memcpy(p, bad_pool.data(), bad_pool.size());
+   return true;
+}
+
+// Point the sections into [p, p + n), after checking that they fit
+bool SyncCharMap::attach(const char *p, uint64_t n, string &err) {
+   const scmap_header_t *h = (const scmap_header_t *)p;
+   if(n < sizeof(*h) || memcmp(h->magic, SCMAP_MAGIC, sizeof(h->magic)) != 0
+      || h->version != SCMAP_VERSION) {
+      err = file + " is not a compiled map, or is from another version";
+      return false;
+   }
+   uint64_t labels_end = sizeof(*h)
+      + (uint64_t)h->nras * sizeof(scmap_ra_t)
+      + (uint64_t)h->nlocks * sizeof(scmap_lock_t) + h->labels_len;
+   uint64_t need = labels_end + h->bad_len;
+   if(n < need || (h->labels_len && p[labels_end - 1] != 0)
+      || (h->bad_len && p[need - 1] != 0)) {
+      err = file + " is truncated";
+      return false;
+   }
+
+   const scmap_ra_t *r = (const scmap_ra_t *)(p + sizeof(*h));
+   const scmap_lock_t *l = (const scmap_lock_t *)(r + h->nras);
+   for(uint32_t i = 0; i < h->nras; i++) {
+      if(r[i].label >= h->labels_len) {
+         err = file + " has a bad label";
+         return false;
+      }
+   }
+   for(uint32_t i = 0; i < h->nlocks; i++) {
+      if(l[i].label >= h->labels_len) {
+         err = file + " has a bad label";
+         return false;
+      }
+   }
+
+   // The bad lines, unless compile() already left them in bad
+   if(bad.empty()) {
+      const char *b = p + labels_end;
+      for(uint32_t i = 0; i < h->nbad && b < p + need; i++) {
+         bad.push_back(b);
+         b += strlen(b) + 1;
+      }
+   }
+
+   data = p;
+   len = n;
+   hdr = h;
+   ras = r;
+   locks = l;
+   labels = (const char *)(l + h->nlocks);
+   return true;
+}
+
+bool SyncCharMap::map_file(const char *bin, string &err) {
+   int fd = open(bin, O_RDONLY);
+   if(fd < 0) {
+      err = string("can't open ") + bin + ": " + strerror(errno);
+      return false;
+   }
+   struct stat st;
+   if(fstat(fd, &st) != 0 || st.st_size == 0) {
+      err = string(bin) + " is empty";
+      close(fd);
+      return false;
+   }
+   void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if(p == MAP_FAILED) {
+      err = string("can't mmap ") + bin + ": " + strerror(errno);
+      return false;
+   }
+   if(!attach((const char *)p, st.st_size, err)) {
+      munmap(p, st.st_size);
+      return false;
+   }
+   mapped = true;
+   return true;
+}
+
+bool SyncCharMap::stale() const {
+   if(!from_text)
+      return false;
+   struct stat st;
+   return stat(file.c_str(), &st) != 0
+      || hdr->src_size != (uint64_t)st.st_size
+      || hdr->src_mtime != (uint64_t)st.st_mtime;
+}
+
+SyncCharMap *SyncCharMap::load(const char *path, string &err) {
+   struct stat st;
+   if(stat(path, &st) != 0) {
+      err = string("can't open ") + path + ": " + strerror(errno);
+      return NULL;
+   }
+
+   SyncCharMap *m = new SyncCharMap();
+   m->file = path;
+
+   // Already compiled?
+   char magic[sizeof(((scmap_header_t *)0)->magic)];
+   FILE *f = fopen(path, "r");
+   bool is_bin = f != NULL && fread(magic, sizeof(magic), 1, f) == 1
+      && memcmp(magic, SCMAP_MAGIC, sizeof(magic)) == 0;
+   if(f != NULL)
+      fclose(f);
+   if(is_bin) {
+      if(m->map_file(path, err))
+         return m;
+      delete m;
+      return NULL;
+   }
+
+   // An up to date compiled copy next to the text
+   m->from_text = true;
+   string bin = string(path) + SCMAP_SUFFIX;
+   string ignored;
+   if(m->map_file(bin.c_str(), ignored)) {
+      if(m->hdr->src_size == (uint64_t)st.st_size
+         && m->hdr->src_mtime == (uint64_t)st.st_mtime)
+         return m;
+      munmap((void *)m->data, m->len);
+      m->mapped = false;
+      m->bad.clear();
+   }
+
+   vector<char> out;
+   if(!compile(path, out, m->bad, err)) {
+      delete m;
+      return NULL;
+   }
+   m->was_compiled = true;
+   scmap_header_t *h = (scmap_header_t *)&out[0];
+   h->src_size = st.st_size;
+   h->src_mtime = st.st_mtime;
+
+   // Write it through a temporary, so that a concurrent load never
+   // maps half a file
+   ostringstream tmp;
+   tmp << bin << "." << getpid();
+   FILE *bf = fopen(tmp.str().c_str(), "w");
+   bool written = bf != NULL
+      && fwrite(&out[0], out.size(), 1, bf) == 1;
+   if(bf != NULL && fclose(bf) != 0)
+      written = false;
+   if(written && rename(tmp.str().c_str(), bin.c_str()) == 0
+      && m->map_file(bin.c_str(), ignored))
+      return m;
+   unlink(tmp.str().c_str());
+
+   // Can't write next to the text map; keep it in memory
+   m->buf.swap(out);
+   if(!m->attach(&m->buf[0], m->buf.size(), err)) {
+      delete m;
+      return NULL;
+   }
+   return m;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -0,0 +1,127 @@
+// SyncChar Project
+// File Name: SyncCharMap.h
+//
+// Description: Compiled form of sync_char.map.  The text map is
+// parsed once into a binary file next to it (sync_char.map.bin): a
+// header, the ra records sorted by ra, the lock definitions in file
+// order, a pool of interned, NUL-terminated labels, then the lines
+// that were neither kind of record, each NUL-terminated, so that a
+// load of the compiled map reports them like a parse would.  Later loads
+// mmap the binary if it is newer than the text, so every process
+// that loads the same map shares one parse and one copy of the
+// labels.  No simulator code, like EventLog.cc.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef SYNCCHARMAP_H
+#define SYNCCHARMAP_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define SCMAP_MAGIC    "SCMAPBIN"
+#define SCMAP_VERSION  1
+#define SCMAP_SUFFIX   ".bin"
+
+typedef struct _scmap_header_t {
+   char     magic[8];
+   uint32_t version;
+   uint32_t nras;
+   uint32_t nlocks;
+   uint32_t labels_len;
+   uint32_t nbad;
+   uint32_t bad_len;
+   // The text map this was compiled from
+   uint64_t src_size;
+   uint64_t src_mtime;
+} scmap_header_t;
+
+// A lock instruction: "ra off reg lock_id flags func_pc label"
+typedef struct _scmap_ra_t {
+   uint32_t ra;
+   uint32_t lock_off;
+   uint32_t lock_id;
+   uint32_t flags;
+   uint32_t func_pc;
+   uint32_t label;         // offset in the label pool
+   char     lock_reg[4];   // register name, "nil" for none
+} scmap_ra_t;
+
+// A statically defined lock: "addr lock_id value label"
+typedef struct _scmap_lock_t {
+   uint32_t addr;
+   uint32_t lock_id;
+   int32_t  value;
+   uint32_t label;
+} scmap_lock_t;
+
+class SyncCharMap {
+ public:
+   // Load path, which may be a text map or a compiled one.  A text
+   // map is compiled to path.bin, unless that is up to date; if it
+   // can't be written, the compiled map is kept in memory.  NULL on
+   // failure, with the reason in err.
+   static SyncCharMap *load(const char *path, string &err);
+   ~SyncCharMap();
+
+   const char *path() const { return file.c_str(); }
+   // True if the map was parsed on this load
+   bool compiled() const { return was_compiled; }
+   // True if it was loaded from a text map that has changed since
+   bool stale() const;
+   // Lines of the text map that were neither kind of record, whether
+   // it was parsed on this load or not
+   const vector<string> &bad_records() const { return bad; }
+
+   uint32_t nras() const { return hdr->nras; }
+   const scmap_ra_t &ra(uint32_t i) const { return ras[i]; }
+   uint32_t nlocks() const { return hdr->nlocks; }
+   const scmap_lock_t &lock(uint32_t i) const { return locks[i]; }
+   const char *label(uint32_t off) const { return labels + off; }
+
+ private:
+   SyncCharMap();
+   bool attach(const char *p, uint64_t n, string &err);
+   bool map_file(const char *bin, string &err);
+   static bool compile(const char *text, vector<char> &out,
+                       vector<string> &bad, string &err);
+
+   string file;
+   bool from_text;
+   bool was_compiled;
+   vector<string> bad;
+
+   // Either mmapped or in buf
+   const char *data;
+   uint64_t len;
+   bool mapped;
+   vector<char> buf;
+
+   const scmap_header_t *hdr;
+   const scmap_ra_t *ras;
+   const scmap_lock_t *locks;
+   const char *labels;
+
+   // Not copyable
+   SyncCharMap(const SyncCharMap &);
+   SyncCharMap &operator=(const SyncCharMap &);
+};
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -1,31 +1,222 @@
 // SyncChar Project
 // File Name: WorkSet.cc
 //
-// Description: 
+// Description:
 //
 // Operating Systems & Architecture Group
 // University of Texas at Austin - Department of Computer Sciences
 // Copyright 2006, 2007. All Rights Reserved.
 // See LICENSE file for license terms.
 
+#include <algorithm>
+#include <stddef.h>
 #include "WorkSet.h"
 
-// counts the number of bits set
-// x &= x - 1 clears the least significant set bit,
-// so the loop executes the number of times there
-// are set bits
-inline int population(set_chunk x) {
-   unsigned int pop = 0;
-   for(pop = 0; x;  pop++)
-      x &= x - 1;
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+// Initial number of block slots; grown by doubling at half full
+#define WS_MIN_CAPACITY    4
+#define WS_NO_BLOCK        0xffffffff
+
+// Without -mpopcnt, __builtin_popcountll is a library call
+static inline int popcount64(uint64_t x) {
+#ifdef __POPCNT__
+   return __builtin_popcountll(x);
+#else
+   x = x - ((x >> 1) & 0x5555555555555555ULL);
+   x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+   x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+   return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/*
+ * Population count kernels.  Each one sweeps n blocks' worth of
+ * words and returns the number of set bits in f(words), for the
+ * combinations size(), rsize(), wsize() and compare() need.  With
+ * -mavx2 or -mssse3 they use the nibble-lookup popcount on whole
+ * vectors; otherwise a scalar loop.
+ */
+
+#if defined(__AVX2__)
+
+static inline __m256i popcount256(__m256i v) {
+   const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                        1, 2, 2, 3, 2, 3, 3, 4,
+                                        0, 1, 1, 2, 1, 2, 2, 3,
+                                        1, 2, 2, 3, 2, 3, 3, 4);
+   const __m256i low = _mm256_set1_epi8(0x0f);
+   __m256i lo = _mm256_and_si256(v, low);
+   __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+   __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo),
+                                 _mm256_shuffle_epi8(lut, hi));
+   return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+static inline int hsum256(__m256i acc) {
+   uint64_t t[4];
+   _mm256_storeu_si256((__m256i *)t, acc);
+   return (int)(t[0] + t[1] + t[2] + t[3]);
+}
+
+#define LOAD(p)   _mm256_loadu_si256((const __m256i *)(p))
+
+// WS_BLOCK_WORDS is 4, so each block half is exactly one vector
+static int pop_r(const char *b, size_t stride, unsigned int n, size_t off) {
+   __m256i acc = _mm256_setzero_si256();
+   for(unsigned int i = 0; i < n; i++, b += stride)
+      acc = _mm256_add_epi64(acc, popcount256(LOAD(b + off)));
+   return hsum256(acc);
+}
+
+static int pop_rw(const char *b, size_t stride, unsigned int n,
+                  size_t roff, size_t woff) {
+   __m256i acc = _mm256_setzero_si256();
+   for(unsigned int i = 0; i < n; i++, b += stride)
+      acc = _mm256_add_epi64(acc, popcount256(
+                                _mm256_or_si256(LOAD(b + roff), LOAD(b + woff))));
+   return hsum256(acc);
+}
+
+static inline int pop_conflict(const uint64_t *r1, const uint64_t *w1,
+                               const uint64_t *r2, const uint64_t *w2) {
+   __m256i vr1 = LOAD(r1), vw1 = LOAD(w1), vr2 = LOAD(r2), vw2 = LOAD(w2);
+   // RAW, WAR, and WAW hazards
+   __m256i d = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(vr1, vw2),
+                                               _mm256_and_si256(vr2, vw1)),
+                               _mm256_and_si256(vw1, vw2));
+   return hsum256(popcount256(d));
+}
+
+#undef LOAD
+
+#elif defined(__SSSE3__)
+
+static inline __m128i popcount128(__m128i v) {
+   const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                     1, 2, 2, 3, 2, 3, 3, 4);
+   const __m128i low = _mm_set1_epi8(0x0f);
+   __m128i lo = _mm_and_si128(v, low);
+   __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+   __m128i cnt = _mm_add_epi8(_mm_shuffle_epi8(lut, lo),
+                              _mm_shuffle_epi8(lut, hi));
+   return _mm_sad_epu8(cnt, _mm_setzero_si128());
+}
+
+static inline int hsum128(__m128i acc) {
+   uint64_t t[2];
+   _mm_storeu_si128((__m128i *)t, acc);
+   return (int)(t[0] + t[1]);
+}
+
+#define LOAD(p)   _mm_loadu_si128((const __m128i *)(p))
+
+static int pop_r(const char *b, size_t stride, unsigned int n, size_t off) {
+   __m128i acc = _mm_setzero_si128();
+   for(unsigned int i = 0; i < n; i++, b += stride)
+      for(unsigned int j = 0; j < WS_BLOCK_WORDS * 8; j += 16)
+         acc = _mm_add_epi64(acc, popcount128(LOAD(b + off + j)));
+   return hsum128(acc);
+}
+
+static int pop_rw(const char *b, size_t stride, unsigned int n,
+                  size_t roff, size_t woff) {
+   __m128i acc = _mm_setzero_si128();
+   for(unsigned int i = 0; i < n; i++, b += stride)
+      for(unsigned int j = 0; j < WS_BLOCK_WORDS * 8; j += 16)
+         acc = _mm_add_epi64(acc, popcount128(
+                                _mm_or_si128(LOAD(b + roff + j),
+                                             LOAD(b + woff + j))));
+   return hsum128(acc);
+}
+
+static inline int pop_conflict(const uint64_t *r1, const uint64_t *w1,
+                               const uint64_t *r2, const uint64_t *w2) {
+   __m128i acc = _mm_setzero_si128();
+   for(unsigned int j = 0; j < WS_BLOCK_WORDS; j += 2) {
+      __m128i vr1 = LOAD(r1 + j), vw1 = LOAD(w1 + j);
+      __m128i vr2 = LOAD(r2 + j), vw2 = LOAD(w2 + j);
+      // RAW, WAR, and WAW hazards
+      __m128i d = _mm_or_si128(_mm_or_si128(_mm_and_si128(vr1, vw2),
+                                            _mm_and_si128(vr2, vw1)),
+                               _mm_and_si128(vw1, vw2));
+      acc = _mm_add_epi64(acc, popcount128(d));
+   }
+   return hsum128(acc);
+}
+
+#undef LOAD
+
+#else
+
+static int pop_r(const char *b, size_t stride, unsigned int n, size_t off) {
+   int pop = 0;
+   for(unsigned int i = 0; i < n; i++, b += stride) {
+      const uint64_t *r = (const uint64_t *)(b + off);
+      for(unsigned int j = 0; j < WS_BLOCK_WORDS; j++)
+         pop += popcount64(r[j]);
+   }
    return pop;
 }
 
+static int pop_rw(const char *b, size_t stride, unsigned int n,
+                  size_t roff, size_t woff) {
+   int pop = 0;
+   for(unsigned int i = 0; i < n; i++, b += stride) {
+      const uint64_t *r = (const uint64_t *)(b + roff);
+      const uint64_t *w = (const uint64_t *)(b + woff);
+      for(unsigned int j = 0; j < WS_BLOCK_WORDS; j++)
+         pop += popcount64(r[j] | w[j]);
+   }
+   return pop;
+}
+
+static inline int pop_conflict(const uint64_t *r1, const uint64_t *w1,
+                               const uint64_t *r2, const uint64_t *w2) {
+   int pop = 0;
+   for(unsigned int j = 0; j < WS_BLOCK_WORDS; j++)
+      // RAW, WAR, and WAW hazards
+      pop += popcount64((r1[j] & w2[j]) | (r2[j] & w1[j]) | (w1[j] & w2[j]));
+   return pop;
+}
+
+#endif
+
+// Set bits [lo, hi) of a block's read or write words
+static inline void set_bits(uint64_t *words, unsigned int lo, unsigned int hi) {
+   unsigned int first = lo >> 6, last = (hi - 1) >> 6;
+   for(unsigned int i = first; i <= last; i++) {
+      uint64_t mask = ~0ULL;
+      if(i == first)
+         mask &= ~0ULL << (lo & 63);
+      if(i == last && (hi & 63))
+         mask &= ~(~0ULL << (hi & 63));
+      words[i] |= mask;
+   }
+}
+
+// Reverse the low 16 bits and spread them to the even bit positions:
+// the set_chunk layout puts the first byte of a chunk in the top pair
+static inline set_chunk legacy_spread(unsigned int x) {
+   x = ((x >> 1) & 0x5555) | ((x & 0x5555) << 1);
+   x = ((x >> 2) & 0x3333) | ((x & 0x3333) << 2);
+   x = ((x >> 4) & 0x0f0f) | ((x & 0x0f0f) << 4);
+   x = ((x >> 8) & 0x00ff) | ((x & 0x00ff) << 8);
+   x = (x | (x << 8)) & 0x00ff00ff;
+   x = (x | (x << 4)) & 0x0f0f0f0f;
+   x = (x | (x << 2)) & 0x33333333;
+   x = (x | (x << 1)) & 0x55555555;
+   return x;
+}
+
 WorkSet::WorkSet(unsigned int lk_addr, spid_t pd,
-		 unsigned int lk_generation, 
+		 unsigned int lk_generation,
 		 unsigned int ws_index, int cpu) {
    cnt = 0;
    IO = 0;
+   sampled = 1;
    pid = pd;
    old_pid = pd;
    twoowners = 0;
@@ -33,209 +224,186 @@ WorkSet::WorkSet(unsigned int lk_addr, spid_t pd,
    if(ws_index == 0xfffffffe){
      cout << "XXX: Almost out of workset indices\n";
    }
-   id = WorksetID(lk_addr, lk_generation, ws_index);  
+   id = WorksetID(lk_addr, lk_generation, ws_index);
    this->cpu = cpu;
 
+   // Most worksets stay empty; allocate on the first grow
+   slots = NULL;
+   capacity = 0;
+   nranges = 0;
+}
+
+WorkSet::~WorkSet() {
+   delete [] slots;
+}
+
+unsigned int WorkSet::home(osa_logical_address_t base) {
+   unsigned int key = (unsigned int)(base >> WS_BLOCK_ORDER)
+      ^ (unsigned int)((uint64_t)base >> 32);
+   return (key * 2654435761U) & (capacity - 1);
+}
+
+WorkSet::block *WorkSet::find_block(osa_logical_address_t base) {
+   if(capacity == 0)
+      return NULL;
+   for(unsigned int i = home(base); ; i = (i + 1) & (capacity - 1)) {
+      if(slots[i].index == WS_NO_BLOCK)
+         return NULL;
+      if(slots[i].base == base)
+         return &blocks[slots[i].index];
+   }
+}
+
+// Find or add the block at base.  The pointer is good until the
+// next get_block.
+WorkSet::block *WorkSet::get_block(osa_logical_address_t base) {
+   block *b = find_block(base);
+   if(b)
+      return b;
+
+   if((blocks.size() + 1) * 2 > capacity)
+      rehash(capacity ? capacity * 2 : WS_MIN_CAPACITY);
+
+   unsigned int i = home(base);
+   while(slots[i].index != WS_NO_BLOCK)
+      i = (i + 1) & (capacity - 1);
+   slots[i].base = base;
+   slots[i].index = blocks.size();
+
+   blocks.push_back(block());
+   b = &blocks.back();
+   b->base = base;
+   return b;
+}
+
+void WorkSet::rehash(unsigned int new_capacity) {
+   delete [] slots;
+   slots = new slot[new_capacity];
+   capacity = new_capacity;
+   for(unsigned int i = 0; i < capacity; i++)
+      slots[i].index = WS_NO_BLOCK;
+
+   for(unsigned int j = 0; j < blocks.size(); j++) {
+      unsigned int i = home(blocks[j].base);
+      while(slots[i].index != WS_NO_BLOCK)
+         i = (i + 1) & (capacity - 1);
+      slots[i].base = blocks[j].base;
+      slots[i].index = j;
+   }
+}
+
+void WorkSet::sorted_blocks(vector<block *> &out) {
+   // Sort (base, block) pairs so the comparisons stay in one array
+   // instead of chasing into the blocks
+   vector<pair<osa_logical_address_t, block *> > keys(blocks.size());
+   for(unsigned int i = 0; i < blocks.size(); i++)
+      keys[i] = make_pair(blocks[i].base, &blocks[i]);
+   sort(keys.begin(), keys.end());
+
+   out.resize(keys.size());
+   for(unsigned int i = 0; i < keys.size(); i++)
+      out[i] = keys[i].second;
 }
 
 void WorkSet::grow(osa_logical_address_t addr, int len, osa_memop_basic_type_t type) {
    osa_logical_address_t cur = addr;
    osa_logical_address_t end = addr+len;
    while(cur < end) {
-      // get the extents of the byterange we want
-      osa_logical_address_t range_start = cur & RANGE_MASK;
+      // get the extents of the block we want
+      osa_logical_address_t base = cur & WS_BLOCK_MASK;
+      osa_logical_address_t stop = base + WS_BLOCK_BYTES;
+      if(end < stop)
+         stop = end;
+      unsigned int lo = cur - base;
+      unsigned int hi = stop - base;
+
+      block *b = get_block(base);
+
+      // Note which SET_GRANULARITY ranges this covers
+      unsigned int ranges = (2U << ((hi - 1) >> SET_ORDER))
+         - (1U << (lo >> SET_ORDER));
+      nranges += popcount64(ranges & ~b->touched);
+      b->touched |= ranges;
 
-      // look up the corresponding map, put in a blank if not found
-      ByteRange range;
-      set_it range_it = set.find(range_start);
-      if(range_it == set.end()) {
-         memset(&range, 0, sizeof(ByteRange));
-         pair<set_it, bool> inserted =
-            set.insert(make_pair(range_start, range)); 
-         range_it = inserted.first;
-      }
-      else {
-         range = range_it->second;
-      }
-
-      // make a chunk with all reads or writes set
-      set_chunk full_chunk;
       if(type == Sim_Trans_Load)
-         full_chunk = READ_MASK;
+         set_bits(b->r, lo, hi);
       else if(type == Sim_Trans_Store)
-         full_chunk = WRITE_MASK;
-      else
-         full_chunk = 0;
-
-      unsigned int offset = cur & ~RANGE_MASK;
-      unsigned int i = offset/CHUNK_BYTES;
-      osa_logical_address_t chunk_start = range_start + i*CHUNK_BYTES;
-      osa_logical_address_t chunk_end = chunk_start + CHUNK_BYTES;
-      for(; i < BYTEMAP_LEN && cur < end; i++) {
-         
-         // mask off bits that aren't in this transaction
-         set_chunk chunk_mask = (set_chunk)-1;
-         if(addr > chunk_start)
-            chunk_mask &=
-               ~BIT_MASK(2*(8*sizeof(set_chunk) - (addr - chunk_start)));
-         if(end < chunk_end)
-            chunk_mask &= BIT_MASK(2*(chunk_end - end));
-
-         range.bmap[i] |= full_chunk & chunk_mask;
-
-         chunk_start = chunk_end;
-         chunk_end += CHUNK_BYTES;
-
-         cur = chunk_start;
-      }
-      
-      // replace the updated map
-      range_it->second = range;
+         set_bits(b->w, lo, hi);
+
+      cur = stop;
    }
 }
 
 int WorkSet::compare(WorkSet *other, int *this_size) {
-   set_it self_it = set.begin(); 
-   set_it other_it = other->set.begin();
-
    int dependencies = 0;
-   int size = 0;
-
-   // iterate through the sets, comparing byteranges for identical
-   // addresses
-   while(self_it != set.end() && other_it != other->set.end()) {
-      if(self_it->first < other_it->first) {
-         // since self_it is advancing, add the size
-         unsigned int i;
-         for(i = 0; i < BYTEMAP_LEN; i++)
-            size += population(
-                  (self_it->second.bmap[i] & READ_MASK) | 
-                  ((self_it->second.bmap[i] & WRITE_MASK) >> 1));
-         self_it++;
-      }
-      else if(other_it->first < self_it->first)
-         other_it++;
-      else {
-         ByteRange range1 = self_it->second;
-         ByteRange range2 = other_it->second;
-         set_chunk reads1, writes1, reads2, writes2, depends;
-         unsigned int i, chunk_size;
-
-         for(i = 0; i < BYTEMAP_LEN; i++) {
-            reads1 = range1.bmap[i] & READ_MASK;
-            writes1 = (range1.bmap[i] & WRITE_MASK) >> 1;
-
-            chunk_size = population(reads1 | writes1);
-            size += chunk_size;
-
-            // if no bits are set, then the rest of the loop is of little
-            // value
-            if(!chunk_size)
-               continue;
-
-            reads2 = range2.bmap[i] & READ_MASK;
-            writes2 = (range2.bmap[i] & WRITE_MASK) >> 1;
-
-	    // RAW, WAR, and WAW hazards
-            depends = (reads1 & writes2) | (reads2 & writes1) | (writes1 & writes2);
-
-            // count the number of bits set
-            dependencies += population(depends);
-         }
 
-         self_it++;
-         other_it++;
-      }
+   // Walk our blocks, probe the other table for the same address
+   for(unsigned int i = 0; i < blocks.size(); i++) {
+      block *b = other->find_block(blocks[i].base);
+      if(b)
+         dependencies += pop_conflict(blocks[i].r, blocks[i].w, b->r, b->w);
    }
 
    if(this_size != NULL)
-      *this_size = size;
+      *this_size = size();
    return dependencies;
 }
 
 int WorkSet::size(){
-
-  int size = 0;
-  
-  for(set_it iter = set.begin(); iter != set.end(); iter++){
-    ByteRange range = iter->second;
-    for(unsigned int i = 0; i < BYTEMAP_LEN; i++){
-      set_chunk reads = range.bmap[i] & READ_MASK;
-      set_chunk writes = (range.bmap[i] & WRITE_MASK) >> 1;
-      
-      size += population(reads | writes);
-    }
-  }
-
-  return size;
-
+   if(blocks.empty())
+      return 0;
+   return pop_rw((const char *)&blocks[0], sizeof(block), blocks.size(),
+                 offsetof(block, r), offsetof(block, w));
 }
 
 int WorkSet::rsize(){
-
-  int size = 0;
-  
-  for(set_it iter = set.begin(); iter != set.end(); iter++){
-    ByteRange range = iter->second;
-    for(unsigned int i = 0; i < BYTEMAP_LEN; i++){
-      set_chunk reads = range.bmap[i] & READ_MASK;
-      size += population(reads);
-    }
-  }
-
-  return size;
-
+   if(blocks.empty())
+      return 0;
+   return pop_r((const char *)&blocks[0], sizeof(block), blocks.size(),
+                offsetof(block, r));
 }
 
 int WorkSet::wsize(){
-
-  int size = 0;
-  
-  for(set_it iter = set.begin(); iter != set.end(); iter++){
-    ByteRange range = iter->second;
-    for(unsigned int i = 0; i < BYTEMAP_LEN; i++){
-      set_chunk writes = (range.bmap[i] & WRITE_MASK) >> 1;
-      size += population(writes);
-    }
-  }
-
-  return size;
-
+   if(blocks.empty())
+      return 0;
+   return pop_r((const char *)&blocks[0], sizeof(block), blocks.size(),
+                offsetof(block, w));
 }
 
+// Every byte with a bit set, as (address, 1 read | 2 write), in the
+// order the SET_GRANULARITY layout enumerates them: ranges in address
+// order, and within each CHUNK_BYTES chunk, last byte first.
+void WorkSet::legacy_bytes(vector<pair<osa_logical_address_t, int> > &out){
+   vector<block *> sorted;
+   sorted_blocks(sorted);
+
+   out.clear();
+   for(unsigned int k = 0; k < sorted.size(); k++){
+      block *b = sorted[k];
+      for(unsigned int c = 0; c < WS_BLOCK_BYTES; c += CHUNK_BYTES){
+         for(int j = CHUNK_BYTES - 1; j >= 0; j--){
+            unsigned int byte = c + j;
+            int val = (b->r[byte >> 6] >> (byte & 63)) & 1;
+            if((b->w[byte >> 6] >> (byte & 63)) & 1)
+               val |= 2;
+            if(val)
+               out.push_back(make_pair(b->base + byte, val));
+         }
+      }
+   }
+}
 
 // Get the workset as a simics attribute value
 attr_value_t WorkSet::get_workset(){
   // We set up a dict with the address as the key and the value as 1
   // (read), 2 (write), 3 (rw)
+  vector<pair<osa_logical_address_t, int> > bytes;
+  legacy_bytes(bytes);
 
-  attr_value_t avReturn = SIM_alloc_attr_dict(size());
-  int idx = 0;
-
-  for(set_it iter = set.begin(); iter != set.end(); iter++){
-    ByteRange range = iter->second;
-    for(unsigned int i = 0; i < BYTEMAP_LEN; i++){
-      set_chunk reads = range.bmap[i] & READ_MASK;
-      set_chunk writes = (range.bmap[i] & WRITE_MASK) >> 1;
-
-      for(unsigned int j = 0; j < 4 * sizeof(set_chunk); j++){
-	if((reads & 1) || (writes & 1)){ // We got a hit 
-	  osa_logical_address_t addr = iter->first;
-	  addr += (4 * sizeof(set_chunk) * i) + ((4 * sizeof(set_chunk)) - 1 - j);
-	  
-	  char val = (reads & 1) ? 1 : 0;
-	  if(writes & 1){
-	    val |= 2;
-	  }
-	  
-	  avReturn.u.dict.vector[idx].key = SIM_make_attr_integer(addr);
-	  avReturn.u.dict.vector[idx].value = SIM_make_attr_integer(val);
-	  idx++;
-	}
-	reads >>= 2;
-	writes >>= 2;
-      }
-    }
+  attr_value_t avReturn = SIM_alloc_attr_dict(bytes.size());
+  for(unsigned int idx = 0; idx < bytes.size(); idx++){
+    avReturn.u.dict.vector[idx].key = SIM_make_attr_integer(bytes[idx].first);
+    avReturn.u.dict.vector[idx].value = SIM_make_attr_integer(bytes[idx].second);
   }
 
   return avReturn;
@@ -243,41 +411,54 @@ attr_value_t WorkSet::get_workset(){
 
 // Dump the workset to standard out for debugging
 void WorkSet::dumpWorkset(){
-  for(set_it iter = set.begin(); iter != set.end(); iter++){
-    ByteRange range = iter->second;
-    for(unsigned int i = 0; i < BYTEMAP_LEN; i++){
-      set_chunk reads = range.bmap[i] & READ_MASK;
-      set_chunk writes = (range.bmap[i] & WRITE_MASK) >> 1;
-
-      for(unsigned int j = 0; j < 4 * sizeof(set_chunk); j++){
-	if((reads & 1) || (writes & 1)){ // We got a hit 
-	  osa_logical_address_t addr = iter->first;
-	  addr += (4 * sizeof(set_chunk) * i) + ((4*sizeof(set_chunk)) - 1 - j);
-	  
-	  int val = (reads & 1) ? 1 : 0;
-	  if(writes & 1){
-	    val |= 2;
-	  }
-
-	  cout << std::hex <<  addr << std::dec << " - " << val << endl;	  
-	}
-	reads >>= 2;
-	writes >>= 2;
-      }
-    }
+  vector<pair<osa_logical_address_t, int> > bytes;
+  legacy_bytes(bytes);
+
+  for(unsigned int idx = 0; idx < bytes.size(); idx++){
+    cout << std::hex << bytes[idx].first << std::dec
+         << " - " << bytes[idx].second << endl;
   }
 }
 
+// One SET_GRANULARITY range of a block as a ByteRange bitmap
+void WorkSet::encode_range(const block *b, unsigned int rg, ByteRange &range){
+   for(unsigned int i = 0; i < BYTEMAP_LEN; i++){
+      unsigned int byte = rg * SET_GRANULARITY + i * CHUNK_BYTES;
+      unsigned int reads = (b->r[byte >> 6] >> (byte & 63)) & 0xffff;
+      unsigned int writes = (b->w[byte >> 6] >> (byte & 63)) & 0xffff;
+      range.bmap[i] = legacy_spread(reads) | (legacy_spread(writes) << 1);
+   }
+}
+
+void WorkSet::get_ranges(vector<uint32_t> &addrs, vector<ByteRange> &bmaps){
+   addrs.resize(nranges);
+   bmaps.resize(nranges);
+
+   vector<block *> sorted;
+   sorted_blocks(sorted);
+   unsigned int n = 0;
+   for(unsigned int k = 0; k < sorted.size(); k++){
+      block *b = sorted[k];
+      for(unsigned int rg = 0; rg < WS_BLOCK_RANGES; rg++){
+         if(!(b->touched & (1U << rg)))
+            continue;
+         addrs[n] = b->base + rg * SET_GRANULARITY;
+         encode_range(b, rg, bmaps[n]);
+         n++;
+      }
+   }
+}
+
 void WorkSet::logWorkset(ostream &out){
   out << "WS_CLOSE "
       << " " << std::hex << id.lock_addr << std::dec
       << " " << id.lock_generation
-      << " " << id.workset_index 
+      << " " << id.workset_index
       << " (" << pid;
   if(twoowners){
     out << " " << old_pid;
   }
-  out << ") " << cpu << " C["; 
+  out << ") " << cpu << " C[";
   for(vector<WorksetID>::iterator iter = contended_worksets.begin();
       iter != contended_worksets.end(); iter++){
     // We only wait on the same lock/generation
@@ -289,30 +470,35 @@ void WorkSet::logWorkset(ostream &out){
   }
   out << endl;
 
-  // Binary record format - starts on a new line
-  char tmp_buf[(sizeof(set_chunk) * BYTEMAP_LEN) + sizeof(int)];
-
-  char size[sizeof(int)];
-  *(int *) size = set.size();
-  out.write((char *) &size, sizeof(int));
-
-  for(set_it iter = set.begin(); iter != set.end(); iter++){
-    // Clear the buffer each time we use it
-    memset(tmp_buf, 0, sizeof(tmp_buf));
-    
-    ByteRange range = iter->second;
-    osa_logical_address_t addr = iter->first;
-	   
-    *((int *) tmp_buf) = addr;
+  // Binary record format - starts on a new line.  One record per
+  // touched SET_GRANULARITY range, in address order: the address as
+  // an int, then the range's ByteRange bitmap.  The records are
+  // built in one buffer and written together.
+  const size_t rec_len = (sizeof(set_chunk) * BYTEMAP_LEN) + sizeof(int);
+  vector<char> buf(sizeof(int) + nranges * rec_len);
+  char *p = &buf[0];
+
+  *(int *) p = nranges;
+  p += sizeof(int);
+
+  vector<block *> sorted;
+  sorted_blocks(sorted);
+  for(unsigned int k = 0; k < sorted.size(); k++){
+    block *b = sorted[k];
+    for(unsigned int rg = 0; rg < WS_BLOCK_RANGES; rg++){
+      if(!(b->touched & (1U << rg)))
+        continue;
 
-    memcpy(tmp_buf + sizeof(int),
-	   range.bmap, sizeof(range.bmap));
-    
-    out.write(tmp_buf, sizeof(tmp_buf));
+      ByteRange range;
+      encode_range(b, rg, range);
 
+      *(int *) p = b->base + rg * SET_GRANULARITY;
+      memcpy(p + sizeof(int), range.bmap, sizeof(range.bmap));
+      p += rec_len;
+    }
   }
+  out.write(&buf[0], buf.size());
   out << "\n";
 
   //out.flush();
 }
-
@@ -11,12 +11,18 @@
 #ifndef WORKSET_H
 #define WORKSET_H
 
+#include <stdint.h>
 #include "../common/simulator.h"
 #include "../common/os.h"
 
 
 using namespace std;
 
+// The SET_* / ByteRange definitions describe the logWorkset record
+// format (one record per touched SET_GRANULARITY range, 2 bits per
+// byte), which post-processing depends on.  In memory, worksets use
+// WS_BLOCK_BYTES blocks instead; see WorkSet::block.
+//
 // SET_GRANULARITY should be a power of 2 that is greater than
 // 4*sizeof(set_chunk) = (2^4)
 // i.e. SET_ORDER must be greater than 4
@@ -47,6 +53,14 @@ struct ByteRange {
    set_chunk bmap[BYTEMAP_LEN];
 };
 
+// In-memory block: WS_BLOCK_BYTES of address space, one read and one
+// write bit per byte
+#define WS_BLOCK_ORDER     8
+#define WS_BLOCK_BYTES     (1<<WS_BLOCK_ORDER)
+#define WS_BLOCK_MASK      BIT_MASK(WS_BLOCK_ORDER)
+#define WS_BLOCK_WORDS     (WS_BLOCK_BYTES/64)
+#define WS_BLOCK_RANGES    (WS_BLOCK_BYTES/SET_GRANULARITY)
+
 class WorksetID {
  public:
   // address of corresponding lock
@@ -83,6 +97,7 @@ class WorkSet {
    public:
       WorkSet(unsigned int lk_addr, spid_t pd, unsigned int lk_generation,
 	      unsigned int ws_index, int cpu);
+      ~WorkSet();
       void grow(osa_logical_address_t addr, int len, osa_memop_basic_type_t type);
 
       int compare(WorkSet*, int*);  // returns the number of conflicting bytes
@@ -120,15 +135,53 @@ class WorkSet {
       // Does this workset include an IO operation?
       int IO;
 
+      // Is this workset being collected?  Unsampled worksets are
+      // opened and closed like the others, but never grown or logged.
+      int sampled;
+
       // Worksets we have waited on while trying to acquire a lock
       vector<struct WorksetID> contended_worksets;
 
       // Log the workset
       void logWorkset(ostream &out);
 
+      // The touched SET_GRANULARITY ranges, in address order, with
+      // the same bitmaps logWorkset writes
+      void get_ranges(vector<uint32_t> &addrs, vector<ByteRange> &bmaps);
+
    private:
-      map<osa_logical_address_t, ByteRange> set;
-      typedef map<osa_logical_address_t, ByteRange>::iterator set_it;
+      // Blocks are kept densely, in the order they were first
+      // touched, so the size kernels sweep only live data.  They are
+      // found through an open-addressed table of (base, index) slots
+      // (linear probing, power of 2 capacity, at most half full).
+      struct block {
+         uint64_t r[WS_BLOCK_WORDS];
+         uint64_t w[WS_BLOCK_WORDS];
+         osa_logical_address_t base;
+         // SET_GRANULARITY ranges grown so far, for logWorkset
+         unsigned int touched;
+      };
+      struct slot {
+         osa_logical_address_t base;
+         unsigned int index;
+      };
+      vector<block> blocks;
+      slot *slots;
+      unsigned int capacity;
+      // Number of touched SET_GRANULARITY ranges
+      unsigned int nranges;
+
+      unsigned int home(osa_logical_address_t base);
+      block *find_block(osa_logical_address_t base);
+      block *get_block(osa_logical_address_t base);
+      void rehash(unsigned int new_capacity);
+      void sorted_blocks(vector<block *> &out);
+      void legacy_bytes(vector<pair<osa_logical_address_t, int> > &out);
+      static void encode_range(const block *b, unsigned int rg, ByteRange &range);
+
+      // Not copyable
+      WorkSet(const WorkSet &);
+      WorkSet &operator=(const WorkSet &);
 };
 
 #endif
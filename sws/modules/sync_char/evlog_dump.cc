@@ -0,0 +1,214 @@
+// SyncChar Project
+// File Name: evlog_dump.cc
+//
+// Description: syncchar-evlog, prints a binary event log written via
+// the sync_char event_log attribute.
+//
+//    syncchar-evlog [-b] [-l lock] [-t lock] log
+//
+// With no options, summarizes the log per segment.  -b lists the
+// blocks.  -l prints one lock's workset closes as WS_CLOSE lines like
+// the text log, with their contention read from the contention
+// segment.  -t prints one lock's timeline (timeline_epoch), a
+// TIMELINE line per bucket:
+//    TIMELINE lock generation start length acquires contended
+//             hold_cycles max_wait
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <map>
+#include "EventLogReader.h"
+
+using namespace std;
+
+static void usage(const char *prog) {
+   cerr << "usage: " << prog << " [-b] [-l lock] [-t lock] log" << endl;
+   exit(1);
+}
+
+static int summary(EventLogReader &log, bool list_blocks) {
+   uint64_t records[EVLOG_NSEGS] = { 0 };
+   uint64_t raw[EVLOG_NSEGS] = { 0 };
+   uint64_t stored[EVLOG_NSEGS] = { 0 };
+   unsigned int blocks[EVLOG_NSEGS] = { 0 };
+   unsigned int codecs[EVLOG_NCODECS] = { 0 };
+
+   for(unsigned int i = 0; i < log.nblocks(); i++) {
+      const evlog_index_entry_t &e = log.block(i);
+      const evlog_block_header_t &h = e.hdr;
+      if(list_blocks) {
+         cout << i << ": " << evlog_schemas[h.segment].name
+              << " @" << e.offset << " " << h.nrecords << " records, "
+              << h.raw_len << "/" << h.stored_len << " bytes "
+              << (h.codec < EVLOG_NCODECS ? evlog_codec_names[h.codec] : "?")
+              << ", seq " << h.seq_first << "-" << h.seq_last
+              << hex << ", locks " << h.lock_min << "-" << h.lock_max
+              << dec << endl;
+      }
+      records[h.segment] += h.nrecords;
+      raw[h.segment] += h.raw_len;
+      stored[h.segment] += h.stored_len;
+      blocks[h.segment]++;
+      if(h.codec < EVLOG_NCODECS)
+         codecs[h.codec]++;
+   }
+
+   cout << log.nblocks() << " blocks"
+        << (log.indexed() ? "" : " (no index: log was not closed)") << endl;
+   for(int s = 0; s < EVLOG_NSEGS; s++) {
+      cout << "   " << evlog_schemas[s].name << ": " << records[s]
+           << " records in " << blocks[s] << " blocks, " << raw[s]
+           << " bytes, " << stored[s] << " stored" << endl;
+   }
+   cout << "   codecs:";
+   for(int c = 0; c < EVLOG_NCODECS; c++)
+      if(codecs[c])
+         cout << " " << evlog_codec_names[c] << " " << codecs[c];
+   cout << endl;
+   return 0;
+}
+
+static int dump_lock(EventLogReader &log, uint32_t lock) {
+   // Waiters' (generation, index) -> holders' indices
+   map<pair<uint32_t, uint32_t>, vector<uint32_t> > contended;
+   vector<unsigned int> blocks;
+   log.find_lock(lock, EVLOG_SEG_CONTENTION, blocks);
+   EventLogBlock blk;
+   for(unsigned int i = 0; i < blocks.size(); i++) {
+      if(!log.load(blocks[i], blk)) {
+         cerr << "XXX: " << log.error() << endl;
+         return 1;
+      }
+      for(uint32_t r = 0; r < blk.records(); r++) {
+         if(blk.u32(EVLOG_CT_LOCK)[r] != lock)
+            continue;
+         contended[make_pair(blk.u32(EVLOG_CT_GENERATION)[r],
+                             blk.u32(EVLOG_CT_INDEX)[r])]
+            .push_back(blk.u32(EVLOG_CT_HOLDER_INDEX)[r]);
+      }
+   }
+
+   vector<evlog_ws_close_t> worksets;
+   if(!log.ws_closes(lock, worksets)) {
+      cerr << "XXX: " << log.error() << endl;
+      return 1;
+   }
+   for(unsigned int i = 0; i < worksets.size(); i++) {
+      evlog_ws_close_t &ws = worksets[i];
+      cout << "WS_CLOSE  " << hex << ws.lock << dec
+           << " " << ws.generation << " " << ws.index << " (" << ws.pid;
+      if(ws.flags & EVLOG_WS_TWO_OWNERS)
+         cout << " " << ws.old_pid;
+      cout << ") " << ws.cpu << " C[";
+      vector<uint32_t> &c = contended[make_pair(ws.generation, ws.index)];
+      for(unsigned int j = 0; j < c.size(); j++)
+         cout << " " << c[j];
+      cout << " ]";
+      if(ws.flags & EVLOG_WS_IO)
+         cout << " IO";
+      cout << endl << "   seq " << ws.seq << ", cycle " << ws.cycle
+           << ", " << ws.size << " bytes in " << ws.range_addr.size()
+           << " ranges" << endl;
+   }
+   return 0;
+}
+
+// Buckets still filling at a stats dump are logged again at the
+// next one, so keep the last record for each
+static int dump_timeline(EventLogReader &log, uint32_t lock) {
+   // (generation, start) -> block, row
+   map<pair<uint32_t, uint64_t>, pair<unsigned int, uint32_t> > last;
+   vector<unsigned int> blocks;
+   log.find_lock(lock, EVLOG_SEG_TIMELINE, blocks);
+   EventLogBlock blk;
+   for(unsigned int i = 0; i < blocks.size(); i++) {
+      if(!log.load(blocks[i], blk)) {
+         cerr << "XXX: " << log.error() << endl;
+         return 1;
+      }
+      for(uint32_t r = 0; r < blk.records(); r++) {
+         if(blk.u32(EVLOG_TL_LOCK)[r] != lock)
+            continue;
+         last[make_pair(blk.u32(EVLOG_TL_GENERATION)[r],
+                        blk.u64(EVLOG_TL_START)[r])]
+            = make_pair(blocks[i], r);
+      }
+   }
+
+   unsigned int loaded = (unsigned int)-1;
+   for(map<pair<uint32_t, uint64_t>, pair<unsigned int, uint32_t> >::iterator
+          it = last.begin(); it != last.end(); it++) {
+      if(it->second.first != loaded) {
+         if(!log.load(it->second.first, blk)) {
+            cerr << "XXX: " << log.error() << endl;
+            return 1;
+         }
+         loaded = it->second.first;
+      }
+      uint32_t r = it->second.second;
+      cout << "TIMELINE " << hex << lock << dec
+           << " " << it->first.first
+           << " " << it->first.second
+           << " " << blk.u64(EVLOG_TL_LENGTH)[r]
+           << " " << blk.u32(EVLOG_TL_ACQUIRES)[r]
+           << " " << blk.u32(EVLOG_TL_CONTENDED)[r]
+           << " " << blk.u64(EVLOG_TL_HOLD_CYCLES)[r]
+           << " " << blk.u64(EVLOG_TL_MAX_WAIT)[r] << endl;
+   }
+   return 0;
+}
+
+int main(int argc, char **argv) {
+   bool list_blocks = false;
+   bool by_lock = false;
+   bool timeline = false;
+   uint32_t lock = 0;
+   int c;
+   while((c = getopt(argc, argv, "bl:t:h")) != -1) {
+      switch(c) {
+      case 'b':
+         list_blocks = true;
+         break;
+      case 'l':
+         by_lock = true;
+         lock = strtoul(optarg, NULL, 16);
+         break;
+      case 't':
+         timeline = true;
+         lock = strtoul(optarg, NULL, 16);
+         break;
+      default:
+         usage(argv[0]);
+      }
+   }
+   if(optind != argc - 1)
+      usage(argv[0]);
+
+   EventLogReader log(argv[optind]);
+   if(!log.good()) {
+      cerr << "XXX: " << log.error() << endl;
+      return 1;
+   }
+   if(timeline)
+      return dump_timeline(log, lock);
+   if(by_lock)
+      return dump_lock(log, lock);
+   return summary(log, list_blocks);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
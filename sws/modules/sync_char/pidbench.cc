@@ -0,0 +1,238 @@
+// SyncChar Project
+// File Name: pidbench.cc
+//
+// Description: Microbenchmark for the os_data_t process table.  Runs
+// a fork/exit churn with a sched and a stream of current spid reads
+// between them (what sync_char's breakpoint and timing paths do)
+// through the slot table and through MapProcs, a copy of the
+// original std::map tables, checks that both see the same processes,
+// and reports the time per operation for each.
+//
+//    make -f Makefile.replay pidbench
+//    ./pidbench [operations [live processes]]
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "../common/os.h"
+
+using namespace std;
+
+// The original process tables, kept as the reference
+class MapProcs {
+ public:
+   MapProcs() : spid_max(1) {
+      struct pid_info *p0 = new struct pid_info();
+      procs[0] = p0;
+      sprocs[0] = p0;
+   }
+   ~MapProcs() {
+      for(map<spid_t, struct pid_info*>::iterator it = sprocs.begin();
+          it != sprocs.end(); it++)
+         delete it->second;
+   }
+   void fork(int pid, bool kernel) {
+      struct pid_info *pp = new struct pid_info();
+      pp->pid = pid;
+      pp->spid = spid_max++;
+      pp->kernel = kernel;
+      if(procs[pid]) {
+         sprocs.erase(procs[pid]->spid);
+         delete procs[pid];
+      }
+      procs[pid] = pp;
+      sprocs[pp->spid] = pp;
+   }
+   void exit(int pid) {
+      struct pid_info *pp = procs[pid];
+      sprocs.erase(pp->spid);
+      procs.erase(pid);
+      delete pp;
+   }
+   struct pid_info *find(int pid) {
+      map<int, struct pid_info*>::iterator it = procs.find(pid);
+      return it == procs.end() ? NULL : it->second;
+   }
+
+   map<int, struct pid_info*> procs;
+   map<spid_t, struct pid_info*> sprocs;
+   map<int, spid_t> current_process;
+   unsigned int spid_max;
+};
+
+typedef struct _pid_op_t {
+   enum { FORK, EXIT, SCHED } kind;
+   int pid;
+   int cpu;
+} pid_op_t;
+
+#define BENCH_CPUS  8
+// current spid reads between two table operations
+#define READS_PER_OP 64
+
+// Keeps about nlive processes: forks with increasing pids (wrapping
+// like pid_max), exits of a random live one, and scheds of a random
+// live one onto a random cpu
+static void make_ops(vector<pid_op_t> &out, int n, int nlive) {
+   vector<int> live;
+   vector<bool> is_live(32768, false);
+   int next_pid = 1;
+   srand(12);
+   out.clear();
+   for(int i = 0; i < n; i++) {
+      pid_op_t op;
+      op.cpu = rand() % BENCH_CPUS;
+      int r = rand() % 100;
+      if(live.empty() || ((int)live.size() < nlive && r < 60)
+         || ((int)live.size() >= nlive && r < 30)) {
+         op.kind = pid_op_t::FORK;
+         while(is_live[next_pid])
+            next_pid = next_pid % 32767 + 1;
+         op.pid = next_pid;
+         live.push_back(next_pid);
+         is_live[next_pid] = true;
+         next_pid = next_pid % 32767 + 1;
+      } else if(r < 65) {
+         op.kind = pid_op_t::EXIT;
+         int k = rand() % live.size();
+         op.pid = live[k];
+         is_live[op.pid] = false;
+         live[k] = live.back();
+         live.pop_back();
+      } else {
+         op.kind = pid_op_t::SCHED;
+         op.pid = live[rand() % live.size()];
+      }
+      out.push_back(op);
+   }
+}
+
+static double now() {
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, int i) {
+   if(!ok) {
+      cerr << "XXX: " << what << " differs at op " << i << endl;
+      failures++;
+   }
+}
+
+int main(int argc, char **argv) {
+   int nops = argc > 1 ? atoi(argv[1]) : 1000000;
+   int nlive = argc > 2 ? atoi(argv[2]) : 500;
+
+   vector<pid_op_t> ops;
+   make_ops(ops, nops, nlive);
+
+   MapProcs *old_os = new MapProcs();
+   os_data_t *new_os = new os_data_t;
+   os_init_procs(new_os);
+
+   unsigned long long osum = 0, nsum = 0;
+   double t = now();
+   for(unsigned int i = 0; i < ops.size(); i++) {
+      pid_op_t &op = ops[i];
+      if(op.kind == pid_op_t::FORK) {
+         old_os->fork(op.pid, false);
+      } else if(op.kind == pid_op_t::EXIT) {
+         old_os->exit(op.pid);
+      } else {
+         struct pid_info *pp = old_os->procs[op.pid];
+         pp->cpu = op.cpu;
+         old_os->current_process[op.cpu] = pp->spid;
+      }
+      for(int r = 0; r < READS_PER_OP; r++)
+         osum += old_os->current_process[(i + r) % BENCH_CPUS] != 0;
+   }
+   double t_old = now() - t;
+
+   t = now();
+   for(unsigned int i = 0; i < ops.size(); i++) {
+      pid_op_t &op = ops[i];
+      if(op.kind == pid_op_t::FORK) {
+         os_add_proc(new_os, op.pid, false);
+      } else if(op.kind == pid_op_t::EXIT) {
+         os_remove_proc(new_os, op.pid);
+      } else {
+         struct pid_info *pp = os_pid_info(new_os, op.pid);
+         pp->cpu = op.cpu;
+         os_set_current_spid(new_os, op.cpu, pp->spid);
+      }
+      for(int r = 0; r < READS_PER_OP; r++)
+         nsum += os_current_spid(new_os, (i + r) % BENCH_CPUS) != 0;
+   }
+   double t_new = now() - t;
+
+   // Same processes, each findable by its spid, and the same cpus
+   // busy
+   check(osum == nsum, "busy cpu count", -1);
+   check(old_os->procs.size() == os_nprocs(new_os), "process count", -1);
+   for(int pid = 0; pid <= 32768; pid++) {
+      struct pid_info *o = old_os->find(pid);
+      struct pid_info *n = os_pid_info(new_os, pid);
+      check((o == NULL) == (n == NULL), "pid", pid);
+      if(n != NULL)
+         check(os_spid_info(new_os, n->spid) == n, "spid lookup", pid);
+   }
+
+   // A recycled slot's old spid is stale
+   struct pid_info *pp = os_add_proc(new_os, 40000, true);
+   spid_t stale = pp->spid;
+   os_remove_proc(new_os, 40000);
+   check(os_spid_info(new_os, stale) == NULL, "stale spid", -1);
+
+   // A slot reused until its generation runs out is retired, not
+   // wrapped, so no spid is handed out twice
+   os_data_t *wrap_os = new os_data_t;
+   os_init_procs(wrap_os);
+   set<spid_t> seen;
+   for(unsigned int i = 0; i < 2 * (OS_SPID_GEN_RETIRED + 1); i++) {
+      struct pid_info *wp = os_add_proc(wrap_os, 1, false);
+      if(wp == NULL || !seen.insert(wp->spid).second) {
+         check(false, "spid reuse", i);
+         break;
+      }
+      os_remove_proc(wrap_os, 1);
+   }
+   delete wrap_os;
+
+   long long per = (long long)nops;
+   cout << nops << " fork/exit/sched ops, " << READS_PER_OP
+        << " current spid reads each, " << old_os->procs.size()
+        << " processes left, " << new_os->slots.size() << " slots" << endl;
+   double o = t_old * 1e9 / per;
+   double n = t_new * 1e9 / per;
+   cout << "   op + reads: map " << o << " ns, table " << n << " ns ("
+        << (n > 0 ? o / n : 0) << "x)" << endl;
+
+   delete old_os;
+   if(failures) {
+      cerr << "XXX: " << failures << " mismatches" << endl;
+      return 1;
+   }
+   return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
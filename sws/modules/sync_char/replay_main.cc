@@ -0,0 +1,202 @@
+// SyncChar Project
+// File Name: replay_main.cc
+//
+// Description: syncchar-replay, runs the common and sync_char modules
+// over a trace captured with the common module's replay_record
+// attribute, without Simics.  Useful for profiling and for A/B
+// comparisons of module changes against a fixed workload.
+//
+//    syncchar-replay [-a obj.attr=value]... [-g obj.attr]... trace
+//
+// -a overrides a recorded attribute (or sets one that was not
+//    recorded, e.g. -a sync_char0.mapfile=/path/to/sync_char.map when
+//    replaying on another machine).  Lists are written [a, b, ...],
+//    e.g. -a "sync_char0.ws_sample_rate=[1, 10]".
+// -g prints an attribute after the replay (e.g. -g sync_char0.stats).
+//
+// Each lock breakpoint is one lock transition, so breaks/s in the
+// summary is the transition rate (make -f Makefile.replay bench).
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../common/simulator.h"
+#include "../common/osacommon.h"
+#include "../common/replaytrace.h"
+
+using namespace std;
+
+// Each module's init_local, renamed at compile time (Makefile.replay)
+extern "C" void common_init_local(void);
+extern "C" void sync_char_init_local(void);
+
+static const char *event_names[REPLAY_MAX_EVENT_TYPE] = {
+   NULL, "object", "attr", "breakpoint", "post", "memop", "magic",
+   "exception", "device", "end"
+};
+
+static void usage(const char *prog) {
+   cerr << "usage: " << prog
+        << " [-a obj.attr=value]... [-g obj.attr]... trace" << endl;
+   exit(1);
+}
+
+static void print_attr(ostream &out, attr_value_t v) {
+   switch(v.kind) {
+   case Sim_Val_String:
+      out << "\"" << v.u.string << "\"";
+      break;
+   case Sim_Val_Integer:
+   case Sim_Val_Boolean:
+      out << v.u.integer;
+      break;
+   case Sim_Val_Floating:
+      out << v.u.floating;
+      break;
+   case Sim_Val_Object:
+      out << v.u.object->name;
+      break;
+   case Sim_Val_List:
+      out << "[";
+      for(int i = 0; i < v.u.list.size; i++) {
+         if(i)
+            out << ", ";
+         print_attr(out, v.u.list.vector[i]);
+      }
+      out << "]";
+      break;
+   case Sim_Val_Dict:
+      out << "{";
+      for(int i = 0; i < v.u.dict.size; i++) {
+         if(i)
+            out << ", ";
+         print_attr(out, v.u.dict.vector[i].key);
+         out << ": ";
+         print_attr(out, v.u.dict.vector[i].value);
+      }
+      out << "}";
+      break;
+   case Sim_Val_Data:
+      out << "<" << v.u.data.size << " bytes>";
+      break;
+   case Sim_Val_Nil:
+      out << "NIL";
+      break;
+   default:
+      out << "<invalid>";
+      break;
+   }
+}
+
+static bool split_obj_attr(const string &s, string &obj, string &attr) {
+   size_t dot = s.find('.');
+   if(dot == string::npos || dot == 0 || dot + 1 == s.size())
+      return false;
+   obj = s.substr(0, dot);
+   attr = s.substr(dot + 1);
+   return true;
+}
+
+int main(int argc, char **argv) {
+   vector<string> gets;
+   int c;
+   while((c = getopt(argc, argv, "a:g:h")) != -1) {
+      switch(c) {
+      case 'a': {
+         string arg(optarg), obj, attr;
+         size_t eq = arg.find('=');
+         if(eq == string::npos || !split_obj_attr(arg.substr(0, eq), obj, attr))
+            usage(argv[0]);
+         replay_add_override(obj.c_str(), attr.c_str(),
+                             arg.substr(eq + 1).c_str());
+         break;
+      }
+      case 'g':
+         gets.push_back(optarg);
+         break;
+      default:
+         usage(argv[0]);
+      }
+   }
+   if(optind != argc - 1)
+      usage(argv[0]);
+
+   common_init_local();
+   sync_char_init_local();
+
+   replay_stats_t stats;
+   struct timeval start, stop;
+   gettimeofday(&start, NULL);
+   if(replay_run(argv[optind], &stats) != 0) {
+      cerr << "XXX: can't replay " << argv[optind] << endl;
+      return 1;
+   }
+   gettimeofday(&stop, NULL);
+
+   for(osamod_t *cur_mod = OSA_mod_list();
+       cur_mod != NULL; cur_mod = cur_mod->next_mod){
+      if(cur_mod->pStatStream)
+         cur_mod->pStatStream->flush();
+   }
+
+   for(unsigned i = 0; i < gets.size(); i++) {
+      string obj, attr;
+      if(!split_obj_attr(gets[i], obj, attr)) {
+         cerr << "XXX: bad attribute " << gets[i] << endl;
+         continue;
+      }
+      conf_object_t *o = SIM_get_object(obj.c_str());
+      attr_value_t v = o ? SIM_get_attribute(o, attr.c_str())
+         : SIM_make_attr_invalid();
+      SIM_clear_exception();
+      cout << gets[i] << " = ";
+      print_attr(cout, v);
+      cout << endl;
+   }
+
+   double secs = (stop.tv_sec - start.tv_sec)
+      + (stop.tv_usec - start.tv_usec) / 1e6;
+   unsigned long long total = 0;
+   cerr << "replay: " << argv[optind] << endl;
+   for(int i = 0; i < REPLAY_MAX_EVENT_TYPE; i++) {
+      if(stats.events[i] == 0)
+         continue;
+      total += stats.events[i];
+      cerr << "   " << (event_names[i] ? event_names[i] : "?") << " "
+           << stats.events[i] << endl;
+   }
+   cerr << "   fills " << stats.fills << endl
+        << "   memop stall cycles " << stats.memop_stall << endl
+        << "   breaks " << stats.breaks
+        << ", unmatched posts " << stats.unmatched_posts
+        << ", unknown objects " << stats.unknown_objects << endl
+        << "   " << total << " events, " << stats.bytes << " bytes in "
+        << secs << "s";
+   if(secs > 0)
+      cerr << " (" << (unsigned long long)(total / secs) << " events/s, "
+           << (unsigned long long)(stats.breaks / secs) << " breaks/s, "
+           << stats.bytes / secs / (1 << 20) << " MB/s)";
+   cerr << endl;
+
+   return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
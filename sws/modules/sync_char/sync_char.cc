@@ -41,6 +41,14 @@
 #include "../common/os.h"
 
 #include "WorkSet.h"
+#include "LockTable.h"
+#include "LatencyHist.h"
+#include "ReaderSet.h"
+#include "EventLogWriter.h"
+#include "SyncCharMap.h"
+#include "../include/pool.h"
+#include "../common/replaytrace.h"
+#include "../common/LogSink.h"
 
 #include "stdio.h"
 #include <sys/time.h>
@@ -53,9 +61,6 @@ using namespace std::tr1;
 //#define DEBUG_INTERACTIVE 1
 //#define DEBUG_ADDRESS 0xf7f9237c
 
-#define OSA_PRINT_TO_CONSOLE	false /*true*/
-bool gbOsaPrintCout	= OSA_PRINT_TO_CONSOLE;
-
 // XXX These must match the definitions in sync_char_pre.py
 #undef F_LOCK
 // Don't use F_LOCK and F_UNLOCK because rwsem_atomic_update cannot be
@@ -88,6 +93,14 @@ inline int cache_count(osamod_t *osamod) {
    return osamod->minfo->getNumCpus();
 }
 
+struct transition_info;
+struct _as_data_t;
+
+// Tracks one completed lock instruction: the state machine for its
+// lock type and flags
+typedef void (*lock_handler_t)(struct transition_info *t, osamod_t *osamod,
+                               struct _as_data_t *as_data);
+
 // Two maps for lock information, one keyed by caller ra, the other by
 // lock address
 // Map from lock_ra to information for lock address
@@ -96,8 +109,11 @@ struct ra {
    unsigned long      lock_reg;
    unsigned           lock_id;
    unsigned long      flags;
-   char*              label;
+   const char*        label;   // in the SyncCharMap's label pool
    // Omit func_pc
+   // Resolved from lock_id and flags when the map is read
+   lock_handler_t     handler;
+   bool               read_lkval;  // read the lock word around the instruction
 };
 
 // Maintain information for average and variance
@@ -109,7 +125,8 @@ typedef struct avg_var {
 
 struct caller {
    // Number of times caller calls lock routine. Difference between
-   // this number and hold_av[0] + acq_av[0] is # of (test&set) retries.
+   // this number and hold_hist + acq_hist counts is # of (test&set)
+   // retries.
    unsigned long long count;
    // When first try to acquire, is lock busy?
    unsigned long long q_count;
@@ -129,12 +146,11 @@ struct caller {
    // Free lock that is already free.
    unsigned int useless_release;
    /// NB: These are only updated under the acquire RA
-   // Average cycle times for holding a lock.  Grab & release is a
-   // hold, even if other (e.g., other readers) are also holding 
-   avg_var hold_av[3];
-   // Time between acquire semaphore and getting scheduled.  For all, short
-   // and long cases (short is less than 1,000 cycles)
-   avg_var acq_av[3];
+   // Cycles holding a lock.  Grab & release is a hold, even if other
+   // (e.g., other readers) are also holding
+   LatencyHist hold_hist;
+   // Cycles between acquire semaphore and getting scheduled
+   LatencyHist acq_hist;
 };
 
 // Map from lock addr to lock info
@@ -148,6 +164,7 @@ struct spid_info {
    osa_cycles_t      acq_cyc; // When we get lock
    unsigned long acq_ra;  // Lock caller
    int           cnt; // For spid that grabs read locks multiple times
+   bool          rd_blocked; // req_cyc was set while readers held the lock
 };
 
 //#define BUSTED_GCC 1
@@ -160,10 +177,6 @@ typedef map<unsigned int, struct caller> caller_map_t;
 typedef map<unsigned int, struct caller>::const_iterator caller_mapcit_t;
 typedef map<unsigned int, struct caller>::iterator caller_mapit_t;
 
-typedef map<spid_t, int> reader_map_t;
-typedef map<spid_t, int>::iterator reader_mapit_t;
-typedef map<spid_t, int>::const_iterator reader_mapcit_t;
-
 typedef map <spid_t, struct spid_info> acq_map_t;
 typedef map<spid_t, struct spid_info>::const_iterator acq_mapcit_t;
 
@@ -179,10 +192,6 @@ typedef unordered_map<unsigned int, struct caller> caller_map_t;
 typedef unordered_map<unsigned int, struct caller>::const_iterator caller_mapcit_t;
 typedef unordered_map<unsigned int, struct caller>::iterator caller_mapit_t;
 
-typedef unordered_map<spid_t, int> reader_map_t;
-typedef unordered_map<spid_t, int>::iterator reader_mapit_t;
-typedef unordered_map<spid_t, int>::const_iterator reader_mapcit_t;
-
 typedef unordered_map <spid_t, struct spid_info> acq_map_t;
 typedef unordered_map<spid_t, struct spid_info>::const_iterator acq_mapcit_t;
 
@@ -191,6 +200,138 @@ typedef unordered_map<spid_t, struct spid_info>::const_iterator acq_mapcit_t;
 
 #define LOCK_NAME_SIZE 256
 
+// Online data independence (online_independence attribute).  Each
+// closed workset is compared against a ring of the lock's last
+// archived_worksets closed worksets, and then sampled the way
+// sync_char_post.py does: with the newest workset of up to n-1 other
+// pids, for each cpu count n.
+#define DI_NCPU_COUNTS 5
+static const unsigned int di_cpu_counts[DI_NCPU_COUNTS] = { 2, 4, 8, 16, 32 };
+#define DI_MAX_CPUS    32
+// Bin 0 is "no conflict", bin i the fraction of the sample in
+// conflict in ((i-1)/10, i/10]
+#define DI_HIST_BINS   11
+// Bounds the ring (and its conflict matrix) whatever
+// archived_worksets says
+#define DI_MAX_ARCHIVE 1024
+
+// One cpu count's samples: the sums sync_char_post.py averages
+typedef struct _di_cpus_t {
+   unsigned long long samples;
+   unsigned long long conflicting;   // worksets that conflict with
+                                     // another in the sample
+   unsigned long long completions;   // worksets that do not
+   unsigned long long threads;       // sample sizes
+   double density;                   // conflict density
+   unsigned long long hist[DI_HIST_BINS];
+} di_cpus_t;
+
+struct lock_di {
+   // The last closed worksets.  The newest is at head - 1.
+   vector<WorkSet*> ring;
+   unsigned int head;
+   unsigned int count;
+
+   // Whether ring slots a and b conflict: bit b of row a, words per
+   // row.  Filled in as each workset is archived, so sampling needs
+   // no further compares.
+   vector<unsigned long long> conflicts;
+   unsigned int words;
+
+   // Pairwise, against every other-pid workset in the ring
+   avg_var depend_av[3];      // number of dependent bytes
+   avg_var total_av[3];       // total number of bytes in working set
+   avg_var percent_av[3];     // percent of bytes conflicting
+
+   unsigned long long closes;
+   // Distinct pids that closed a workset
+   unordered_map<spid_t, unsigned long long> pids;
+
+   di_cpus_t cpus[DI_NCPU_COUNTS];
+};
+
+// Lock timeline (timeline_epoch attribute).  Time is cut into epochs
+// of timeline_epoch cycles, and each lock counts its acquires, hold
+// cycles and longest wait per epoch into a ring of its last
+// timeline_buckets epochs, allocated whole when the lock first
+// records into it.  Stats dumps export the epochs recorded since the
+// last one to the event log.  An epoch that would overwrite one not
+// yet exported first exports the ring's epochs, which are complete,
+// so the ring only loses epochs when there is no event log.
+#define TL_EMPTY ((unsigned long long)-1)
+
+typedef struct _tl_bucket_t {
+   unsigned long long epoch;     // TL_EMPTY if unused
+   unsigned int acquires;
+   unsigned int contended;       // acquires that had to wait
+   unsigned long long hold_cycles;
+   unsigned long long max_wait;
+} tl_bucket_t;
+
+struct lock_timeline {
+   // Epoch e is in ring[e % ring.size()]
+   vector<tl_bucket_t> ring;
+   unsigned long long newest;
+   // The first epoch not yet exported, or that was still open when
+   // it was
+   unsigned long long exported;
+};
+
+// A stream of critical sections being sampled at some rate: how many
+// were considered, and how many of the current block of m were taken
+typedef struct _ws_sample_pos_t {
+   unsigned long long seq;
+   unsigned int chosen;
+} ws_sample_pos_t;
+
+// Reader/writer lock behavior, for L_RSPIN, L_WSPIN, L_RSEMA and
+// L_WSEMA locks.  A batch is a run of readers from the lock going
+// read-locked until it opens again.
+#define RW_READER_BINS 16
+struct rw_stats {
+   // Readers holding the lock just after each read acquire, the last
+   // bin for RW_READER_BINS - 1 or more
+   unsigned long long readers[RW_READER_BINS];
+   unsigned long long batches;
+   unsigned long long batch_reads;
+   unsigned long long writes;
+   // Write acquires that had queued while readers held the lock, and
+   // their cycles from queueing to acquiring
+   unsigned long long starved;
+   unsigned long long starve_cycles;
+};
+
+// The parts of a lock that are only touched by stats, naming and
+// nesting bookkeeping.  Kept out of struct lock so that the lock
+// table stays dense.
+struct lock_cold {
+   caller_map_t *callers;
+
+   // Nesting depth of the locks.  i.e. how many other locks does this
+   // process have when it gets this one.  Useful for telling when one
+   // lock is "occluding" anothers performance tuning.
+   LatencyHist nest_hist;
+
+   // The name of this lock
+   char name[LOCK_NAME_SIZE];
+
+   // Workset archive and data independence stats, if
+   // online_independence has been on since the last reset
+   struct lock_di *di;
+
+   // Worksets opened and collected since the last reset, and the
+   // lock's place in its sampling rate (see sample_workset)
+   unsigned long long ws_opened;
+   unsigned long long ws_sampled;
+   ws_sample_pos_t ws_pos;
+
+   // Per-epoch counters, if timeline_epoch is set
+   struct lock_timeline *tl;
+
+   // Reader/writer locks only, from their first acquire
+   struct rw_stats *rw;
+};
+
 struct lock {
    short state;
    int   lkval;
@@ -213,12 +354,17 @@ struct lock {
    // It gets weird because there can be multiple readers at once.
    spid_t spid_owner;
 
+   // A hand-off lock (handoff_lock attribute) can be released by a
+   // different pid than took it, like the runqueue lock across a
+   // context switch.  Its owner is indexed in as_data->handoffs.
+   bool handoff;
+
    // The pids that hold the reader lock.  The second term is the
    // number of times this pid has acquired the lock.  A pid can get
    // the read_lock more than once (see do_tty_hangup(), which
    // acquires the tasklist_lock and then calls send_group_sig_info(),
    // which also acquires it).
-   reader_map_t readers;
+   ReaderSet<spid_t> readers;
 
    // Track the aggregate workset of all lock data
    WorkSet* aggregate_workset;
@@ -228,39 +374,24 @@ struct lock {
    // accessed this lock.
    acq_map_t *acq;
 
-   caller_map_t *callers;
-
-   // The name of this lock
-   char name[LOCK_NAME_SIZE];
-
-   // Nesting depth of the locks.  i.e. how many other locks does this
-   // process have when it gets this one.  Useful for telling when one
-   // lock is "occluding" anothers performance tuning.
-   avg_var nest_av[3];
-
-   // worksets covered by previous holders of this lock
-   //deque<WorkSet*> worksets;
-   //avg_var depend_av[3];      // number of dependent bytes
-   //avg_var total_av[3];       // total number of bytes in working set
-   //avg_var percent_av[3];     // percent of bytes conflicting
+   // Callers, name, nesting averages and the workset archive
+   struct lock_cold *cold;
 };
 
+// Locks are looked up on every transition and, for every open
+// workset, on every memop, so they live in a flat table rather than
+// a node-based map.  Handles are stable across inserts.
+typedef LockTable<struct lock> lock_map_t;
+typedef LockTable<struct lock>::iterator lock_mapit_t;
+
 #ifdef BUSTED_GCC
-typedef map<unsigned int, struct lock> lock_map_t;
-typedef map<unsigned int, struct lock>::const_iterator lock_mapcit_t;
-typedef map<unsigned int, struct lock>::iterator lock_mapit_t;
 typedef map<spid_t, struct spid_info>::const_iterator acqcit_t;
-
 #else
-typedef unordered_map<unsigned int, struct lock> lock_map_t;
-typedef unordered_map<unsigned int, struct lock>::const_iterator lock_mapcit_t;
-typedef unordered_map<unsigned int, struct lock>::iterator lock_mapit_t;
 typedef unordered_map<spid_t, struct spid_info>::const_iterator acqcit_t;
-
 #endif
 
 // keep track of all the locks held by each pid, and the worksets for each
-typedef list< pair<lock_mapcit_t, WorkSet*> > workset_list_t;
+typedef list< pair<lock_handle_t, WorkSet*> > workset_list_t;
 #ifdef BUSTED_GCC
 typedef map<spid_t, workset_list_t*> lockset_map_t;
 #else
@@ -277,11 +408,15 @@ struct transition_info {
    unsigned int lock_ra;
    unsigned int caller_ra;
    unsigned int lock_addr;
+   // The lock being transitioned, resolved once in initialize_transition
+   lock_handle_t lock;
+   struct lock *lk;
    unsigned int lock_id;
    short old_state;
    short new_state;
    spid_t spid_owner;
    unsigned long flags;
+   lock_handler_t handler;
    bool read_lock;
    bool read_unlock;
    osa_cycles_t now_cyc;
@@ -295,6 +430,32 @@ struct transition_info {
 // modified by instruction, and after
 //#define DBG_LK_ADDR 0xc0329200 /* 0xc0321880*/
 
+// Lock acquisition order (lock_order attribute): an edge from each
+// lock a spid holds to each lock it then acquires.  Edges live in one
+// vector per address space, found through an index on the
+// (outer, inner) handle pair.
+typedef struct _lock_edge_t {
+   lock_handle_t outer;
+   lock_handle_t inner;
+   unsigned long long count;        // inner acquired under outer
+   unsigned long long wait_cycles;  // waiting for inner, holding outer
+   unsigned long long hold_cycles;  // holding inner under outer
+} lock_edge_t;
+
+typedef struct _lock_order_t {
+   vector<lock_edge_t> edges;
+   unordered_map<unsigned long long, unsigned int> index;
+} lock_order_t;
+
+// Locks whose hold time is most dominated by inner lock waits, at
+// each stats dump
+#define LOCK_ORDER_TOP 10
+
+// Hand-off locks by owner spid, so a context switch finds the ones
+// the old pid holds without walking the lockmap.  A pid rarely holds
+// more than two (double_rq_lock).
+typedef unordered_map<spid_t, vector<lock_handle_t> > handoff_map_t;
+
 // Magic count of address spaces until rotation
 #define AS_COUNT 4096
 
@@ -311,6 +472,8 @@ typedef struct _as_data_t {
    WorkSet *asym_detector;
    int ad_count;
    int ref_count;
+   lock_order_t order;
+   handoff_map_t handoffs;
 } as_data_t;
 
 // Map pids to syncchar process data
@@ -339,9 +502,6 @@ typedef unordered_map<unsigned int, spcl_caller_map_t>::const_iterator
 typedef unordered_map<unsigned int, lock_spcl_caller_map_t>::const_iterator
    tx_spcl_caller_mapcit_t;
 
-// keep track of speculative spin data
-tx_spcl_caller_map_t spcl_map;
-
 
 // Information for breakpoint callback.
 struct bp_rec {
@@ -355,6 +515,30 @@ struct bp_rec {
    as_data_t *bp_as_data;
 };
 
+// What timing_operate needs for the spid running on a cpu: its
+// address space, the open worksets and the aggregate workset of each
+// one's lock.  Rebuilt when the spid changes or the generation moves.
+typedef struct _ws_cache_t {
+   unsigned int gen;
+   spid_t spid;
+   bool in_kernel;
+   as_data_t *as_data;
+   // In a critical section, sampled or not
+   bool in_cs;
+   // The sampled open worksets
+   vector<WorkSet*> open;
+   vector<WorkSet*> aggregate;
+} ws_cache_t;
+
+// Collect n of every m worksets
+typedef struct _ws_rate_t {
+   unsigned int n;
+   unsigned int m;
+   // For a per-caller rate, the caller's place in it
+   ws_sample_pos_t pos;
+} ws_rate_t;
+typedef unordered_map<unsigned int, ws_rate_t> ws_rate_map_t;
+
 // Per-syncchar instance information
 typedef struct _syncchar_data_t {
 
@@ -383,8 +567,86 @@ typedef struct _syncchar_data_t {
    // Also disable workset logging before boot to save space
    bool afterBoot;
 
+   // Compute data independence as worksets close, instead of (or as
+   // well as) from the workset log afterwards
+   bool onlineIndependence;
+
+   // Build the lock order graph as locks are taken (needs
+   // logWorksets, which tracks the locks each spid holds)
+   bool lockOrder;
+
+   // Workset sampling (ws_sample_* attributes).  Lock and unlock
+   // accounting stays exact; only the worksets of sampled critical
+   // sections grow.  sampling is set if any of these is.
+   bool sampling;
+   ws_rate_t sample_rate;
+   ws_rate_map_t sample_lock_rates;     // by lock address
+   ws_rate_map_t sample_caller_rates;   // by caller ra
+   // Collect only in the first sample_on of every sample_period
+   // cycles after boot, if sample_period is set
+   osa_cycles_t sample_on;
+   osa_cycles_t sample_period;
+   osa_cycles_t boot_cycle;
+   bool boot_cycle_known;
+   unsigned long long sample_rng;
+
+   // Per-cpu open workset cache.  Anything that opens, closes or
+   // moves a workset, replaces an aggregate workset or changes the
+   // as_data map must call invalidate_ws_cache().
+   ws_cache_t *ws_cache;
+   unsigned int ws_cache_gen;
+
+   // Per-cpu free lists for the records made at every lock
+   // breakpoint and critical section entry
+   pool<struct bp_rec> *bp_pool;
+   pool<WorkSet> *ws_pool;
+
+   // Compiled sync_char.maps by file name, shared by every address
+   // space that loads one.  A map replaced because its text changed
+   // stays mapped in all_maps, since ra labels point into it.
+   map<string, SyncCharMap *> maps;
+   vector<SyncCharMap *> all_maps;
+
+   // Binary event log (event_log attribute).  While it is open,
+   // closed worksets go there instead of into the stat stream.
+   EventLogWriter *event_log;
+   int event_log_codec;
+
+   // Lock timelines: epoch length in cycles (0 is off) and ring size
+   osa_cycles_t timeline_epoch;
+   unsigned int timeline_buckets;
+   // Buckets overwritten before a stats dump exported them
+   unsigned long long timeline_dropped;
+
+   // Locks with this name are hand-off locks (empty for none)
+   char handoff_name[LOCK_NAME_SIZE];
+
+   // keep track of speculative spin data
+   tx_spcl_caller_map_t spcl_map;
+
 } syncchar_data_t;
 
+static inline void invalidate_ws_cache(syncchar_data_t *syncchar){
+   syncchar->ws_cache_gen++;
+}
+
+// The worksets of critical sections come from ws_pool, on the list
+// of the cpu they are opened on.  Long lived ones (aggregate
+// worksets, asym detectors) are newed.
+static WorkSet *alloc_workset(syncchar_data_t *syncchar,
+                              unsigned int lk_addr, spid_t pid,
+                              unsigned int lk_generation,
+                              unsigned int ws_index, int cpu) {
+   return new(syncchar->ws_pool->get(cpu))
+      WorkSet(lk_addr, pid, lk_generation, ws_index, cpu);
+}
+
+static void free_workset(syncchar_data_t *syncchar, WorkSet *ws) {
+   int cpu = ws->cpu;
+   ws->~WorkSet();
+   syncchar->ws_pool->put(ws, cpu);
+}
+
 // Wrapper to send reads through osatxm if it is hooked up.  This way
 // we get the right data if our address is inside a transaction
 inline unsigned int read_4bytes(osamod_t * osamod,
@@ -426,6 +688,9 @@ static void insert_bps(osamod_t *osamod, as_data_t *as_data) {
 
 }
 
+static lock_handler_t resolve_lock_handler(unsigned int lock_id,
+                                           unsigned int flags);
+
 static void insert_ra(ra_map_t *ramap,
                       unsigned int lock_ra,  // return address of lock op
                       unsigned int lock_off, // addr of sync fn that owns instr
@@ -445,87 +710,95 @@ static void insert_ra(ra_map_t *ramap,
    ra.lock_reg    = lock_reg;
    ra.lock_id     = lock_id;
    ra.flags       = flags;
-   ra.label       = strdup(label); // Just leak for now
+   ra.label       = label;
+   ra.handler     = resolve_lock_handler(lock_id, flags);
+   // OSH cx_ special cased until I find the true meaning of F_EAX
+   // (and christmas)
+   ra.read_lkval  = lock_id == L_CXA || lock_id == L_CXE
+      || (flags & (F_NOADDR | F_EAX)) == 0;
    (*ramap)[lock_ra] = ra;
 }
 
-static void allocate_lock(short lock_id, osa_uinteger_t lock_addr, int lkval, char * label, osamod_t *osamod, as_data_t *as_data);
+static lock_handle_t allocate_lock(short lock_id, osa_uinteger_t lock_addr, int lkval, const char * label, osamod_t *osamod, as_data_t *as_data);
 
-static void read_ra2sync(FILE* f, osamod_t *osamod, int first_time, as_data_t *as_data) {
-   char buf[256];
-   char label[256];
-   char lock_reg[4];
-   unsigned int lock_ra, lock_off, lock_id, flags, func_pc;
+static void read_ra2sync(const SyncCharMap *scmap, osamod_t *osamod,
+                         int first_time, as_data_t *as_data) {
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
-   while(!feof(f)) {
-      int matched;
-      buf[0] = 0;
-      if(fgets(buf, 256, f) == NULL)
-         break;
-      // sscanf might not clear these values if it has a blank line
-      lock_ra = lock_off = lock_id = flags = func_pc = 0;
-      lock_reg[0] = 0;
-      matched = sscanf(buf, "%x %x %3s %d %x %x %255s", 
-                       &lock_ra, &lock_off, &lock_reg[0],
-                       &lock_id, &flags, &func_pc, &label[0]);
-      if(matched != 7 && buf[0] != 0) {
-         unsigned int lock_addr = 0;
-         int lock_val = 0;
-         // We could have a lock def
-         matched = sscanf(buf, "%x %d %d %255s",
-                          &lock_addr, &lock_id, &lock_val, &label[0]);
-                  
-         if(matched != 4){
-            pr("%s", buf);
-            pr("XXX sync_char.map bad record");
-         } else {
-            // We have a lock definition
-            allocate_lock(lock_id, lock_addr, lock_val, label, osamod, as_data);
-         }
-      } else {
-         if(lock_id > 255) {
-            pr("XXX [sync_char]: lock_id is > 255.  Ack!");
-         }
 
-         // Only set the breakpoints once
-         if(!first_time){
-            continue;
-         }
+   for(uint32_t i = 0; i < scmap->nlocks(); i++) {
+      // We have a lock definition
+      const scmap_lock_t &l = scmap->lock(i);
+      allocate_lock(l.lock_id, l.addr, l.value, scmap->label(l.label),
+                    osamod, as_data);
+   }
 
-         // Disable RW Semaphores until we can put more thought into
-         // how to instrument them
-         //if(lock_id == L_RSEMA || lock_id == L_WSEMA){
-         // Disable everything except spins for debugging
-         if(lock_id != L_SPIN && lock_id != L_CXA && lock_id != L_CXE){
-            continue;
-         }
-         
-         unsigned int lock_reg_int = (unsigned int) -1;
-         if(strcmp("nil", lock_reg) != 0) {
-            lock_reg_int = SIM_get_register_number(cpu, lock_reg);
-         }
-         insert_ra(&as_data->ramap, lock_ra, lock_off, lock_reg_int, lock_id, flags, func_pc, 
-                   label);
+   for(uint32_t i = 0; i < scmap->nras(); i++) {
+      const scmap_ra_t &r = scmap->ra(i);
+      if(r.lock_id > 255) {
+         pr("XXX [sync_char]: lock_id is > 255.  Ack!");
+      }
+
+      // Only set the breakpoints once
+      if(!first_time){
+         continue;
+      }
+
+      // Disable RW Semaphores until we can put more thought into
+      // how to instrument them
+      //if(lock_id == L_RSEMA || lock_id == L_WSEMA){
+      // Disable everything except spins for debugging
+      if(r.lock_id != L_SPIN && r.lock_id != L_CXA && r.lock_id != L_CXE){
+         continue;
+      }
+
+      char lock_reg[sizeof(r.lock_reg) + 1];
+      memcpy(lock_reg, r.lock_reg, sizeof(r.lock_reg));
+      lock_reg[sizeof(r.lock_reg)] = 0;
+      unsigned int lock_reg_int = (unsigned int) -1;
+      if(strcmp("nil", lock_reg) != 0) {
+         lock_reg_int = SIM_get_register_number(cpu, lock_reg);
       }
+      insert_ra(&as_data->ramap, r.ra, r.lock_off, lock_reg_int, r.lock_id,
+                r.flags, r.func_pc, scmap->label(r.label));
    }
 }
 
-int init_ras(osamod_t *osamod, as_data_t *as_data){
-   FILE* f = fopen(as_data->map_file_name, "r");
-   if(f == NULL) {
+// Find the compiled map for as_data's map file, compiling it on the
+// first load (or when the text has changed)
+static const SyncCharMap *get_map(osamod_t *osamod, as_data_t *as_data) {
+   syncchar_data_t *syncchar = osamod->syncchar;
+   map<string, SyncCharMap *>::iterator it =
+      syncchar->maps.find(as_data->map_file_name);
+   if(it != syncchar->maps.end() && !it->second->stale())
+      return it->second;
+
+   string err;
+   SyncCharMap *scmap = SyncCharMap::load(as_data->map_file_name, err);
+   if(scmap == NULL) {
       char buf[128];
-      perror("Failure to open sync_char mapfile");
+      fprintf(stderr, "Failure to open sync_char mapfile: %s\n",
+              err.c_str());
       if(getcwd(buf, 128) == NULL)
          fprintf(stderr, "Can't even look up CWD: %d\n", errno);
       else 
          fprintf(stderr, "CWD: %s\n", buf);
-      return -1;
+      return NULL;
    }
-   read_ra2sync(f, osamod, as_data->ramap.size() == 0,
-                as_data);
-   if( fclose(f) < 0 ) {
-      perror("fclose");
+   for(unsigned int i = 0; i < scmap->bad_records().size(); i++) {
+      pr("%s", scmap->bad_records()[i].c_str());
+      pr("XXX sync_char.map bad record");
    }
+   syncchar->maps[as_data->map_file_name] = scmap;
+   syncchar->all_maps.push_back(scmap);
+   return scmap;
+}
+
+int init_ras(osamod_t *osamod, as_data_t *as_data){
+   const SyncCharMap *scmap = get_map(osamod, as_data);
+   if(scmap == NULL)
+      return -1;
+   read_ra2sync(scmap, osamod, as_data->ramap.size() == 0,
+                as_data);
    return 0;
 }
 
@@ -549,8 +822,8 @@ static void update_avgs(avg_var av[3], long double value, double split) {
    av[i].cnt++;
 }
 
-static void update_cyc_avgs(avg_var av[3], osa_cycles_t now_cyc, osa_cycles_t start_cyc,
-                       osamod_t *osamod) {
+static void update_cyc_hist(LatencyHist &hist, osa_cycles_t now_cyc,
+                            osa_cycles_t start_cyc, osamod_t *osamod) {
    osa_cycles_t cyc;
    if(start_cyc == (osa_cycles_t)0) {
       *osamod->pStatStream << "XXX update_Avg\n";
@@ -572,7 +845,7 @@ static void update_cyc_avgs(avg_var av[3], osa_cycles_t now_cyc, osa_cycles_t st
 
       if((cyc * -1) > av.u.integer){
          // This is something to be worried about
-         cout << "XXX: update_cyc_avgs negative cycles " << cyc 
+         cout << "XXX: update_cyc_hist negative cycles " << cyc 
               << ", now_cyc = " << now_cyc << ", start_cyc = " << start_cyc
               << ", Switch time = " << av.u.integer << endl;
       }
@@ -580,7 +853,72 @@ static void update_cyc_avgs(avg_var av[3], osa_cycles_t now_cyc, osa_cycles_t st
    }
 
 
-   update_avgs(av, (long double)cyc, (double)1000);
+   hist.record(cyc);
+}
+
+static void log_lock_timeline(syncchar_data_t *syncchar,
+                              unsigned int lock_addr, const struct lock *lock);
+
+// The lock's bucket for the epoch of cycle now, reusing the ring slot
+// of an older epoch.  NULL if the slot already holds a newer epoch
+// (cpu clocks are not exactly in step).
+static tl_bucket_t *timeline_bucket(syncchar_data_t *syncchar,
+                                    unsigned int lock_addr, struct lock *lk,
+                                    osa_cycles_t now) {
+   struct lock_timeline *tl = lk->cold->tl;
+   if(tl == NULL) {
+      tl = lk->cold->tl = new struct lock_timeline;
+      tl_bucket_t empty;
+      memset(&empty, 0, sizeof(empty));
+      empty.epoch = TL_EMPTY;
+      tl->ring.assign(syncchar->timeline_buckets, empty);
+      tl->newest = 0;
+      tl->exported = 0;
+   }
+
+   unsigned long long epoch = now < 0 ? 0 : now / syncchar->timeline_epoch;
+   tl_bucket_t *b = &tl->ring[epoch % tl->ring.size()];
+   if(b->epoch != epoch) {
+      if(b->epoch != TL_EMPTY && b->epoch > epoch)
+         return NULL;
+      if(b->epoch != TL_EMPTY && b->epoch >= tl->exported) {
+         if(syncchar->event_log != NULL) {
+            // Every epoch in the ring is older than this one, so done
+            log_lock_timeline(syncchar, lock_addr, lk);
+            tl->exported = tl->newest + 1;
+         } else {
+            syncchar->timeline_dropped++;
+         }
+      }
+      memset(b, 0, sizeof(*b));
+      b->epoch = epoch;
+      if(epoch > tl->newest)
+         tl->newest = epoch;
+   }
+   return b;
+}
+
+static void timeline_acquire(syncchar_data_t *syncchar, unsigned int lock_addr,
+                             struct lock *lk, osa_cycles_t now,
+                             osa_cycles_t req_cyc, bool waited) {
+   tl_bucket_t *b = timeline_bucket(syncchar, lock_addr, lk, now);
+   if(b == NULL)
+      return;
+   b->acquires++;
+   if(waited)
+      b->contended++;
+   if(now > req_cyc && (unsigned long long)(now - req_cyc) > b->max_wait)
+      b->max_wait = now - req_cyc;
+}
+
+// Counted in the epoch of the release, like hold_hist
+static void timeline_release(syncchar_data_t *syncchar, unsigned int lock_addr,
+                             struct lock *lk, osa_cycles_t now,
+                             osa_cycles_t acq_cyc) {
+   tl_bucket_t *b = timeline_bucket(syncchar, lock_addr, lk, now);
+   if(b == NULL)
+      return;
+   b->hold_cycles += (acq_cyc != 0 && now > acq_cyc) ? now - acq_cyc : 1;
 }
 
 static void print_log(const char* str, int param, const struct transition_info* t,
@@ -670,20 +1008,20 @@ static void _record_contention(spid_t spid, struct lock *lk,
          // Make sure we don't add the same lock more than once when
          // we are spinning
          for( vector<WorksetID>::iterator iter = 
-                 (*lk->callers)[t->caller_ra].contended_worksets.begin();
-              iter != (*lk->callers)[t->caller_ra].contended_worksets.end();
+                 (*lk->cold->callers)[t->caller_ra].contended_worksets.begin();
+              iter != (*lk->cold->callers)[t->caller_ra].contended_worksets.end();
               iter++){
             if(*(iter) == wsit->second->id){
                goto NEXT_LOOP; // break only goes up one loop.  grrr...
             }
          }
          
-         (*lk->callers)[t->caller_ra].contended_worksets.push_back(wsit->second->id);
+         (*lk->cold->callers)[t->caller_ra].contended_worksets.push_back(wsit->second->id);
          
          // Increment q_count 
          // Do it here rather than every time we call so that we don't
          // get a false bias. 
-         (*lk->callers)[t->caller_ra].q_count++;
+         (*lk->cold->callers)[t->caller_ra].q_count++;
 
       NEXT_LOOP:
          check++;
@@ -722,9 +1060,10 @@ static void record_contention(struct lock *lk, struct transition_info *t, osamod
 #endif
       }
 
-      for(reader_mapcit_t reader = lk->readers.begin();
-          reader != lk->readers.end(); reader++){
-         _record_contention(reader->first, lk, t, osamod);
+      vector<spid_t> readers;
+      lk->readers.keys(readers);
+      for(unsigned int i = 0; i < readers.size(); i++){
+         _record_contention(readers[i], lk, t, osamod);
       }
    } else {
       _record_contention(lk->spid_owner, lk, t, osamod);
@@ -779,8 +1118,9 @@ static void lock_spid_info(struct spid_info* spi,
       spi->acq_ra  = t->caller_ra;
    }
    // Every lock means our request is over
-   struct lock* lk = &as_data->lockmap[t->lock_addr];
+   struct lock* lk = t->lk;
    (*lk->acq)[t->spid].req_cyc = 0ULL;
+   (*lk->acq)[t->spid].rd_blocked = false;
 #ifdef DBG_LK_ADDR
    if(t->lock_addr == DBG_LK_ADDR)
       print_log("  lock cnt ", spi->cnt, t);
@@ -797,8 +1137,8 @@ static void caller_zero(struct caller* caller) {
    caller->q_count_dependent_conflicting_bytes = 0;
    */
    caller->useless_release = 0;
-   zero_av(caller->acq_av);
-   zero_av(caller->hold_av);
+   caller->acq_hist.clear();
+   caller->hold_hist.clear();
    
    // Go ahead and dump the contended worksets for each lock
    caller->contended_worksets.clear();
@@ -806,20 +1146,19 @@ static void caller_zero(struct caller* caller) {
 
 static void dbg_breakpoint_callback(conf_object_t *trigger_obj,
                                     lang_void* _bp_rec) {
-#ifdef DBG_LK_ADDR
-   struct bp_rec *bp_rec = (struct bp_rec*)_bp_rec;
+   osamod_t *osamod = (osamod_t *) trigger_obj;
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
    int cpuNum = osamod->minfo->getCpuNum(cpu);
-   MM_FREE(bp_rec);
-   bp_rec = 0;
-   spid_t spid = current_process[cpuNum];
+   osamod->syncchar->bp_pool->put(_bp_rec, cpuNum);
+#ifdef DBG_LK_ADDR
+   spid_t spid = os_current_spid(osamod->os, cpuNum);
    int lkval = read_4bytes(osamod, cpu, DATA_SEGMENT, DBG_LK_ADDR);
-   *pStatStream << "DBG PC " << hex 
-                << SIM_get_program_counter(cpu)
-                << " lkval " << lkval
-                << dec 
-                << " spid " << spid
-                << endl;
+   *osamod->pStatStream << "DBG PC " << hex 
+                        << SIM_get_program_counter(cpu)
+                        << " lkval " << lkval
+                        << dec 
+                        << " spid " << spid
+                        << endl;
 #endif
 }
 
@@ -827,56 +1166,112 @@ static void print_lock(ostream *stat_str, unsigned int lock_addr,
                        const struct lock *lock, as_data_t *as_data);
 
 
-static void allocate_lock(short lock_id, osa_uinteger_t lock_addr, int lkval, 
-                          char * label, osamod_t *osamod, 
-                          as_data_t *as_data){
+static void print_lock_di(ostream *stat_str, unsigned int lock_addr,
+                          const struct lock *lock);
+static void print_lock_sample(ostream *stat_str, unsigned int lock_addr,
+                              const struct lock *lock);
+static void free_lock_di(struct lock_di *di, syncchar_data_t *syncchar);
+
+static void free_lock(struct lock *lock, syncchar_data_t *syncchar){
+   free_lock_di(lock->cold->di, syncchar);
+   delete lock->cold->tl;
+   delete lock->cold->rw;
+   delete lock->acq;
+   delete lock->cold->callers;
+   delete lock->cold;
+   delete lock->aggregate_workset;
+}
+
+static bool is_handoff_name(const syncchar_data_t *syncchar,
+                            const char *name) {
+   return syncchar->handoff_name[0] != 0
+      && strncmp(name, syncchar->handoff_name, LOCK_NAME_SIZE) == 0;
+}
+
+static void handoff_own(as_data_t *as_data, lock_handle_t handle,
+                        spid_t owner) {
+   as_data->handoffs[owner].push_back(handle);
+}
+
+static void handoff_disown(as_data_t *as_data, lock_handle_t handle,
+                           spid_t owner) {
+   handoff_map_t::iterator it = as_data->handoffs.find(owner);
+   if(it == as_data->handoffs.end())
+      return;
+   vector<lock_handle_t> &held = it->second;
+   for(unsigned int i = 0; i < held.size(); i++) {
+      if(held[i] == handle) {
+         held[i] = held.back();
+         held.pop_back();
+         break;
+      }
+   }
+   if(held.empty())
+      as_data->handoffs.erase(it);
+}
+
+static lock_handle_t allocate_lock(short lock_id, osa_uinteger_t lock_addr,
+                                   int lkval, const char * label, osamod_t *osamod, 
+                                   as_data_t *as_data){
    int generation = 0;
 
-   // Log the old lock if there is already one here
-   lock_mapit_t iter = as_data->lockmap.find(lock_addr);
-   if( iter != as_data->lockmap.end() ) {
+   // Log the old lock if there is already one here.  The new
+   // generation reuses its slot, so open handles follow the address.
+   lock_handle_t handle = as_data->lockmap.find(lock_addr);
+   if( handle != LOCK_HANDLE_NONE ) {
       
       // Print the old lock out to the log
-      struct lock *old_lock = &(iter->second);
+      struct lock *old_lock = as_data->lockmap.get(handle);
       print_lock(osamod->pStatStream, lock_addr, old_lock, as_data);
+      print_lock_di(osamod->pStatStream, lock_addr, old_lock);
+      if(osamod->syncchar->sampling)
+         print_lock_sample(osamod->pStatStream, lock_addr, old_lock);
+      if(osamod->syncchar->event_log && old_lock->cold->tl)
+         log_lock_timeline(osamod->syncchar, lock_addr, old_lock);
 
       // Get the old lock's generation number, increment
       generation = old_lock->generation + 1;
+      if(old_lock->handoff && old_lock->spid_owner != (spid_t)-1)
+         handoff_disown(as_data, handle, old_lock->spid_owner);
 
       // Clean up the memory
-      delete old_lock->acq;
-      delete old_lock->callers;
-      delete old_lock->aggregate_workset;
-
-      as_data->lockmap.erase(iter);
+      free_lock(old_lock, osamod->syncchar);
+      invalidate_ws_cache(osamod->syncchar);
+   } else {
+      handle = as_data->lockmap.insert(lock_addr);
    }
 
    // New lock address
-   struct lock lock;
-   lock.state = LKST_OPEN;
-   lock.queue = false;
-   lock.lkval = lkval,
-   lock.lock_id = lock_id;
-   lock.spid_owner = (spid_t)-1;
-   lock.generation = generation;
-   lock.workset_count = 0;
-   lock.acq = new acq_map_t();
+   struct lock *lock = as_data->lockmap.get(handle);
+   lock->state = LKST_OPEN;
+   lock->queue = false;
+   lock->lkval = lkval,
+   lock->lock_id = lock_id;
+   lock->spid_owner = (spid_t)-1;
+   lock->generation = generation;
+   lock->workset_count = 0;
+   lock->readers.clear();
+   lock->acq = new acq_map_t();
+   lock->addr = lock_addr;
+
+   lock->cold = new struct lock_cold;
    // Allocate array of callers of this lock address
-   lock.callers = new caller_map_t();
-   lock.addr = lock_addr;
-
-   memset(lock.name, 0, LOCK_NAME_SIZE);
+   lock->cold->callers = new caller_map_t();
+   memset(lock->cold->name, 0, LOCK_NAME_SIZE);
    if(label != NULL){
-      strcpy(lock.name, label);
+      strcpy(lock->cold->name, label);
    }
-   lock.aggregate_workset = new WorkSet(lock_addr, 0, generation, 0xffffffff, 0);
-   zero_av(lock.nest_av);
-   /*
-   zero_av(lock.depend_av);
-   zero_av(lock.total_av);
-   zero_av(lock.percent_av);
-   */
-   as_data->lockmap[lock_addr] = lock;
+   lock->handoff = is_handoff_name(osamod->syncchar, lock->cold->name);
+   lock->aggregate_workset = new WorkSet(lock_addr, 0, generation, 0xffffffff, 0);
+   lock->cold->nest_hist.clear();
+   lock->cold->di = NULL;
+   lock->cold->ws_opened = 0;
+   lock->cold->ws_sampled = 0;
+   lock->cold->ws_pos.seq = 0;
+   lock->cold->ws_pos.chosen = 0;
+   lock->cold->tl = NULL;
+   lock->cold->rw = NULL;
+   return handle;
 }
 
 static void initialize_transition(struct transition_info* t,
@@ -892,31 +1287,28 @@ static void initialize_transition(struct transition_info* t,
    t->caller_ra = bp_rec->caller_ra;
    t->bp_cyc    = bp_rec->cyc;
    t->bp_lkval  = bp_rec->bp_lkval;
-   MM_FREE(bp_rec);
+   osamod->syncchar->bp_pool->put(bp_rec, cpuNum);
    bp_rec = 0;
-   t->spid = osamod->os->current_process[cpuNum];
+   t->spid = os_current_spid(osamod->os, cpuNum);
    // Keep track of lock state
    t->now_cyc = osa_get_sim_cycle_count(cpu);
    ra_mapcit_t raci = as_data->ramap.find(t->lock_ra);
    t->lock_id = raci->second.lock_id;
    t->lock_addr = get_lock_addr(raci, cpu);
    t->flags = raci->second.flags;
+   t->handler = raci->second.handler;
    if( t->flags & F_NOADDR ) {
       // Store all RCU records at 1
       t->lock_addr = 1;
    }
    t->lkval = 0xdeadbeef;
-
-   // OSH cx_ special cased until I find the true meaning of
-   // F_EAX (and christmas)
-   if(t->lock_id == L_CXA || t->lock_id == L_CXE) {
+   if(raci->second.read_lkval) {
       t->lkval = read_4bytes(osamod, cpu, DATA_SEGMENT, t->lock_addr);
    }
-   else if( (t->flags & F_NOADDR) == 0 && (t->flags & F_EAX) == 0 ) {
-      t->lkval = read_4bytes(osamod, cpu, DATA_SEGMENT, t->lock_addr);
-   }
-   if( as_data->lockmap.find(t->lock_addr) == as_data->lockmap.end() ) {
-      allocate_lock(t->lock_id, t->lock_addr, t->bp_lkval, NULL, osamod, as_data);
+   t->lock = as_data->lockmap.find(t->lock_addr);
+   if( t->lock == LOCK_HANDLE_NONE ) {
+      t->lock = allocate_lock(t->lock_id, t->lock_addr, t->bp_lkval, NULL,
+                              osamod, as_data);
 
       if(t->lock_id == L_SPIN || t->lock_id == L_CXE || t->lock_id == L_CXA){
          *osamod->pStatStream << "XXX: Noname spinlock: " << std::hex << t->lock_addr << std::dec << endl;
@@ -928,20 +1320,21 @@ static void initialize_transition(struct transition_info* t,
 
       struct caller caller;
       caller_zero(&caller);
-      (*as_data->lockmap[t->lock_addr].callers)[t->caller_ra] = caller;
+      (*as_data->lockmap.get(t->lock)->cold->callers)[t->caller_ra] = caller;
    }
-   if( as_data->lockmap[t->lock_addr].callers->find(t->caller_ra) ==
-         as_data->lockmap[t->lock_addr].callers->end() ) {
-      caller_zero(&(*as_data->lockmap[t->lock_addr].callers)[t->caller_ra]);
+   struct lock* lk = as_data->lockmap.get(t->lock);
+   t->lk = lk;
+   caller_map_t *callers = lk->cold->callers;
+   if( callers->find(t->caller_ra) == callers->end() ) {
+      caller_zero(&(*callers)[t->caller_ra]);
    }
 
-   t->old_state     = as_data->lockmap[t->lock_addr].state;
-   struct lock* lk = &as_data->lockmap[t->lock_addr];
+   t->old_state     = lk->state;
    t->spid_owner    = lk->spid_owner;
 
    // Record old lkval and update with new value
-   t->old_lkval     = as_data->lockmap[t->lock_addr].lkval;
-   as_data->lockmap[t->lock_addr].lkval = t->lkval;
+   t->old_lkval     = lk->lkval;
+   lk->lkval = t->lkval;
    // Allocate and zero spid_info record
    if((*lk->acq).find(t->spid) == (*lk->acq).end()) {
       struct spid_info spi;
@@ -950,19 +1343,23 @@ static void initialize_transition(struct transition_info* t,
    }
 
 }
+// The lock state machines are instantiated for each lock type and
+// F_UNLOCK (and, for detect_read_lock_unlock, F_LOCK) flag by
+// resolve_lock_handler, so the tests on those fold away
+template <unsigned int ID, bool UNLOCK>
 static short update_current_lock_state(const struct transition_info* t,
-                                       osamod_t *osamod, as_data_t *as_data) {
+                                       osamod_t *osamod) {
 
-   struct lock* lk = &as_data->lockmap[t->lock_addr];
+   struct lock* lk = t->lk;
    // Update current state
    lk->queue = false;  // Is there anyone waiting?
    unsigned int ebx, ecx, edx;
    osa_cpu_object_t *cpu;
-   switch(t->lock_id) {
+   switch(ID) {
    case L_SEMA:
       // up() is a bit of a special case.  It always releases the lock
       // by incrementing its value, even if it goes from -1 to 0.
-      if(((t->flags & F_UNLOCK) != 0)
+      if(UNLOCK
          && (t->lkval > t->old_lkval)){
          lk->state = LKST_OPEN;
          break;
@@ -971,8 +1368,8 @@ static short update_current_lock_state(const struct transition_info* t,
    case L_COMPL:
       if( t->lkval < 1 ){
          lk->state = LKST_WRLK;
-         if(t->lock_id == L_MUTEX
-            || t->lock_id == L_SEMA){
+         if(ID == L_MUTEX
+            || ID == L_SEMA){
             // Any time a semaphore or mutex goes from locked->locked,
             // assume we are waiting
             lk->queue = true;
@@ -1014,9 +1411,9 @@ static short update_current_lock_state(const struct transition_info* t,
    case L_WSPIN:
 
       // Unlock in reader/writer locks is tricky, hence we split them out
-      if(((t->flags & F_UNLOCK) != 0)){
+      if(UNLOCK){
 
-         if(t->lock_id == L_RSPIN){
+         if(ID == L_RSPIN){
             // If we are a read unlock, we are open iff the value mod
             // 0x10000000 is zero (e.g. 0, 0x10000000, -0x1000000, etc).
             // Otherwise, we are just one of a number of readers
@@ -1084,7 +1481,7 @@ static short update_current_lock_state(const struct transition_info* t,
       }
       break;
    case L_CXE:
-      if(t->flags & F_UNLOCK) {
+      if(UNLOCK) {
          if(t->lkval != 1 || t->old_state != LKST_WRLK) {
             print_log("XXX cx_end result/lkval/old_state inconsistency!",
                   0, t, osamod);
@@ -1109,6 +1506,7 @@ static short update_current_lock_state(const struct transition_info* t,
    return lk->state;
 }
 // Must be done after new_state is initialized
+template <unsigned int ID, bool UNLOCK, bool LOCK>
 static void detect_read_lock_unlock(struct transition_info *t,
                                     osamod_t *osamod) {
    // Detect read locks/unlocks unlocks by examining the state of the
@@ -1132,7 +1530,7 @@ static void detect_read_lock_unlock(struct transition_info *t,
    if(t->new_state == LKST_OPEN
       || (t->old_state == t->new_state
           && t->old_state == LKST_RLK)) {
-      if(t->lock_id == L_RSPIN || t->lock_id == L_WSPIN) {
+      if(ID == L_RSPIN || ID == L_WSPIN) {
          // Read spin locks count down
 
          // RW spin locks should also use the bp_lkval, as there are
@@ -1144,21 +1542,21 @@ static void detect_read_lock_unlock(struct transition_info *t,
          // get a transition from 0x01000000 -> 0x00ffffff, and one
          // from 0x0100000 -> 0x00ffffffe.
 
-         if(t->lock_id == L_RSPIN){
-            if((t->flags & F_UNLOCK) != 0
+         if(ID == L_RSPIN){
+            if(UNLOCK
                && t->lkval >= t->bp_lkval){
                t->read_unlock = true;
             }
 
             if(t->lkval > 0 && t->lkval < 0x01000000
-               && (t->flags & F_LOCK) != 0){
+               && LOCK){
                t->read_lock = true;
             }            
          }
 
          return;
       }
-      if(t->lock_id == L_RSEMA || t->lock_id == L_WSEMA) {
+      if(ID == L_RSEMA || ID == L_WSEMA) {
          // Read semapohres cout up
          lk_incr = 1;
       }
@@ -1172,9 +1570,9 @@ static void detect_read_lock_unlock(struct transition_info *t,
    }
 }
 
-// Encapsulate special case where a runqueue lock changes owners along
-// the way
-static lockset_mapcit_t get_lsit(spid_t spid, const char *name, spid_t spid_owner, 
+// Encapsulate special case where a hand-off lock (the runqueue lock)
+// changes owners along the way
+static lockset_mapcit_t get_lsit(spid_t spid, bool handoff, spid_t spid_owner, 
                                  as_data_t *as_data){
    lockset_mapcit_t lsit = as_data->locksetmap.find(spid);
 
@@ -1187,72 +1585,192 @@ static lockset_mapcit_t get_lsit(spid_t spid, const char *name, spid_t spid_owne
     * acquired it (spid_owner)
     *
     */
-   if(0== strncmp(name, "runqueue_t->lock", LOCK_NAME_SIZE)){
+   if(handoff){
       lsit = as_data->locksetmap.find(spid_owner);
    }
 
    return lsit;
 }
 
-// Keep the algorithmically interesting part of the old code around
-// until we get the post-processing stage done
-#if 0
-static void archive_workset(workset_list_t *worksets, workset_listit_t wsit,
-      struct transition_info *t, osamod_t *osamod) {
-
-   // remove workset from list
-   WorkSet *ws = wsit->second;
-   worksets->erase(wsit);
-
-   // compare to the previous group of worksets for this lock
-   struct lock *lk = &osamod->syncchar->lockmap[t->lock_addr];
-   deque<WorkSet*>::const_iterator prevws_it;
-   for(prevws_it = lk->worksets.begin(); prevws_it != lk->worksets.end();
-         prevws_it++) {
-      WorkSet *other = *prevws_it;
-      // Filter comparisons to locks in same workset
-      if(other->pid == ws->pid){
-         continue;
-      }
+static struct lock_di *new_lock_di(int archived) {
+   struct lock_di *di = new struct lock_di;
+   unsigned int size = min(archived, DI_MAX_ARCHIVE);
+   di->ring.assign(size, (WorkSet *)NULL);
+   di->head = 0;
+   di->count = 0;
+   di->words = (size + 63) / 64;
+   di->conflicts.assign(size * di->words, 0ULL);
+   zero_av(di->depend_av);
+   zero_av(di->total_av);
+   zero_av(di->percent_av);
+   di->closes = 0;
+   memset(di->cpus, 0, sizeof(di->cpus));
+   return di;
+}
 
-      // Filter second pid if we are a runqueue lock
-      if(other->twoowners && ws->twoowners
-         && other->old_pid == ws->old_pid){
-         continue;
+static void free_lock_di(struct lock_di *di, syncchar_data_t *syncchar) {
+   if(di == NULL)
+      return;
+   for(unsigned int i = 0; i < di->ring.size(); i++)
+      if(di->ring[i] != NULL)
+         free_workset(syncchar, di->ring[i]);
+   delete di;
+}
+
+static inline bool di_conflict(const struct lock_di *di,
+                               unsigned int a, unsigned int b) {
+   return (di->conflicts[a * di->words + b / 64] >> (b % 64)) & 1;
+}
+
+// Pairs of worksets that may come from the same thread, which can't
+// conflict with each other
+static bool di_same_owner(const WorkSet *ws, const WorkSet *other) {
+   if(other->pid == ws->pid)
+      return true;
+
+   // Filter second pid if we are a runqueue lock
+   if(other->twoowners && ws->twoowners
+      && other->old_pid == ws->old_pid)
+      return true;
+   if(other->twoowners
+      && other->old_pid == ws->pid)
+      return true;
+   if(ws->twoowners
+      && ws->old_pid == other->pid)
+      return true;
+   return false;
+}
+
+// Sample the first k of members (ring slots, one per pid) as
+// calculate_new_data_independence does: a workset is conflicting if
+// it conflicts with any other in the sample
+static void di_sample(const struct lock_di *di, const unsigned int *members,
+                      unsigned int k, di_cpus_t *out) {
+   unsigned int conflicting[DI_MAX_CPUS];
+   unsigned int nconflicting = 0;
+   for(unsigned int j = 0; j < k; j++) {
+      for(unsigned int l = 0; l < k; l++) {
+         if(l != j && di_conflict(di, members[j], members[l])) {
+            conflicting[nconflicting++] = members[j];
+            break;
+         }
       }
-      if(other->twoowners
-         && other->old_pid == ws->pid){
+   }
+
+   // Conflicts are symmetric, so there are none or at least two
+   double density = 0.0;
+   for(unsigned int x = 0; x < nconflicting; x++) {
+      unsigned int local = 0;
+      for(unsigned int y = 0; y < nconflicting; y++)
+         if(y != x && di_conflict(di, conflicting[x], conflicting[y]))
+            local++;
+      density += (double)local / (double)(nconflicting - 1);
+   }
+
+   out->samples++;
+   out->conflicting += nconflicting;
+   out->completions += k - nconflicting;
+   out->threads += k;
+   out->density += density;
+   out->hist[nconflicting ? (nconflicting * 10 + k - 1) / k : 0]++;
+}
+
+// Take ownership of a closed workset: compare it with the archive,
+// sample, then put it in the archive in place of the oldest one
+static void archive_workset(struct lock *lk, WorkSet *ws,
+                            syncchar_data_t *syncchar) {
+   struct lock_di *di = lk->cold->di;
+   if(di == NULL)
+      di = lk->cold->di = new_lock_di(syncchar->archived_worksets);
+
+   unsigned int size = di->ring.size();
+   unsigned int slot = di->head;
+   if(di->count == size) {
+      free_workset(syncchar, di->ring[slot]);
+      di->count--;
+   }
+   for(unsigned int i = 0; i < di->words; i++)
+      di->conflicts[slot * di->words + i] = 0;
+   for(unsigned int i = 0; i < size; i++)
+      di->conflicts[i * di->words + slot / 64] &= ~(1ULL << (slot % 64));
+
+   // The sample: this workset, then the newest workset of each other
+   // pid, newest first
+   unsigned int members[DI_MAX_CPUS];
+   spid_t member_pids[DI_MAX_CPUS];
+   unsigned int nmembers = 1;
+   members[0] = slot;
+   member_pids[0] = ws->pid;
+
+   for(unsigned int i = 0; i < di->count; i++) {
+      unsigned int other_slot = (slot + size - 1 - i) % size;
+      WorkSet *other = di->ring[other_slot];
+      if(di_same_owner(ws, other))
          continue;
+
+      int depends, ws_size;
+      depends = ws->compare(other, &ws_size);
+      update_avgs(di->depend_av, (long double)depends, (double)0.5);
+      update_avgs(di->total_av, (long double)ws_size, (double)100);
+      update_avgs(di->percent_av,
+                  ws_size > 0 ? (long double)depends / (long double)ws_size : 0,
+                  0.1);
+
+      // IO counts as a conflict, as in the post-processing
+      if(depends > 0 || ws->IO || other->IO) {
+         di->conflicts[slot * di->words + other_slot / 64]
+            |= 1ULL << (other_slot % 64);
+         di->conflicts[other_slot * di->words + slot / 64]
+            |= 1ULL << (slot % 64);
       }
-      if(ws->twoowners
-         && ws->old_pid == other->pid){
-         continue;
+
+      if(nmembers < DI_MAX_CPUS
+         && find(member_pids, member_pids + nmembers, other->pid)
+            == member_pids + nmembers) {
+         members[nmembers] = other_slot;
+         member_pids[nmembers] = other->pid;
+         nmembers++;
       }
+   }
 
-      
-      int depends, size;
-      depends = ws->compare(other, &size);
-      update_avgs(lk->depend_av, (long double)depends, (double)0.5);
-      update_avgs(lk->total_av, (long double)size, (double)100);
-      update_avgs(lk->percent_av,
-                  size > 0 ? (long double)depends / (long double)size : 0, 0.1);
-   }
-
-   // place workset on queue for this lock
-   lk->worksets.push_front(ws);
-   if(lk->worksets.size() > (unsigned int)(osamod->syncchar->archived_worksets)) {
-      WorkSet *oldws = lk->worksets.back();
-      lk->worksets.pop_back();
-      if(oldws->refs == 1){
-         delete oldws;
-      } else {
-         oldws->refs--;
+   di->ring[slot] = ws;
+   di->head = (slot + 1) % size;
+   di->count++;
+   di->closes++;
+   di->pids[ws->pid]++;
+
+   // Samples for the smaller cpu counts are prefixes of the larger
+   // ones; once the pids run out they are all the same sample
+   di_cpus_t sample;
+   unsigned int last_k = 0;
+   for(int c = 0; c < DI_NCPU_COUNTS; c++) {
+      unsigned int k = min(di_cpu_counts[c], nmembers);
+      if(k != last_k) {
+         memset(&sample, 0, sizeof(sample));
+         di_sample(di, members, k, &sample);
+         last_k = k;
       }
+      di_cpus_t *out = &di->cpus[c];
+      out->samples += sample.samples;
+      out->conflicting += sample.conflicting;
+      out->completions += sample.completions;
+      out->threads += sample.threads;
+      out->density += sample.density;
+      for(int b = 0; b < DI_HIST_BINS; b++)
+         out->hist[b] += sample.hist[b];
    }
+}
 
+// Log a closed workset to the event log if there is one, otherwise
+// as a WS_CLOSE entry in the stat stream
+static void log_workset(osamod_t *osamod, WorkSet *ws) {
+   EventLogWriter *event_log = osamod->syncchar->event_log;
+   if(event_log){
+      event_log->ws_close(ws, osa_get_sim_cycle_count(OSA_get_sim_cpu()));
+   } else {
+      ws->logWorkset(*osamod->pStatStream);
+   }
 }
-// #if 0
-#endif
 
 static void close_workset(struct transition_info *t, osamod_t *osamod, 
                           as_data_t *as_data) {
@@ -1262,8 +1780,7 @@ static void close_workset(struct transition_info *t, osamod_t *osamod,
    // from the current spid, and place it in the list
    // of old worksets covered by this lock
 
-   lock_mapcit_t lock_cit = as_data->lockmap.find(t->lock_addr);
-   lockset_mapcit_t lsit = get_lsit(t->spid, lock_cit->second.name,
+   lockset_mapcit_t lsit = get_lsit(t->spid, t->lk->handoff,
                                     t->spid_owner, as_data);
 
    if(lsit == as_data->locksetmap.end()) {
@@ -1280,19 +1797,28 @@ static void close_workset(struct transition_info *t, osamod_t *osamod,
    workset_listit_t wsit;
    int found = 0;
    for(wsit = worksets->begin(); wsit != worksets->end(); wsit++) {
-      if(wsit->first == lock_cit) {
+      if(wsit->first == t->lock) {
          found = 1;
          
          if(--(wsit->second->cnt) <= 0){
-            // Don't archive it - just log and delete
-            //archive_workset(worksets, wsit, t, osamod);
+            // Log it, then archive it if we are computing data
+            // independence online, otherwise delete it
             WorkSet *ws = wsit->second;
             if(syncchar->logWorksets
-               && syncchar->afterBoot){
-               ws->logWorkset(*osamod->pStatStream);
+               && syncchar->afterBoot
+               && ws->sampled){
+               log_workset(osamod, ws);
             }
             worksets->erase(wsit);
-            delete ws;
+            if(syncchar->onlineIndependence
+               && syncchar->afterBoot
+               && syncchar->archived_worksets > 0
+               && ws->sampled){
+               archive_workset(t->lk, ws, syncchar);
+            } else {
+               free_workset(syncchar, ws);
+            }
+            invalidate_ws_cache(syncchar);
          }
          break;
       }
@@ -1313,38 +1839,99 @@ static void close_workset(struct transition_info *t, osamod_t *osamod,
       as_data->ad_count = 0;
       if(syncchar->logWorksets 
          && syncchar->afterBoot)
-         as_data->asym_detector->logWorkset(*osamod->pStatStream);
+         log_workset(osamod, as_data->asym_detector);
       delete as_data->asym_detector;
       as_data->asym_detector = new WorkSet(lock_addr, t->spid, 0, 0xffffffff, 0);
    }
 }
 
+static lock_edge_t *find_edge(lock_order_t *order, lock_handle_t outer,
+                              lock_handle_t inner, bool create) {
+   unsigned long long key = ((unsigned long long)outer << 32) | inner;
+   unordered_map<unsigned long long, unsigned int>::iterator it =
+      order->index.find(key);
+   if(it != order->index.end())
+      return &order->edges[it->second];
+   if(!create)
+      return NULL;
+   lock_edge_t e;
+   e.outer = outer;
+   e.inner = inner;
+   e.count = 0;
+   e.wait_cycles = 0;
+   e.hold_cycles = 0;
+   order->index[key] = order->edges.size();
+   order->edges.push_back(e);
+   return &order->edges.back();
+}
+
+// t->spid acquired t->lock after waiting wait cycles: an edge from
+// every other lock it holds
+static void order_acquire(struct transition_info *t, as_data_t *as_data,
+                          osa_cycles_t wait) {
+   lockset_mapcit_t lsit = as_data->locksetmap.find(t->spid);
+   if(lsit == as_data->locksetmap.end())
+      return;
+   workset_list_t *worksets = lsit->second;
+   for(workset_listit_t wsit = worksets->begin(); wsit != worksets->end();
+       wsit++) {
+      if(wsit->first == t->lock)
+         continue;
+      lock_edge_t *e = find_edge(&as_data->order, wsit->first, t->lock, true);
+      e->count++;
+      if(wait > 0)
+         e->wait_cycles += wait;
+   }
+}
+
+// spid released t->lock, acquired at acq_cyc.  The locks it took
+// before t->lock are after it in the newest-first workset list.
+static void order_release(struct transition_info *t, as_data_t *as_data,
+                          spid_t spid, osa_cycles_t acq_cyc) {
+   lockset_mapcit_t lsit = as_data->locksetmap.find(spid);
+   if(lsit == as_data->locksetmap.end())
+      return;
+   osa_cycles_t hold = (acq_cyc != 0 && t->now_cyc > acq_cyc)
+      ? t->now_cyc - acq_cyc : 1;
+   workset_list_t *worksets = lsit->second;
+   workset_listit_t wsit = worksets->begin();
+   while(wsit != worksets->end() && wsit->first != t->lock)
+      wsit++;
+   if(wsit == worksets->end())
+      return;
+   for(wsit++; wsit != worksets->end(); wsit++) {
+      lock_edge_t *e = find_edge(&as_data->order, wsit->first, t->lock, false);
+      if(e != NULL)
+         e->hold_cycles += hold;
+   }
+}
+
 static void process_unlock(struct transition_info* t, osamod_t *osamod,
                            as_data_t *as_data) {
 
    syncchar_data_t *syncchar = osamod->syncchar;
 
-   struct lock* lk = &as_data->lockmap[t->lock_addr];
+   struct lock* lk = t->lk;
 
    // If the lock was reader-locked, we can remove ourselves from the
    // reader list.  Because we can have multiple calls of a reader
    // lock we must check for this, effectively ignoring the nested
    // acquires (i.e. flat nesting in transaction parlance)
    if(t->old_state == LKST_RLK){
-      reader_mapit_t rdr = lk->readers.find(t->spid);
-      if(rdr == lk->readers.end()){
+      int *rdr = lk->readers.find(t->spid);
+      if(rdr == NULL){
          print_log("XXX reader unlock missing reader lock ", 0, t, osamod);
 #ifdef DEBUG_INTERACTIVE      
          SIM_break_simulation("XXX");
 #endif
-      } else if(lk->readers[t->spid] > 1){
+      } else if(*rdr > 1){
          // Just decrement the count if we have multiple acquires of
          // the same read lock
-         lk->readers[t->spid]--;
+         (*rdr)--;
          // Don't do the other stuff until we get to the outermost acquire
          return;
       } else {
-         lk->readers.erase(rdr);
+         lk->readers.erase(t->spid);
       }
    }
 
@@ -1394,8 +1981,13 @@ static void process_unlock(struct transition_info* t, osamod_t *osamod,
    // Lock release.  It doesn't matter if it made lock available
    // Only do it if we know acquire, otherwise it will throw off
    // stats. 
-   update_cyc_avgs((*lk->callers)[acq_ra].hold_av, t->now_cyc, acq_cyc, 
-              osamod);
+   update_cyc_hist((*lk->cold->callers)[acq_ra].hold_hist, t->now_cyc, acq_cyc,
+                   osamod);
+   if(syncchar->timeline_epoch > 0)
+      timeline_release(syncchar, t->lock_addr, lk, t->now_cyc, acq_cyc);
+   if(syncchar->lockOrder)
+      order_release(t, as_data, acq_spid != (spid_t)-1 ? acq_spid : t->spid,
+                    acq_cyc);
    if(acq_spid != (spid_t)-1) {
       // Change spid in our local copy
       struct transition_info _t = *t;
@@ -1421,17 +2013,18 @@ static void process_unlock(struct transition_info* t, osamod_t *osamod,
    }
    // Only clear owner if the lock is open
    if(lk->state == LKST_OPEN) {
+      if(lk->handoff && lk->spid_owner != (spid_t)-1)
+         handoff_disown(as_data, t->lock, lk->spid_owner);
       lk->spid_owner = (spid_t)-1;
    }
 
    // If we have a non-zero contended worksets vector, we experienced contention
-   if((*lk->callers)[acq_ra].contended_worksets.size() > 0){
+   if((*lk->cold->callers)[acq_ra].contended_worksets.size() > 0){
 
       int cpuNum = osamod->minfo->getCpuNum(OSA_get_sim_cpu());
-      spid_t spid = osamod->os->current_process[cpuNum];
+      spid_t spid = os_current_spid(osamod->os, cpuNum);
       
-      lock_mapcit_t lock_cit = as_data->lockmap.find(t->lock_addr);
-      lockset_mapcit_t lsit = get_lsit(spid, lock_cit->second.name,
+      lockset_mapcit_t lsit = get_lsit(spid, lk->handoff,
                                        t->spid_owner, as_data);
 
       if(lsit == as_data->locksetmap.end()) {
@@ -1471,16 +2064,16 @@ static void process_unlock(struct transition_info* t, osamod_t *osamod,
       } else {
 
          // Copy the contended worksets list into the workset itself
-         for( vector<WorksetID>::iterator iter = (*lk->callers)[acq_ra].contended_worksets.begin();
-              iter != (*lk->callers)[acq_ra].contended_worksets.end(); iter++){
+         for( vector<WorksetID>::iterator iter = (*lk->cold->callers)[acq_ra].contended_worksets.begin();
+              iter != (*lk->cold->callers)[acq_ra].contended_worksets.end(); iter++){
 
             ws->contended_worksets.push_back(*iter);
          }
 
 #if 0
          // Iterate over working sets and determine if we are dependent or not
-         for( vector<WorksetID>::iterator iter = (*lk->callers)[acq_ra].contended_worksets.begin();
-              iter != (*lk->callers)[acq_ra].contended_worksets.end(); iter++){
+         for( vector<WorksetID>::iterator iter = (*lk->cold->callers)[acq_ra].contended_worksets.begin();
+              iter != (*lk->cold->callers)[acq_ra].contended_worksets.end(); iter++){
             
             int size = 0;
             int dependent = 0;
@@ -1488,11 +2081,11 @@ static void process_unlock(struct transition_info* t, osamod_t *osamod,
             dependent = ws->compare( *iter, &size);
 
             if(dependent){ 
-               (*lk->callers)[acq_ra].q_count_dependent++;
-               (*lk->callers)[acq_ra].q_count_dependent_total_bytes += size;
-               (*lk->callers)[acq_ra].q_count_dependent_conflicting_bytes += dependent;
+               (*lk->cold->callers)[acq_ra].q_count_dependent++;
+               (*lk->cold->callers)[acq_ra].q_count_dependent_total_bytes += size;
+               (*lk->cold->callers)[acq_ra].q_count_dependent_conflicting_bytes += dependent;
             } else {
-               (*lk->callers)[acq_ra].q_count_independent++;
+               (*lk->cold->callers)[acq_ra].q_count_independent++;
             }
             
             if( (*iter)->refs <= 1){
@@ -1505,7 +2098,7 @@ static void process_unlock(struct transition_info* t, osamod_t *osamod,
       }
 
       // Drop old contended worksets entries
-      (*lk->callers)[acq_ra].contended_worksets.clear();
+      (*lk->cold->callers)[acq_ra].contended_worksets.clear();
    }
 
    if(syncchar->logWorksets) {
@@ -1513,6 +2106,85 @@ static void process_unlock(struct transition_info* t, osamod_t *osamod,
    }
 }
 
+// xorshift64*; fixed seed, so that replays sample the same way
+static inline unsigned long long sample_random(syncchar_data_t *syncchar) {
+   unsigned long long x = syncchar->sample_rng;
+   x ^= x >> 12;
+   x ^= x << 25;
+   x ^= x >> 27;
+   syncchar->sample_rng = x;
+   return x * 2685821657736338717ULL;
+}
+
+// Whether the next critical section of a stream gets sampled at
+// rate: n of each block of m, at random places in the block
+// (selection sampling), so that a periodic workload does not alias
+// with the rate
+static bool sample_next(syncchar_data_t *syncchar, const ws_rate_t *rate,
+                        ws_sample_pos_t *pos) {
+   unsigned int i = pos->seq++ % rate->m;
+   if(i == 0)
+      pos->chosen = 0;
+   if(pos->chosen >= rate->n)
+      return false;
+   if(sample_random(syncchar) % (rate->m - i) < rate->n - pos->chosen){
+      pos->chosen++;
+      return true;
+   }
+   return false;
+}
+
+// Whether to collect the workset of the critical section t opens:
+// not outside the sampling windows, if there are any, and otherwise n
+// of every m by the caller's rate, the lock's rate or the default
+// rate, in that order.  Lock and default rates count the lock's own
+// critical sections, the ones in a window.
+static bool sample_workset(struct transition_info *t,
+                           syncchar_data_t *syncchar) {
+   if(syncchar->sample_period > 0){
+      if(!syncchar->afterBoot)
+         return false;
+      // after_boot was set by hand, say after loading a checkpoint:
+      // windows start now
+      if(!syncchar->boot_cycle_known){
+         syncchar->boot_cycle = t->now_cyc;
+         syncchar->boot_cycle_known = true;
+      }
+      osa_cycles_t since = t->now_cyc > syncchar->boot_cycle ?
+         t->now_cyc - syncchar->boot_cycle : 0;
+      if(since % syncchar->sample_period >= syncchar->sample_on)
+         return false;
+   }
+
+   ws_rate_map_t::iterator rit = syncchar->sample_caller_rates.find(t->caller_ra);
+   if(rit != syncchar->sample_caller_rates.end()){
+      return sample_next(syncchar, &rit->second, &rit->second.pos);
+   }
+
+   const ws_rate_t *rate = &syncchar->sample_rate;
+   rit = syncchar->sample_lock_rates.find(t->lock_addr);
+   if(rit != syncchar->sample_lock_rates.end())
+      rate = &rit->second;
+   return sample_next(syncchar, rate, &t->lk->cold->ws_pos);
+}
+
+// A workset for the critical section t opens, sampled or not
+static WorkSet *new_workset(struct transition_info *t, osamod_t *osamod,
+                            int cpu) {
+   syncchar_data_t *syncchar = osamod->syncchar;
+   struct lock *lk = t->lk;
+   WorkSet *ws = alloc_workset(syncchar, t->lock_addr, t->spid,
+                               lk->generation, lk->workset_count, cpu);
+   if(syncchar->sampling)
+      ws->sampled = sample_workset(t, syncchar);
+   lk->cold->ws_opened++;
+   if(ws->sampled)
+      lk->cold->ws_sampled++;
+   // Increment the workset count
+   lk->workset_count++;
+   return ws;
+}
+
 static void open_workset(struct transition_info *t, osamod_t *osamod, 
                          as_data_t *as_data) {
 
@@ -1520,22 +2192,18 @@ static void open_workset(struct transition_info *t, osamod_t *osamod,
    // map has both the current spid and a workset for this lock
 
    // check if this spid is in the map
-   lock_mapit_t lock_it  = as_data->lockmap.find(t->lock_addr);
-   lock_mapit_t lock_cit = as_data->lockmap.find(t->lock_addr);
+   struct lock *lk = t->lk;
    lockset_mapcit_t lsit = as_data->locksetmap.find(t->spid);
-   int cpu = SIM_get_processor_number(OSA_get_sim_cpu());
+   int cpu = osamod->minfo->getCpuNum(OSA_get_sim_cpu());
+
+   invalidate_ws_cache(osamod->syncchar);
 
    // if not, insert with an empty workset
    if(lsit == as_data->locksetmap.end()) {
       as_data->locksetmap[t->spid] =
-         new workset_list_t(1, make_pair(lock_cit, new WorkSet(t->lock_addr, t->spid,
-                                                               lock_cit->second.generation,
-                                                               lock_cit->second.workset_count,
-                                                               cpu)));
-      // Increment the workset count
-      lock_it->second.workset_count++;
+         new workset_list_t(1, make_pair(t->lock, new_workset(t, osamod, cpu)));
       // Update nesting averages
-      update_avgs(lock_it->second.nest_av, 0, 1);
+      lk->cold->nest_hist.record(0);
       return;
    }
 
@@ -1543,7 +2211,7 @@ static void open_workset(struct transition_info *t, osamod_t *osamod,
    workset_list_t *worksets = lsit->second;
    workset_listit_t wsit;
    for(wsit = worksets->begin(); wsit != worksets->end(); wsit++) {
-      if(wsit->first == lock_cit) {
+      if(wsit->first == t->lock) {
          print_log("XXX multiple workset opens (this might be okay)",
                0, t, osamod);
 #ifdef DEBUG_INTERACTIVE      
@@ -1555,24 +2223,19 @@ static void open_workset(struct transition_info *t, osamod_t *osamod,
    }
 
    // Update nesting averages
-   update_avgs(lock_it->second.nest_av, worksets->size(), 1);
+   lk->cold->nest_hist.record(worksets->size());
 
    // create a new workset for the current lock
-   worksets->push_front(make_pair(lock_cit, new WorkSet(t->lock_addr, t->spid,
-                                                        lock_cit->second.generation,
-                                                        lock_cit->second.workset_count, 
-                                                        cpu)));
-   // Increment the workset count
-   lock_it->second.workset_count++;
-
+   worksets->push_front(make_pair(t->lock, new_workset(t, osamod, cpu)));
 }
 
 // get the speculative lock data for a given transaction and
 // lock address, or return a blank structure
-static spcl_caller_t get_speculative_lock(int txid, unsigned int addr,
+static spcl_caller_t get_speculative_lock(syncchar_data_t *syncchar,
+                                          int txid, unsigned int addr,
                                           unsigned int caller, as_data_t *as_data) {
    spcl_caller_t result;
-   spcl_caller_map_t lsmap = spcl_map[txid][addr];
+   spcl_caller_map_t lsmap = syncchar->spcl_map[txid][addr];
    spcl_caller_mapcit_t scit = lsmap.find(caller);
    if(scit == lsmap.end()) {
       result.req_cyc = 0ULL;
@@ -1584,11 +2247,41 @@ static spcl_caller_t get_speculative_lock(int txid, unsigned int addr,
    return result;
 }
 
+static inline bool is_rw_lock(unsigned int lock_id) {
+   return lock_id == L_RSPIN || lock_id == L_WSPIN
+      || lock_id == L_RSEMA || lock_id == L_WSEMA;
+}
+
+// t->spid has just taken rw lock lk, as a reader if it is read-locked.
+// Before lock_spid_info, which clears the request.
+static void rw_acquire(struct lock *lk, const struct transition_info *t) {
+   struct rw_stats *rw = lk->cold->rw;
+   if(rw == NULL) {
+      rw = lk->cold->rw = new struct rw_stats;
+      memset(rw, 0, sizeof(*rw));
+   }
+   if(lk->state == LKST_RLK) {
+      if(t->old_state != LKST_RLK)
+         rw->batches++;
+      rw->batch_reads++;
+      unsigned int n = lk->readers.size();
+      rw->readers[n < RW_READER_BINS ? n : RW_READER_BINS - 1]++;
+      return;
+   }
+   rw->writes++;
+   const struct spid_info *spi = &(*lk->acq)[t->spid];
+   if(spi->rd_blocked) {
+      rw->starved++;
+      if(t->now_cyc > spi->req_cyc)
+         rw->starve_cycles += t->now_cyc - spi->req_cyc;
+   }
+}
+
 static void process_transition(struct transition_info *t, osamod_t *osamod, 
                                as_data_t *as_data) {
    syncchar_data_t *syncchar = osamod->syncchar;
 
-   struct lock* lk = &as_data->lockmap[t->lock_addr];
+   struct lock* lk = t->lk;
    switch(t->old_state) {
    case LKST_OPEN: // old_state
       switch(lk->state) {
@@ -1612,7 +2305,7 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
             }
          }
          // unlocked -> unlocked, huh?
-         (*lk->callers)[t->caller_ra].useless_release++;
+         (*lk->cold->callers)[t->caller_ra].useless_release++;
          print_log("XXX useless ", 0, t, osamod);
 #ifdef DEBUG_INTERACTIVE      
          SIM_break_simulation("XXX");
@@ -1625,6 +2318,8 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
             if(lk->state == LKST_WRLK) {
                if(lk->spid_owner == (spid_t)-1) {
                   lk->spid_owner = t->spid;
+                  if(lk->handoff)
+                     handoff_own(as_data, t->lock, t->spid);
                } else {
                   print_log("XXX OWNER ", 0, t, osamod);
 #ifdef DEBUG_INTERACTIVE      
@@ -1634,16 +2329,18 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
             } else if(lk->state == LKST_RLK) {
                // Push our pid on the reader list, if it isn't
                // already.  Otherwise, increment the count
-               reader_mapit_t rdr = lk->readers.find(t->spid);
-               if(rdr == lk->readers.end()){
-                  lk->readers[t->spid] = 1;
+               int *rdr = lk->readers.find(t->spid);
+               if(rdr == NULL){
+                  lk->readers.insert(t->spid, 1);
                } else {
-                  lk->readers[t->spid]++;
+                  (*rdr)++;
                   // Don't do the other bookkeeping on nested acquires
                   // of a read lock
                   break;
                }
             }
+            if(is_rw_lock(lk->lock_id) && lk->state != LKST_CXA)
+               rw_acquire(lk, t);
 
             // if this acquire is in a transaction, add a speculative
             // cycle count to avoid double-counting with aborts
@@ -1663,15 +2360,21 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
                txid = syncchar->osatxm->get_current_transaction(
                      (osamod_t*)syncchar->osatxm_mod, OSA_get_sim_cpu());
             }
+            osa_cycles_t wait = 0;
             if(txid == 0) {
-               if((*lk->acq)[t->spid].req_cyc != 0ULL) {
+               bool waited = (*lk->acq)[t->spid].req_cyc != 0ULL;
+               if(waited) {
                   req_cyc = (*lk->acq)[t->spid].req_cyc;
                }
-               update_cyc_avgs((*lk->callers)[t->caller_ra].acq_av, t->now_cyc,
-                          req_cyc, osamod);
+               update_cyc_hist((*lk->cold->callers)[t->caller_ra].acq_hist,
+                               t->now_cyc, req_cyc, osamod);
+               if(syncchar->timeline_epoch > 0)
+                  timeline_acquire(syncchar, t->lock_addr, lk, t->now_cyc,
+                                   req_cyc, waited);
+               wait = t->now_cyc - req_cyc;
             }
             else {
-               spcl_caller_t scaller = get_speculative_lock(txid, t->lock_addr,
+               spcl_caller_t scaller = get_speculative_lock(syncchar, txid, t->lock_addr,
                                                             t->caller_ra, as_data);
                osa_cycles_t req_cyc = t->bp_cyc;
                if(scaller.req_cyc != 0ULL) {
@@ -1679,9 +2382,11 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
                   scaller.req_cyc = 0ULL;
                }
                scaller.total_cyc += t->now_cyc - req_cyc;
-               spcl_map[txid][t->lock_addr][t->caller_ra] = scaller;
+               syncchar->spcl_map[txid][t->lock_addr][t->caller_ra] = scaller;
             }
 
+            if(syncchar->lockOrder)
+               order_acquire(t, as_data, wait);
             lock_spid_info(&(*lk->acq)[t->spid], t, as_data);
             if(syncchar->logWorksets) {
                open_workset(t, osamod, as_data);
@@ -1709,24 +2414,31 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
          if(t->read_lock) {
             // Push our pid on the reader list, if it isn't
             // already.  Otherwise, increment the count
-            reader_mapit_t rdr = lk->readers.find(t->spid);
-            if(rdr == lk->readers.end()){
-               lk->readers[t->spid] = 1;
+            int *rdr = lk->readers.find(t->spid);
+            if(rdr == NULL){
+               lk->readers.insert(t->spid, 1);
                open_workset(t, osamod, as_data);
             } else {
-               lk->readers[t->spid]++;
+               (*rdr)++;
                // Don't do the other bookkeeping on nested acquires of
                // a read lock
                break;
             }
+            rw_acquire(lk, t);
 
             // We are a reader and we acquired the read lock
             osa_cycles_t req_cyc = t->bp_cyc;
-            if((*lk->acq)[t->spid].req_cyc != 0ULL) {
+            bool waited = (*lk->acq)[t->spid].req_cyc != 0ULL;
+            if(waited) {
                req_cyc = (*lk->acq)[t->spid].req_cyc;
             }
-            update_cyc_avgs((*lk->callers)[t->caller_ra].acq_av, t->now_cyc,
-                       req_cyc, osamod);
+            update_cyc_hist((*lk->cold->callers)[t->caller_ra].acq_hist,
+                            t->now_cyc, req_cyc, osamod);
+            if(syncchar->timeline_epoch > 0)
+               timeline_acquire(syncchar, t->lock_addr, lk, t->now_cyc,
+                                req_cyc, waited);
+            if(syncchar->lockOrder)
+               order_acquire(t, as_data, t->now_cyc - req_cyc);
             lock_spid_info(&(*lk->acq)[t->spid], t, as_data);
 
          } else if( t->read_unlock ) {
@@ -1740,6 +2452,7 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
             if((t->flags & F_TRYLOCK) == 0
                && (*lk->acq)[t->spid].req_cyc == 0ULL) {
                (*lk->acq)[t->spid].req_cyc = t->bp_cyc;
+               (*lk->acq)[t->spid].rd_blocked = true;
                if((*lk->acq)[t->spid].acq_ra != 0) {
                   *osamod->pStatStream << "XXXr acq_ra "
                                        << hex << (*lk->acq)[t->spid].acq_ra
@@ -1821,12 +2534,12 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
          }
          else {
             if((t->flags & F_TRYLOCK) == 0) {
-               spcl_caller_t scaller = get_speculative_lock(txid, t->lock_addr,
+               spcl_caller_t scaller = get_speculative_lock(syncchar, txid, t->lock_addr,
                                                             t->caller_ra, as_data);
                if(scaller.req_cyc == 0ULL) {
                   scaller.req_cyc = t->bp_cyc;
                }
-               spcl_map[txid][t->lock_addr][t->caller_ra] = scaller;
+               syncchar->spcl_map[txid][t->lock_addr][t->caller_ra] = scaller;
             }
          }
          break;
@@ -1835,6 +2548,56 @@ static void process_transition(struct transition_info *t, osamod_t *osamod,
    }
 }
 
+// RCU (no address) and completions: count a free acquire, that's it
+static void count_transition(struct transition_info *t, osamod_t *osamod,
+                             as_data_t *as_data) {
+   struct caller *caller = &(*t->lk->cold->callers)[t->caller_ra];
+   caller->acq_hist.record(0);
+   if(osamod->syncchar->timeline_epoch > 0)
+      timeline_acquire(osamod->syncchar, t->lock_addr, t->lk, t->now_cyc,
+                       t->now_cyc, false);
+}
+
+template <unsigned int ID, bool UNLOCK, bool LOCK>
+static void track_transition(struct transition_info *t, osamod_t *osamod,
+                             as_data_t *as_data) {
+   t->new_state = update_current_lock_state<ID, UNLOCK>(t, osamod);
+   // Process transition from old_state -> new_state (lk->state)
+   detect_read_lock_unlock<ID, UNLOCK, LOCK>(t, osamod);
+   process_transition(t, osamod, as_data);
+}
+
+#define TRACK_TRANSITION(id)                                            \
+   (unlock ? (lock ? track_transition<id, true, true>                  \
+                   : track_transition<id, true, false>)                \
+           : (lock ? track_transition<id, false, true>                 \
+                   : track_transition<id, false, false>))
+
+static lock_handler_t resolve_lock_handler(unsigned int lock_id,
+                                           unsigned int flags) {
+   if((flags & F_NOADDR) != 0 || lock_id == L_COMPL)
+      return count_transition;
+
+   bool unlock = (flags & F_UNLOCK) != 0;
+   bool lock = (flags & F_LOCK) != 0;
+   switch(lock_id) {
+   case L_SEMA:  return TRACK_TRANSITION(L_SEMA);
+   case L_RSEMA: return TRACK_TRANSITION(L_RSEMA);
+   case L_WSEMA: return TRACK_TRANSITION(L_WSEMA);
+   case L_SPIN:  return TRACK_TRANSITION(L_SPIN);
+   case L_RSPIN: return TRACK_TRANSITION(L_RSPIN);
+   case L_WSPIN: return TRACK_TRANSITION(L_WSPIN);
+   case L_MUTEX: return TRACK_TRANSITION(L_MUTEX);
+   case L_CXA:   return TRACK_TRANSITION(L_CXA);
+   case L_CXE:   return TRACK_TRANSITION(L_CXE);
+   default:
+      // No state machine; update_current_lock_state logs UNK
+      return TRACK_TRANSITION(0);
+   }
+}
+
+#undef TRACK_TRANSITION
+
 // An instruction that changed the state of a lock completed.  Track
 // the transition 
 static void lock_transition(conf_object_t *trigger_obj,
@@ -1856,7 +2619,7 @@ static void lock_transition(conf_object_t *trigger_obj,
       return;
    }
 
-   struct lock* lk = &as_data->lockmap[t->lock_addr];
+   struct lock* lk = t->lk;
 
 #ifdef DEBUG_ADDRESS
    if(t->lock_addr == DEBUG_ADDRESS){
@@ -1874,21 +2637,8 @@ static void lock_transition(conf_object_t *trigger_obj,
 #endif
 
    // Increment counts
-   (*lk->callers)[t->caller_ra].count++;
-   if( (t->flags & F_NOADDR) != 0 ) {
-      // RCU, count & short count increment, thats it
-      (*lk->callers)[t->caller_ra].acq_av[0].cnt++;
-      (*lk->callers)[t->caller_ra].acq_av[1].cnt++;
-   } else if( t->lock_id == L_COMPL ) {
-      // Just count completions
-      (*lk->callers)[t->caller_ra].acq_av[0].cnt++;
-      (*lk->callers)[t->caller_ra].acq_av[1].cnt++;
-   } else {
-      t->new_state = update_current_lock_state(t, osamod, as_data);
-      // Process transition from old_state -> new_state (lk->state)
-      detect_read_lock_unlock(t, osamod);
-      process_transition(t, osamod, as_data);
-   }
+   (*lk->cold->callers)[t->caller_ra].count++;
+   t->handler(t, osamod, as_data);
 
 #ifdef DEBUG_ADDRESS
    if(t->lock_addr == DEBUG_ADDRESS){
@@ -1896,9 +2646,11 @@ static void lock_transition(conf_object_t *trigger_obj,
       if(t->lock_id == L_RSPIN
          || t->lock_id == L_WSPIN){
          *osamod->pStatStream << "\tReaders:" << endl;
-         for(reader_mapit_t rdr = lk->readers.begin();
-             rdr != lk->readers.end(); rdr++){
-            *osamod->pStatStream << "\t\t" << rdr->first << ": " << rdr->second << endl;
+         vector<spid_t> readers;
+         lk->readers.keys(readers);
+         for(unsigned int i = 0; i < readers.size(); i++){
+            *osamod->pStatStream << "\t\t" << readers[i] << ": "
+                                 << *lk->readers.find(readers[i]) << endl;
          }
       }
    }
@@ -1913,6 +2665,7 @@ static void exception_callback(lang_void* callback_data,
    osamod_t *osamod = (osamod_t*)callback_data;   
 
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
+   OSA_REPLAY_SCOPE(osamod, REPLAY_EV_EXCEPTION, cpu, NULL, NULL);
    osamod->syncchar->exception_addrs[osamod->minfo->getCpuNum(cpu)] = osa_read_register(cpu, regEIP);
 }
 
@@ -1923,28 +2676,36 @@ static void breakpoint_callback(lang_void* callback_data,
    osamod_t *osamod = (osamod_t *) callback_data;
    syncchar_data_t *syncchar = osamod->syncchar;
 
-   struct bp_rec* bp_rec = (struct bp_rec*)MM_ZALLOC(1, struct bp_rec);
+   OSA_REPLAY_SCOPE(osamod, REPLAY_EV_BREAKPOINT, OSA_get_sim_cpu(),
+                    trigger_obj, memop);
+
    osa_sim_outer_memop_t* xmt = (osa_sim_outer_memop_t*) memop;
-   bp_rec->bp_pc = (unsigned int)xmt->linear_address;
-   bp_rec->caller_ra = bp_rec->bp_pc; // True for inlined functions
+   unsigned int bp_pc = (unsigned int)xmt->linear_address;
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
-   bp_rec->cyc = osa_get_sim_cycle_count(cpu);
    int cpuNum = osamod->minfo->getCpuNum(cpu);
    syncchar->exception_addrs[cpuNum] = 0;
 
    // Set the proc info on the bp_rec
-   spid_t my_spid = bp_rec->bp_pc < 0xC0000000 ? 
-      osamod->os->current_process[cpuNum] : 0;
+   spid_t my_spid = bp_pc < 0xC0000000 ? 
+      os_current_spid(osamod->os, cpuNum) : 0;
 
    as_mapit_t iter = syncchar->as_data.find(my_spid);
    if(iter == syncchar->as_data.end())
       return;
 
    as_data_t *as_data = iter->second;
+
+   // Returned to the pool by the callback it is posted to
+   struct bp_rec* bp_rec = (struct bp_rec*)syncchar->bp_pool->get(cpuNum);
+   bp_rec->bp_pc = bp_pc;
+   bp_rec->caller_ra = bp_pc; // True for inlined functions
+   bp_rec->cyc = osa_get_sim_cycle_count(cpu);
+   bp_rec->bp_lkval = 0;
    bp_rec->bp_as_data = as_data;
 
    if(break_number == syncchar->dbg_bp) {
-      SIM_stacked_post(NULL, dbg_breakpoint_callback, bp_rec);
+      osa_stacked_post((conf_object_t * )osamod, dbg_breakpoint_callback,
+                       bp_rec);
       return;
    }
    ra_mapcit_t raci = as_data->ramap.find(bp_rec->bp_pc);
@@ -1958,6 +2719,7 @@ static void breakpoint_callback(lang_void* callback_data,
          SIM_break_simulation("XXX");
 #endif
       }
+      syncchar->bp_pool->put(bp_rec, cpuNum);
       return;
    }
    unsigned int lock_addr = get_lock_addr(raci, cpu);
@@ -1966,10 +2728,7 @@ static void breakpoint_callback(lang_void* callback_data,
    // we get to lock_transition and have never seen this lock before.
    // The real previous lock value is in the lockmap because another
    // processor can write the value between now and lock_transition
-   // OSH more cx_ special case
-   if( ((raci->second.flags & F_NOADDR) == 0 
-       && (raci->second.flags & F_EAX) == 0) 
-       || raci->second.lock_id == L_CXA || raci->second.lock_id == L_CXE) {
+   if(raci->second.read_lkval) {
       bp_rec->bp_lkval = read_4bytes(osamod, cpu, DATA_SEGMENT, lock_addr);
    }
    if((raci->second.flags & F_INLINED) == 0) {
@@ -1997,11 +2756,13 @@ static void breakpoint_callback(lang_void* callback_data,
       bp_rec->caller_ra = read_4bytes(osamod, cpu, STACK_SEGMENT, stack_addr);
    }
 
-   SIM_stacked_post((conf_object_t * )osamod, lock_transition, bp_rec);
+   osa_stacked_post((conf_object_t * )osamod, lock_transition, bp_rec);
 }
 
 void handle_transaction_commit(void *syncchar_osamod, conf_object_t *osamod_obj,
       osa_cpu_object_t *cpu, int txid) {
+   tx_spcl_caller_map_t &spcl_map =
+      ((osamod_t *)syncchar_osamod)->syncchar->spcl_map;
    // walk through all of the locks and callers used by this
    // transaction and update the actual cycle averages
    tx_spcl_caller_mapcit_t tsit = spcl_map.find(txid);
@@ -2019,39 +2780,58 @@ void handle_transaction_commit(void *syncchar_osamod, conf_object_t *osamod_obj,
             unsigned int caller = cit->first;
             spcl_caller_t scaller = cit->second;
             if(!lk)
-               *lk = scaller.as_data->lockmap[lock_addr];
+               lk = scaller.as_data->lockmap.lookup(lock_addr);
+            if(!lk)
+               break;
 
-            update_avgs((*lk->callers)[caller].acq_av,
-                  (long double)scaller.total_cyc, (double)1000);
+            (*lk->cold->callers)[caller].acq_hist.record(scaller.total_cyc);
          }
       }
    }
    spcl_map.erase(txid);
 }
 
-void handle_transaction_abort(void *, conf_object_t *osamod,
+void handle_transaction_abort(void *syncchar_osamod, conf_object_t *osamod,
       osa_cpu_object_t *cpu, int txid) {
-   spcl_map.erase(txid);
+   ((osamod_t *)syncchar_osamod)->syncchar->spcl_map.erase(txid);
 }
 
 static void reset_stats(osamod_t *osamod) {
    syncchar_data_t *syncchar = osamod->syncchar;
 
+   // The aggregate worksets are replaced below
+   invalidate_ws_cache(syncchar);
+
    for( as_mapit_t asit = syncchar->as_data.begin();
         asit != syncchar->as_data.end(); asit++){
       
       as_data_t *as_data = asit->second;
 
+      // Edges are counts too
+      as_data->order.edges.clear();
+      as_data->order.index.clear();
+
       // Leave state & zero counters
       for( lock_mapit_t lkit = as_data->lockmap.begin();
            lkit != as_data->lockmap.end();
            ++lkit ) {
 
-         //zero_av(lkit->second.depend_av);
+         // The archive goes too, so that the new benchmark's
+         // worksets are not compared with the old one's
+         free_lock_di(lkit->second.cold->di, syncchar);
+         lkit->second.cold->di = NULL;
+         lkit->second.cold->ws_opened = 0;
+         lkit->second.cold->ws_sampled = 0;
+         lkit->second.cold->ws_pos.seq = 0;
+         lkit->second.cold->ws_pos.chosen = 0;
+         delete lkit->second.cold->tl;
+         lkit->second.cold->tl = NULL;
+         delete lkit->second.cold->rw;
+         lkit->second.cold->rw = NULL;
          
          // New benchmark, all new timings
-         for( caller_mapit_t cait = lkit->second.callers->begin();
-              cait != lkit->second.callers->end(); ++cait ) {
+         for( caller_mapit_t cait = lkit->second.cold->callers->begin();
+              cait != lkit->second.cold->callers->end(); ++cait ) {
             caller_zero(&cait->second);
          }
          
@@ -2067,13 +2847,16 @@ static void reset_stats(osamod_t *osamod) {
    for (int i = 0; i < osamod->minfo->getNumCpus() ; i++){
       osamod->procCycles[i] = osa_get_sim_cycle_count(osamod->minfo->getCpu(i));
    }
-   const char *prefix = osamod->minfo->getPrefix().c_str();
-   reset_cache_statistics(cache_count(osamod), prefix);
+   string prefix = osamod->minfo->getPrefix();
+   reset_cache_statistics(cache_count(osamod), prefix.c_str());
    prepare_kstats_snapshot(osamod);
 
    // Put a line in the log so that we dump the worksets we have read
    // thus far
    *osamod->pStatStream << "RESET_STATS" << endl;
+   if(syncchar->event_log)
+      syncchar->event_log->reset(osamod->procCycles[0]);
+   log_flush(osamod->pStatStream);
 
 }
 
@@ -2096,15 +2879,34 @@ static void print_av(ostream* stat_str, const avg_var av[3],
    }
 }
 
-static void print_lock(ostream *stat_str, unsigned int lock_addr,
-                       const struct lock *lock, as_data_t *as_data){
-   // Lock address, lock id, number of accessing spids, r/w/tot aggregate workset size
+// count sum p50 p90 p99 p99.9 max, in cycles (or locks held, for
+// nesting)
+static void print_hist(ostream* stat_str, const LatencyHist &hist) {
+   *stat_str << hist.count()
+             << " " << hist.sum()
+             << " " << hist.percentile(0.5)
+             << " " << hist.percentile(0.9)
+             << " " << hist.percentile(0.99)
+             << " " << hist.percentile(0.999)
+             << " " << hist.max()
+             << " ";
+}
+
+// addr[_generation](name), which starts each of a lock's lines
+static void print_lock_key(ostream *stat_str, unsigned int lock_addr,
+                           const struct lock *lock){
    *stat_str << hex << lock_addr << dec;
    if(lock->generation > 0){
       *stat_str << "_" << lock->generation;
    }
-   *stat_str << "(" << lock->name << ")"
-            << " " << lock->generation
+   *stat_str << "(" << lock->cold->name << ")";
+}
+
+static void print_lock(ostream *stat_str, unsigned int lock_addr,
+                       const struct lock *lock, as_data_t *as_data){
+   // Lock address, lock id, number of accessing spids, r/w/tot aggregate workset size
+   print_lock_key(stat_str, lock_addr, lock);
+   *stat_str << " " << lock->generation
             << " " << lock->workset_count
             << " " << lock->lock_id
             << " " << lock->acq->size()
@@ -2113,18 +2915,11 @@ static void print_lock(ostream *stat_str, unsigned int lock_addr,
             << " " << lock->aggregate_workset->size()
             << " ";
       
-   print_av(stat_str, lock->nest_av, 0);
-
-   // print data set depend averages
-   /*
-   print_av(stat_str, lock->depend_av, 0);
-   print_av(stat_str, lock->total_av, 0);
-   print_av(stat_str, lock->percent_av, 2);
-   */
+   print_hist(stat_str, lock->cold->nest_hist);
 
-   for( caller_mapcit_t cacit = lock->callers->begin();
-        cacit != lock->callers->end(); ++cacit ) {
-      // Print [caller_ra flags count q_count useless_release avg_var's]
+   for( caller_mapcit_t cacit = lock->cold->callers->begin();
+        cacit != lock->cold->callers->end(); ++cacit ) {
+      // Print [caller_ra flags count q_count useless_release acq hold]
       *stat_str << " [" 
                << " " << hex << cacit->first << dec
                << " " << as_data->ramap[cacit->first].flags
@@ -2138,12 +2933,293 @@ static void print_lock(ostream *stat_str, unsigned int lock_addr,
          */
                << " " << cacit->second.useless_release
                << " ";
-      print_av(stat_str, cacit->second.acq_av, 0);
-      print_av(stat_str, cacit->second.hold_av, 0);
+      print_hist(stat_str, cacit->second.acq_hist);
+      print_hist(stat_str, cacit->second.hold_hist);
       *stat_str << "] ";
    }
 
    *stat_str << '\n';
+
+   // Reader/writer locks also get
+   //    RW_LOCK addr[_generation](name) batches batch_reads writes
+   //            starved starve_cycles readers...
+   // where readers counts read acquires by how many readers then
+   // held the lock, from 1 to RW_READER_BINS - 1 or more
+   const struct rw_stats *rw = lock->cold->rw;
+   if(rw == NULL)
+      return;
+   *stat_str << "RW_LOCK ";
+   print_lock_key(stat_str, lock_addr, lock);
+   *stat_str << " " << rw->batches
+             << " " << rw->batch_reads
+             << " " << rw->writes
+             << " " << rw->starved
+             << " " << rw->starve_cycles;
+   for(int i = 1; i < RW_READER_BINS; i++)
+      *stat_str << " " << rw->readers[i];
+   *stat_str << '\n';
+}
+
+static void print_di_cpus(ostream *stat_str, const di_cpus_t *cpus) {
+   char buf[64];
+   snprintf(buf, sizeof(buf), "%.4f", cpus->density);
+   *stat_str << cpus->samples
+             << " " << cpus->conflicting
+             << " " << cpus->completions
+             << " " << cpus->threads
+             << " " << buf;
+   for(int b = 0; b < DI_HIST_BINS; b++)
+      *stat_str << " " << cpus->hist[b];
+}
+
+// The lock's online data independence, after its print_lock line:
+//    DI_LOCK addr[_generation](name) closes pids
+//            depend_av total_av percent_av
+//            [ cpus samples conflicting completions threads density
+//              hist... ] for each cpu count
+static void print_lock_di(ostream *stat_str, unsigned int lock_addr,
+                          const struct lock *lock){
+   const struct lock_di *di = lock->cold->di;
+   if(di == NULL)
+      return;
+
+   *stat_str << "DI_LOCK ";
+   print_lock_key(stat_str, lock_addr, lock);
+   *stat_str << " " << di->closes
+             << " " << di->pids.size()
+             << " ";
+   print_av(stat_str, di->depend_av, 0);
+   print_av(stat_str, di->total_av, 0);
+   print_av(stat_str, di->percent_av, 2);
+   for(int c = 0; c < DI_NCPU_COUNTS; c++) {
+      *stat_str << " [ " << di_cpu_counts[c] << " ";
+      print_di_cpus(stat_str, &di->cpus[c]);
+      *stat_str << " ]";
+   }
+   *stat_str << '\n';
+}
+
+// With sampling on, after the lock's print_lock line:
+//    WS_SAMPLE addr[_generation](name) opened sampled
+// Counts over this lock's logged worksets estimate counts over all
+// its critical sections when scaled by opened / sampled.  Its data
+// independence, here and in the post-processing, can't be scaled and
+// is only good when opened == sampled.
+static void print_lock_sample(ostream *stat_str, unsigned int lock_addr,
+                              const struct lock *lock){
+   *stat_str << "WS_SAMPLE ";
+   print_lock_key(stat_str, lock_addr, lock);
+   *stat_str << " " << lock->cold->ws_opened
+             << " " << lock->cold->ws_sampled
+             << '\n';
+}
+
+static bool edge_before(const lock_edge_t *a, const lock_edge_t *b) {
+   return a->outer != b->outer ? a->outer < b->outer : a->inner < b->inner;
+}
+
+typedef struct _occluding_t {
+   lock_handle_t lock;
+   unsigned long long hold_cycles;
+   unsigned long long inner_wait;
+   double ratio;
+} occluding_t;
+
+static bool more_occluding(const occluding_t &a, const occluding_t &b) {
+   return a.ratio > b.ratio;
+}
+
+// The address space's lock order graph, after its locks' lines:
+//    LOCK_ORDER outer inner count wait_cycles hold_cycles
+// for each edge, where wait and hold are inner's while holding
+// outer,
+//    LOCK_CYCLE n lock...
+// for each set of n > 1 locks that were taken in both orders
+// (strongly connected), and
+//    OCCLUDING lock hold_cycles inner_wait_cycles ratio
+// for the LOCK_ORDER_TOP locks whose holds spent the largest
+// fraction waiting on inner locks.  Locks are addr[_generation](name).
+static void print_lock_order(ostream *stat_str, as_data_t *as_data){
+   lock_order_t *order = &as_data->order;
+   if(order->edges.empty())
+      return;
+
+   vector<const lock_edge_t *> edges;
+   for(unsigned int i = 0; i < order->edges.size(); i++)
+      edges.push_back(&order->edges[i]);
+   sort(edges.begin(), edges.end(), edge_before);
+
+   // Nodes are the locks on edges; first[n] is node n's first edge
+   vector<lock_handle_t> nodes;
+   vector<unsigned int> first;
+   unordered_map<lock_handle_t, unsigned int> node_of;
+   for(unsigned int i = 0; i < edges.size(); i++) {
+      const struct lock *outer = as_data->lockmap.get(edges[i]->outer);
+      const struct lock *inner = as_data->lockmap.get(edges[i]->inner);
+      *stat_str << "LOCK_ORDER ";
+      print_lock_key(stat_str, outer->addr, outer);
+      *stat_str << " ";
+      print_lock_key(stat_str, inner->addr, inner);
+      *stat_str << " " << edges[i]->count
+                << " " << edges[i]->wait_cycles
+                << " " << edges[i]->hold_cycles << '\n';
+      if(nodes.empty() || nodes.back() != edges[i]->outer) {
+         node_of[edges[i]->outer] = nodes.size();
+         nodes.push_back(edges[i]->outer);
+         first.push_back(i);
+      }
+   }
+   unsigned int nouter = nodes.size();
+   first.push_back(edges.size());
+   for(unsigned int i = 0; i < edges.size(); i++) {
+      if(node_of.find(edges[i]->inner) == node_of.end()) {
+         node_of[edges[i]->inner] = nodes.size();
+         nodes.push_back(edges[i]->inner);
+      }
+   }
+
+   // Tarjan's strongly connected components, without recursion:
+   // the stack of nodes being visited and the edge each is at
+   unsigned int n = nodes.size();
+   const unsigned int unseen = (unsigned int)-1;
+   vector<unsigned int> num(n, unseen), low(n, 0), next(n, 0);
+   vector<bool> on_stack(n, false);
+   vector<unsigned int> stack, path;
+   unsigned int counter = 0;
+   for(unsigned int root = 0; root < nouter; root++) {
+      if(num[root] != unseen)
+         continue;
+      path.push_back(root);
+      while(!path.empty()) {
+         unsigned int v = path.back();
+         if(num[v] == unseen) {
+            num[v] = low[v] = counter++;
+            next[v] = v < nouter ? first[v] : 0;
+            stack.push_back(v);
+            on_stack[v] = true;
+         }
+         unsigned int end = v < nouter ? first[v + 1] : 0;
+         if(next[v] < end) {
+            unsigned int w = node_of[edges[next[v]++]->inner];
+            if(num[w] == unseen)
+               path.push_back(w);
+            else if(on_stack[w] && num[w] < low[v])
+               low[v] = num[w];
+            continue;
+         }
+         path.pop_back();
+         if(!path.empty() && low[v] < low[path.back()])
+            low[path.back()] = low[v];
+         if(low[v] != num[v])
+            continue;
+         vector<unsigned int> scc;
+         unsigned int w;
+         do {
+            w = stack.back();
+            stack.pop_back();
+            on_stack[w] = false;
+            scc.push_back(w);
+         } while(w != v);
+         if(scc.size() < 2)
+            continue;
+         *stat_str << "LOCK_CYCLE " << scc.size();
+         for(unsigned int i = 0; i < scc.size(); i++) {
+            const struct lock *lk = as_data->lockmap.get(nodes[scc[i]]);
+            *stat_str << " ";
+            print_lock_key(stat_str, lk->addr, lk);
+         }
+         *stat_str << '\n';
+      }
+   }
+
+   // How much of each outer lock's hold time went to waiting on
+   // inner locks
+   vector<occluding_t> occ;
+   for(unsigned int v = 0; v < nouter; v++) {
+      occluding_t o;
+      o.lock = nodes[v];
+      o.inner_wait = 0;
+      for(unsigned int i = first[v]; i < first[v + 1]; i++)
+         o.inner_wait += edges[i]->wait_cycles;
+      o.hold_cycles = 0;
+      const struct lock *lk = as_data->lockmap.get(o.lock);
+      for(caller_mapcit_t cacit = lk->cold->callers->begin();
+          cacit != lk->cold->callers->end(); ++cacit)
+         o.hold_cycles += cacit->second.hold_hist.sum();
+      if(o.inner_wait == 0 || o.hold_cycles == 0)
+         continue;
+      o.ratio = (double)o.inner_wait / (double)o.hold_cycles;
+      occ.push_back(o);
+   }
+   stable_sort(occ.begin(), occ.end(), more_occluding);
+   for(unsigned int i = 0; i < occ.size() && i < LOCK_ORDER_TOP; i++) {
+      const struct lock *lk = as_data->lockmap.get(occ[i].lock);
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.4f", occ[i].ratio);
+      *stat_str << "OCCLUDING ";
+      print_lock_key(stat_str, lk->addr, lk);
+      *stat_str << " " << occ[i].hold_cycles
+                << " " << occ[i].inner_wait
+                << " " << buf << '\n';
+   }
+}
+
+// The lock's line of the stats dump, summed over callers, for the
+// event log
+static void log_lock_stats(EventLogWriter *event_log, unsigned int lock_addr,
+                           const struct lock *lock){
+   evlog_lock_stats_t st;
+   memset(&st, 0, sizeof(st));
+   st.lock = lock_addr;
+   st.generation = lock->generation;
+   st.lock_id = lock->lock_id;
+   st.workset_count = lock->workset_count;
+   st.nacq = lock->acq->size();
+   st.rsize = lock->aggregate_workset->rsize();
+   st.wsize = lock->aggregate_workset->wsize();
+   st.size = lock->aggregate_workset->size();
+   for( caller_mapcit_t cacit = lock->cold->callers->begin();
+        cacit != lock->cold->callers->end(); ++cacit ) {
+      st.acquires += cacit->second.count;
+      st.contended += cacit->second.q_count;
+      st.useless_release += cacit->second.useless_release;
+      st.acq_cycles += cacit->second.acq_hist.sum();
+      st.hold_cycles += cacit->second.hold_hist.sum();
+   }
+   event_log->lock_stats(st);
+}
+
+// The lock's timeline buckets since the last export, oldest first.
+// The newest may still be filling, so it is exported again next time.
+// Epochs with no activity have no bucket, so the ring can hold epochs
+// older than its size behind the newest; look at every slot.
+static void log_lock_timeline(syncchar_data_t *syncchar,
+                              unsigned int lock_addr, const struct lock *lock){
+   struct lock_timeline *tl = lock->cold->tl;
+   vector<pair<unsigned long long, unsigned int> > pending;
+   for(unsigned int i = 0; i < tl->ring.size(); i++) {
+      unsigned long long e = tl->ring[i].epoch;
+      if(e != TL_EMPTY && e >= tl->exported)
+         pending.push_back(make_pair(e, i));
+   }
+   sort(pending.begin(), pending.end());
+
+   evlog_timeline_t b;
+   b.lock = lock_addr;
+   b.generation = lock->generation;
+   b.length = syncchar->timeline_epoch;
+   for(unsigned int i = 0; i < pending.size(); i++) {
+      const tl_bucket_t *tb = &tl->ring[pending[i].second];
+      b.start = pending[i].first * syncchar->timeline_epoch;
+      b.acquires = tb->acquires;
+      b.contended = tb->contended;
+      b.hold_cycles = tb->hold_cycles;
+      b.max_wait = tb->max_wait;
+      syncchar->event_log->timeline(b);
+   }
+   // A full ring may already have exported past the newest epoch
+   if(tl->exported < tl->newest)
+      tl->exported = tl->newest;
 }
 
 static void get_stats(osamod_t *osamod) {
@@ -2157,14 +3233,14 @@ static void get_stats(osamod_t *osamod) {
    
    // beware empty lines. Apparently they are dangerous.
 
-   const char *prefix = osamod->minfo->getPrefix().c_str();
+   string prefix = osamod->minfo->getPrefix();
    dump_cache_statistics( cache_count(osamod), 
                           osamod->pStatStream,
                           OSATXM_STATS_TABULAR,
                           OSATXM_STATS_DELIMITER,
                           OSATXM_STATS_SHOWROWNAMES,
                           OSATXM_STATS_SHOWCOLNAMES,
-                          prefix);
+                          prefix.c_str());
    *osamod->pStatStream << take_kstats_snapshot(osamod);
 
    // beware empty lines. No, really.
@@ -2175,6 +3251,12 @@ static void get_stats(osamod_t *osamod) {
    }
 
    unordered_map<as_data_t *, int> already_seen;
+   di_cpus_t di_total[DI_NCPU_COUNTS];
+   memset(di_total, 0, sizeof(di_total));
+   unsigned int di_sampled_locks = 0;
+
+   if(syncchar->event_log)
+      syncchar->event_log->begin_stats();
 
    for( as_mapit_t asit = syncchar->as_data.begin();
         asit != syncchar->as_data.end(); asit++){
@@ -2187,17 +3269,44 @@ static void get_stats(osamod_t *osamod) {
          already_seen[as_data] = 1;
 
       // Active locks
-      for( lock_mapcit_t lkcit = as_data->lockmap.begin();
+      for( lock_mapit_t lkcit = as_data->lockmap.begin();
            lkcit != as_data->lockmap.end();
            ++lkcit ) {
          print_lock(osamod->pStatStream, lkcit->first, &(lkcit->second), as_data);
+         print_lock_di(osamod->pStatStream, lkcit->first, &(lkcit->second));
+         if(syncchar->sampling)
+            print_lock_sample(osamod->pStatStream, lkcit->first, &(lkcit->second));
+         const struct lock_cold *cold = lkcit->second.cold;
+         // A lock whose worksets were sampled archived worksets that
+         // were not neighbouring critical sections; its DI_LOCK line
+         // is printed, but it is kept out of the totals
+         if(cold->di && cold->ws_sampled < cold->ws_opened){
+            di_sampled_locks++;
+         } else if(cold->di){
+            for(int c = 0; c < DI_NCPU_COUNTS; c++){
+               const di_cpus_t *cpus = &cold->di->cpus[c];
+               di_total[c].samples += cpus->samples;
+               di_total[c].conflicting += cpus->conflicting;
+               di_total[c].completions += cpus->completions;
+               di_total[c].threads += cpus->threads;
+               di_total[c].density += cpus->density;
+               for(int b = 0; b < DI_HIST_BINS; b++)
+                  di_total[c].hist[b] += cpus->hist[b];
+            }
+         }
+         if(syncchar->event_log){
+            log_lock_stats(syncchar->event_log, lkcit->first, &(lkcit->second));
+            if(cold->tl)
+               log_lock_timeline(syncchar, lkcit->first, &(lkcit->second));
+         }
       }
+      print_lock_order(osamod->pStatStream, as_data);
       
       // Reduce acq maps to contain only the spids that are using it (and
       // hence are valid users for the next measurement period 
       acq_map_t* new_acq
          = new acq_map_t();
-      for( lock_mapcit_t lkcit = as_data->lockmap.begin();
+      for( lock_mapit_t lkcit = as_data->lockmap.begin();
            lkcit != as_data->lockmap.end();
            ++lkcit ) {
          for( acqcit_t acqcit = lkcit->second.acq->begin(); 
@@ -2213,7 +3322,50 @@ static void get_stats(osamod_t *osamod) {
       delete new_acq;
    }
 
+   // Online data independence over all locks whose worksets were
+   // all collected, per cpu count
+   for(int c = 0; c < DI_NCPU_COUNTS; c++){
+      if(di_total[c].samples == 0)
+         continue;
+      *osamod->pStatStream << "DI_CPUS " << di_cpu_counts[c] << " ";
+      print_di_cpus(osamod->pStatStream, &di_total[c]);
+      *osamod->pStatStream << '\n';
+   }
+   if(di_sampled_locks > 0){
+      *osamod->pStatStream << "XXX: " << di_sampled_locks
+                           << " locks had their worksets sampled; their "
+                           << "data independence is not in DI_CPUS" << endl;
+   }
+
+   if(syncchar->timeline_epoch > 0 && syncchar->event_log == NULL){
+      *osamod->pStatStream << "XXX: timeline_epoch is set but there is no "
+                           << "event_log to export the timelines to" << endl;
+   }
+   if(syncchar->timeline_dropped > 0){
+      *osamod->pStatStream << "XXX: " << syncchar->timeline_dropped
+                           << " timeline buckets were overwritten before "
+                           << "a stats dump; raise timeline_buckets" << endl;
+      syncchar->timeline_dropped = 0;
+   }
+
    *osamod->pStatStream << "SYNCCHAR: End of Stats" << endl; 
+
+   // A stats dump is a checkpoint for the event log too
+   if(syncchar->event_log){
+      syncchar->event_log->flush();
+      if(syncchar->event_log->failed()){
+         *osamod->pStatStream << "XXX: write to event log "
+                              << syncchar->event_log->name() << " failed" << endl;
+      }
+   }
+
+   // And for the text log
+   LogSink *sink = log_sink(osamod->pStatStream);
+   if(sink != NULL){
+      sink->flush_all();
+      if(sink->failed())
+         cerr << "XXX: write to the sync_char log failed" << endl;
+   }
 }
 
 static attr_value_t get_stats_attribute(void *arg, conf_object_t *obj, 
@@ -2237,59 +3389,62 @@ static void output_stats(osamod_t *osamod){
 }
 
 static void osa_sched_callback(osamod_t *osamod){
-   // First we need to update the runqueue lock's owner.  A lot of
-   // work for one lock, imho
+   // First we need to update the owner of any hand-off lock (the
+   // runqueue lock) the old pid holds, and move its workset along
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
    spid_t new_pid =  (int)osa_read_register(cpu, regECX);
    int cpuNum = osamod->minfo->getCpuNum(cpu);
-   spid_t old_pid = osamod->os->current_process[cpuNum];
+   spid_t old_pid = os_current_spid(osamod->os, cpuNum);
    syncchar_data_t *syncchar = osamod->syncchar;
 
    // Assume we are in the kernel
    as_data_t *as_data = syncchar->as_data[0];
 
-   for( lock_mapit_t lkit = as_data->lockmap.begin();
-        lkit != as_data->lockmap.end();
-        ++lkit ) {
-         
-      if(lkit->second.spid_owner == old_pid
-         && strncmp(lkit->second.name, "runqueue_t->lock", LOCK_NAME_SIZE) == 0){
-         // Update the pid of the runqueue lock
-         lkit->second.spid_owner = new_pid;
-
-         // Find the runqueue locks's workset and update it too
-         lockset_mapcit_t lsit = as_data->locksetmap.find(old_pid);
-         if(lsit != as_data->locksetmap.end()) {
-            workset_list_t *worksets = lsit->second;
-            workset_listit_t wsit, wsit2;
-               
-            for(wsit = worksets->begin(); wsit != worksets->end(); ){
-               // Increment wsit early so that we can delete and
-               // keep going
-               wsit2 = wsit;
-               wsit++;
-
-               if(wsit2->second->id.lock_addr == lkit->first){
-                  WorkSet * ws = wsit2->second;
-                  // Update spid
-                  ws->pid = new_pid;
-                  ws->old_pid = old_pid;
-                  ws->twoowners = 1;
-                  // Take it out of this workset
-                  worksets->erase(wsit2);
-
-                  // Put it in the workset of the new pid
-                  lock_mapcit_t lock_cit = as_data->lockmap.find(lkit->first);
-                  lockset_mapcit_t lsit2 = as_data->locksetmap.find(new_pid);
-                  if(lsit2 == as_data->locksetmap.end()) {
-                     // We don't have a workset list
-                     as_data->locksetmap[new_pid] =
-                        new workset_list_t(1, make_pair(lock_cit, ws));
-                  } else {
-                     // We do have a workset list, just insert it
-                     lsit2->second->push_front(make_pair(lock_cit, ws));
-                  }
-               }
+   handoff_map_t::iterator hit = as_data->handoffs.find(old_pid);
+   if(hit == as_data->handoffs.end())
+      return;
+   vector<lock_handle_t> held;
+   held.swap(hit->second);
+   as_data->handoffs.erase(hit);
+
+   lockset_mapcit_t lsit = as_data->locksetmap.find(old_pid);
+   for(unsigned int i = 0; i < held.size(); i++) {
+      lock_handle_t handle = held[i];
+      // Update the pid of the runqueue lock
+      as_data->lockmap.get(handle)->spid_owner = new_pid;
+      handoff_own(as_data, handle, new_pid);
+
+      // Find the runqueue locks's workset and update it too
+      if(lsit == as_data->locksetmap.end())
+         continue;
+      workset_list_t *worksets = lsit->second;
+      workset_listit_t wsit, wsit2;
+
+      for(wsit = worksets->begin(); wsit != worksets->end(); ){
+         // Increment wsit early so that we can delete and
+         // keep going
+         wsit2 = wsit;
+         wsit++;
+
+         if(wsit2->first == handle){
+            WorkSet * ws = wsit2->second;
+            // Update spid
+            ws->pid = new_pid;
+            ws->old_pid = old_pid;
+            ws->twoowners = 1;
+            // Take it out of this workset
+            worksets->erase(wsit2);
+            invalidate_ws_cache(syncchar);
+
+            // Put it in the workset of the new pid
+            lockset_mapcit_t lsit2 = as_data->locksetmap.find(new_pid);
+            if(lsit2 == as_data->locksetmap.end()) {
+               // We don't have a workset list
+               as_data->locksetmap[new_pid] =
+                  new workset_list_t(1, make_pair(handle, ws));
+            } else {
+               // We do have a workset list, just insert it
+               lsit2->second->push_front(make_pair(handle, ws));
             }
          }
       }
@@ -2297,19 +3452,15 @@ static void osa_sched_callback(osamod_t *osamod){
 }
  
 
-static void free_as_data(as_data_t *as_data){
+static void free_as_data(as_data_t *as_data, syncchar_data_t *syncchar){
    // Clear the ras
    as_data->ramap.clear();
    
    // clear the lock definitions
    for(lock_mapit_t iter = as_data->lockmap.begin();
-       iter != as_data->lockmap.end(); iter++){
-      struct lock *old_lock = &(iter->second);
-      delete old_lock->acq;
-      delete old_lock->callers;
-      delete old_lock->aggregate_workset;
-      
-      as_data->lockmap.erase(iter);
+       iter != as_data->lockmap.end(); ++iter){
+      free_lock(&(iter->second), syncchar);
+      as_data->lockmap.erase(iter.handle());
    }
 
    // clear the bps
@@ -2327,7 +3478,7 @@ static void free_as_data(as_data_t *as_data){
  static void osa_fork_callback(osamod_t *osamod){
     osa_cpu_object_t *cpu = OSA_get_sim_cpu();
     int cpuNum = osamod->minfo->getCpuNum(OSA_get_sim_cpu());
-    spid_t ppid = osamod->os->current_process[cpuNum];
+    spid_t ppid = os_current_spid(osamod->os, cpuNum);
 
     // Don't bother with the kernel/idle process
     if(ppid == 0)
@@ -2341,6 +3492,7 @@ static void free_as_data(as_data_t *as_data){
        as_data_t *as_data = iter->second;
        osamod->syncchar->as_data[pid] = as_data;
        as_data->ref_count++;
+       invalidate_ws_cache(osamod->syncchar);
     }
  }
 
@@ -2351,7 +3503,7 @@ static void free_as_data(as_data_t *as_data){
 
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
    int cpuNum = osamod->minfo->getCpuNum(cpu);
-   spid_t spid = osamod->os->current_process[cpuNum];
+   spid_t spid = os_current_spid(osamod->os, cpuNum);
 
    // Don't free kernel data
    if(spid == 0){
@@ -2365,18 +3517,19 @@ static void free_as_data(as_data_t *as_data){
       as_data->ref_count--;
       
       if(as_data->ref_count == 0){
-         free_as_data(iter->second);         
+         free_as_data(iter->second, syncchar);         
          pr("[syncchar] Cleared map for pid %d\n", spid);
       }
 
       syncchar->as_data.erase(iter);
+      invalidate_ws_cache(syncchar);
    }
  }
  
 static void osa_register_spinlock_callback(osamod_t *osamod){
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
    int cpuNum = osamod->minfo->getCpuNum(cpu);
-   spid_t spid = osamod->os->current_process[cpuNum];
+   spid_t spid = os_current_spid(osamod->os, cpuNum);
 
    // As we register other lock types, just fall through other cases 
    osa_uinteger_t lock_addr = osa_read_register(cpu, regEDX);
@@ -2393,7 +3546,7 @@ static void osa_register_spinlock_callback(osamod_t *osamod){
    read_string(cpu, str_ptr, tmp, len < LOCK_NAME_SIZE ? len + 1 : 256, 1);
 
    int lkval = read_4bytes(osamod, cpu, DATA_SEGMENT, lock_addr);
-   // Create a new lock entry
+   // Create a new lock entry, a hand-off lock if tmp is handoff_name
    // Only support spins for now
    allocate_lock(L_SPIN, lock_addr, lkval, tmp, osamod, as_data);
 }
@@ -2401,9 +3554,47 @@ static void osa_register_spinlock_callback(osamod_t *osamod){
 static void osa_after_boot_callback(osamod_t *osamod){
    syncchar_data_t *scd = osamod->syncchar;
    scd->afterBoot = true;
+   scd->boot_cycle = osa_get_sim_cycle_count(OSA_get_sim_cpu());
+   scd->boot_cycle_known = true;
 }
 
 
+// Per-cpu view of the open worksets, see ws_cache_t
+static ws_cache_t *get_ws_cache(syncchar_data_t *syncchar, int cpuNum,
+                                spid_t spid, bool in_kernel){
+   ws_cache_t *wc = &syncchar->ws_cache[cpuNum];
+   if(wc->gen == syncchar->ws_cache_gen
+      && wc->spid == spid && wc->in_kernel == in_kernel)
+      return wc;
+
+   wc->gen = syncchar->ws_cache_gen;
+   wc->spid = spid;
+   wc->in_kernel = in_kernel;
+   wc->as_data = NULL;
+   wc->in_cs = false;
+   wc->open.clear();
+   wc->aggregate.clear();
+
+   as_mapit_t iter = syncchar->as_data.find(in_kernel ? 0 : spid);
+   if(iter == syncchar->as_data.end())
+      return wc;
+   wc->as_data = iter->second;
+
+   lockset_mapcit_t lsit = wc->as_data->locksetmap.find(spid);
+   if(lsit == wc->as_data->locksetmap.end())
+      return wc;
+   wc->in_cs = !lsit->second->empty();
+   for(workset_listit_t wsit = lsit->second->begin();
+       wsit != lsit->second->end(); wsit++){
+      if(!wsit->second->sampled)
+         continue;
+      wc->open.push_back(wsit->second);
+      wc->aggregate.push_back(
+         wc->as_data->lockmap.get(wsit->first)->aggregate_workset);
+   }
+   return wc;
+}
+
 /*
  * timing_operate()
  * return the number of cycles 
@@ -2419,8 +3610,9 @@ static osa_cycles_t timing_operate( conf_object_t* pConfObject,
    osamod_t *osamod = (osamod_t*)pConfObject;
 
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
+   OSA_REPLAY_SCOPE(osamod, REPLAY_EV_MEMOP, cpu, pConfObject, pMemTx);
    int cpuNum = osamod->minfo->getCpuNum(cpu);
-   spid_t spid = osamod->os->current_process[cpuNum];
+   spid_t spid = os_current_spid(osamod->os, cpuNum);
       
    // Hack to figure out if we are in the kernel or not
    bool in_kernel = osa_read_register(cpu, regEIP) >= 0xc0000000;
@@ -2437,50 +3629,30 @@ static osa_cycles_t timing_operate( conf_object_t* pConfObject,
          (pMemTx->type == Sim_Trans_Load || pMemTx->type == Sim_Trans_Store)) {
          // This is a memory reference we care about
 
-         as_mapit_t iter = osamod->syncchar->as_data.find(in_kernel ? 0 : spid);
-         if(iter != osamod->syncchar->as_data.end()){
+         ws_cache_t *wc = get_ws_cache(osamod->syncchar, cpuNum, spid, in_kernel);
+         if(wc->as_data != NULL){
             // This is an address space (user or kernel) that we care about
-            as_data_t *as_data = iter->second;
+            as_data_t *as_data = wc->as_data;
          
-            lockset_mapcit_t lsit = as_data->locksetmap.find(spid);
-            if(lsit != as_data->locksetmap.end()) {
-               // And we have a lockmap for this address space
-               workset_list_t *worksets = lsit->second;
-               workset_listit_t wsit;
-            
-               
-               if(!worksets->empty()){
-                  
-                  // add this access to each workset for the current spid
-                  for(wsit = worksets->begin(); wsit != worksets->end(); wsit++){
-                     
-                     // We need to filter out the lock address itself from the
-                     // workset, so that we don't just get 100% data
-                     // dependence!  Actually, let's filter all lock addresses,
-                     // just for good measure
-                     if(as_data->lockmap.find(pMemTx->logical_address) 
-                        == as_data->lockmap.end()){
-                     
-                     
-                        wsit->second->grow(pMemTx->logical_address, pMemTx->size,
-                                           pMemTx->type);
-                     
-                        // Also, add this to the aggregate workset for the lock
-                        lock_mapcit_t lkit = as_data->lockmap.find(wsit->second->id.lock_addr);
-                        if(lkit == as_data->lockmap.end()){
-                           cout << "XXX: Can't find lock " << std::hex 
-                                << wsit->second->id.lock_addr << std::dec << endl;
-#ifdef DEBUG_INTERACTIVE      
-                           SIM_break_simulation("XXX");
-#endif
-                        }
-                     
-                        lkit->second.aggregate_workset->grow(pMemTx->logical_address, pMemTx->size,
-                                                             pMemTx->type);
-                     }
+            if(wc->in_cs){
+               // We need to filter out the lock address itself from the
+               // workset, so that we don't just get 100% data
+               // dependence!  Actually, let's filter all lock addresses,
+               // just for good measure.  Nothing to do if none of the
+               // open worksets is sampled.
+               if(!wc->open.empty()
+                  && !as_data->lockmap.contains(pMemTx->logical_address)){
+
+                  // add this access to each workset for the current
+                  // spid, and to the aggregate workset for its lock
+                  for(unsigned int i = 0; i < wc->open.size(); i++){
+                     wc->open[i]->grow(pMemTx->logical_address, pMemTx->size,
+                                       pMemTx->type);
+                     wc->aggregate[i]->grow(pMemTx->logical_address, pMemTx->size,
+                                            pMemTx->type);
                   }
-                  goto cct;
                }
+               goto cct;
             }
 
             // If we don't have any active worksets, add it to the asymmetric conflict detector
@@ -2501,6 +3673,7 @@ static void handle_device_access_memop(lang_void *callback_data,
                                        osa_sim_inner_memop_t *pMemTx) {
    osamod_t *osamod = (osamod_t*)callback_data;
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
+   OSA_REPLAY_SCOPE(osamod, REPLAY_EV_DEVICE, cpu, NULL, NULL);
    // Make sure this is the correct machine
    if(osamod->minfo->getOwner(cpu) != osamod){
       cout << std::hex << "cpu = " << cpu 
@@ -2511,7 +3684,7 @@ static void handle_device_access_memop(lang_void *callback_data,
    }
 
    int cpuNum = osamod->minfo->getCpuNum(cpu);
-   spid_t spid = osamod->os->current_process[cpuNum];
+   spid_t spid = os_current_spid(osamod->os, cpuNum);
 
    // Hack to figure out if we are in the kernel or not
    bool in_kernel = osa_read_register(cpu, regEIP) >= 0xc0000000;
@@ -2536,15 +3709,7 @@ static void handle_device_access_memop(lang_void *callback_data,
          wsit->second->IO = 1;
          
          // Also, mark the aggregate workset for the lock
-         lock_mapcit_t lkit = as_data->lockmap.find(wsit->second->id.lock_addr);
-         if(lkit == as_data->lockmap.end()){
-            cout << "XXX: Can't find lock " << std::hex 
-                 << wsit->second->id.lock_addr << std::dec << endl;
-#ifdef DEBUG_INTERACTIVE      
-            SIM_break_simulation("XXX");
-#endif
-         }
-         lkit->second.aggregate_workset->IO = 1;
+         as_data->lockmap.get(wsit->first)->aggregate_workset->IO = 1;
       }
    }
 }
@@ -2684,6 +3849,18 @@ static set_error_t set_system_attribute(void*, conf_object_t *osa_obj,
    memset(syncchar->exception_addrs, 0,
           osamod->minfo->getNumCpus()*sizeof(*syncchar->exception_addrs));
 
+   delete [] syncchar->ws_cache;
+   syncchar->ws_cache = new ws_cache_t[osamod->minfo->getNumCpus()];
+   for(int i = 0; i < osamod->minfo->getNumCpus(); i++)
+      syncchar->ws_cache[i].gen = 0;
+   syncchar->ws_cache_gen = 1;
+
+   if(syncchar->bp_pool == NULL) {
+      syncchar->bp_pool =
+         new pool<struct bp_rec>(osamod->minfo->getNumCpus());
+      syncchar->ws_pool = new pool<WorkSet>(osamod->minfo->getNumCpus());
+   }
+
 
    /* init os visibility */
    init_procs(osamod);
@@ -2736,11 +3913,12 @@ static void syncchar_clear_map_callback(osamod_t *osamod){
 
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
    int cpuNum = osamod->minfo->getCpuNum(cpu);
-   spid_t spid = osamod->os->current_process[cpuNum];
+   spid_t spid = os_current_spid(osamod->os, cpuNum);
 
    as_mapit_t iter = syncchar->as_data.find(spid);
    if(iter != syncchar->as_data.end()){
-      free_as_data(iter->second);
+      free_as_data(iter->second, syncchar);
+      invalidate_ws_cache(syncchar);
    }
    
    pr("[syncchar] Cleared map\n");
@@ -2767,6 +3945,7 @@ static set_error_t set_mapfile(void*, conf_object_t *osa_obj,
       
    scd->as_data[0] = as_data;
    as_data->ref_count = 1;
+   invalidate_ws_cache(scd);
 
    as_data->map_file_name = MM_ZALLOC(strlen(val->u.string) + 1, char);
    strcpy(as_data->map_file_name, val->u.string);
@@ -2798,7 +3977,7 @@ static void syncchar_load_map_callback(osamod_t *osamod){
    osa_cpu_object_t *cpu = OSA_get_sim_cpu();
    int cpuNum = osamod->minfo->getCpuNum(cpu);
 
-   spid_t pid = osamod->os->current_process[cpuNum];
+   spid_t pid = os_current_spid(osamod->os, cpuNum);
 
    // Don't let the kernel map change.
    OSA_assert(pid != 0, osamod);
@@ -2815,6 +3994,7 @@ static void syncchar_load_map_callback(osamod_t *osamod){
       as_data->ref_count = 1;
       as_data->asym_detector = new WorkSet(0, pid, 0, 0xffffffff, cpuNum);
       as_data->ad_count = 0;
+      invalidate_ws_cache(scd);
    } else {
       as_data = iter->second;
       if(as_data->map_file_name)
@@ -2865,6 +4045,381 @@ static set_error_t set_logWorksets(void*, conf_object_t *osa_obj,
 }
 
 
+static attr_value_t get_event_log(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   EventLogWriter *event_log = ((osamod_t*)sc)->syncchar->event_log;
+   if(event_log == NULL)
+      return SIM_make_attr_nil();
+   return SIM_make_attr_string(event_log->name());
+}
+
+static void close_event_log(syncchar_data_t *syncchar) {
+   EventLogWriter *event_log = syncchar->event_log;
+   if(event_log == NULL)
+      return;
+   syncchar->event_log = NULL;
+
+   event_log->close();
+   pr("[syncchar] Closed event log %s: %llu records, %u blocks, "
+      "%llu bytes (%llu stored)%s\n", event_log->name(),
+      (unsigned long long)event_log->records(), event_log->blocks(),
+      (unsigned long long)event_log->raw_bytes(),
+      (unsigned long long)event_log->stored_bytes(),
+      event_log->failed() ? ", WRITE FAILED" : "");
+   delete event_log;
+}
+
+// Setting a file name starts a new event log, closing any previous
+// one; nil or "" just closes it
+static set_error_t set_event_log(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)osa_obj)->syncchar;
+
+   close_event_log(syncchar);
+   if(val->kind != Sim_Val_String || val->u.string[0] == '\0')
+      return Sim_Set_Ok;
+
+   EventLogWriter *event_log = new EventLogWriter(val->u.string,
+                                                  syncchar->event_log_codec);
+   if(!event_log->good()){
+      delete event_log;
+      return Sim_Set_Illegal_Value;
+   }
+   syncchar->event_log = event_log;
+   return Sim_Set_Ok;
+}
+
+static attr_value_t get_event_log_codec(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   return SIM_make_attr_string(
+      evlog_codec_names[((osamod_t*)sc)->syncchar->event_log_codec]);
+}
+
+// Takes effect for the next event log opened
+static set_error_t set_event_log_codec(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   if(val->kind != Sim_Val_String)
+      return Sim_Set_Need_String;
+   int codec = evlog_codec_by_name(val->u.string);
+   if(codec < 0 || !evlog_codec_available(codec))
+      return Sim_Set_Illegal_Value;
+   ((osamod_t*)osa_obj)->syncchar->event_log_codec = codec;
+   return Sim_Set_Ok;
+}
+
+// Timelines of different epochs or sizes don't mix; changing either
+// starts every lock's timeline over
+static void drop_timelines(syncchar_data_t *syncchar) {
+   for( as_mapit_t asit = syncchar->as_data.begin();
+        asit != syncchar->as_data.end(); asit++){
+      lock_map_t *lockmap = &asit->second->lockmap;
+      for( lock_mapit_t lkit = lockmap->begin(); lkit != lockmap->end();
+           ++lkit ) {
+         delete lkit->second.cold->tl;
+         lkit->second.cold->tl = NULL;
+      }
+   }
+}
+
+static attr_value_t get_timeline_epoch(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   return SIM_make_attr_integer(((osamod_t*)sc)->syncchar->timeline_epoch);
+}
+
+static set_error_t set_timeline_epoch(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)osa_obj)->syncchar;
+   if(val->u.integer < 0)
+      return Sim_Set_Illegal_Value;
+   if(val->u.integer != syncchar->timeline_epoch)
+      drop_timelines(syncchar);
+   syncchar->timeline_epoch = val->u.integer;
+   return Sim_Set_Ok;
+}
+
+static attr_value_t get_timeline_buckets(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   return SIM_make_attr_integer(((osamod_t*)sc)->syncchar->timeline_buckets);
+}
+
+static set_error_t set_timeline_buckets(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)osa_obj)->syncchar;
+   if(val->u.integer < 1 || val->u.integer > (1 << 20))
+      return Sim_Set_Illegal_Value;
+   if(val->u.integer != (integer_t)syncchar->timeline_buckets)
+      drop_timelines(syncchar);
+   syncchar->timeline_buckets = val->u.integer;
+   return Sim_Set_Ok;
+}
+
+// Flag the locks named handoff_name, and index the owners of the ones
+// that are held
+static void reflag_handoffs(syncchar_data_t *syncchar) {
+   for( as_mapit_t asit = syncchar->as_data.begin();
+        asit != syncchar->as_data.end(); asit++){
+      as_data_t *as_data = asit->second;
+      as_data->handoffs.clear();
+      for( lock_mapit_t lkit = as_data->lockmap.begin();
+           lkit != as_data->lockmap.end(); ++lkit ) {
+         struct lock *lk = &lkit->second;
+         lk->handoff = is_handoff_name(syncchar, lk->cold->name);
+         if(lk->handoff && lk->spid_owner != (spid_t)-1)
+            handoff_own(as_data, lkit.handle(), lk->spid_owner);
+      }
+   }
+}
+
+static attr_value_t get_handoff_lock(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   return SIM_make_attr_string(((osamod_t*)sc)->syncchar->handoff_name);
+}
+
+static set_error_t set_handoff_lock(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)osa_obj)->syncchar;
+   if(val->kind != Sim_Val_String)
+      return Sim_Set_Need_String;
+   if(strlen(val->u.string) >= LOCK_NAME_SIZE)
+      return Sim_Set_Illegal_Value;
+   strcpy(syncchar->handoff_name, val->u.string);
+   reflag_handoffs(syncchar);
+   return Sim_Set_Ok;
+}
+
+// The log's buffering (log_buffer and log_async attributes).  Changes
+// apply to the open log, and carry over to the next one.
+static attr_value_t get_log_buffer(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   LogSink *sink = log_sink(((osamod_t*)sc)->pStatStream);
+   return SIM_make_attr_integer(sink ? sink->buffer_size() : 0);
+}
+
+static set_error_t set_log_buffer(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   LogSink *sink = log_sink(((osamod_t*)osa_obj)->pStatStream);
+   if(sink == NULL)
+      return Sim_Set_Not_Writable;
+   if(val->u.integer < 1 || val->u.integer > (1 << 30))
+      return Sim_Set_Illegal_Value;
+   sink->configure(val->u.integer, sink->async());
+   return Sim_Set_Ok;
+}
+
+static attr_value_t get_log_async(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   LogSink *sink = log_sink(((osamod_t*)sc)->pStatStream);
+   return SIM_make_attr_boolean(sink ? sink->async() : false);
+}
+
+static set_error_t set_log_async(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   LogSink *sink = log_sink(((osamod_t*)osa_obj)->pStatStream);
+   if(sink == NULL)
+      return Sim_Set_Not_Writable;
+   sink->configure(sink->buffer_size(), val->u.boolean);
+   return Sim_Set_Ok;
+}
+
+// [[type, records, bytes], ...] written to the log so far
+static attr_value_t get_log_records(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   LogSink *sink = log_sink(((osamod_t*)sc)->pStatStream);
+   if(sink == NULL)
+      return SIM_alloc_attr_list(0);
+   sink->flush_all();
+   const log_type_map_t &types = sink->type_stats();
+   attr_value_t list = SIM_alloc_attr_list(types.size());
+   int i = 0;
+   for(log_type_map_t::const_iterator it = types.begin();
+       it != types.end(); it++, i++) {
+      attr_value_t stat = SIM_alloc_attr_list(3);
+      stat.u.list.vector[0] = SIM_make_attr_string(it->first.c_str());
+      stat.u.list.vector[1] = SIM_make_attr_integer(it->second.records);
+      stat.u.list.vector[2] = SIM_make_attr_integer(it->second.bytes);
+      list.u.list.vector[i] = stat;
+   }
+   return list;
+}
+
+static attr_value_t get_lockOrder(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   return SIM_make_attr_boolean(((osamod_t*)sc)->syncchar->lockOrder);
+}
+
+static set_error_t set_lockOrder(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   osamod_t *osamod = (osamod_t*)osa_obj;
+
+   osamod->syncchar->lockOrder = val->u.boolean;
+
+   return Sim_Set_Ok;
+}
+
+static attr_value_t get_onlineIndependence(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   return SIM_make_attr_boolean(((osamod_t*)sc)->syncchar->onlineIndependence);
+}
+
+static set_error_t set_onlineIndependence(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   osamod_t *osamod = (osamod_t*)osa_obj;
+
+   osamod->syncchar->onlineIndependence = val->u.boolean;
+
+   return Sim_Set_Ok;
+}
+
+static void update_sampling(syncchar_data_t *syncchar) {
+   syncchar->sampling = syncchar->sample_rate.n < syncchar->sample_rate.m
+      || !syncchar->sample_lock_rates.empty()
+      || !syncchar->sample_caller_rates.empty()
+      || syncchar->sample_period > 0;
+   // Worksets opened from now on are sampled differently
+   invalidate_ws_cache(syncchar);
+}
+
+// [n, m], 0 <= n <= m, 0 < m
+static bool attr_to_rate(const attr_value_t *val, int first, ws_rate_t *rate) {
+   if(val->kind != Sim_Val_List || val->u.list.size != first + 2)
+      return false;
+   for(int i = 0; i < first + 2; i++)
+      if(val->u.list.vector[i].kind != Sim_Val_Integer)
+         return false;
+   integer_t n = val->u.list.vector[first].u.integer;
+   integer_t m = val->u.list.vector[first + 1].u.integer;
+   if(m <= 0 || n < 0 || n > m)
+      return false;
+   rate->n = n;
+   rate->m = m;
+   rate->pos.seq = 0;
+   rate->pos.chosen = 0;
+   return true;
+}
+
+static attr_value_t rate_map_attr(const ws_rate_map_t *rates) {
+   attr_value_t list = SIM_alloc_attr_list(rates->size());
+   int i = 0;
+   for(ws_rate_map_t::const_iterator it = rates->begin();
+       it != rates->end(); ++it, i++) {
+      list.u.list.vector[i] = SIM_alloc_attr_list(3);
+      list.u.list.vector[i].u.list.vector[0] = SIM_make_attr_integer(it->first);
+      list.u.list.vector[i].u.list.vector[1] = SIM_make_attr_integer(it->second.n);
+      list.u.list.vector[i].u.list.vector[2] = SIM_make_attr_integer(it->second.m);
+   }
+   return list;
+}
+
+// [[addr, n, m]*], replacing the current rates
+static set_error_t set_rate_map(ws_rate_map_t *rates, const attr_value_t *val) {
+   if(val->kind != Sim_Val_List)
+      return Sim_Set_Need_List;
+   ws_rate_map_t new_rates;
+   for(int i = 0; i < val->u.list.size; i++) {
+      ws_rate_t rate;
+      const attr_value_t *entry = &val->u.list.vector[i];
+      if(!attr_to_rate(entry, 1, &rate))
+         return Sim_Set_Illegal_Value;
+      new_rates[(unsigned int)entry->u.list.vector[0].u.integer] = rate;
+   }
+   rates->swap(new_rates);
+   return Sim_Set_Ok;
+}
+
+template <typename T>
+static attr_value_t pool_attr(const char *name, pool<T> *p) {
+   attr_value_t entry = SIM_alloc_attr_list(6);
+   entry.u.list.vector[0] = SIM_make_attr_string(name);
+   entry.u.list.vector[1] = SIM_make_attr_integer(p ? p->allocations() : 0);
+   entry.u.list.vector[2] = SIM_make_attr_integer(p ? p->deallocations() : 0);
+   entry.u.list.vector[3] = SIM_make_attr_integer(p ? p->allocated_count() : 0);
+   entry.u.list.vector[4] = SIM_make_attr_integer(p ? p->high_water() : 0);
+   entry.u.list.vector[5] = SIM_make_attr_integer(p ? p->size() : 0);
+   return entry;
+}
+
+static attr_value_t get_pool_stats(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)sc)->syncchar;
+   attr_value_t list = SIM_alloc_attr_list(2);
+   list.u.list.vector[0] = pool_attr("bp_rec", syncchar->bp_pool);
+   list.u.list.vector[1] = pool_attr("workset", syncchar->ws_pool);
+   return list;
+}
+
+static attr_value_t get_ws_sample_rate(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)sc)->syncchar;
+   attr_value_t list = SIM_alloc_attr_list(2);
+   list.u.list.vector[0] = SIM_make_attr_integer(syncchar->sample_rate.n);
+   list.u.list.vector[1] = SIM_make_attr_integer(syncchar->sample_rate.m);
+   return list;
+}
+
+static set_error_t set_ws_sample_rate(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)osa_obj)->syncchar;
+   if(!attr_to_rate(val, 0, &syncchar->sample_rate))
+      return Sim_Set_Illegal_Value;
+   update_sampling(syncchar);
+   return Sim_Set_Ok;
+}
+
+static attr_value_t get_ws_sample_lock_rates(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   return rate_map_attr(&((osamod_t*)sc)->syncchar->sample_lock_rates);
+}
+
+static set_error_t set_ws_sample_lock_rates(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)osa_obj)->syncchar;
+   set_error_t err = set_rate_map(&syncchar->sample_lock_rates, val);
+   if(err == Sim_Set_Ok)
+      update_sampling(syncchar);
+   return err;
+}
+
+static attr_value_t get_ws_sample_caller_rates(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   return rate_map_attr(&((osamod_t*)sc)->syncchar->sample_caller_rates);
+}
+
+static set_error_t set_ws_sample_caller_rates(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)osa_obj)->syncchar;
+   set_error_t err = set_rate_map(&syncchar->sample_caller_rates, val);
+   if(err == Sim_Set_Ok)
+      update_sampling(syncchar);
+   return err;
+}
+
+static attr_value_t get_ws_sample_window(void*, conf_object_t *sc,
+      attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)sc)->syncchar;
+   attr_value_t list = SIM_alloc_attr_list(2);
+   list.u.list.vector[0] = SIM_make_attr_integer(syncchar->sample_on);
+   list.u.list.vector[1] = SIM_make_attr_integer(syncchar->sample_period);
+   return list;
+}
+
+// [on, period] in cycles; a period of 0 turns windows off
+static set_error_t set_ws_sample_window(void*, conf_object_t *osa_obj,
+      attr_value_t *val, attr_value_t *idx) {
+   syncchar_data_t *syncchar = ((osamod_t*)osa_obj)->syncchar;
+   if(val->kind != Sim_Val_List || val->u.list.size != 2
+      || val->u.list.vector[0].kind != Sim_Val_Integer
+      || val->u.list.vector[1].kind != Sim_Val_Integer)
+      return Sim_Set_Need_List;
+   integer_t on = val->u.list.vector[0].u.integer;
+   integer_t period = val->u.list.vector[1].u.integer;
+   if(on < 0 || period < 0 || (period > 0 && on == 0) || on > period)
+      return Sim_Set_Illegal_Value;
+   syncchar->sample_on = on;
+   syncchar->sample_period = period;
+   update_sampling(syncchar);
+   return Sim_Set_Ok;
+}
+
 static attr_value_t get_afterBoot(void*, conf_object_t *sc,
       attr_value_t *idx) {
    return SIM_make_attr_boolean(((osamod_t*)sc)->syncchar->afterBoot);
@@ -2880,6 +4435,31 @@ static set_error_t set_afterBoot(void*, conf_object_t *osa_obj,
 }
 
 
+// [[cnt, sum, xsqr] x 3], as print_av prints them
+static attr_value_t av_attr(const avg_var av[3]) {
+   attr_value_t list = SIM_alloc_attr_list(3);
+   for(int i = 0; i < 3; i++) {
+      list.u.list.vector[i] = SIM_alloc_attr_list(3);
+      list.u.list.vector[i].u.list.vector[0] = SIM_make_attr_integer(av[i].cnt);
+      list.u.list.vector[i].u.list.vector[1] = SIM_make_attr_floating(av[i].sum);
+      list.u.list.vector[i].u.list.vector[2] = SIM_make_attr_floating(av[i].xsqr);
+   }
+   return list;
+}
+
+// [count, sum, p50, p90, p99, p99.9, max], as print_hist prints them
+static attr_value_t hist_attr(const LatencyHist &hist) {
+   attr_value_t list = SIM_alloc_attr_list(7);
+   list.u.list.vector[0] = SIM_make_attr_integer(hist.count());
+   list.u.list.vector[1] = SIM_make_attr_integer(hist.sum());
+   list.u.list.vector[2] = SIM_make_attr_integer(hist.percentile(0.5));
+   list.u.list.vector[3] = SIM_make_attr_integer(hist.percentile(0.9));
+   list.u.list.vector[4] = SIM_make_attr_integer(hist.percentile(0.99));
+   list.u.list.vector[5] = SIM_make_attr_integer(hist.percentile(0.999));
+   list.u.list.vector[6] = SIM_make_attr_integer(hist.max());
+   return list;
+}
+
 static attr_value_t get_lockmap(void*, conf_object_t *osamod,
       attr_value_t *idx) {
    syncchar_data_t *syncchar = ((osamod_t*)osamod)->syncchar;
@@ -2892,11 +4472,11 @@ static attr_value_t get_lockmap(void*, conf_object_t *osamod,
 
    // Populate it, keyed on lock address
    int i = 0;
-   for(lock_mapcit_t lsit = lockmap->begin(); 
+   for(lock_mapit_t lsit = lockmap->begin(); 
        lsit != lockmap->end(); lsit++, i++){
 
       // Allocate another dict to represent the struct lock
-      attr_value_t avStructLock = SIM_alloc_attr_dict(12);
+      attr_value_t avStructLock = SIM_alloc_attr_dict(15);
       
       avStructLock.u.dict.vector[0].key = SIM_make_attr_string("state");
       switch(lsit->second.state){
@@ -2971,15 +4551,32 @@ static attr_value_t get_lockmap(void*, conf_object_t *osamod,
       avStructLock.u.dict.vector[5].key = SIM_make_attr_string("acq");
       avStructLock.u.dict.vector[5].value = SIM_make_attr_nil(); //FIXME
 
+      // [[caller ra, count, q_count, acq, hold]*], and acq and hold
+      // merged over the callers
+      caller_map_t *callers = lsit->second.cold->callers;
+      LatencyHist acq, hold;
       avStructLock.u.dict.vector[6].key = SIM_make_attr_string("callers");
-      avStructLock.u.dict.vector[6].value = SIM_make_attr_nil(); // FIXME
+      avStructLock.u.dict.vector[6].value = SIM_alloc_attr_list(callers->size());
+      int c = 0;
+      for(caller_mapcit_t cacit = callers->begin();
+          cacit != callers->end(); ++cacit, c++) {
+         attr_value_t avCaller = SIM_alloc_attr_list(5);
+         avCaller.u.list.vector[0] = SIM_make_attr_integer(cacit->first);
+         avCaller.u.list.vector[1] = SIM_make_attr_integer(cacit->second.count);
+         avCaller.u.list.vector[2] = SIM_make_attr_integer(cacit->second.q_count);
+         avCaller.u.list.vector[3] = hist_attr(cacit->second.acq_hist);
+         avCaller.u.list.vector[4] = hist_attr(cacit->second.hold_hist);
+         avStructLock.u.dict.vector[6].value.u.list.vector[c] = avCaller;
+         acq.merge(cacit->second.acq_hist);
+         hold.merge(cacit->second.hold_hist);
+      }
 
       avStructLock.u.dict.vector[7].key = SIM_make_attr_string("name");
-      avStructLock.u.dict.vector[7].value = SIM_make_attr_string(lsit->second.name);
+      avStructLock.u.dict.vector[7].value = SIM_make_attr_string(lsit->second.cold->name);
 
       // Not used any more //
       avStructLock.u.dict.vector[8].key = SIM_make_attr_string("worksets");
-      avStructLock.u.dict.vector[6].value = SIM_make_attr_nil(); // FIXME
+      avStructLock.u.dict.vector[8].value = SIM_make_attr_nil(); // FIXME
       /*
       avStructLock.u.dict.vector[8].value = SIM_alloc_attr_list(lsit->second.worksets.size());
       { // Put the worksets in the attr_value_t
@@ -2992,14 +4589,28 @@ static attr_value_t get_lockmap(void*, conf_object_t *osamod,
       }
       */
          
+      // Only kept with online_independence
+      const struct lock_di *di = lsit->second.cold->di;
       avStructLock.u.dict.vector[9].key = SIM_make_attr_string("depend_av");
-      avStructLock.u.dict.vector[9].value = SIM_make_attr_nil(); // FIXME
+      avStructLock.u.dict.vector[9].value = di ? av_attr(di->depend_av)
+                                               : SIM_make_attr_nil();
 
       avStructLock.u.dict.vector[10].key = SIM_make_attr_string("total_av");
-      avStructLock.u.dict.vector[10].value = SIM_make_attr_nil(); // FIXME
+      avStructLock.u.dict.vector[10].value = di ? av_attr(di->total_av)
+                                                : SIM_make_attr_nil();
 
       avStructLock.u.dict.vector[11].key = SIM_make_attr_string("percent_av");
-      avStructLock.u.dict.vector[11].value = SIM_make_attr_nil(); // FIXME
+      avStructLock.u.dict.vector[11].value = di ? av_attr(di->percent_av)
+                                                : SIM_make_attr_nil();
+
+      avStructLock.u.dict.vector[12].key = SIM_make_attr_string("acq");
+      avStructLock.u.dict.vector[12].value = hist_attr(acq);
+
+      avStructLock.u.dict.vector[13].key = SIM_make_attr_string("hold");
+      avStructLock.u.dict.vector[13].value = hist_attr(hold);
+
+      avStructLock.u.dict.vector[14].key = SIM_make_attr_string("nest");
+      avStructLock.u.dict.vector[14].value = hist_attr(lsit->second.cold->nest_hist);
 
 
       // Put it back in the output dict
@@ -3044,13 +4655,36 @@ extern "C" {
       osamod->syncchar->archived_worksets = 1;
       osamod->syncchar->logWorksets = true;
       osamod->syncchar->afterBoot = false;
+      osamod->syncchar->onlineIndependence = false;
+      osamod->syncchar->lockOrder = false;
+      osamod->syncchar->sampling = false;
+      osamod->syncchar->sample_rate.n = 1;
+      osamod->syncchar->sample_rate.m = 1;
+      osamod->syncchar->sample_rate.pos.seq = 0;
+      osamod->syncchar->sample_rate.pos.chosen = 0;
+      osamod->syncchar->sample_on = 0;
+      osamod->syncchar->sample_period = 0;
+      osamod->syncchar->boot_cycle = 0;
+      osamod->syncchar->boot_cycle_known = false;
+      osamod->syncchar->sample_rng = 0x9e3779b97f4a7c15ULL;
 
       osamod->syncchar->osatxm = NULL;
       osamod->syncchar->osatxm_mod = NULL;
+      osamod->syncchar->ws_cache = NULL;
+      osamod->syncchar->ws_cache_gen = 1;
+      osamod->syncchar->bp_pool = NULL;
+      osamod->syncchar->ws_pool = NULL;
+      osamod->syncchar->event_log = NULL;
+      osamod->syncchar->event_log_codec = EVLOG_CODEC_NONE;
+      osamod->syncchar->timeline_epoch = 0;
+      osamod->syncchar->timeline_buckets = 256;
+      osamod->syncchar->timeline_dropped = 0;
+      strcpy(osamod->syncchar->handoff_name, "runqueue_t->lock");
+      osamod->recorder = NULL;
 
       time_t tim = time(NULL);
       
-      ostream *pStatStream = new ofstream("sync_char.log");
+      ostream *pStatStream = new LogStream("sync_char.log");
       osamod->pStatStream = pStatStream;
       
       if(pStatStream->good() == false) {
@@ -3184,7 +4818,7 @@ extern "C" {
                                    set_archived_worksets, NULL,
                                    Sim_Attr_Optional,
                                    "i", NULL,
-                                   "Number of previous worksets to compare.");
+                                   "Number of previous worksets per lock to compare each closed workset with when online_independence is set.");
 
       SIM_register_typed_attribute(
                                    pConfClass, "lockmap",
@@ -3227,6 +4861,94 @@ extern "C" {
                                    "b", NULL,
                                    "Should syncchar log its worksets?");
 
+      SIM_register_typed_attribute(
+                                   pConfClass, "online_independence",
+                                   get_onlineIndependence, 0,
+                                   set_onlineIndependence, 0,
+                                   Sim_Attr_Optional,
+                                   "b", NULL,
+                                   "Compute data independence as worksets close, and print it with the stats (DI_LOCK and DI_CPUS lines)?");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "lock_order",
+                                   get_lockOrder, 0,
+                                   set_lockOrder, 0,
+                                   Sim_Attr_Optional,
+                                   "b", NULL,
+                                   "Build the lock acquisition order graph from the locks each pid holds (needs log_worksets), and print it with the stats (LOCK_ORDER, LOCK_CYCLE and OCCLUDING lines)?");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "log_buffer",
+                                   get_log_buffer, 0,
+                                   set_log_buffer, 0,
+                                   Sim_Attr_Optional,
+                                   "i", NULL,
+                                   "Bytes of log text buffered before it is written (default 1MB).  The log only reaches the file when the buffer fills, at stats dumps and resets, at killsim and when the simulator exits.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "log_async",
+                                   get_log_async, 0,
+                                   set_log_async, 0,
+                                   Sim_Attr_Optional,
+                                   "b", NULL,
+                                   "Write full log buffers from a background thread?");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "log_records",
+                                   get_log_records, 0,
+                                   0, 0,
+                                   Sim_Attr_Pseudo,
+                                   "[[sii]*]", NULL,
+                                   "Records and bytes written to the log by record type (the word a line starts with), after writing out the buffer.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "handoff_lock",
+                                   get_handoff_lock, 0,
+                                   set_handoff_lock, 0,
+                                   Sim_Attr_Optional,
+                                   "s", NULL,
+                                   "Name of the registered locks that are handed from the pid that took them to the next one scheduled, and released there (default runqueue_t->lock, empty for none).");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "ws_sample_rate",
+                                   get_ws_sample_rate, 0,
+                                   set_ws_sample_rate, 0,
+                                   Sim_Attr_Optional,
+                                   "[ii]", NULL,
+                                   "[n, m]: collect the worksets of n of every m critical sections of each lock.  Lock accounting is unaffected.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "ws_sample_lock_rates",
+                                   get_ws_sample_lock_rates, 0,
+                                   set_ws_sample_lock_rates, 0,
+                                   Sim_Attr_Optional,
+                                   "[[iii]*]", NULL,
+                                   "[[lock address, n, m]*]: per-lock workset sampling rates, overriding ws_sample_rate.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "ws_sample_caller_rates",
+                                   get_ws_sample_caller_rates, 0,
+                                   set_ws_sample_caller_rates, 0,
+                                   Sim_Attr_Optional,
+                                   "[[iii]*]", NULL,
+                                   "[[caller ra, n, m]*]: per-caller workset sampling rates, counted over the caller's critical sections and overriding the lock rates.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "ws_sample_window",
+                                   get_ws_sample_window, 0,
+                                   set_ws_sample_window, 0,
+                                   Sim_Attr_Optional,
+                                   "[ii]", NULL,
+                                   "[on, period]: collect worksets only in the first on cycles of every period cycles after boot.  A period of 0 (the default) collects at all times.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "pool_stats",
+                                   get_pool_stats, 0,
+                                   0, 0,
+                                   Sim_Attr_Pseudo,
+                                   "[[siiiii]*]", NULL,
+                                   "[[pool, allocations, frees, live, high water, slots]*] for the breakpoint record and workset pools.");
+
 
 
       SIM_register_typed_attribute(pConfClass, "use_txcache",
@@ -3244,6 +4966,45 @@ extern "C" {
                                    "b", NULL,
                                    "Have we passed boot? (set manually if loading after a checkpoint)");
 
+      SIM_register_typed_attribute(
+                                   pConfClass, "event_log",
+                                   get_event_log, 0,
+                                   set_event_log, 0,
+                                   Sim_Attr_Session,
+                                   "s|n", NULL,
+                                   "Binary event log file.  While set, worksets are "
+                                   "logged there instead of in sync_char.log.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "event_log_codec",
+                                   get_event_log_codec, 0,
+                                   set_event_log_codec, 0,
+                                   Sim_Attr_Session,
+                                   "s", NULL,
+                                   "Block compression for the next event log: "
+                                   "none, zlib, lz4 or zstd, as built in.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "timeline_epoch",
+                                   get_timeline_epoch, 0,
+                                   set_timeline_epoch, 0,
+                                   Sim_Attr_Optional,
+                                   "i", NULL,
+                                   "Cycles per lock timeline bucket.  If set, each lock "
+                                   "counts acquires, contended acquires, hold cycles and "
+                                   "its longest wait per bucket, and stats dumps write "
+                                   "the buckets to the event log.  0 (the default) is off.");
+
+      SIM_register_typed_attribute(
+                                   pConfClass, "timeline_buckets",
+                                   get_timeline_buckets, 0,
+                                   set_timeline_buckets, 0,
+                                   Sim_Attr_Optional,
+                                   "i", NULL,
+                                   "Buckets kept per lock when timeline_epoch is set "
+                                   "(default 256).  A lock whose buckets fill up before "
+                                   "a stats dump writes them to the event log early.");
+
 
 
 
@@ -0,0 +1,371 @@
+// SyncChar Project
+// File Name: wsbench.cc
+//
+// Description: Microbenchmark for WorkSet.  Runs the same synthetic
+// access streams through WorkSet and through MapWorkSet, a copy of
+// the original std::map<address, ByteRange> implementation, checks
+// that sizes, compare() and the logWorkset bytes agree, and reports
+// the time per operation for each.
+//
+//    make -f Makefile.replay wsbench
+//    ./wsbench [worksets [accesses]]
+//
+// Build with CXXFLAGS="-O2 -mavx2" (or -mssse3) to time the vector
+// kernels.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2006, 2007. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "WorkSet.h"
+
+using namespace std;
+
+// The original WorkSet storage, kept as the reference
+static inline int population(set_chunk x) {
+   unsigned int pop = 0;
+   for(pop = 0; x;  pop++)
+      x &= x - 1;
+   return pop;
+}
+
+class MapWorkSet {
+ public:
+   MapWorkSet(unsigned int lk_addr, spid_t pd, unsigned int ws_index)
+      : id(lk_addr, 0, ws_index), pid(pd) {}
+   void grow(osa_logical_address_t addr, int len, osa_memop_basic_type_t type);
+   int compare(MapWorkSet *other, int *this_size);
+   int size();
+   int rsize();
+   int wsize();
+   void logWorkset(ostream &out);
+
+   WorksetID id;
+   spid_t pid;
+
+ private:
+   map<osa_logical_address_t, ByteRange> set;
+   typedef map<osa_logical_address_t, ByteRange>::iterator set_it;
+};
+
+void MapWorkSet::grow(osa_logical_address_t addr, int len, osa_memop_basic_type_t type) {
+   osa_logical_address_t cur = addr;
+   osa_logical_address_t end = addr+len;
+   while(cur < end) {
+      osa_logical_address_t range_start = cur & RANGE_MASK;
+      ByteRange range;
+      set_it range_it = set.find(range_start);
+      if(range_it == set.end()) {
+         memset(&range, 0, sizeof(ByteRange));
+         pair<set_it, bool> inserted =
+            set.insert(make_pair(range_start, range));
+         range_it = inserted.first;
+      }
+      else {
+         range = range_it->second;
+      }
+
+      set_chunk full_chunk;
+      if(type == Sim_Trans_Load)
+         full_chunk = READ_MASK;
+      else if(type == Sim_Trans_Store)
+         full_chunk = WRITE_MASK;
+      else
+         full_chunk = 0;
+
+      unsigned int offset = cur & ~RANGE_MASK;
+      unsigned int i = offset/CHUNK_BYTES;
+      osa_logical_address_t chunk_start = range_start + i*CHUNK_BYTES;
+      osa_logical_address_t chunk_end = chunk_start + CHUNK_BYTES;
+      for(; i < BYTEMAP_LEN && cur < end; i++) {
+         set_chunk chunk_mask = (set_chunk)-1;
+         if(addr > chunk_start)
+            chunk_mask &=
+               ~BIT_MASK(2*(8*sizeof(set_chunk) - (addr - chunk_start)));
+         if(end < chunk_end)
+            chunk_mask &= BIT_MASK(2*(chunk_end - end));
+
+         range.bmap[i] |= full_chunk & chunk_mask;
+
+         chunk_start = chunk_end;
+         chunk_end += CHUNK_BYTES;
+
+         cur = chunk_start;
+      }
+      range_it->second = range;
+   }
+}
+
+int MapWorkSet::compare(MapWorkSet *other, int *this_size) {
+   set_it self_it = set.begin();
+   set_it other_it = other->set.begin();
+
+   int dependencies = 0;
+   int size = 0;
+
+   while(self_it != set.end() && other_it != other->set.end()) {
+      if(self_it->first < other_it->first) {
+         unsigned int i;
+         for(i = 0; i < BYTEMAP_LEN; i++)
+            size += population(
+                  (self_it->second.bmap[i] & READ_MASK) |
+                  ((self_it->second.bmap[i] & WRITE_MASK) >> 1));
+         self_it++;
+      }
+      else if(other_it->first < self_it->first)
+         other_it++;
+      else {
+         ByteRange range1 = self_it->second;
+         ByteRange range2 = other_it->second;
+         set_chunk reads1, writes1, reads2, writes2, depends;
+         unsigned int i, chunk_size;
+
+         for(i = 0; i < BYTEMAP_LEN; i++) {
+            reads1 = range1.bmap[i] & READ_MASK;
+            writes1 = (range1.bmap[i] & WRITE_MASK) >> 1;
+            chunk_size = population(reads1 | writes1);
+            size += chunk_size;
+            if(!chunk_size)
+               continue;
+            reads2 = range2.bmap[i] & READ_MASK;
+            writes2 = (range2.bmap[i] & WRITE_MASK) >> 1;
+            depends = (reads1 & writes2) | (reads2 & writes1) | (writes1 & writes2);
+            dependencies += population(depends);
+         }
+
+         self_it++;
+         other_it++;
+      }
+   }
+
+   if(this_size != NULL)
+      *this_size = size;
+   return dependencies;
+}
+
+int MapWorkSet::size(){
+   int size = 0;
+   for(set_it iter = set.begin(); iter != set.end(); iter++){
+      ByteRange range = iter->second;
+      for(unsigned int i = 0; i < BYTEMAP_LEN; i++){
+         set_chunk reads = range.bmap[i] & READ_MASK;
+         set_chunk writes = (range.bmap[i] & WRITE_MASK) >> 1;
+         size += population(reads | writes);
+      }
+   }
+   return size;
+}
+
+int MapWorkSet::rsize(){
+   int size = 0;
+   for(set_it iter = set.begin(); iter != set.end(); iter++){
+      ByteRange range = iter->second;
+      for(unsigned int i = 0; i < BYTEMAP_LEN; i++)
+         size += population(range.bmap[i] & READ_MASK);
+   }
+   return size;
+}
+
+int MapWorkSet::wsize(){
+   int size = 0;
+   for(set_it iter = set.begin(); iter != set.end(); iter++){
+      ByteRange range = iter->second;
+      for(unsigned int i = 0; i < BYTEMAP_LEN; i++)
+         size += population((range.bmap[i] & WRITE_MASK) >> 1);
+   }
+   return size;
+}
+
+void MapWorkSet::logWorkset(ostream &out){
+   out << "WS_CLOSE "
+       << " " << std::hex << id.lock_addr << std::dec
+       << " " << id.lock_generation
+       << " " << id.workset_index
+       << " (" << pid << ") 0 C[ ]" << endl;
+
+   char tmp_buf[(sizeof(set_chunk) * BYTEMAP_LEN) + sizeof(int)];
+   char size[sizeof(int)];
+   *(int *) size = set.size();
+   out.write((char *) &size, sizeof(int));
+
+   for(set_it iter = set.begin(); iter != set.end(); iter++){
+      memset(tmp_buf, 0, sizeof(tmp_buf));
+      ByteRange range = iter->second;
+      osa_logical_address_t addr = iter->first;
+      *((int *) tmp_buf) = addr;
+      memcpy(tmp_buf + sizeof(int), range.bmap, sizeof(range.bmap));
+      out.write(tmp_buf, sizeof(tmp_buf));
+   }
+   out << "\n";
+}
+
+typedef struct _ws_access_t {
+   osa_logical_address_t addr;
+   int len;
+   osa_memop_basic_type_t type;
+} ws_access_t;
+
+// Critical-section-like streams: a few hot structures plus a tail of
+// scattered accesses, sizes 1-8, about a third stores
+static void make_stream(vector<ws_access_t> &out, int n, unsigned int seed,
+                        int scatter_pct) {
+   static const int lens[] = { 1, 2, 4, 4, 4, 8 };
+   srand(seed);
+   osa_logical_address_t hot = 0xc0400000 + (rand() % 64) * 4096;
+   out.clear();
+   for(int i = 0; i < n; i++) {
+      ws_access_t a;
+      a.len = lens[rand() % 6];
+      if(rand() % 100 < scatter_pct)
+         a.addr = 0xc1000000 + (rand() % (64 << 20));
+      else
+         a.addr = hot + (rand() % 2048);
+      a.addr &= ~(osa_logical_address_t)(a.len - 1);
+      a.type = rand() % 3 ? Sim_Trans_Load : Sim_Trans_Store;
+      out.push_back(a);
+   }
+}
+
+static double now() {
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, int set) {
+   if(!ok) {
+      cerr << "XXX: " << what << " differs for workset " << set << endl;
+      failures++;
+   }
+}
+
+static void run(const char *name, int nsets, int naccess, int scatter_pct) {
+   vector<vector<ws_access_t> > streams(nsets);
+   for(int s = 0; s < nsets; s++)
+      make_stream(streams[s], naccess, s + 1, scatter_pct);
+
+   vector<MapWorkSet *> old_ws;
+   vector<WorkSet *> new_ws;
+   double t_old[4], t_new[4];
+   long long total = 0;
+   int osum = 0, nsum = 0;
+
+   // grow
+   double t = now();
+   for(int s = 0; s < nsets; s++) {
+      MapWorkSet *ws = new MapWorkSet(0xc0500000, s, s);
+      for(unsigned int i = 0; i < streams[s].size(); i++)
+         ws->grow(streams[s][i].addr, streams[s][i].len, streams[s][i].type);
+      old_ws.push_back(ws);
+   }
+   t_old[0] = now() - t;
+   t = now();
+   for(int s = 0; s < nsets; s++) {
+      WorkSet *ws = new WorkSet(0xc0500000, s, 0, s, 0);
+      for(unsigned int i = 0; i < streams[s].size(); i++)
+         ws->grow(streams[s][i].addr, streams[s][i].len, streams[s][i].type);
+      new_ws.push_back(ws);
+   }
+   t_new[0] = now() - t;
+   total = (long long)nsets * naccess;
+
+   // size, rsize, wsize
+   t = now();
+   for(int s = 0; s < nsets; s++)
+      osum += old_ws[s]->size() + old_ws[s]->rsize() + old_ws[s]->wsize();
+   t_old[1] = now() - t;
+   t = now();
+   for(int s = 0; s < nsets; s++)
+      nsum += new_ws[s]->size() + new_ws[s]->rsize() + new_ws[s]->wsize();
+   t_new[1] = now() - t;
+   for(int s = 0; s < nsets; s++) {
+      check(old_ws[s]->size() == new_ws[s]->size(), "size", s);
+      check(old_ws[s]->rsize() == new_ws[s]->rsize(), "rsize", s);
+      check(old_ws[s]->wsize() == new_ws[s]->wsize(), "wsize", s);
+   }
+
+   // compare each workset with its neighbour
+   int odeps = 0, ndeps = 0;
+   t = now();
+   for(int s = 0; s + 1 < nsets; s++)
+      odeps += old_ws[s]->compare(old_ws[s + 1], NULL);
+   t_old[2] = now() - t;
+   t = now();
+   for(int s = 0; s + 1 < nsets; s++)
+      ndeps += new_ws[s]->compare(new_ws[s + 1], NULL);
+   t_new[2] = now() - t;
+   check(odeps == ndeps, "compare", -1);
+
+   // logWorkset, into a scratch stream per workset so that neither
+   // side pays for growing one big buffer
+   string olog, nlog;
+   ostringstream scratch;
+   t = now();
+   for(int s = 0; s < nsets; s++) {
+      scratch.str("");
+      old_ws[s]->logWorkset(scratch);
+      olog += scratch.str();
+   }
+   t_old[3] = now() - t;
+   t = now();
+   for(int s = 0; s < nsets; s++) {
+      scratch.str("");
+      new_ws[s]->logWorkset(scratch);
+      nlog += scratch.str();
+   }
+   t_new[3] = now() - t;
+   check(olog == nlog, "logWorkset", -1);
+   check(osum == nsum, "size sum", -1);
+
+   static const char *ops[] = { "grow", "size+rsize+wsize", "compare",
+                                "logWorkset" };
+   long long per[] = { total, nsets, nsets - 1, nsets };
+   cout << name << ": " << nsets << " worksets x " << naccess
+        << " accesses, " << olog.size() << " log bytes" << endl;
+   for(int i = 0; i < 4; i++) {
+      double o = t_old[i] * 1e9 / (per[i] ? per[i] : 1);
+      double n = t_new[i] * 1e9 / (per[i] ? per[i] : 1);
+      cout << "   " << ops[i] << ": map " << o << " ns, block " << n
+           << " ns (" << (n > 0 ? o / n : 0) << "x)" << endl;
+   }
+
+   for(int s = 0; s < nsets; s++) {
+      delete old_ws[s];
+      delete new_ws[s];
+   }
+}
+
+int main(int argc, char **argv) {
+   int nsets = argc > 1 ? atoi(argv[1]) : 2000;
+   int naccess = argc > 2 ? atoi(argv[2]) : 200;
+
+   run("dense", nsets, naccess, 0);
+   run("mixed", nsets, naccess, 10);
+   run("sparse", nsets, naccess, 90);
+
+   if(failures) {
+      cerr << "XXX: " << failures << " mismatches" << endl;
+      return 1;
+   }
+   return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -1,105 +1,137 @@
 // MetaTM Project
-// File Name: dram.cc 
+// File Name: dram.cc
 //
-// Description: This modules implements a simple
-// first_ready DRAM scheduler with permutation based
-// page interleaving. It will detect the DRAM row hit
-// and return appropriate stall time to the staller module.  
+// Description: banked FR-FCFS DRAM timing model for the staller
 //
 // Operating Systems & Architecture Group
 // University of Texas at Austin - Department of Computer Sciences
 // Copyright 2008. All Rights Reserved.
 // See LICENSE file for license terms.
 
+#include <string.h>
 #include "dram.h"
 
-dram_stat_t dram_stat;
-mem_controller_t mem_controller;
+static int exact_log2(int v) {
+   if(v < 1 || (v & (v - 1)))
+      return -1;
+   return __builtin_ctz(v);
+}
 
-unsigned mem_controller_element_t::get_bank_address (void)
-{
-	
-	return (((( address >> MEM_COL_ADDR_BITS ) && MEM_BANK_ADDR_MASK ) ^ (address >> (PHYSICAL_ADDR_SIZE - CACHE_TAG_BITS))) & MEM_BANK_ADDR_MASK);
+bool dram_configure(dram_t *d, stconfig *config) {
+   int bank_bits = exact_log2(config->get_dram_banks());
+   int rank_bits = exact_log2(config->get_dram_ranks());
+   int row_bits = config->get_dram_row_bits();
+   if(bank_bits < 0 || rank_bits < 0 ||
+      (1 << (bank_bits + rank_bits)) > DRAM_MAX_BANKS ||
+      row_bits < 1 || row_bits > 30)
+      return false;
+   d->bank_bits = bank_bits;
+   d->rank_bits = rank_bits;
+   d->row_bits = row_bits;
+   d->open_page = config->get_dram_open_page() != 0;
+   memset(d->banks, 0, sizeof(d->banks));
+   return true;
 }
 
-unsigned mem_controller_element_t::get_row_address (void)
-{
-	
-	return ( (address >> (MEM_COL_ADDR_BITS + MEM_BANK_ADDR_BITS)) & MEM_ROW_ADDR_MASK);
+static inline dram_req_t *bank_req(dram_bank_t *b, unsigned int i) {
+   return &b->q[(b->head + i) % DRAM_QUEUE_DEPTH];
 }
 
-void dram_stat_t::update_stat(mem_controller_element_t &mce)
-{
-	current_bank = mce.get_bank_address();
-	current_rows[current_bank] = mce.get_row_address();
+// Drop the requests finished by now
+static inline void bank_retire(dram_bank_t *b, cycles_t now) {
+   while(b->n && b->q[b->head].done <= now) {
+      b->head = (b->head + 1) % DRAM_QUEUE_DEPTH;
+      b->n--;
+   }
 }
 
+cycles_t dram_access(dram_t *d, stconfig *config, cycles_t now,
+                     uint64_t paddr) {
+   uint64_t a = paddr >> d->row_bits;
+   unsigned int bank = a & ((1 << d->bank_bits) - 1);
+   a >>= d->bank_bits;
+   unsigned int rank = a & ((1 << d->rank_bits) - 1);
+   uint64_t row = a >> d->rank_bits;
+   bank ^= row & ((1 << d->bank_bits) - 1);
+   dram_bank_t *b = &d->banks[(rank << d->bank_bits) | bank];
 
+   cycles_t cas = config->get_dram_cas();
+   cycles_t ras = config->get_dram_ras();
+   cycles_t pre = config->get_dram_precharge();
 
-trans_time_t mem_controller_t::book_keeping (trans_time_t current_time, dram_stat_t dram_stat) 
-{
-	list <mem_controller_element_t>:: iterator i;
-	trans_time_t next_complete_time = 0;
+   cycles_t arrive = now;
+   bank_retire(b, arrive);
+   if(b->n == DRAM_QUEUE_DEPTH) {
+      // wait for the oldest to finish
+      d->stats.queue_full++;
+      arrive = b->q[b->head].done;
+      bank_retire(b, arrive);
+   }
+   d->stats.accesses++;
 
-	for (i = L.begin(); i != L.end(); i++){
-		if (i->get_complete_time() <= current_time) {
-			dram_stat.update_stat(*i);
-			L.erase(i);
-		} else {
-			next_complete_time = i->get_complete_time();
-		}
-	}
-	/*return zero if there is no more outstanding memop in scheduler*/
-	return next_complete_time;
-}
-trans_time_t mem_controller_t::insert_memeop (trans_time_t current_time, mem_controller_element_t &mce, dram_stat_t dram_stat)	
-{
-	list <mem_controller_element_t>:: iterator i;
-	trans_time_t next_complete_time= 0;
-	dram_stat_t dram_stat_speculated;
+   dram_req_t r;
+   r.row = row;
+   unsigned int pos = b->n;
+   if(d->open_page) {
+      // Look back over queued requests for other rows that have not
+      // started yet, for one that will leave this row open
+      for(unsigned int i = b->n; i > 0; i--) {
+         dram_req_t *q = bank_req(b, i - 1);
+         if(q->row == row) {
+            pos = i;
+            break;
+         }
+         if(q->start <= arrive)
+            break;
+      }
+   }
 
-	next_complete_time = book_keeping(current_time, dram_stat);
+   if(pos < b->n) {
+      // A hit on a row a queued request opens: go in behind it, and
+      // push the ones behind back by a column access
+      r.start = bank_req(b, pos - 1)->done;
+      r.done = r.start + cas;
+      for(unsigned int i = b->n; i > pos; i--) {
+         dram_req_t *q = bank_req(b, i);
+         *q = *bank_req(b, i - 1);
+         q->start += cas;
+         q->done += cas;
+      }
+      *bank_req(b, pos) = r;
+      b->n++;
+      b->ready += cas;
+      d->stats.row_hits++;
+      d->stats.reordered++;
+   } else {
+      r.start = arrive > b->ready ? arrive : b->ready;
+      if(!d->open_page) {
+         r.done = r.start + ras + cas;
+         b->ready = r.done + pre;
+         d->stats.row_empty++;
+      } else {
+         if(b->open && b->open_row == row) {
+            r.done = r.start + cas;
+            d->stats.row_hits++;
+         } else if(!b->open) {
+            r.done = r.start + ras + cas;
+            d->stats.row_empty++;
+         } else {
+            r.done = r.start + pre + ras + cas;
+            d->stats.row_conflicts++;
+         }
+         b->open = true;
+         b->open_row = row;
+         b->ready = r.done;
+      }
+      *bank_req(b, b->n) = r;
+      b->n++;
+   }
 
-	/*see if there is a pending memop whith same active bank and same row, if so insert the memop there and return the CAS delay*/
-	dram_stat_speculated = dram_stat;
-	int found_matched_mce = 0;
-	for (i = L.begin(); i != L.end(); i++){
-		if (!found_matched_mce && (mce.get_bank_address() == dram_stat_speculated.current_bank && 
-		mce.get_row_address() == dram_stat_speculated.current_rows[dram_stat_speculated.current_bank])){
-		/*insert the new memop here */
-		mce.set_complete_time(i->get_complete_time());
-		i->postpone(CAS_DELAY); 
-		L.insert(i, mce);
-		/*postpone the next memops from here to end*/
-		} else if (found_matched_mce)
-			i->postpone(CAS_DELAY);
-	}			
-	if (found_matched_mce) {
-		i = L.end();
-		return i->get_complete_time();
-	}
-	/*see if there is a pending memop whith same bank (not active) and same row, if so insert the memop there and return the CAS delay*/
-	for (i = L.begin(); i != L.end(); i++){
-		if (!found_matched_mce && (mce.get_bank_address() == i->get_bank_address() && 
-		mce.get_row_address() == i->get_row_address() )){
-		/*insert the new memop here */
-		mce.set_complete_time(i->get_complete_time());
-		i->postpone(CAS_DELAY+RAS_DELAY); 
-		L.insert(i, mce);
-		/*postpone the next memops from here to end*/
-		} else if (found_matched_mce)
-			i->postpone(CAS_DELAY+RAS_DELAY);
-	}			
-	if (found_matched_mce) {
-		i = L.end();
-		return i->get_complete_time();
-	}
-	/*no bank hit lets add the memop at the end of the memory controller list*/
-	i = L.end();
-	mce.set_complete_time(i->get_complete_time()+CAS_DELAY + RAS_DELAY + PRECHARGE_DELAY);
-	L.insert(i, mce);
-	return(mce.get_complete_time());
+   cycles_t latency = r.done - now;
+   d->stats.latency += latency;
+   return latency;
 }
+
 /*
  * Local variables:
  *  c-indent-level: 3
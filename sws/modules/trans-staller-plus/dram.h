@@ -1,67 +1,90 @@
 // MetaTM Project
 // File Name: dram.h
 //
-// Description: This modules implements a simple
-// first_ready DRAM scheduler with permutation based
-// page interleaving. It will detect the DRAM row hit
-// and return appropriate stall time to the staller module.  
+// Description: A banked DRAM timing model for the staller.  Physical
+// addresses are split into row, rank, bank and column, with the bank
+// bits xor-ed with the low row bits (permutation based page
+// interleaving) so that strided streams spread over the banks.  Each
+// bank keeps the requests it has scheduled but not finished in a
+// small ring buffer, in service order, and serves them first-ready
+// first-come-first-served: a request for the row a queued request
+// will leave open goes in right behind it, ahead of any queued
+// requests for other rows that have not started.  With an open-page
+// policy a row stays open until a request for another row needs the
+// bank; with closed-page every access precharges after itself.
+//
+// Latencies, in cycles, are the staller's dram_cas (column access),
+// dram_ras (row activate) and dram_precharge attributes.  A row hit
+// costs CAS, an access to a precharged bank RAS + CAS, and a row
+// conflict precharge + RAS + CAS, each after the bank is free.
 //
 // Operating Systems & Architecture Group
 // University of Texas at Austin - Department of Computer Sciences
 // Copyright 2008. All Rights Reserved.
 // See LICENSE file for license terms.
-#include <iostream>
-#include <list>
-#include <vector>
 
-using namespace std;
+#ifndef _TX_STALLER_DRAM_H_
+#define _TX_STALLER_DRAM_H_
+
+#include <stdint.h>
+#include "stconfig.h"
+
+// Outstanding requests per bank before a new one has to wait
+#define DRAM_QUEUE_DEPTH   16
+// ranks * banks
+#define DRAM_MAX_BANKS     64
+
+typedef struct _dram_req_t {
+   uint64_t row;
+   cycles_t start;
+   cycles_t done;
+} dram_req_t;
 
-#define CACHE_TAG_BITS 7
-#define MEM_BANK_ADDR_BITS 2
-#define MEM_COL_ADDR_BITS 11 
-#define MEM_BANK_ADDR_MASK (1<<MEM_BANK_ADDR_BITS)-1
-#define MEM_ROW_ADDR_BITS (PHYSICAL_ADDR_SIZE - MEM_COL_ADDR_BITS - MEM_BANK_ADDR_BITS)
-#define MEM_ROW_ADDR_MASK (1<<MEM_ROW_ADDR_BITS)-1
-#define MEM_NUM_OF_BANKS 1<<MEM_BANK_ADDR_BITS
-#define PHYSICAL_ADDR_SIZE 32
-#define UNDEFINED_ROW 0xFFFFFFFF 
+typedef struct _dram_bank_t {
+   dram_req_t q[DRAM_QUEUE_DEPTH];
+   unsigned int head;
+   unsigned int n;
+   /* row buffer state once everything queued has been served */
+   bool open;
+   uint64_t open_row;
+   /* when the bank can start on a new request */
+   cycles_t ready;
+} dram_bank_t;
 
-#define CAS_DELAY 100  
-#define RAS_DELAY 100 
-#define PRECHARGE_DELAY 150
-/* The above stuff are default values they will be parametrized in staller*/
+typedef struct _dram_stats_t {
+   unsigned long long accesses;
+   unsigned long long row_hits;
+   /* bank precharged, row had to be opened */
+   unsigned long long row_empty;
+   /* another row open, had to be closed first */
+   unsigned long long row_conflicts;
+   /* row hits served ahead of older requests */
+   unsigned long long reordered;
+   /* arrived to a full bank queue */
+   unsigned long long queue_full;
+   unsigned long long latency;
+} dram_stats_t;
 
-typedef unsigned physical_address_t;
-typedef unsigned trans_time_t;
+typedef struct _dram_t {
+   /* geometry, from the stconfig at the last dram_configure() */
+   int rank_bits;
+   int bank_bits;
+   int row_bits;
+   bool open_page;
+   dram_stats_t stats;
+   dram_bank_t banks[DRAM_MAX_BANKS];
+} dram_t;
 
-typedef class mem_controller_element_t {
-	unsigned int address;
-	trans_time_t complete_time;
-	public:
-	trans_time_t get_complete_time () {return complete_time;};
-	void set_complete_time (trans_time_t t) { complete_time = t;};	
-	physical_address_t get_physical_address () {return address;};
-	void set_physical_address (physical_address_t a) { address = a;};	
-	unsigned get_bank_address (void);
-	unsigned get_row_address (void);
-	void postpone (trans_time_t delta) { complete_time += delta; };
-};
+// Empty the banks and take the geometry from config.  false if it
+// is unusable (not powers of 2, or too many banks); the model is then
+// left as it was.
+bool dram_configure(dram_t *d, stconfig *config);
 
-typedef class dram_stat_t {
-public:
-	void drm_stat_t(void) { current_bank = 0; current_rows.assign(MEM_NUM_OF_BANKS, UNDEFINED_ROW);};
-	unsigned current_bank;
-	vector <unsigned> current_rows;	
-	void update_stat (mem_controller_element_t &);
-};
+// Latency of an access to paddr arriving at now
+cycles_t dram_access(dram_t *d, stconfig *config, cycles_t now,
+                     uint64_t paddr);
 
-class mem_controller_t {	
-	public:
-	trans_time_t book_keeping (trans_time_t, dram_stat_t);
-	trans_time_t insert_memeop (trans_time_t, mem_controller_element_t &, dram_stat_t);	
-	list <mem_controller_element_t> L;
-	
-};
+#endif
 /*
  * Local variables:
  *  c-indent-level: 3
@@ -0,0 +1,166 @@
+// MetaTM Project
+// File Name: drambench.cc
+//
+// Description: Drives the staller's DRAM model with synthetic
+// address streams, without Simics.  Checks the latency of row hits,
+// accesses to a precharged bank and row conflicts, that a sequential
+// stream hits the open row for every line but a row's first, that
+// closed-page never hits, that a row hit queued behind a conflict is
+// served first, and that a full bank queue makes requests wait.
+// Then reports the time per access for a random stream.
+//
+//    make -f Makefile.bench
+//    ./drambench [accesses]
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2008. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <iostream>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "dram.h"
+
+using namespace std;
+
+#define LINE_SIZE    64
+// Far enough apart that nothing queues
+#define IDLE_GAP     10000
+
+static double now() {
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+   if(!ok) {
+      cerr << "XXX: " << what << endl;
+      failures++;
+   }
+}
+
+static void setup(dram_t *d, stconfig *config, bool open_page) {
+   config->set_dram_open_page(open_page);
+   memset(&d->stats, 0, sizeof(d->stats));
+   check(dram_configure(d, config), "default geometry refused");
+}
+
+// Row row of rank 0 bank 0: the bank bits are xor-ed with the low
+// row bits, so set them to the row's
+static uint64_t bank0_row(stconfig *config, uint64_t row) {
+   int bank_bits = __builtin_ctz(config->get_dram_banks());
+   int rank_bits = __builtin_ctz(config->get_dram_ranks());
+   uint64_t a = row << rank_bits;
+   a = (a << bank_bits) | (row & (config->get_dram_banks() - 1));
+   return a << config->get_dram_row_bits();
+}
+
+int main(int argc, char **argv) {
+   int naccesses = argc > 1 ? atoi(argv[1]) : 5000000;
+
+   stconfig config;
+   dram_t *d = new dram_t;
+   cycles_t cas = config.get_dram_cas();
+   cycles_t ras = config.get_dram_ras();
+   cycles_t pre = config.get_dram_precharge();
+   cycles_t t = 0;
+
+   // Latencies of an idle bank
+   setup(d, &config, true);
+   check(dram_access(d, &config, t += IDLE_GAP, bank0_row(&config, 1)) ==
+         ras + cas, "precharged bank latency");
+   check(dram_access(d, &config, t += IDLE_GAP, bank0_row(&config, 1) + 64) ==
+         cas, "row hit latency");
+   check(dram_access(d, &config, t += IDLE_GAP, bank0_row(&config, 2)) ==
+         pre + ras + cas, "row conflict latency");
+
+   // Sequential lines, one at a time
+   int lines_per_row = (1 << config.get_dram_row_bits()) / LINE_SIZE;
+   int nrows = 64;
+   setup(d, &config, true);
+   for(int i = 0; i < nrows * lines_per_row; i++)
+      dram_access(d, &config, t += IDLE_GAP, (uint64_t) i * LINE_SIZE);
+   check(d->stats.row_hits == (unsigned long long) nrows * (lines_per_row - 1),
+         "sequential stream missed an open row");
+   cout << "sequential, open page: " << d->stats.row_hits << " hits, "
+        << d->stats.row_empty << " empty, " << d->stats.row_conflicts
+        << " conflicts" << endl;
+
+   setup(d, &config, false);
+   for(int i = 0; i < nrows * lines_per_row; i++)
+      check(dram_access(d, &config, t += IDLE_GAP, (uint64_t) i * LINE_SIZE) ==
+            ras + cas, "closed page latency");
+   check(d->stats.row_hits == 0 && d->stats.row_conflicts == 0,
+         "closed page hit or conflicted");
+
+   // FR-FCFS: row 1 is being served, row 2 waits, and another row 1
+   // request arrives; it goes ahead of row 2
+   setup(d, &config, true);
+   t += IDLE_GAP;
+   cycles_t a = dram_access(d, &config, t, bank0_row(&config, 1));
+   cycles_t b = dram_access(d, &config, t + 1, bank0_row(&config, 2));
+   cycles_t c = dram_access(d, &config, t + 2, bank0_row(&config, 1) + 64);
+   check(a == ras + cas, "first of a burst");
+   check(b == a - 1 + pre + ras + cas, "conflict queued behind a row");
+   check(c == a - 2 + cas, "row hit not served ahead of a conflict");
+   check(d->stats.reordered == 1, "reorder count");
+   // and row 2's request was pushed back for it
+   cycles_t e = dram_access(d, &config, t + 3, bank0_row(&config, 2) + 64);
+   check(e == b - 2 + cas + cas, "row hit behind a pushed back request");
+
+   // A full queue
+   setup(d, &config, true);
+   t += IDLE_GAP * 100;
+   for(int i = 0; i < DRAM_QUEUE_DEPTH + 4; i++)
+      dram_access(d, &config, t, bank0_row(&config, i));
+   check(d->stats.queue_full == 4, "full bank queue count");
+
+   // Geometry checks
+   config.set_dram_banks(3);
+   check(!dram_configure(d, &config), "3 banks accepted");
+   config.set_dram_banks(DRAM_MAX_BANKS * 2);
+   check(!dram_configure(d, &config), "too many banks accepted");
+   config.set_dram_banks(8);
+   config.set_dram_ranks(2);
+
+   // Random lines over 1GB, arriving a little slower than 16 banks
+   // can serve conflicts
+   setup(d, &config, true);
+   srand(1);
+   uint64_t *addrs = new uint64_t[naccesses];
+   for(int i = 0; i < naccesses; i++)
+      addrs[i] = ((uint64_t) rand() << 6) & ((1ULL << 30) - 1);
+   unsigned long long total = 0;
+   double t0 = now();
+   for(int i = 0; i < naccesses; i++)
+      total += dram_access(d, &config, t += 30, addrs[i]);
+   double ns = (now() - t0) * 1e9 / naccesses;
+   cout << "random, 2 ranks x 8 banks: " << ns << " ns/access, mean latency "
+        << (double) total / naccesses << ", " << d->stats.row_hits << " hits, "
+        << d->stats.row_conflicts << " conflicts, " << d->stats.reordered
+        << " reordered, " << d->stats.queue_full << " queue full" << endl;
+   delete [] addrs;
+   delete d;
+
+   if(failures) {
+      cerr << "XXX: " << failures << " failed checks" << endl;
+      return 1;
+   }
+   return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
@@ -23,8 +23,6 @@
 #include "../common/osacommon.h"
 #include "staller.h"
 
-int booted =0;
-
 static void staller_stat_tick(conf_object_t *staller, void *arg)
 {
    attr_value_t ret;
@@ -89,18 +87,23 @@ static void staller_stat_tick(conf_object_t *staller, void *arg)
       }
       sample.stdev = sqrt(sumsq) / (double) pts->size();
       sample.tx_stdev = sqrt(sumsqtx) / (double) ptxts->size();
-      sample.penalty_evts = st->penaltycounter;
+      sample.penalty_evts = st->state.penaltycounter;
+      sample.dram_accesses = st->dram.stats.accesses - st->dram_epoch.accesses;
+      sample.dram_row_hits = st->dram.stats.row_hits - st->dram_epoch.row_hits;
+      sample.dram_row_conflicts = 
+         st->dram.stats.row_conflicts - st->dram_epoch.row_conflicts;
       
       // stash the data point,
       // clear the data for this epoch
       if(st->verbose)  {
-         if(booted)
+         if(st->state.booted)
             cout << "HEY kernel booted" << endl;
          cout << sample << endl;
       }   
       psamples->push_back(sample);
       st->stats->set_current(*&sample);
-      st->penaltycounter = 0;
+      st->state.penaltycounter = 0;
+      st->dram_epoch = st->dram.stats;
       pts->clear();
       ptxts->clear();
    }
@@ -136,123 +139,71 @@ st_new_instance(parse_object_t *pa)
    st->config->set_frontbus_bandwidth_limit_bpc(FB_BW_bc);  
    st->config->set_frontbus_busy_penalty_factor(FB_BUSY_PENALTY_FACTOR);
    st->config->set_frontbus_check_interval(STALL_CHECK_INTERVAL);
-   st->memops_counter = 0;
-   st->staller_previous_cycle = 0;
-   st->penaltycounter = 0;
-   st->memops_probe_counter = 0;
-   st->memops_tx_probe_counter = 0;
    st->frontbus_previous_probe_cycle = 0;
    st->frontbus_previous_tx_probe_cycle = 0;
    st->logcounter = 0;
    st->verbose = 0;
    st->config->set_frontbus_stat_size(BW_STAT_SIZE);
    st->config->set_frontbus_stat_interval(STALLER_STAT_INTERVAL);
+   st->config->set_dram(0);
+   st->config->set_dram_banks(DEF_DRAM_BANKS);
+   st->config->set_dram_ranks(DEF_DRAM_RANKS);
+   st->config->set_dram_row_bits(DEF_DRAM_ROW_BITS);
+   st->config->set_dram_open_page(1);
+   st->config->set_dram_cas(DEF_DRAM_CAS);
+   st->config->set_dram_ras(DEF_DRAM_RAS);
+   st->config->set_dram_precharge(DEF_DRAM_PRECHARGE);
+   dram_configure(&st->dram, st->config);
+   st_state_init(&st->state, st->config);
    
    return (conf_object_t *) st;
    
 }
 
-int st_initialized = 0;
-int current_penalty = 0;
-int max_penalty = 0;
+/*
+ * st_lookup_fast_caches
+ * the common module pushes fast_caches to us when it changes, but
+ * not while the configuration is loading; ask it once, on the first
+ * transaction. With no common module, behave as if caches are fast.
+ */
+static void
+st_lookup_fast_caches(simple_staller_t *st) {
+   conf_object_t *common = osa_get_object_by_name("common");
+   if(common) {
+      st->state.fast_caches = SIM_get_attribute(common, "fast_caches").u.integer;
+   } else {
+      st->state.fast_caches = 1;
+   }
+   if(SIM_get_pending_exception() != SimExc_No_Exception)
+      SIM_clear_exception();
+}
 
 cycles_t
 st_operate(conf_object_t *mem_hier, conf_object_t *space, 
            map_list_t *map, generic_transaction_t *mem_op) {
 
    simple_staller_t *st = (simple_staller_t *) mem_hier;
-   conf_object_t *cpu;   
-   cycles_t staller_current_cycle;
-   int factor = 1;
-   bool fast_caches;
-   conf_object_t *common;
-  
-   common = osa_get_object_by_name("common");
-   if (common) 
-   	fast_caches = SIM_get_attribute(common, "fast_caches").u.boolean; 
-   else 
-	fast_caches = 1;
-
-   if ( !fast_caches )
-      booted = 1; 
 
-   cpu = SIM_current_processor();
-   staller_current_cycle = SIM_cycle_count(cpu);
+   if (st->state.fast_caches < 0)
+      st_lookup_fast_caches(st);
 
-   if (!st_initialized) {
+   if (!st->stat_tick_posted) {
       SIM_time_post_cycle((conf_object_t *)st, 
                        st->config->get_frontbus_stat_interval(), 
                        Sim_Sync_Processor, 
                        staller_stat_tick, 
                        NULL); 
-      st_initialized = 1;
-   }
-   if (mem_op->may_stall) {
-      st->memops_probe_counter += mem_op->size;
-      if ((long)(mem_op->user_ptr) & 0x7fffffff) {
-         st->memops_tx_probe_counter += mem_op->size;
-      }
+      st->stat_tick_posted = 1;
    }
 
-   if (!current_penalty)
-      current_penalty = st->config->get_frontbus_busy_penalty_factor();
-   
-   if (st->config->get_frontbus_bandwidth_limit_bpc() && !fast_caches) {
-      st->memops_counter += mem_op->size;
-      if ((staller_current_cycle - st->staller_previous_cycle) > 
-         st->config->get_frontbus_check_interval()) {
-    
-            if ((staller_current_cycle - st->staller_previous_cycle)* 
-            st->config->get_frontbus_bandwidth_limit_bpc() <= st->memops_counter*8) {
-               factor = current_penalty;
-               st->penaltycounter++;
-               current_penalty++;
-               if (current_penalty > max_penalty) {
-                  max_penalty = current_penalty;
-                  printf("MAX penalty is %d\n", max_penalty);
-               }         
-            } else {
-               st->staller_previous_cycle = staller_current_cycle; 
-               st->memops_counter = 0;
-               current_penalty = st->config->get_frontbus_busy_penalty_factor();
-            }
-      }
-   }
    mem_op->reissue = 0;
    mem_op->block_STC = 1;
-   if (mem_op->may_stall){
-      int stall =  st->config->get_stall_time();
-      if(st->past_bios &&
-         st->config->get_stress_test() &&
-         st->config->get_stress_range() > 0) {
-         // if we are in stress mode, additionally randomly perturb
-         // the stall amount by a potentially wide margin either
-         // direction. What we really want here is high variability,
-         // but we also want an occasional very very long wait.
-         int r = st->config->get_stress_range();
-         int s = random() % (r+1);
-         if(r > st->config->get_stall_time()) {
-            stall = s; // allows us to return 0 values sometimes
-         } else {
-            s *= ((random()%2)&0x1)?-1:1;
-            stall += s;
-         }
-         // pr( "stressed timing: %d\n", stall);
-      }
-      // Randomly perturb the cache timing if we have a non-zero range
-      // (regardless of whether we are in stress test mode or not
-      if(st->past_bios &&
-         st->config->get_perturb_range() > 0){
-         // Add 1 to the range before moding to make it inclusive
-         // i.e. 4 cycles should be [0,4], not [0,4) 
-         stall += random() % (st->config->get_perturb_range() + 1);
-         // pr( "Poenas Dare: %d\n", stall);
-      }
-      return (factor * stall);
-      // return (10000);
-   } else {
-      return 0;
-   }
+   return st_stall(&st->state, st->config,
+                   st->config->get_dram() ? &st->dram : NULL,
+                   SIM_cycle_count(SIM_current_processor()),
+                   mem_op->physical_address, mem_op->size, mem_op->may_stall,
+                   ((long)(mem_op->user_ptr) & 0x7fffffff) != 0,
+                   st->past_bios);
 }
 
 STALLER_CONFIG_ATTR(frontbus_bandwidth_limit_bpc)
@@ -262,9 +213,16 @@ STALLER_CONFIG_ATTR(frontbus_stat_interval)
 STALLER_CONFIG_ATTR(frontbus_stat_size)
 STALLER_CONFIG_ATTR(stall_time)
 STALLER_CONFIG_ATTR(cache_perturb)
-STALLER_CONFIG_ATTR(seed)
 STALLER_CONFIG_ATTR(stress_test)
 STALLER_CONFIG_ATTR(stress_range)
+STALLER_CONFIG_ATTR(dram)
+STALLER_DRAM_ATTR(dram_banks)
+STALLER_DRAM_ATTR(dram_ranks)
+STALLER_DRAM_ATTR(dram_row_bits)
+STALLER_DRAM_ATTR(dram_open_page)
+STALLER_CONFIG_ATTR(dram_cas)
+STALLER_CONFIG_ATTR(dram_ras)
+STALLER_CONFIG_ATTR(dram_precharge)
 STALLER_ATTR(past_bios)
 STALLER_ATTR(verbose)
 STALLER_STATS_ATTR(min)
@@ -276,6 +234,61 @@ STALLER_STATS_ATTR(tx_max)
 STALLER_STATS_ATTR(tx_avg)
 STALLER_STATS_ATTR(tx_stdev)
 STALLER_STATS_INT_ATTR(penalty_evts)
+STALLER_STATS_INT_ATTR(dram_accesses)
+STALLER_STATS_INT_ATTR(dram_row_hits)
+STALLER_STATS_INT_ATTR(dram_row_conflicts)
+
+static set_error_t
+set_st_seed(void *dont_care, conf_object_t *obj,
+            attr_value_t *val, attr_value_t *idx) {
+   if(val->kind != Sim_Val_Integer){
+      return Sim_Set_Need_Integer;
+   }
+   st_t *st = (st_t *) obj;
+   st->config->set_seed(val->u.integer);
+   st_seed(&st->state, st->config->get_seed());
+   return Sim_Set_Ok;
+}
+
+static attr_value_t
+get_st_seed(void *arg, conf_object_t *obj, attr_value_t *idx) {
+   st_t *st = (st_t *) obj;
+   return SIM_make_attr_integer(st->config->get_seed());
+}
+
+static set_error_t
+set_st_fast_caches(void *dont_care, conf_object_t *obj,
+                   attr_value_t *val, attr_value_t *idx) {
+   if(val->kind != Sim_Val_Integer){
+      return Sim_Set_Need_Integer;
+   }
+   st_t *st = (st_t *) obj;
+   st->state.fast_caches = val->u.integer;
+   return Sim_Set_Ok;
+}
+
+static attr_value_t
+get_st_fast_caches(void *arg, conf_object_t *obj, attr_value_t *idx) {
+   st_t *st = (st_t *) obj;
+   return SIM_make_attr_integer(st->state.fast_caches);
+}
+
+static set_error_t
+set_st_max_penalty(void *dont_care, conf_object_t *obj,
+                   attr_value_t *val, attr_value_t *idx) {
+   if(val->kind != Sim_Val_Integer){
+      return Sim_Set_Need_Integer;
+   }
+   st_t *st = (st_t *) obj;
+   st->state.max_penalty = val->u.integer;
+   return Sim_Set_Ok;
+}
+
+static attr_value_t
+get_st_max_penalty(void *arg, conf_object_t *obj, attr_value_t *idx) {
+   st_t *st = (st_t *) obj;
+   return SIM_make_attr_integer(st->state.max_penalty);
+}
 
 static set_error_t
 set_st_stats(void *dont_care, 
@@ -315,6 +328,9 @@ get_st_stats(void *dont_care,
       overall.tx_avg += psd->tx_avg;
       overall.tx_stdev += psd->tx_stdev;
       overall.penalty_evts += psd->penalty_evts;
+      overall.dram_accesses += psd->dram_accesses;
+      overall.dram_row_hits += psd->dram_row_hits;
+      overall.dram_row_conflicts += psd->dram_row_conflicts;
    }
    if(psamples->size()) {
       overall.avg /= psamples->size();
@@ -326,7 +342,7 @@ get_st_stats(void *dont_care,
    // line lists attribute names
    stringstream ss;
    ss << "staller stats:";
-   ss << "       , min, max, avg, stdev, tx_min, tx_max, tx_avg, tx_stdev, penevts" << endl;
+   ss << "       , min, max, avg, stdev, tx_min, tx_max, tx_avg, tx_stdev, penevts, dram, row_hits, row_conflicts" << endl;
    ss << "current, "
       << st->stats->get_min() << ", "
       << st->stats->get_max() << ", "
@@ -336,7 +352,10 @@ get_st_stats(void *dont_care,
       << st->stats->get_tx_max() << ", "
       << st->stats->get_tx_avg() << ", "
       << st->stats->get_tx_stdev() << ", "
-      << st->stats->get_penalty_evts()
+      << st->stats->get_penalty_evts() << ", "
+      << st->stats->get_dram_accesses() << ", "
+      << st->stats->get_dram_row_hits() << ", "
+      << st->stats->get_dram_row_conflicts()
       << endl;
    ss << "overall, "
       << overall.get_min() << ", "
@@ -347,7 +366,10 @@ get_st_stats(void *dont_care,
       << overall.get_tx_max() << ", "
       << overall.get_tx_avg() << ", "
       << overall.get_tx_stdev() << ", "
-      << overall.get_penalty_evts() 
+      << overall.get_penalty_evts() << ", "
+      << overall.get_dram_accesses() << ", "
+      << overall.get_dram_row_hits() << ", "
+      << overall.get_dram_row_conflicts()
       << endl;
 
    attr_value_t ret = SIM_make_attr_string(ss.str().c_str()); 
@@ -369,7 +391,7 @@ get_epoch_time_series(void * v,
 
       int j=0;
       stdatapoint* pdp = &(*ptsi);
-      attr_value_t epochlist = SIM_alloc_attr_list(9);
+      attr_value_t epochlist = SIM_alloc_attr_list(12);
       epochlist.u.list.vector[j++] = SIM_make_attr_floating(pdp->get_min());
       epochlist.u.list.vector[j++] = SIM_make_attr_floating(pdp->get_max());
       epochlist.u.list.vector[j++] = SIM_make_attr_floating(pdp->get_avg());
@@ -379,6 +401,9 @@ get_epoch_time_series(void * v,
       epochlist.u.list.vector[j++] = SIM_make_attr_floating(pdp->get_tx_avg());
       epochlist.u.list.vector[j++] = SIM_make_attr_floating(pdp->get_tx_stdev());
       epochlist.u.list.vector[j++] = SIM_make_attr_floating((double)pdp->get_penalty_evts());
+      epochlist.u.list.vector[j++] = SIM_make_attr_floating((double)pdp->get_dram_accesses());
+      epochlist.u.list.vector[j++] = SIM_make_attr_floating((double)pdp->get_dram_row_hits());
+      epochlist.u.list.vector[j++] = SIM_make_attr_floating((double)pdp->get_dram_row_conflicts());
 
       avlist.u.list.vector[i] = epochlist;
    }
@@ -445,6 +470,35 @@ set_tx_bw_time_series(void *dont_care,
    return Sim_Set_Ok;
 }
 
+static attr_value_t
+get_dram_statistics(void * v,
+                    conf_object_t * o,
+                    attr_value_t * idx) {
+   simple_staller_t * st = (simple_staller_t*) o;
+   dram_stats_t *ds = &st->dram.stats;
+   int j = 0;
+   attr_value_t avlist = SIM_alloc_attr_list(7);
+   avlist.u.list.vector[j++] = SIM_make_attr_integer(ds->accesses);
+   avlist.u.list.vector[j++] = SIM_make_attr_integer(ds->row_hits);
+   avlist.u.list.vector[j++] = SIM_make_attr_integer(ds->row_empty);
+   avlist.u.list.vector[j++] = SIM_make_attr_integer(ds->row_conflicts);
+   avlist.u.list.vector[j++] = SIM_make_attr_integer(ds->reordered);
+   avlist.u.list.vector[j++] = SIM_make_attr_integer(ds->queue_full);
+   avlist.u.list.vector[j++] = SIM_make_attr_integer(ds->latency);
+   return avlist;
+}
+
+static set_error_t
+set_dram_statistics(void *dont_care, 
+                    conf_object_t *obj,
+                    attr_value_t *val, 
+                    attr_value_t *idx) {
+   simple_staller_t *st = (simple_staller_t *) obj;
+   memset(&st->dram.stats, 0, sizeof(st->dram.stats));
+   memset(&st->dram_epoch, 0, sizeof(st->dram_epoch));
+   return Sim_Set_Ok;
+}
+
 static set_error_t
 set_frontbus_bandwidth_probe(void *dont_care, 
                              conf_object_t *obj,
@@ -472,10 +526,10 @@ get_frontbus_bandwidth_probe(void *dont_care,
       st->frontbus_bandwidth_probe = -1;
    } else {
       cycles_t delta = (frontbus_current_probe_cycle - st->frontbus_previous_probe_cycle);
-      double fbp = (double) st->memops_probe_counter / delta;
+      double fbp = (double) st->state.memops_probe_counter / delta;
       st->frontbus_bandwidth_probe = fbp;
       st->frontbus_previous_probe_cycle = frontbus_current_probe_cycle;
-      st->memops_probe_counter = 0;   
+      st->state.memops_probe_counter = 0;   
    }
 
    ret.kind = Sim_Val_Floating;
@@ -510,10 +564,10 @@ get_frontbus_bandwidth_tx_probe(void *dont_care,
       st->frontbus_bandwidth_tx_probe = -1;
    else {
       cycles_t delta = (frontbus_current_probe_cycle - st->frontbus_previous_tx_probe_cycle);
-      double fbp = (double) st->memops_tx_probe_counter/delta;
+      double fbp = (double) st->state.memops_tx_probe_counter/delta;
       st->frontbus_bandwidth_tx_probe = fbp;
       st->frontbus_previous_tx_probe_cycle = frontbus_current_probe_cycle;
-      st->memops_tx_probe_counter = 0;
+      st->state.memops_tx_probe_counter = 0;
    }   
 
    ret.kind = Sim_Val_Floating;
@@ -534,8 +588,18 @@ st_register(conf_class_t *st_class) {
    STALLER_REGISTER_ATTR(seed, "Seed for pseudo-random number generator.");
    STALLER_REGISTER_ATTR(stress_test, "stress test mode--perturbs timings by wild intervals");
    STALLER_REGISTER_ATTR(stress_range, "specifies the range over which stress test timings are taken");
+   STALLER_REGISTER_ATTR(dram, "Use the banked DRAM model for stall times instead of stall_time");
+   STALLER_REGISTER_ATTR(dram_banks, "DRAM banks per rank (power of 2)");
+   STALLER_REGISTER_ATTR(dram_ranks, "DRAM ranks (power of 2)");
+   STALLER_REGISTER_ATTR(dram_row_bits, "log2 of the DRAM row buffer size in bytes");
+   STALLER_REGISTER_ATTR(dram_open_page, "1 to leave DRAM rows open after an access, 0 to precharge");
+   STALLER_REGISTER_ATTR(dram_cas, "DRAM column access latency in cycles");
+   STALLER_REGISTER_ATTR(dram_ras, "DRAM row activate latency in cycles");
+   STALLER_REGISTER_ATTR(dram_precharge, "DRAM precharge latency in cycles");
    STALLER_REGISTER_ATTR(past_bios,"Signals that we are through the bios and can begin perturbing the timings.");
    STALLER_REGISTER_ATTR(verbose, "controls how much junk we spit to cout");
+   STALLER_REGISTER_ATTR(fast_caches, "common's fast_caches, pushed by common; -1 to look it up again");
+   STALLER_REGISTER_ATTR(max_penalty, "largest front bus penalty factor reached");
    STALLER_REGISTER_STAT_ATTR(min, "current epoch min bandwidth consumption");
    STALLER_REGISTER_STAT_ATTR(max, "current max bandwidth consumption");
    STALLER_REGISTER_STAT_ATTR(avg, "current average bw consumption");
@@ -545,6 +609,9 @@ st_register(conf_class_t *st_class) {
    STALLER_REGISTER_STAT_ATTR(tx_avg, "current average bw consumption (transactional memops)");
    STALLER_REGISTER_STAT_ATTR(tx_stdev, "current stdev bw consumption(transactional memops)");
    STALLER_REGISTER_ISTAT_ATTR(penalty_evts, "number of times staller increased penalty to throttle bw");
+   STALLER_REGISTER_ISTAT_ATTR(dram_accesses, "current epoch DRAM accesses");
+   STALLER_REGISTER_ISTAT_ATTR(dram_row_hits, "current epoch DRAM row buffer hits");
+   STALLER_REGISTER_ISTAT_ATTR(dram_row_conflicts, "current epoch DRAM row buffer conflicts");
 
    SIM_register_typed_attribute(st_class, "bw_time_series",
                                 get_bw_time_series, 0,
@@ -567,6 +634,15 @@ st_register(conf_class_t *st_class) {
                                 "[[f*]*]", NULL,
                                 "time series of epoch sample values");
 
+   SIM_register_typed_attribute(st_class, "dram_statistics",
+                                get_dram_statistics, 0,
+                                set_dram_statistics, 0,
+                                Sim_Attr_Pseudo,
+                                "[i*]", NULL,
+                                "DRAM accesses, row hits, accesses to a precharged bank, "
+                                "row conflicts, hits served out of order, arrivals to a "
+                                "full bank queue and total latency; setter resets");
+
    SIM_register_typed_attribute(st_class, "statistics",
                                 get_st_stats, 0,
                                 set_st_stats, 0,
@@ -20,6 +20,7 @@
 #include "ststats.h"
 #include "stconfig.h"
 #include "stdatapoint.h"
+#include "stmodel.h"
 
 #define STALLER_REGISTER_ATTR(attr, desc)                 \
    SIM_register_typed_attribute(st_class, ""#attr,	       \
@@ -149,6 +150,35 @@
       return avReturn;                                                  \
    }
 
+// dram geometry: the model is rebuilt, and a geometry it can't
+// use is refused
+#define STALLER_DRAM_ATTR(attr)                                         \
+   static set_error_t                                                   \
+   set_st_##attr(void *dont_care, conf_object_t *obj,                   \
+                 attr_value_t *val, attr_value_t *idx) {                \
+      if(val->kind != Sim_Val_Integer){                                 \
+         return Sim_Set_Need_Integer;                                   \
+      }                                                                 \
+      st_t *st = (st_t *) obj;                                          \
+      int old = st->config->get_##attr();                               \
+      st->config->set_##attr(val->u.integer);                           \
+      if(!dram_configure(&st->dram, st->config)) {                      \
+         st->config->set_##attr(old);                                   \
+         return Sim_Set_Illegal_Value;                                  \
+      }                                                                 \
+      return Sim_Set_Ok;                                                \
+   }                                                                    \
+   attr_value_t                                                         \
+   get_st_##attr(void *arg, conf_object_t *obj,                         \
+                 attr_value_t *pAttrIdx);                               \
+   attr_value_t                                                         \
+   get_st_##attr(void *arg, conf_object_t *obj,                         \
+                 attr_value_t *pAttrIdx){                               \
+      st_t *st = (st_t *) obj;                                          \
+      attr_value_t avReturn = SIM_make_attr_integer(st->config->get_##attr()); \
+      return avReturn;                                                  \
+   }
+
 extern "C" {
   void st_assert_fail(const char *assertion, const char *file, unsigned int line);
   static attr_value_t                                             
@@ -168,11 +198,14 @@ extern "C" {
 typedef struct simple_staller {
    log_object_t log;
    int past_bios;
-   int memops_counter;
-   cycles_t staller_previous_cycle;
-   int penaltycounter;
-   int memops_probe_counter;
-   int memops_tx_probe_counter;
+   /* everything st_operate touches */
+   st_state_t state;
+   /* the bandwidth sampling event has been posted */
+   int stat_tick_posted;
+   /* memory behind the staller, if config->get_dram() */
+   dram_t dram;
+   /* dram.stats at the start of the epoch */
+   dram_stats_t dram_epoch;
    cycles_t frontbus_previous_probe_cycle;
    cycles_t frontbus_previous_tx_probe_cycle;
    double frontbus_bandwidth_probe; 
@@ -0,0 +1,183 @@
+// MetaTM Project
+// File Name: stbench.cc
+//
+// Description: Transaction-rate microbenchmark for the staller
+// model, without Simics.  Feeds st_stall cache-line transactions
+// from several cpus, each issuing its next one a random gap after
+// the last one's stall, at an offered bus load under, at and over
+// frontbus_bandwidth_limit_bpc, with perturbation and stress timing
+// on.  Reports the time per transaction, the penalties and the bus
+// bandwidth achieved.  It also checks that a seed replays the same
+// stalls, that another seed does not, that only the overloaded
+// stream is throttled, and that throttling holds it near the limit.
+//
+//    make -f Makefile.bench
+//    ./stbench [transactions]
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2008. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "stmodel.h"
+
+using namespace std;
+
+#define BENCH_CPUS   4
+#define LINE_SIZE    64
+
+typedef struct _bench_op_t {
+   cycles_t gap;
+   bool may_stall;
+   bool tx;
+} bench_op_t;
+
+// Without stalls, the cpus together offer a line every
+// cycles_per_line cycles on average
+static void make_ops(vector<bench_op_t> &out, int n, int cycles_per_line) {
+   srand(1);
+   out.clear();
+   for(int i = 0; i < n; i++) {
+      bench_op_t op;
+      op.gap = 1 + rand() % (2 * cycles_per_line * BENCH_CPUS);
+      op.may_stall = (rand() % 8) != 0;
+      op.tx = (rand() % 4) == 0;
+      out.push_back(op);
+   }
+}
+
+static double now() {
+   struct timeval tv;
+   gettimeofday(&tv, NULL);
+   return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+typedef struct _bench_result_t {
+   double ns;
+   unsigned long long stall;
+   int penalties;
+   int max_penalty;
+   // bits per cycle the bus actually carried
+   double bpc;
+} bench_result_t;
+
+static bench_result_t run(const vector<bench_op_t> &ops, stconfig *config,
+                          unsigned int seed) {
+   st_state_t s;
+   config->set_seed(seed);
+   st_state_init(&s, config);
+   s.fast_caches = 0;
+
+   // Each op goes to the cpu that is furthest behind, roughly as
+   // Simics interleaves cpus
+   cycles_t clock[BENCH_CPUS] = { 0 };
+
+   bench_result_t r;
+   r.stall = 0;
+   r.penalties = 0;
+   double t = now();
+   for(unsigned int n = 0; n < ops.size(); n++) {
+      int cpu = 0;
+      for(int c = 1; c < BENCH_CPUS; c++)
+         if(clock[c] < clock[cpu])
+            cpu = c;
+      const bench_op_t &op = ops[n];
+      clock[cpu] += op.gap;
+      cycles_t stall = st_stall(&s, config, NULL, clock[cpu], 0, LINE_SIZE,
+                                op.may_stall, op.tx, true);
+      clock[cpu] += stall;
+      r.stall += stall;
+      // the stat tick's epoch reset
+      if((n & 0xffff) == 0) {
+         r.penalties += s.penaltycounter;
+         s.penaltycounter = 0;
+      }
+   }
+   r.ns = (now() - t) * 1e9 / ops.size();
+   r.penalties += s.penaltycounter;
+   r.max_penalty = s.max_penalty;
+   cycles_t end = 0;
+   for(int c = 0; c < BENCH_CPUS; c++)
+      end = clock[c] > end ? clock[c] : end;
+   r.bpc = end ? (double) ops.size() * LINE_SIZE * 8 / end : 0;
+   return r;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+   if(!ok) {
+      cerr << "XXX: " << what << endl;
+      failures++;
+   }
+}
+
+int main(int argc, char **argv) {
+   int nops = argc > 1 ? atoi(argv[1]) : 5000000;
+
+   // A short stall, so that the gaps set the offered load
+   stconfig config;
+   config.set_stall_time(10);
+   config.set_perturb_range(4);
+   config.set_stress_test(1);
+   config.set_stress_range(8);
+
+   // A line is LINE_SIZE * 8 bits, so the bus carries one every
+   // LINE_SIZE * 8 / FB_BW_bc cycles
+   int line_cycles = LINE_SIZE * 8 / config.get_frontbus_bandwidth_limit_bpc();
+   struct {
+      const char *name;
+      int cycles_per_line;
+   } loads[] = {
+      { "half", 2 * line_cycles },
+      { "full", line_cycles },
+      { "double", line_cycles / 2 },
+   };
+
+   cout << nops << " transactions from " << BENCH_CPUS << " cpus, limit "
+        << config.get_frontbus_bandwidth_limit_bpc() << " bits/cycle" << endl;
+   vector<bench_op_t> ops;
+   for(unsigned int l = 0; l < sizeof(loads) / sizeof(loads[0]); l++) {
+      make_ops(ops, nops, loads[l].cycles_per_line);
+      bench_result_t a = run(ops, &config, 7);
+      bench_result_t b = run(ops, &config, 7);
+      bench_result_t c = run(ops, &config, 8);
+      check(a.stall == b.stall && a.penalties == b.penalties,
+            "same seed gave different stalls");
+      check(a.stall != c.stall, "different seeds gave the same stalls");
+      if(loads[l].cycles_per_line > line_cycles)
+         check(a.penalties == 0, "bus under its limit was throttled");
+      if(loads[l].cycles_per_line < line_cycles) {
+         check(a.penalties > 0, "bus over its limit was not throttled");
+         check(a.bpc < 1.25 * config.get_frontbus_bandwidth_limit_bpc(),
+               "throttled bus well over its limit");
+      }
+      cout << "   " << loads[l].name << " load: " << (a.ns < b.ns ? a.ns : b.ns)
+           << " ns/transaction, " << a.penalties << " penalized, max penalty "
+           << a.max_penalty << ", mean stall "
+           << (double) a.stall / ops.size() << ", " << a.bpc
+           << " bits/cycle" << endl;
+   }
+
+   if(failures) {
+      cerr << "XXX: " << failures << " failed checks" << endl;
+      return 1;
+   }
+   return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
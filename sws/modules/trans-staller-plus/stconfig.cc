@@ -26,6 +26,14 @@ void stconfig::defaults() {
   frontbus_stat_size = BW_STAT_SIZE;
   frontbus_stat_interval = STALLER_STAT_INTERVAL;
   bw_ts_index = 0;
+  dram = 0;
+  dram_banks = DEF_DRAM_BANKS;
+  dram_ranks = DEF_DRAM_RANKS;
+  dram_row_bits = DEF_DRAM_ROW_BITS;
+  dram_open_page = 1;
+  dram_cas = DEF_DRAM_CAS;
+  dram_ras = DEF_DRAM_RAS;
+  dram_precharge = DEF_DRAM_PRECHARGE;
 };
 
 /*
@@ -27,6 +27,12 @@ static const int DEF_STALL_TIME = 200;
 static const int DEF_SEED = 0;
 static const int DEF_STRESS_TEST = 0;
 static const int DEF_STRESS_RANGE = 0;
+static const int DEF_DRAM_BANKS = 4;
+static const int DEF_DRAM_RANKS = 1;
+static const int DEF_DRAM_ROW_BITS = 11;    // 2KB row buffer
+static const int DEF_DRAM_CAS = 100;
+static const int DEF_DRAM_RAS = 100;
+static const int DEF_DRAM_PRECHARGE = 150;
 
 class stconfig {
  public:
@@ -44,6 +50,14 @@ class stconfig {
   member(int, frontbus_check_interval);
   member(unsigned int, frontbus_stat_size); 
   member(unsigned int, frontbus_stat_interval);
+  member(int, dram);
+  member(int, dram_banks);
+  member(int, dram_ranks);
+  member(int, dram_row_bits);
+  member(int, dram_open_page);
+  member(int, dram_cas);
+  member(int, dram_ras);
+  member(int, dram_precharge);
 };
 #endif
 /*
@@ -19,13 +19,16 @@ void stdatapoint::reset() {
   tx_avg = avg = 0;
   tx_stdev = stdev = 0;
   penalty_evts = 0;
+  dram_accesses = dram_row_hits = dram_row_conflicts = 0;
 }
 ostream& operator<<(ostream& os, const stdatapoint& dp) {   
    os << "min: (" << dp.min << "," << dp.tx_min << ") ";
    os << "max: (" << dp.max << "," << dp.tx_max << ") ";
    os << "avg: (" << dp.avg << "," << dp.tx_avg << ") ";
    os << "std: (" << dp.stdev << "," << dp.tx_stdev << ") ";
-   os << "penevts: " << dp.penalty_evts;
+   os << "penevts: " << dp.penalty_evts << " ";
+   os << "dram: (" << dp.dram_accesses << "," << dp.dram_row_hits
+      << "," << dp.dram_row_conflicts << ")";
    return os; 
 }
 
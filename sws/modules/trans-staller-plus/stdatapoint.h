@@ -27,6 +27,9 @@ class stdatapoint {
   pmember(double, tx_avg);
   pmember(double, tx_stdev);
   pmember(unsigned long long, penalty_evts);
+  pmember(unsigned long long, dram_accesses);
+  pmember(unsigned long long, dram_row_hits);
+  pmember(unsigned long long, dram_row_conflicts);
  public:
   friend ostream& operator<<(ostream& os, const stdatapoint& dp);
 };
@@ -0,0 +1,128 @@
+// MetaTM Project
+// File Name: stmodel.cc
+//
+// Description: per-transaction staller model
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2008. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#include <string.h>
+#include "stmodel.h"
+
+void st_state_init(st_state_t *s, stconfig *config) {
+   memset(s, 0, sizeof(*s));
+   s->tokens = (long long) config->get_frontbus_bandwidth_limit_bpc() *
+      config->get_frontbus_check_interval();
+   s->current_penalty = config->get_frontbus_busy_penalty_factor();
+   s->fast_caches = -1;
+   st_seed(s, config->get_seed());
+}
+
+// splitmix64 the seed so that small seeds (and 0, which xorshift
+// can't use) give unrelated streams
+void st_seed(st_state_t *s, unsigned int seed) {
+   uint64_t z = (uint64_t) seed + 0x9E3779B97F4A7C15ULL;
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   z ^= z >> 31;
+   s->rng = z ? z : 1;
+}
+
+// Returns the penalty factor for a transaction of bits at now
+static inline int st_bucket_take(st_state_t *s, stconfig *config,
+                                 cycles_t now, long long bits) {
+   long long limit = config->get_frontbus_bandwidth_limit_bpc();
+   long long cap = limit * config->get_frontbus_check_interval();
+
+   if(now > s->last_refill) {
+      cycles_t elapsed = now - s->last_refill;
+      if(elapsed > (cap - s->tokens) / limit)
+         s->tokens = cap;
+      else
+         s->tokens += elapsed * limit;
+      s->last_refill = now;
+   }
+   if(s->tokens > cap)
+      s->tokens = cap;
+
+   s->tokens -= bits;
+   if(s->tokens >= 0) {
+      s->current_penalty = config->get_frontbus_busy_penalty_factor();
+      return 1;
+   }
+   // the deficit is worked off within one more check interval
+   if(s->tokens < -cap)
+      s->tokens = -cap;
+   if(!s->current_penalty)
+      s->current_penalty = config->get_frontbus_busy_penalty_factor();
+   int factor = s->current_penalty++;
+   s->penaltycounter++;
+   if(s->current_penalty > s->max_penalty)
+      s->max_penalty = s->current_penalty;
+   return factor;
+}
+
+cycles_t st_stall(st_state_t *s, stconfig *config, dram_t *dram,
+                  cycles_t now, uint64_t paddr, unsigned int size,
+                  bool may_stall, bool tx, bool past_bios) {
+   int factor = 1;
+   cycles_t latency = 0;
+
+   if(!s->fast_caches)
+      s->booted = 1;
+
+   if(may_stall) {
+      s->memops_probe_counter += size;
+      if(tx)
+         s->memops_tx_probe_counter += size;
+   }
+
+   if(config->get_frontbus_bandwidth_limit_bpc() > 0 && !s->fast_caches)
+      factor = st_bucket_take(s, config, now, (long long) size * 8);
+
+   // every transaction that gets here occupies its bank
+   if(dram)
+      latency = dram_access(dram, config, now, paddr);
+
+   if(!may_stall)
+      return 0;
+
+   int stall = dram ? (int) latency : config->get_stall_time();
+   if(past_bios &&
+      config->get_stress_test() &&
+      config->get_stress_range() > 0) {
+      // if we are in stress mode, additionally randomly perturb
+      // the stall amount by a potentially wide margin either
+      // direction. What we really want here is high variability,
+      // but we also want an occasional very very long wait.
+      int r = config->get_stress_range();
+      int v = st_random(s) % (r+1);
+      if(r > stall) {
+         stall = v; // allows us to return 0 values sometimes
+      } else {
+         v *= (st_random(s) & 0x1) ? -1 : 1;
+         stall += v;
+      }
+   }
+   // Randomly perturb the cache timing if we have a non-zero range
+   // (regardless of whether we are in stress test mode or not
+   if(past_bios && config->get_perturb_range() > 0) {
+      // Add 1 to the range before moding to make it inclusive
+      // i.e. 4 cycles should be [0,4], not [0,4)
+      stall += st_random(s) % (config->get_perturb_range() + 1);
+   }
+   return (factor * stall);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
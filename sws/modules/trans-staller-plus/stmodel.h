@@ -0,0 +1,75 @@
+// MetaTM Project
+// File Name: stmodel.h
+//
+// Description: the part of the staller that runs on every memory
+// transaction, kept free of Simics so that it can be driven by
+// stbench.  Each staller instance has its own st_state_t: the
+// front-bus token bucket and penalty, the bandwidth probe counters,
+// and the random number generator for stress and perturbation
+// timings, seeded from the seed attribute so runs are repeatable.
+//
+// The bucket holds up to frontbus_bandwidth_limit_bpc *
+// frontbus_check_interval bits and refills at
+// frontbus_bandwidth_limit_bpc bits per cycle.  A transaction that
+// finds it in deficit is stalled frontbus_busy_penalty_factor times
+// over, and the factor grows by one for each further transaction
+// until the bucket recovers.
+//
+// Operating Systems & Architecture Group
+// University of Texas at Austin - Department of Computer Sciences
+// Copyright 2008. All Rights Reserved.
+// See LICENSE file for license terms.
+
+#ifndef _TX_STALLER_MODEL_H_
+#define _TX_STALLER_MODEL_H_
+
+#include <stdint.h>
+#include "stconfig.h"
+#include "dram.h"
+
+typedef struct _st_state_t {
+   /* front-bus token bucket, in bits; negative is a deficit */
+   long long tokens;
+   cycles_t last_refill;
+   int current_penalty;
+   int max_penalty;
+   /* penalized transactions this epoch */
+   int penaltycounter;
+   /* bytes since the last bandwidth probe */
+   int memops_probe_counter;
+   int memops_tx_probe_counter;
+   /* common's fast_caches, pushed to us; -1 until we know it */
+   int fast_caches;
+   /* fast_caches has been seen off */
+   int booted;
+   uint64_t rng;
+} st_state_t;
+
+void st_state_init(st_state_t *s, stconfig *config);
+void st_seed(st_state_t *s, unsigned int seed);
+
+// Stall for one transaction of size bytes to paddr at cycle now.
+// With a dram model its latency replaces the fixed stall_time.
+cycles_t st_stall(st_state_t *s, stconfig *config, dram_t *dram,
+                  cycles_t now, uint64_t paddr, unsigned int size,
+                  bool may_stall, bool tx, bool past_bios);
+
+// xorshift64*: not random() so that each staller has its own stream
+static inline uint32_t st_random(st_state_t *s) {
+   s->rng ^= s->rng >> 12;
+   s->rng ^= s->rng << 25;
+   s->rng ^= s->rng >> 27;
+   return (uint32_t)((s->rng * 2685821657736338717ULL) >> 32);
+}
+
+#endif
+/*
+ * Local variables:
+ *  c-indent-level: 3
+ *  c-basic-offset: 3
+ *  indent-tabs-mode: nil
+ *  tab-width: 3
+ * End:
+ *
+ * vim: ts=3 sw=3 expandtab
+ */
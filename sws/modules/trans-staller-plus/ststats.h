@@ -37,6 +37,9 @@ class ststats {
   double get_tx_avg() { return current.get_tx_avg(); }
   double get_tx_stdev() { return current.get_tx_stdev(); }
   unsigned long long get_penalty_evts() { return current.get_penalty_evts(); }
+  unsigned long long get_dram_accesses() { return current.get_dram_accesses(); }
+  unsigned long long get_dram_row_hits() { return current.get_dram_row_hits(); }
+  unsigned long long get_dram_row_conflicts() { return current.get_dram_row_conflicts(); }
   void set_min(double d) { return current.set_min(d); }
   void set_max(double d) { return current.set_max(d); }
   void set_avg(double d) { return current.set_avg(d); }
@@ -46,6 +49,9 @@ class ststats {
   void set_tx_avg(double d) { return current.set_tx_avg(d); }
   void set_tx_stdev(double d) { return current.set_tx_stdev(d); }
   void set_penalty_evts(unsigned long long l) { return current.set_penalty_evts(l); }
+  void set_dram_accesses(unsigned long long l) { return current.set_dram_accesses(l); }
+  void set_dram_row_hits(unsigned long long l) { return current.set_dram_row_hits(l); }
+  void set_dram_row_conflicts(unsigned long long l) { return current.set_dram_row_conflicts(l); }
 };
 #endif
 /*